@@ -0,0 +1,19 @@
+# Find package structure taken from libcurl
+
+include(FindPackageHandleStandardArgs)
+
+find_path(ZSTD_INCLUDE_DIRS zstd.h)
+find_library(ZSTD_LIBRARY zstd)
+
+find_package_handle_standard_args(Zstd
+    FOUND_VAR
+      ZSTD_FOUND
+    REQUIRED_VARS
+      ZSTD_LIBRARY
+      ZSTD_INCLUDE_DIRS
+    FAIL_MESSAGE
+      "Could NOT find zstd"
+)
+
+set(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIRS})
+set(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
@@ -0,0 +1,178 @@
+/*
+ *  IXBufferPool.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXBufferPool.h"
+
+#include <algorithm>
+
+namespace ix
+{
+    const size_t BufferPool::kDefaultMaxSize(256 * 1024);
+    const size_t BufferPool::kMinBufferSize(64);
+    const size_t BufferPool::kMaxBufferSize(1024 * 1024);
+    const size_t BufferPool::kClassCount(15); // 64 bytes to 1MB
+
+    double BufferPoolStats::getHitRatio() const
+    {
+        uint64_t requests = hits + misses;
+        return (requests == 0) ? 0 : (double) hits / requests;
+    }
+
+    std::string BufferAllocator::allocate(size_t capacity)
+    {
+        std::string buffer;
+        buffer.reserve(capacity);
+        return buffer;
+    }
+
+    void BufferAllocator::deallocate(std::string&& buffer)
+    {
+        std::string().swap(buffer);
+    }
+
+    BufferPool::BufferPool(size_t maxSize)
+        : _freeLists(kClassCount)
+        , _maxSize(maxSize)
+        , _allocator(std::make_shared<BufferAllocator>())
+    {
+    }
+
+    void BufferPool::setMaxSize(size_t maxSize)
+    {
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _maxSize = maxSize;
+
+            // Largest buffers first
+            for (size_t i = kClassCount; i-- > 0 && _stats.size > _maxSize;)
+            {
+                auto& freeList = _freeLists[i];
+                while (!freeList.empty() && _stats.size > _maxSize)
+                {
+                    _stats.size -= freeList.back().capacity();
+                    _stats.buffers--;
+                    evicted.push_back(std::move(freeList.back()));
+                    freeList.pop_back();
+                }
+            }
+        }
+
+        for (auto&& buffer : evicted)
+        {
+            _allocator->deallocate(std::move(buffer));
+        }
+    }
+
+    void BufferPool::setAllocator(const std::shared_ptr<BufferAllocator>& allocator)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _allocator = allocator ? allocator : std::make_shared<BufferAllocator>();
+    }
+
+    size_t BufferPool::getCapacityClass(size_t capacity)
+    {
+        if (capacity < kMinBufferSize) return kClassCount;
+
+        size_t capacityClass = 0;
+        while (capacityClass < kClassCount && (kMinBufferSize << (capacityClass + 1)) <= capacity)
+        {
+            capacityClass++;
+        }
+        return capacityClass;
+    }
+
+    std::string BufferPool::acquire(size_t size)
+    {
+        // Small strings do not allocate
+        if (size <= std::string().capacity()) return std::string();
+
+        std::shared_ptr<BufferAllocator> allocator;
+        size_t capacity = size;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (size <= kMaxBufferSize)
+            {
+                // Smallest class whose buffers are large enough, a buffer up to 4 times
+                // larger than needed can be used
+                size_t capacityClass = 0;
+                while ((kMinBufferSize << capacityClass) < size)
+                {
+                    capacityClass++;
+                }
+                capacity = kMinBufferSize << capacityClass;
+
+                size_t lastClass = std::min(capacityClass + 2, kClassCount - 1);
+                for (size_t i = capacityClass; i <= lastClass; ++i)
+                {
+                    auto& freeList = _freeLists[i];
+                    if (freeList.empty()) continue;
+
+                    std::string buffer(std::move(freeList.back()));
+                    freeList.pop_back();
+                    _stats.hits++;
+                    _stats.buffers--;
+                    _stats.size -= buffer.capacity();
+                    return buffer;
+                }
+            }
+
+            _stats.misses++;
+            allocator = _allocator;
+        }
+
+        // Rounded up to the class size, so that the buffer can be reused for other
+        // messages of about the same size
+        return allocator->allocate(capacity);
+    }
+
+    void BufferPool::release(std::string&& buffer)
+    {
+        size_t capacity = buffer.capacity();
+        if (capacity <= std::string().capacity()) return;
+
+        std::shared_ptr<BufferAllocator> allocator;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            size_t capacityClass = getCapacityClass(capacity);
+            if (capacityClass != kClassCount && _stats.size + capacity <= _maxSize)
+            {
+                buffer.clear();
+                _freeLists[capacityClass].push_back(std::move(buffer));
+                _stats.buffers++;
+                _stats.size += capacity;
+                return;
+            }
+
+            allocator = _allocator;
+        }
+
+        allocator->deallocate(std::move(buffer));
+    }
+
+    std::shared_ptr<std::string> BufferPool::share(std::string&& buffer)
+    {
+        std::weak_ptr<BufferPool> weakPool(shared_from_this());
+
+        return std::shared_ptr<std::string>(new std::string(std::move(buffer)),
+                                            [weakPool](std::string* sharedBuffer)
+                                            {
+                                                if (auto pool = weakPool.lock())
+                                                {
+                                                    pool->release(std::move(*sharedBuffer));
+                                                }
+                                                delete sharedBuffer;
+                                            });
+    }
+
+    BufferPoolStats BufferPool::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+} // namespace ix
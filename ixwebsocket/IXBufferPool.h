@@ -0,0 +1,87 @@
+/*
+ *  IXBufferPool.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Free lists of buffers, by power of two capacity classes, so that the buffers
+ *  used to receive, decompress and send messages are recycled instead of being
+ *  allocated for every message.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ix
+{
+    struct BufferPoolStats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t buffers = 0; // buffers held by the pool
+        size_t size = 0;    // bytes held by the pool
+
+        double getHitRatio() const;
+    };
+
+    // Source of the buffers when the pool has none large enough, and destination of
+    // the buffers it does not keep. An allocator shared by several pools must be
+    // thread safe.
+    class BufferAllocator
+    {
+    public:
+        virtual ~BufferAllocator() = default;
+
+        // An empty buffer, with at least capacity bytes reserved
+        virtual std::string allocate(size_t capacity);
+        virtual void deallocate(std::string&& buffer);
+    };
+
+    // Thread safe, since shared buffers can be released from any thread
+    class BufferPool : public std::enable_shared_from_this<BufferPool>
+    {
+    public:
+        BufferPool(size_t maxSize = BufferPool::kDefaultMaxSize);
+
+        // Bound on the total capacity of the pooled buffers. 0 disables the pool.
+        void setMaxSize(size_t maxSize);
+        void setAllocator(const std::shared_ptr<BufferAllocator>& allocator);
+
+        // An empty buffer, with at least size bytes reserved
+        std::string acquire(size_t size);
+
+        // Give a buffer back, its content is discarded
+        void release(std::string&& buffer);
+
+        // Share a buffer, which goes back to the pool once its last reference is
+        // released. The pool must be owned by a shared_ptr.
+        std::shared_ptr<std::string> share(std::string&& buffer);
+
+        BufferPoolStats getStats() const;
+
+        const static size_t kDefaultMaxSize;
+        const static size_t kMinBufferSize;
+        const static size_t kMaxBufferSize;
+
+    private:
+        // Index of the free list holding buffers of that capacity, or kClassCount
+        static size_t getCapacityClass(size_t capacity);
+
+        const static size_t kClassCount;
+
+        // Free lists of buffers with a capacity in [kMinBufferSize << i, kMinBufferSize << (i + 1))
+        std::vector<std::vector<std::string>> _freeLists;
+
+        size_t _maxSize;
+        std::shared_ptr<BufferAllocator> _allocator;
+        BufferPoolStats _stats;
+        mutable std::mutex _mutex;
+    };
+
+    using BufferPoolPtr = std::shared_ptr<BufferPool>;
+} // namespace ix
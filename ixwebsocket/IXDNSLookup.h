@@ -3,19 +3,16 @@
  *  Author: Benjamin Sergeant
  *  Copyright (c) 2018 Machine Zone, Inc. All rights reserved.
  *
- *  Resolve a hostname+port to a struct addrinfo obtained with getaddrinfo
- *  Does this in a background thread so that it can be cancelled, since
- *  getaddrinfo is a blocking call, and we don't want to block the main thread on Mobile.
+ *  Resolve a hostname+port to a struct addrinfo, with the process wide DNSResolver.
+ *  The lookup runs in a background thread of the resolver so that it can be cancelled,
+ *  and we don't want to block the main thread on Mobile.
  */
 
 #pragma once
 
 #include "IXCancellationRequest.h"
-#include <atomic>
 #include <cstdint>
 #include <memory>
-#include <mutex>
-#include <set>
 #include <string>
 
 struct addrinfo;
@@ -34,34 +31,9 @@ namespace ix
                                  bool cancellable = true);
 
     private:
-        AddrInfoPtr resolveCancellable(std::string& errMsg,
-                                            const CancellationRequest& isCancellationRequested);
-        AddrInfoPtr resolveUnCancellable(std::string& errMsg,
-                                              const CancellationRequest& isCancellationRequested);
-
-        AddrInfoPtr getAddrInfo(const std::string& hostname,
-                                            int port,
-                                            std::string& errMsg);
-
-        void run(std::weak_ptr<DNSLookup> self, std::string hostname, int port); // thread runner
-
-        void setErrMsg(const std::string& errMsg);
-        const std::string& getErrMsg();
-
-        void setRes(AddrInfoPtr addr);
-        AddrInfoPtr getRes();
-
         std::string _hostname;
         int _port;
-        int64_t _wait;
+        int64_t _wait; // interval between two checks of the cancellation request
         const static int64_t kDefaultWait;
-
-        AddrInfoPtr _res;
-        std::mutex _resMutex;
-
-        std::string _errMsg;
-        std::mutex _errMsgMutex;
-
-        std::atomic<bool> _done;
     };
 } // namespace ix
@@ -0,0 +1,1034 @@
+/*
+ *  IXDNSResolver.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+//
+// On Windows Universal Platform (uwp), gai_strerror defaults behavior is to returns wchar_t
+// which is different from all other platforms. We want the non unicode version.
+// See https://github.com/microsoft/vcpkg/pull/11030
+// We could do this in IXNetSystem.cpp but so far we are only using gai_strerror in here.
+//
+#ifdef _UNICODE
+#undef _UNICODE
+#endif
+#ifdef UNICODE
+#undef UNICODE
+#endif
+
+#include "IXDNSResolver.h"
+
+#include "IXSetThreadName.h"
+#include "IXSocket.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string.h>
+#include <sys/stat.h>
+
+// mingw build quirks
+#if defined(_WIN32) && defined(__GNUC__)
+#ifndef AI_NUMERICSERV
+#define AI_NUMERICSERV NI_NUMERICSERV
+#endif
+#ifndef AI_ADDRCONFIG
+#define AI_ADDRCONFIG LUP_ADDRCONFIG
+#endif
+#endif
+
+#ifdef __APPLE__
+#ifndef AI_NUMERICSERV
+#define AI_NUMERICSERV 0
+#endif
+#endif
+
+namespace
+{
+    // Record types and response codes of RFC 1035
+    const uint16_t kTypeA = 1;
+    const uint16_t kTypeCNAME = 5;
+    const uint16_t kTypeSOA = 6;
+    const uint16_t kTypeAAAA = 28;
+    const uint16_t kClassIN = 1;
+    const int kResponseNoError = 0;
+    const int kResponseNameError = 3;
+
+    const int kDNSPort = 53;
+    const size_t kMaxResponseSize = 4096;
+
+    // Defaults of resolv.conf
+    const int kDefaultQueryTimeoutMs = 5000;
+    const int kDefaultQueryAttempts = 2;
+
+    const char* kResolvConfPath = "/etc/resolv.conf";
+    const char* kHostsPath = "/etc/hosts";
+
+    // Addresses returned in an addrinfo list, which is freed by its shared pointer
+    struct AddrInfoNode
+    {
+        addrinfo info;
+        sockaddr_storage address;
+    };
+
+    std::string toLower(std::string value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        return value;
+    }
+
+    std::string getFileStamp(const char* path)
+    {
+        struct stat st;
+        if (stat(path, &st) != 0) return std::string();
+
+        return std::to_string((long long) st.st_mtime) + ':' +
+               std::to_string((long long) st.st_size);
+    }
+
+    socklen_t getAddressLength(const sockaddr_storage& address)
+    {
+        return (address.ss_family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+    }
+
+    // "ip", "ip:port" or "[ip]:port"
+    bool parseAddress(std::string host, int port, sockaddr_storage& address)
+    {
+        if (!host.empty() && host[0] == '[')
+        {
+            auto end = host.find(']');
+            if (end == std::string::npos) return false;
+
+            if (end + 1 < host.size())
+            {
+                if (host[end + 1] != ':') return false;
+                port = atoi(host.c_str() + end + 2);
+            }
+            host = host.substr(1, end - 1);
+        }
+        else if (std::count(host.begin(), host.end(), ':') == 1)
+        {
+            auto colon = host.find(':');
+            port = atoi(host.c_str() + colon + 1);
+            host = host.substr(0, colon);
+        }
+
+        if (port <= 0 || port > 65535) return false;
+
+        // Numeric hosts only, including IPv6 addresses with a scope
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+
+        struct addrinfo* res = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0)
+        {
+            return false;
+        }
+
+        memset(&address, 0, sizeof(address));
+        memcpy(&address, res->ai_addr, res->ai_addrlen);
+        freeaddrinfo(res);
+        return true;
+    }
+
+    // AAAA records are only queried with a route to IPv6 hosts, as AI_ADDRCONFIG does.
+    // Connecting a UDP socket looks up the route without sending anything.
+    bool hasIPv6Route()
+    {
+        sockaddr_storage address;
+        if (!parseAddress("[2001:4860:4860::8888]:53", kDNSPort, address)) return false;
+
+        ix::socket_t fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+        if (fd < 0) return false;
+
+        bool connected =
+            ::connect(fd, (const struct sockaddr*) &address, getAddressLength(address)) == 0;
+        ix::Socket::closeSocket(fd);
+        return connected;
+    }
+
+    bool encodeName(std::string name, std::string& encodedName)
+    {
+        if (!name.empty() && name.back() == '.') name.pop_back();
+        if (name.empty() || name.size() > 253) return false;
+
+        size_t start = 0;
+        while (start <= name.size())
+        {
+            size_t end = name.find('.', start);
+            if (end == std::string::npos) end = name.size();
+
+            size_t length = end - start;
+            if (length == 0 || length > 63) return false;
+
+            encodedName += (char) length;
+            encodedName.append(name, start, length);
+            start = end + 1;
+        }
+        encodedName += '\0';
+        return true;
+    }
+
+    void appendUint16(std::string& message, uint16_t value)
+    {
+        message += (char) (value >> 8);
+        message += (char) (value & 0xff);
+    }
+
+    std::string makeQuery(uint16_t id, const std::string& encodedName, uint16_t type)
+    {
+        std::string query;
+        appendUint16(query, id);
+        appendUint16(query, 0x0100); // recursion desired
+        appendUint16(query, 1);      // one question
+        appendUint16(query, 0);
+        appendUint16(query, 0);
+        appendUint16(query, 0);
+        query += encodedName;
+        appendUint16(query, type);
+        appendUint16(query, kClassIN);
+        return query;
+    }
+
+    class MessageReader
+    {
+    public:
+        MessageReader(const char* data, size_t size)
+            : _data(reinterpret_cast<const unsigned char*>(data))
+            , _size(size)
+            , _pos(0)
+        {
+        }
+
+        bool readUint16(uint16_t& value)
+        {
+            if (_pos + 2 > _size) return false;
+            value = (uint16_t) ((_data[_pos] << 8) | _data[_pos + 1]);
+            _pos += 2;
+            return true;
+        }
+
+        bool readUint32(uint32_t& value)
+        {
+            uint16_t high, low;
+            if (!readUint16(high) || !readUint16(low)) return false;
+            value = ((uint32_t) high << 16) | low;
+            return true;
+        }
+
+        bool readBytes(void* buffer, size_t length)
+        {
+            if (_pos + length > _size) return false;
+            memcpy(buffer, _data + _pos, length);
+            _pos += length;
+            return true;
+        }
+
+        // Names can point to a previous occurrence of their end (message compression)
+        bool readName(std::string& name)
+        {
+            name.clear();
+            size_t pos = _pos;
+            bool jumped = false;
+
+            for (int jumps = 0; jumps < 64;)
+            {
+                if (pos >= _size) return false;
+                unsigned char length = _data[pos];
+
+                if ((length & 0xc0) == 0xc0)
+                {
+                    if (pos + 1 >= _size) return false;
+                    if (!jumped) _pos = pos + 2;
+                    jumped = true;
+                    pos = ((length & 0x3f) << 8) | _data[pos + 1];
+                    ++jumps;
+                }
+                else if (length == 0)
+                {
+                    if (!jumped) _pos = pos + 1;
+                    return true;
+                }
+                else
+                {
+                    if (pos + 1 + length > _size) return false;
+                    if (!name.empty()) name += '.';
+                    name.append(reinterpret_cast<const char*>(_data + pos + 1), length);
+                    pos += 1 + length;
+                }
+            }
+            return false;
+        }
+
+        size_t getPosition() const
+        {
+            return _pos;
+        }
+
+        bool seek(size_t pos)
+        {
+            if (pos > _size) return false;
+            _pos = pos;
+            return true;
+        }
+
+    private:
+        const unsigned char* _data;
+        size_t _size;
+        size_t _pos;
+    };
+
+    struct Answer
+    {
+        int responseCode = 0;
+        bool truncated = false;
+        std::vector<sockaddr_storage> addresses;
+        uint32_t ttl = 0;
+        bool hasNegativeTTL = false;
+        uint32_t negativeTTL = 0;
+    };
+
+    bool readRecordHeader(MessageReader& reader,
+                          std::string& name,
+                          uint16_t& type,
+                          uint16_t& recordClass,
+                          uint32_t& ttl,
+                          uint16_t& length)
+    {
+        return reader.readName(name) && reader.readUint16(type) &&
+               reader.readUint16(recordClass) && reader.readUint32(ttl) &&
+               reader.readUint16(length);
+    }
+
+    // Returns false if the message is not the response to the query
+    bool parseResponse(const char* data,
+                       size_t size,
+                       uint16_t id,
+                       const std::string& name,
+                       uint16_t type,
+                       Answer& answer)
+    {
+        MessageReader reader(data, size);
+
+        uint16_t responseId, flags, questions, answers, authorities, additionals;
+        if (!reader.readUint16(responseId) || !reader.readUint16(flags) ||
+            !reader.readUint16(questions) || !reader.readUint16(answers) ||
+            !reader.readUint16(authorities) || !reader.readUint16(additionals))
+        {
+            return false;
+        }
+
+        if (responseId != id || (flags & 0x8000) == 0 || questions != 1) return false;
+
+        std::string questionName;
+        uint16_t questionType, questionClass;
+        if (!reader.readName(questionName) || !reader.readUint16(questionType) ||
+            !reader.readUint16(questionClass) || toLower(questionName) != name ||
+            questionType != type)
+        {
+            return false;
+        }
+
+        answer = Answer();
+        answer.responseCode = flags & 0x000f;
+        answer.truncated = (flags & 0x0200) != 0;
+        if (answer.truncated) return true;
+
+        // Follow the CNAME records from the name to the addresses
+        std::set<std::string> names = {name};
+        bool hasTTL = false;
+
+        for (uint16_t i = 0; i < answers; ++i)
+        {
+            std::string owner;
+            uint16_t recordType, recordClass, length;
+            uint32_t ttl;
+            if (!readRecordHeader(reader, owner, recordType, recordClass, ttl, length))
+            {
+                return false;
+            }
+            size_t next = reader.getPosition() + length;
+
+            if (recordClass == kClassIN && names.count(toLower(owner)) != 0)
+            {
+                bool used = false;
+                if (recordType == kTypeCNAME)
+                {
+                    std::string target;
+                    if (!reader.readName(target)) return false;
+                    names.insert(toLower(target));
+                    used = true;
+                }
+                else if (recordType == type && type == kTypeA && length == 4)
+                {
+                    sockaddr_storage address;
+                    memset(&address, 0, sizeof(address));
+                    auto addressV4 = reinterpret_cast<sockaddr_in*>(&address);
+                    addressV4->sin_family = AF_INET;
+                    if (!reader.readBytes(&addressV4->sin_addr, 4)) return false;
+                    answer.addresses.push_back(address);
+                    used = true;
+                }
+                else if (recordType == type && type == kTypeAAAA && length == 16)
+                {
+                    sockaddr_storage address;
+                    memset(&address, 0, sizeof(address));
+                    auto addressV6 = reinterpret_cast<sockaddr_in6*>(&address);
+                    addressV6->sin6_family = AF_INET6;
+                    if (!reader.readBytes(&addressV6->sin6_addr, 16)) return false;
+                    answer.addresses.push_back(address);
+                    used = true;
+                }
+
+                if (used)
+                {
+                    answer.ttl = hasTTL ? std::min(answer.ttl, ttl) : ttl;
+                    hasTTL = true;
+                }
+            }
+
+            if (!reader.seek(next)) return false;
+        }
+
+        // The absence of records is cached for the TTL of the SOA record (RFC 2308)
+        for (uint16_t i = 0; i < authorities; ++i)
+        {
+            std::string owner, primary, mailbox;
+            uint16_t recordType, recordClass, length;
+            uint32_t ttl;
+            if (!readRecordHeader(reader, owner, recordType, recordClass, ttl, length))
+            {
+                return false;
+            }
+            size_t next = reader.getPosition() + length;
+
+            uint32_t serial, refresh, retry, expire, minimum;
+            if (recordType == kTypeSOA && reader.readName(primary) && reader.readName(mailbox) &&
+                reader.readUint32(serial) && reader.readUint32(refresh) &&
+                reader.readUint32(retry) && reader.readUint32(expire) &&
+                reader.readUint32(minimum))
+            {
+                answer.hasNegativeTTL = true;
+                answer.negativeTTL = std::min(ttl, minimum);
+            }
+
+            if (!reader.seek(next)) return false;
+        }
+
+        return true;
+    }
+} // namespace
+
+namespace ix
+{
+    const size_t DNSResolver::kDefaultWorkerThreadCount(4);
+    const int64_t DNSResolver::kDefaultCancellationCheckIntervalMs(10);
+    const size_t DNSResolver::kMaxCacheEntries(1024);
+    const int DNSResolver::kMaxTTLSecs(3600);
+    const int DNSResolver::kDefaultNegativeTTLSecs(5);
+    const int DNSResolver::kSystemLookupTTLSecs(60);
+    const int DNSResolver::kNameserverRetryDelaySecs(60);
+    const int DNSResolver::kConfigurationCheckIntervalMs(5000);
+
+    DNSResolver::DNSResolver(size_t workerThreadCount)
+        : _stop(false)
+        , _queryTimeoutMs(0)
+    {
+        if (workerThreadCount == 0) workerThreadCount = 1;
+
+        for (size_t i = 0; i < workerThreadCount; ++i)
+        {
+            _threads.emplace_back(&DNSResolver::run, this);
+        }
+    }
+
+    DNSResolver::~DNSResolver()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+
+        for (auto&& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    DNSResolver& DNSResolver::getInstance()
+    {
+        // Never destroyed, so that lookups still work while static objects are destroyed
+        static DNSResolver* resolver = new DNSResolver();
+        return *resolver;
+    }
+
+    DNSResolver::AddrInfoPtr DNSResolver::resolve(
+        const std::string& hostname,
+        int port,
+        std::string& errMsg,
+        const CancellationRequest& isCancellationRequested,
+        bool cancellable,
+        int64_t checkIntervalMs)
+    {
+        errMsg = "no error";
+
+        if (isCancellationRequested && isCancellationRequested())
+        {
+            errMsg = "cancellation requested";
+            return nullptr;
+        }
+
+        // Numeric addresses need no lookup
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        struct addrinfo* res = nullptr;
+        if (getaddrinfo(hostname.c_str(), std::to_string(port).c_str(), &hints, &res) == 0)
+        {
+            return AddrInfoPtr {res, freeaddrinfo};
+        }
+
+        std::string key = toLower(hostname);
+        std::shared_ptr<PendingLookup> pendingLookup;
+        bool runLookup = false;
+        LookupResult result;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stats.lookups++;
+
+            auto it = _cache.find(key);
+            if (it != _cache.end())
+            {
+                if (std::chrono::steady_clock::now() < it->second.expiry)
+                {
+                    _stats.cacheHits++;
+                    result = it->second.result;
+                    lock.unlock();
+                    return makeAddrInfo(result, port, errMsg);
+                }
+                _cache.erase(it);
+            }
+
+            // Concurrent lookups of the same host wait for the first one
+            auto pending = _pendingLookups.find(key);
+            if (pending != _pendingLookups.end())
+            {
+                pendingLookup = pending->second;
+                _stats.coalescedLookups++;
+            }
+            else
+            {
+                pendingLookup = std::make_shared<PendingLookup>();
+                _pendingLookups[key] = pendingLookup;
+
+                if (cancellable)
+                {
+                    _queue.push_back(key);
+                    _condition.notify_one();
+                }
+                else
+                {
+                    runLookup = true;
+                }
+            }
+
+            auto checkInterval = std::chrono::milliseconds(std::max(checkIntervalMs, (int64_t) 1));
+            while (!runLookup && !pendingLookup->done)
+            {
+                if (!cancellable)
+                {
+                    pendingLookup->condition.wait(lock);
+                    continue;
+                }
+
+                // Woken up as soon as the lookup completes
+                pendingLookup->condition.wait_for(lock, checkInterval);
+                if (!pendingLookup->done && isCancellationRequested &&
+                    isCancellationRequested())
+                {
+                    _stats.cancelledLookups++;
+                    errMsg = "cancellation requested";
+                    return nullptr;
+                }
+            }
+
+            if (!runLookup) result = pendingLookup->result;
+        }
+
+        if (runLookup)
+        {
+            result = lookup(key);
+            complete(key, pendingLookup, result);
+        }
+
+        // Maybe a cancellation request got in before the lookup completed ?
+        if (cancellable && isCancellationRequested && isCancellationRequested())
+        {
+            errMsg = "cancellation requested";
+            return nullptr;
+        }
+
+        return makeAddrInfo(result, port, errMsg);
+    }
+
+    void DNSResolver::run()
+    {
+        setThreadName("DNSResolver");
+
+        while (true)
+        {
+            std::string key;
+            std::shared_ptr<PendingLookup> pendingLookup;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this] { return _stop || !_queue.empty(); });
+                if (_stop) return;
+
+                key = _queue.front();
+                _queue.pop_front();
+                pendingLookup = _pendingLookups[key];
+            }
+
+            complete(key, pendingLookup, lookup(key));
+        }
+    }
+
+    void DNSResolver::complete(const std::string& key,
+                               const std::shared_ptr<PendingLookup>& pendingLookup,
+                               const LookupResult& result)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        pendingLookup->result = result;
+        pendingLookup->done = true;
+        pendingLookup->condition.notify_all();
+        _pendingLookups.erase(key);
+
+        // Temporary failures, and records with a TTL of 0, are not cached
+        if (result.ttlSecs <= 0) return;
+
+        auto now = std::chrono::steady_clock::now();
+        if (_cache.size() >= kMaxCacheEntries)
+        {
+            for (auto it = _cache.begin(); it != _cache.end();)
+            {
+                if (now >= it->second.expiry)
+                {
+                    it = _cache.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        if (_cache.size() >= kMaxCacheEntries)
+        {
+            // Drop the entry which expires first
+            auto first = _cache.begin();
+            for (auto it = _cache.begin(); it != _cache.end(); ++it)
+            {
+                if (it->second.expiry < first->second.expiry) first = it;
+            }
+            _cache.erase(first);
+        }
+
+        CacheEntry entry;
+        entry.result = result;
+        entry.expiry = now + std::chrono::seconds(std::min(result.ttlSecs, kMaxTTLSecs));
+        _cache[key] = entry;
+    }
+
+    DNSResolver::LookupResult DNSResolver::lookup(const std::string& hostname)
+    {
+        Configuration configuration = getConfiguration();
+
+        // Only the nameservers set with setNameservers are queried directly. getaddrinfo
+        // follows nsswitch and the scoped resolvers of macOS, which resolv.conf does not
+        // describe. It also knows about /etc/hosts, and applies the search domains to the
+        // names without a dot.
+        bool useNameservers = !configuration.nameservers.empty() &&
+                              hostname.find('.') != std::string::npos &&
+                              configuration.hostNames.count(hostname) == 0;
+
+        LookupResult result;
+        if (useNameservers)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stats.nameserverQueries++;
+            }
+            if (queryNameservers(hostname, configuration, result)) return result;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.systemLookups++;
+        }
+        return systemLookup(hostname);
+    }
+
+    bool DNSResolver::queryNameservers(const std::string& hostname,
+                                       const Configuration& configuration,
+                                       LookupResult& result)
+    {
+        std::string encodedName;
+        if (!encodeName(hostname, encodedName)) return false;
+
+        std::string name(hostname);
+        if (name.back() == '.') name.pop_back();
+
+        // IPv6 addresses first, as getaddrinfo sorts them (RFC 6724)
+        std::vector<uint16_t> types;
+        if (configuration.hasIPv6Route) types.push_back(kTypeAAAA);
+        types.push_back(kTypeA);
+
+        std::random_device randomDevice;
+        std::mt19937 generator(randomDevice());
+        std::uniform_int_distribution<int> distribution(0, 0xffff);
+
+        for (int attempt = 0; attempt < configuration.attempts; ++attempt)
+        {
+            for (auto&& nameserver : configuration.nameservers)
+            {
+                socket_t fd = socket(nameserver.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+                if (fd < 0) continue;
+
+                // Connected, so that only the nameserver answers are received, and an
+                // unreachable nameserver is reported right away
+                if (::connect(fd,
+                              (const struct sockaddr*) &nameserver,
+                              getAddressLength(nameserver)) != 0)
+                {
+                    Socket::closeSocket(fd);
+                    continue;
+                }
+
+                std::vector<uint16_t> ids;
+                bool sent = true;
+                for (auto type : types)
+                {
+                    ids.push_back((uint16_t) distribution(generator));
+                    std::string query = makeQuery(ids.back(), encodedName, type);
+                    if (::send(fd, query.data(), (int) query.size(), 0) != (ssize_t) query.size())
+                    {
+                        sent = false;
+                    }
+                }
+
+                std::vector<Answer> answers(types.size());
+                std::vector<bool> received(types.size(), false);
+                size_t receivedCount = 0;
+                auto deadline = std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(configuration.timeoutMs);
+
+                while (sent && receivedCount < types.size())
+                {
+                    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now());
+                    if (remaining.count() <= 0) break;
+
+                    struct pollfd pfd;
+                    pfd.fd = fd;
+                    pfd.events = POLLIN;
+                    pfd.revents = 0;
+                    if (ix::poll(&pfd, 1, (int) remaining.count(), nullptr) <= 0) break;
+
+                    char buffer[kMaxResponseSize];
+                    ssize_t size = ::recv(fd, buffer, (int) sizeof(buffer), 0);
+                    if (size < 0)
+                    {
+                        if (Socket::isWaitNeeded()) continue;
+                        break; // e.g. connection refused
+                    }
+
+                    for (size_t i = 0; i < types.size(); ++i)
+                    {
+                        if (!received[i] && parseResponse(buffer,
+                                                          (size_t) size,
+                                                          ids[i],
+                                                          name,
+                                                          types[i],
+                                                          answers[i]))
+                        {
+                            received[i] = true;
+                            receivedCount++;
+                            break;
+                        }
+                    }
+                }
+                Socket::closeSocket(fd);
+
+                if (receivedCount < types.size()) continue;
+
+                bool nameError = false;
+                bool serverError = false;
+                for (auto&& answer : answers)
+                {
+                    // Large answers need TCP, which getaddrinfo uses
+                    if (answer.truncated) return false;
+
+                    if (answer.responseCode == kResponseNameError)
+                    {
+                        nameError = true;
+                    }
+                    else if (answer.responseCode != kResponseNoError)
+                    {
+                        serverError = true;
+                    }
+                }
+                if (serverError) continue;
+
+                bool hasTTL = false;
+                for (auto&& answer : answers)
+                {
+                    if (answer.addresses.empty()) continue;
+
+                    result.addresses.insert(
+                        result.addresses.end(), answer.addresses.begin(), answer.addresses.end());
+                    result.ttlSecs = hasTTL ? std::min(result.ttlSecs, (int) answer.ttl)
+                                            : (int) std::min(answer.ttl, (uint32_t) kMaxTTLSecs);
+                    hasTTL = true;
+                }
+                if (!result.addresses.empty()) return true;
+
+                // The search domains are tried by getaddrinfo
+                if (nameError && configuration.hasSearchDomains) return false;
+
+                result.errMsg = gai_strerror(EAI_NONAME);
+                result.ttlSecs = kDefaultNegativeTTLSecs;
+                for (auto&& answer : answers)
+                {
+                    if (answer.hasNegativeTTL)
+                    {
+                        result.ttlSecs = (int) std::min(answer.negativeTTL, (uint32_t) kMaxTTLSecs);
+                    }
+                }
+                return true;
+            }
+        }
+
+        // getaddrinfo is used until the nameservers are tried again
+        std::lock_guard<std::mutex> lock(_configurationMutex);
+        _nameserversRetryTime = std::chrono::steady_clock::now() +
+                                std::chrono::seconds(kNameserverRetryDelaySecs);
+        return false;
+    }
+
+    DNSResolver::LookupResult DNSResolver::systemLookup(const std::string& hostname)
+    {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_flags = AI_ADDRCONFIG;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        LookupResult result;
+
+        struct addrinfo* res = nullptr;
+        int getaddrinfo_result = getaddrinfo(hostname.c_str(), nullptr, &hints, &res);
+        if (getaddrinfo_result)
+        {
+            result.errMsg = gai_strerror(getaddrinfo_result);
+
+            // Temporary failures are not cached
+            result.ttlSecs = (getaddrinfo_result == EAI_AGAIN) ? 0 : kDefaultNegativeTTLSecs;
+            return result;
+        }
+
+        for (struct addrinfo* address = res; address != nullptr; address = address->ai_next)
+        {
+            sockaddr_storage storage;
+            memset(&storage, 0, sizeof(storage));
+            memcpy(&storage, address->ai_addr, address->ai_addrlen);
+
+            bool duplicate = false;
+            for (auto&& other : result.addresses)
+            {
+                duplicate = duplicate || memcmp(&other, &storage, sizeof(storage)) == 0;
+            }
+            if (!duplicate) result.addresses.push_back(storage);
+        }
+        freeaddrinfo(res);
+
+        result.ttlSecs = kSystemLookupTTLSecs;
+        return result;
+    }
+
+    DNSResolver::AddrInfoPtr DNSResolver::makeAddrInfo(const LookupResult& result,
+                                                       int port,
+                                                       std::string& errMsg)
+    {
+        if (result.addresses.empty())
+        {
+            errMsg = result.errMsg;
+            return nullptr;
+        }
+
+        AddrInfoNode* first = nullptr;
+        AddrInfoNode* last = nullptr;
+        for (auto&& address : result.addresses)
+        {
+            auto node = new AddrInfoNode();
+            node->address = address;
+            if (address.ss_family == AF_INET6)
+            {
+                reinterpret_cast<sockaddr_in6*>(&node->address)->sin6_port = htons(port);
+            }
+            else
+            {
+                reinterpret_cast<sockaddr_in*>(&node->address)->sin_port = htons(port);
+            }
+
+            node->info.ai_family = address.ss_family;
+            node->info.ai_socktype = SOCK_STREAM;
+            node->info.ai_protocol = IPPROTO_TCP;
+            node->info.ai_addrlen = getAddressLength(address);
+            node->info.ai_addr = reinterpret_cast<struct sockaddr*>(&node->address);
+
+            if (last != nullptr)
+            {
+                last->info.ai_next = &node->info;
+            }
+            else
+            {
+                first = node;
+            }
+            last = node;
+        }
+
+        return AddrInfoPtr {&first->info, [](addrinfo* info) {
+                                while (info != nullptr)
+                                {
+                                    addrinfo* next = info->ai_next;
+                                    delete reinterpret_cast<AddrInfoNode*>(info);
+                                    info = next;
+                                }
+                            }};
+    }
+
+    DNSResolver::Configuration DNSResolver::getConfiguration()
+    {
+        std::lock_guard<std::mutex> lock(_configurationMutex);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= _nextConfigurationCheck)
+        {
+            loadConfiguration();
+            _configuration.hasIPv6Route = hasIPv6Route();
+            _nextConfigurationCheck =
+                now + std::chrono::milliseconds(kConfigurationCheckIntervalMs);
+        }
+
+        Configuration configuration = _configuration;
+        configuration.nameservers = _nameservers;
+        if (_queryTimeoutMs > 0) configuration.timeoutMs = _queryTimeoutMs;
+        if (now < _nameserversRetryTime) configuration.nameservers.clear();
+        return configuration;
+    }
+
+    void DNSResolver::loadConfiguration()
+    {
+        std::string stamp = getFileStamp(kResolvConfPath) + '\n' + getFileStamp(kHostsPath);
+        if (!_configurationStamp.empty() && stamp == _configurationStamp) return;
+        _configurationStamp = stamp;
+
+        Configuration configuration;
+        configuration.timeoutMs = kDefaultQueryTimeoutMs;
+        configuration.attempts = kDefaultQueryAttempts;
+
+        std::string line;
+        std::ifstream resolvConf(kResolvConfPath);
+        while (std::getline(resolvConf, line))
+        {
+            std::istringstream iss(line);
+            std::string keyword, value;
+            iss >> keyword;
+
+            if ((keyword == "search" || keyword == "domain") && iss >> value)
+            {
+                configuration.hasSearchDomains = true;
+            }
+            else if (keyword == "options")
+            {
+                while (iss >> value)
+                {
+                    if (value.compare(0, 8, "timeout:") == 0)
+                    {
+                        configuration.timeoutMs = 1000 * std::max(1, atoi(value.c_str() + 8));
+                    }
+                    else if (value.compare(0, 9, "attempts:") == 0)
+                    {
+                        configuration.attempts = std::max(1, atoi(value.c_str() + 9));
+                    }
+                }
+            }
+        }
+
+        std::ifstream hosts(kHostsPath);
+        while (std::getline(hosts, line))
+        {
+            std::istringstream iss(line.substr(0, line.find('#')));
+            std::string address, hostName;
+            iss >> address;
+            while (iss >> hostName)
+            {
+                configuration.hostNames.insert(toLower(hostName));
+            }
+        }
+
+        _configuration = configuration;
+    }
+
+    void DNSResolver::setNameservers(const std::vector<std::string>& nameservers)
+    {
+        std::vector<sockaddr_storage> addresses;
+        for (auto&& nameserver : nameservers)
+        {
+            sockaddr_storage address;
+            if (parseAddress(nameserver, kDNSPort, address))
+            {
+                addresses.push_back(address);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_configurationMutex);
+        _nameservers = addresses;
+        _nameserversRetryTime = std::chrono::steady_clock::time_point();
+    }
+
+    void DNSResolver::setQueryTimeout(int timeoutMs)
+    {
+        std::lock_guard<std::mutex> lock(_configurationMutex);
+        _queryTimeoutMs = timeoutMs;
+    }
+
+    void DNSResolver::invalidate(const std::string& hostname)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cache.erase(toLower(hostname));
+    }
+
+    void DNSResolver::clearCache()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cache.clear();
+    }
+
+    DNSResolverStats DNSResolver::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+} // namespace ix
@@ -0,0 +1,165 @@
+/*
+ *  IXDNSResolver.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Resolver used by DNSLookup. Lookups run on a bounded pool of worker threads, and
+ *  concurrent lookups of the same host share a single one. Names are resolved with
+ *  getaddrinfo, and cached for a fixed time. With nameservers set with setNameservers,
+ *  they are queried over UDP instead, and their addresses (or their absence) are cached
+ *  for the TTL of the DNS records. Names of /etc/hosts, names without a dot and names
+ *  which need the search domains still go through getaddrinfo, as do all names when the
+ *  nameservers do not answer. The addresses of a host are dropped from the cache when
+ *  none of them could be connected to.
+ */
+
+#pragma once
+
+#include "IXCancellationRequest.h"
+#include "IXNetSystem.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ix
+{
+    struct DNSResolverStats
+    {
+        uint64_t lookups = 0;
+        uint64_t cacheHits = 0;         // including the hosts which do not exist
+        uint64_t coalescedLookups = 0;  // waited for the lookup of another caller
+        uint64_t cancelledLookups = 0;
+        uint64_t nameserverQueries = 0; // hosts queried over UDP
+        uint64_t systemLookups = 0;     // hosts resolved with getaddrinfo
+    };
+
+    class DNSResolver
+    {
+    public:
+        using AddrInfoPtr = std::shared_ptr<addrinfo>;
+
+        DNSResolver(size_t workerThreadCount = DNSResolver::kDefaultWorkerThreadCount);
+        ~DNSResolver();
+
+        // Process wide resolver
+        static DNSResolver& getInstance();
+
+        // The cancellation request is checked every checkIntervalMs while
+        // waiting for a worker thread. A cancelled lookup still completes in the
+        // background, and fills the cache. Without cancellable, the lookup runs in the
+        // calling thread.
+        AddrInfoPtr resolve(const std::string& hostname,
+                            int port,
+                            std::string& errMsg,
+                            const CancellationRequest& isCancellationRequested,
+                            bool cancellable = true,
+                            int64_t checkIntervalMs = kDefaultCancellationCheckIntervalMs);
+
+        // Nameservers queried over UDP instead of resolving names with getaddrinfo, as "ip"
+        // or "ip:port" ("[ip]:port" for IPv6). An empty list goes back to getaddrinfo.
+        void setNameservers(const std::vector<std::string>& nameservers);
+
+        // Time to wait for an answer, before trying the next nameserver
+        void setQueryTimeout(int timeoutMs);
+
+        // Drops the cached addresses of a host, when they could not be connected to
+        void invalidate(const std::string& hostname);
+
+        void clearCache();
+        DNSResolverStats getStats() const;
+
+        const static size_t kDefaultWorkerThreadCount;
+        const static int64_t kDefaultCancellationCheckIntervalMs;
+        const static size_t kMaxCacheEntries;
+
+        // Bounds of the TTL of the cached answers
+        const static int kMaxTTLSecs;
+        const static int kDefaultNegativeTTLSecs;
+
+        // getaddrinfo does not return the TTL of the records
+        const static int kSystemLookupTTLSecs;
+
+        // Nameservers which did not answer are not queried again before this delay
+        const static int kNameserverRetryDelaySecs;
+
+    private:
+        struct LookupResult
+        {
+            std::vector<sockaddr_storage> addresses;
+            std::string errMsg;
+            int ttlSecs = 0;
+        };
+
+        struct PendingLookup
+        {
+            bool done = false;
+            LookupResult result;
+            std::condition_variable condition;
+        };
+
+        struct CacheEntry
+        {
+            LookupResult result;
+            std::chrono::steady_clock::time_point expiry;
+        };
+
+        // Contents of /etc/resolv.conf and /etc/hosts, and nameservers set with
+        // setNameservers
+        struct Configuration
+        {
+            std::vector<sockaddr_storage> nameservers;
+            bool hasIPv6Route = false;
+            bool hasSearchDomains = false;
+            int timeoutMs = 0;
+            int attempts = 0;
+            std::set<std::string> hostNames;
+        };
+
+        void run(); // worker threads runner
+
+        LookupResult lookup(const std::string& hostname);
+        bool queryNameservers(const std::string& hostname,
+                              const Configuration& configuration,
+                              LookupResult& result);
+        LookupResult systemLookup(const std::string& hostname);
+
+        // Reads the configuration files again when they changed
+        Configuration getConfiguration();
+        void loadConfiguration();
+
+        void complete(const std::string& key,
+                      const std::shared_ptr<PendingLookup>& pendingLookup,
+                      const LookupResult& result);
+
+        static AddrInfoPtr makeAddrInfo(const LookupResult& result,
+                                        int port,
+                                        std::string& errMsg);
+
+        std::vector<std::thread> _threads;
+        std::deque<std::string> _queue;
+        std::map<std::string, std::shared_ptr<PendingLookup>> _pendingLookups;
+        std::map<std::string, CacheEntry> _cache;
+        DNSResolverStats _stats;
+        bool _stop;
+        mutable std::mutex _mutex;
+        std::condition_variable _condition;
+
+        std::mutex _configurationMutex;
+        Configuration _configuration;
+        std::string _configurationStamp;
+        std::chrono::steady_clock::time_point _nextConfigurationCheck;
+        std::vector<sockaddr_storage> _nameservers; // set with setNameservers
+        int _queryTimeoutMs;
+        std::chrono::steady_clock::time_point _nameserversRetryTime;
+
+        const static int kConfigurationCheckIntervalMs;
+    };
+} // namespace ix
@@ -7,8 +7,8 @@
 #include "IXGzipCodec.h"
 
 #include "IXBench.h"
+#include "IXUniquePtr.h"
 #include <array>
-#include <string.h>
 
 #ifdef IXWEBSOCKET_USE_ZLIB
 #include <zlib.h>
@@ -16,51 +16,38 @@
 
 namespace ix
 {
-    std::string gzipCompress(const std::string& str)
+    namespace
     {
-#ifndef IXWEBSOCKET_USE_ZLIB
-        return std::string();
-#else
-        z_stream zs; // z_stream is zlib's control structure
-        memset(&zs, 0, sizeof(zs));
-
-        // deflateInit2 configure the file format: request gzip instead of deflate
-        const int windowBits = 15;
-        const int GZIP_ENCODING = 16;
+        // Streams used by the one-shot helpers, reset between calls
+        GzipStream* getThreadStream(GzipStream::Mode mode)
+        {
+            thread_local GzipStream compressStream(GzipStream::Mode::Compress);
+            thread_local GzipStream decompressStream(GzipStream::Mode::Decompress);
 
-        deflateInit2(&zs,
-                     Z_DEFAULT_COMPRESSION,
-                     Z_DEFLATED,
-                     windowBits | GZIP_ENCODING,
-                     8,
-                     Z_DEFAULT_STRATEGY);
+            GzipStream* stream =
+                (mode == GzipStream::Mode::Compress) ? &compressStream : &decompressStream;
+            return stream->reset() ? stream : nullptr;
+        }
+    } // namespace
 
-        zs.next_in = (Bytef*) str.data();
-        zs.avail_in = (uInt) str.size(); // set the z_stream's input
+    std::string gzipCompress(const std::string& str)
+    {
+        std::string out;
 
-        int ret;
-        char outbuffer[32768];
-        std::string outstring;
+        GzipStream* stream = getThreadStream(GzipStream::Mode::Compress);
+        if (stream == nullptr) return out;
 
-        // retrieve the compressed bytes blockwise
-        do
+        auto append = [&out](const char* data, size_t size) -> bool
         {
-            zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-            zs.avail_out = sizeof(outbuffer);
+            out.append(data, size);
+            return true;
+        };
 
-            ret = deflate(&zs, Z_FINISH);
-
-            if (outstring.size() < zs.total_out)
-            {
-                // append the block to the output string
-                outstring.append(outbuffer, zs.total_out - outstring.size());
-            }
-        } while (ret == Z_OK);
-
-        deflateEnd(&zs);
-
-        return outstring;
-#endif // IXWEBSOCKET_USE_ZLIB
+        if (!stream->write(str, append) || !stream->finish(append))
+        {
+            out.clear();
+        }
+        return out;
     }
 
 #ifdef IXWEBSOCKET_USE_DEFLATE
@@ -72,48 +59,180 @@ namespace ix
 #endif
 
     bool gzipDecompress(const std::string& in, std::string& out)
+    {
+        GzipStream* stream = getThreadStream(GzipStream::Mode::Decompress);
+        if (stream == nullptr) return false;
+
+        auto append = [&out](const char* data, size_t size) -> bool
+        {
+            out.append(data, size);
+            return true;
+        };
+
+        return stream->write(in, append) && stream->finish(append);
+    }
+
+    const size_t GzipStream::kChunkSize(1 << 14);
+
+    GzipStream::GzipStream(Mode mode)
+        : _mode(mode)
+        , _initialized(false)
+        , _finished(false)
+#ifdef IXWEBSOCKET_USE_ZLIB
+        , _stream(ix::make_unique<z_stream>())
+#endif
+    {
+    }
+
+    GzipStream::~GzipStream()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_initialized) return;
+
+        if (_mode == Mode::Compress)
+        {
+            deflateEnd(_stream.get());
+        }
+        else
+        {
+            inflateEnd(_stream.get());
+        }
+#endif
+    }
+
+    bool GzipStream::init()
+    {
+#ifndef IXWEBSOCKET_USE_ZLIB
+        return false;
+#else
+        // 16 selects the gzip format instead of raw deflate
+        const int windowBits = 16 + MAX_WBITS;
+
+        if (_mode == Mode::Compress)
+        {
+            _initialized = deflateInit2(_stream.get(),
+                                        Z_DEFAULT_COMPRESSION,
+                                        Z_DEFLATED,
+                                        windowBits,
+                                        8,
+                                        Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+        else
+        {
+            _initialized = inflateInit2(_stream.get(), windowBits) == Z_OK;
+        }
+
+        return _initialized;
+#endif // IXWEBSOCKET_USE_ZLIB
+    }
+
+    bool GzipStream::reset()
     {
 #ifndef IXWEBSOCKET_USE_ZLIB
         return false;
 #else
-        z_stream inflateState;
-        memset(&inflateState, 0, sizeof(inflateState));
+        if (!_initialized) return init();
+
+        _finished = false;
+        int ret = (_mode == Mode::Compress) ? deflateReset(_stream.get())
+                                            : inflateReset(_stream.get());
+        return ret == Z_OK;
+#endif // IXWEBSOCKET_USE_ZLIB
+    }
 
-        inflateState.zalloc = Z_NULL;
-        inflateState.zfree = Z_NULL;
-        inflateState.opaque = Z_NULL;
-        inflateState.avail_in = 0;
-        inflateState.next_in = Z_NULL;
+    GzipStream::Mode GzipStream::getMode() const
+    {
+        return _mode;
+    }
 
-        if (inflateInit2(&inflateState, 16 + MAX_WBITS) != Z_OK)
+    bool GzipStream::write(const char* data, size_t size, const OnOutputCallback& onOutput)
+    {
+#ifndef IXWEBSOCKET_USE_ZLIB
+        (void) data;
+        (void) size;
+        (void) onOutput;
+        return false;
+#else
+        if (!_initialized) return false;
+
+        // Bytes following the end of a gzip stream are ignored
+        if (_finished || size == 0) return true;
+
+        _stream->next_in = (Bytef*) data;
+        _stream->avail_in = (uInt) size;
+
+        return process(Z_NO_FLUSH, onOutput);
+#endif // IXWEBSOCKET_USE_ZLIB
+    }
+
+    bool GzipStream::write(const std::string& data, const OnOutputCallback& onOutput)
+    {
+        return write(data.data(), data.size(), onOutput);
+    }
+
+    bool GzipStream::finish(const OnOutputCallback& onOutput)
+    {
+#ifndef IXWEBSOCKET_USE_ZLIB
+        (void) onOutput;
+        return false;
+#else
+        if (!_initialized) return false;
+
+        if (_mode == Mode::Decompress)
         {
-            return false;
+            return _finished;
         }
 
-        inflateState.avail_in = (uInt) in.size();
-        inflateState.next_in = (unsigned char*) (const_cast<char*>(in.data()));
+        if (_finished) return true;
 
-        const int kBufferSize = 1 << 14;
-        std::array<unsigned char, kBufferSize> compressBuffer;
+        _stream->next_in = Z_NULL;
+        _stream->avail_in = 0;
+        return process(Z_FINISH, onOutput);
+#endif // IXWEBSOCKET_USE_ZLIB
+    }
+
+    bool GzipStream::isFinished() const
+    {
+        return _finished;
+    }
 
+    bool GzipStream::process(int flush, const OnOutputCallback& onOutput)
+    {
+#ifndef IXWEBSOCKET_USE_ZLIB
+        (void) flush;
+        (void) onOutput;
+        return false;
+#else
+        // Run until all the input is consumed and the output buffer is not filled
+        // completely, which means that zlib has nothing more to output
         do
         {
-            inflateState.avail_out = (uInt) kBufferSize;
-            inflateState.next_out = &compressBuffer.front();
+            _stream->next_out = &_outputBuffer.front();
+            _stream->avail_out = (uInt) _outputBuffer.size();
+
+            int ret = (_mode == Mode::Compress) ? deflate(_stream.get(), flush)
+                                                : inflate(_stream.get(), Z_NO_FLUSH);
 
-            int ret = inflate(&inflateState, Z_SYNC_FLUSH);
+            if (ret == Z_STREAM_END)
+            {
+                _finished = true;
+            }
+            else if (ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                return false;
+            }
 
-            if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
+            size_t outputSize = _outputBuffer.size() - _stream->avail_out;
+            if (outputSize > 0 &&
+                !onOutput(reinterpret_cast<const char*>(&_outputBuffer.front()), outputSize))
             {
-                inflateEnd(&inflateState);
                 return false;
             }
 
-            out.append(reinterpret_cast<char*>(&compressBuffer.front()),
-                       kBufferSize - inflateState.avail_out);
-        } while (inflateState.avail_out == 0);
+            // No progress is possible
+            if (ret == Z_BUF_ERROR && outputSize == 0) break;
+        } while (!_finished && (_stream->avail_in != 0 || _stream->avail_out == 0));
 
-        inflateEnd(&inflateState);
         return true;
 #endif // IXWEBSOCKET_USE_ZLIB
     }
@@ -6,10 +6,76 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <string>
 
+#ifdef IXWEBSOCKET_USE_ZLIB
+// Defined by zlib.h, which is only included by the implementation, as applications
+// do not need the zlib headers
+struct z_stream_s;
+#endif
+
 namespace ix
 {
+    // One-shot helpers. They use a stream per thread, which is reset instead of
+    // being allocated again for every call.
     std::string gzipCompress(const std::string& str);
     bool gzipDecompress(const std::string& in, std::string& out);
+
+    // Incremental gzip compression or decompression. Input is passed in pieces, and
+    // the output is delivered as it is produced, in chunks of at most kChunkSize bytes,
+    // so that large bodies never need to be held in memory. A stream can be reset and
+    // reused for another body, which keeps the zlib state allocated.
+    class GzipStream
+    {
+    public:
+        enum class Mode
+        {
+            Compress,
+            Decompress
+        };
+
+        // Returning false stops the stream, and fails the write or finish call
+        using OnOutputCallback = std::function<bool(const char* data, size_t size)>;
+
+        GzipStream(Mode mode);
+        ~GzipStream();
+
+        GzipStream(const GzipStream&) = delete;
+        GzipStream& operator=(const GzipStream&) = delete;
+
+        bool init();
+
+        // Get ready for a new body. The stream is initialized on first use.
+        bool reset();
+
+        Mode getMode() const;
+
+        bool write(const char* data, size_t size, const OnOutputCallback& onOutput);
+        bool write(const std::string& data, const OnOutputCallback& onOutput);
+
+        // Compress: flush the remaining output and the gzip trailer.
+        // Decompress: fails if the end of the gzip stream was not reached.
+        bool finish(const OnOutputCallback& onOutput);
+
+        // The end of the gzip stream was reached
+        bool isFinished() const;
+
+        const static size_t kChunkSize;
+
+    private:
+        bool process(int flush, const OnOutputCallback& onOutput);
+
+        Mode _mode;
+        bool _initialized;
+        bool _finished;
+        std::array<unsigned char, 1 << 14> _outputBuffer;
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+        std::unique_ptr<z_stream_s> _stream;
+#endif
+    };
 } // namespace ix
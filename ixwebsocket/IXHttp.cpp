@@ -9,6 +9,8 @@
 #include "IXCancellationRequest.h"
 #include "IXGzipCodec.h"
 #include "IXSocket.h"
+#include "IXStrCaseCompare.h"
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
@@ -183,8 +185,149 @@ namespace ix
         return std::make_tuple(true, "", httpRequest);
     }
 
-    bool Http::sendResponse(HttpResponsePtr response, std::unique_ptr<Socket>& socket)
+    namespace
     {
+        // Fixed size writes, so that TLS sockets fill whole records
+        constexpr size_t kStreamChunkSize = 16 * 1024;
+
+        // Upper bound of a single sendfile call, so that a large file does not keep a
+        // slow client's socket busy for too long
+        constexpr size_t kSendFileChunkSize = 1024 * 1024;
+
+        // Wake up regularly to check for cancellation, a client which stopped reading
+        // would make us wait forever
+        constexpr int kWritePollIntervalMs = 100;
+
+        bool waitForWrite(std::unique_ptr<Socket>& socket,
+                          const CancellationRequest& isCancellationRequested)
+        {
+            PollResultType pollResult = PollResultType::Timeout;
+            while (pollResult == PollResultType::Timeout)
+            {
+                if (isCancellationRequested && isCancellationRequested()) return false;
+
+                pollResult = socket->isReadyToWrite(kWritePollIntervalMs);
+            }
+            return pollResult == PollResultType::ReadyForWrite;
+        }
+
+        bool sendFileBody(const HttpBodySourcePtr& bodySource,
+                          std::unique_ptr<Socket>& socket,
+                          const CancellationRequest& isCancellationRequested)
+        {
+            uint64_t remaining = (uint64_t) bodySource->getSize();
+            while (remaining > 0)
+            {
+                size_t length = (size_t) std::min(remaining, (uint64_t) kSendFileChunkSize);
+                ssize_t ret =
+                    socket->sendFile(bodySource->getFd(), bodySource->getOffset(), length);
+
+                if (ret > 0)
+                {
+                    bodySource->consume((uint64_t) ret);
+                    remaining -= (uint64_t) ret;
+                }
+                else if (ret < 0 && Socket::isWaitNeeded())
+                {
+                    if (!waitForWrite(socket, isCancellationRequested)) return false;
+                }
+                else
+                {
+                    return false; // error, or the file was truncated
+                }
+            }
+            return true;
+        }
+
+        // The headers and a body held in memory are sent with scatter gather sends, so
+        // that the body is not copied, and small ones go in a single send
+        bool sendBufferBody(const std::string& head,
+                            const char* data,
+                            size_t size,
+                            std::unique_ptr<Socket>& socket,
+                            const CancellationRequest& isCancellationRequested)
+        {
+            SendBuffer buffers[2] = {{head.data(), head.size()}, {data, size}};
+            size_t index = 0;
+            while (index < 2)
+            {
+                if (isCancellationRequested && isCancellationRequested()) return false;
+
+                ssize_t ret = socket->send(buffers + index, 2 - index);
+                if (ret > 0)
+                {
+                    size_t sent = (size_t) ret;
+                    while (index < 2 && sent >= buffers[index].size)
+                    {
+                        sent -= buffers[index].size;
+                        index++;
+                    }
+                    if (index < 2)
+                    {
+                        buffers[index].data += sent;
+                        buffers[index].size -= sent;
+                    }
+                }
+                else if (ret < 0 && Socket::isWaitNeeded())
+                {
+                    if (!waitForWrite(socket, isCancellationRequested)) return false;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool sendStreamedBody(const HttpBodySourcePtr& bodySource,
+                              std::unique_ptr<Socket>& socket,
+                              const CancellationRequest& isCancellationRequested)
+        {
+            int64_t size = bodySource->getSize();
+            bool chunked = size < 0;
+            uint64_t sent = 0;
+
+            std::vector<char> buffer(kStreamChunkSize);
+            std::string data;
+
+            while (true)
+            {
+                ssize_t ret = bodySource->read(&buffer.front(), buffer.size());
+                if (ret < 0) return false;
+                if (ret == 0) break;
+
+                data.clear();
+                if (chunked)
+                {
+                    std::stringstream ss;
+                    ss << std::hex << ret << "\r\n";
+                    data = ss.str();
+                }
+                data.append(&buffer.front(), (size_t) ret);
+                if (chunked) data += "\r\n";
+
+                if (!socket->writeBytes(data, isCancellationRequested)) return false;
+                sent += (uint64_t) ret;
+            }
+
+            if (chunked)
+            {
+                return socket->writeBytes("0\r\n\r\n", isCancellationRequested);
+            }
+
+            // The client expects Content-Length bytes
+            return sent == (uint64_t) size;
+        }
+    } // namespace
+
+    bool Http::sendResponse(HttpResponsePtr response,
+                            std::unique_ptr<Socket>& socket,
+                            bool keepAlive,
+                            const CancellationRequest& isCancellationRequested)
+    {
+        const HttpBodySourcePtr& bodySource = response->bodySource;
+
         // Write the response to the socket
         std::stringstream ss;
         ss << "HTTP/1.1 ";
@@ -193,25 +336,71 @@ namespace ix
         ss << response->description;
         ss << "\r\n";
 
-        if (!socket->writeBytes(ss.str(), nullptr))
+        // Write headers
+        CaseInsensitiveLess less;
+        const std::string connection("Connection");
+        int64_t bodySize = bodySource ? bodySource->getSize() : (int64_t) response->body.size();
+
+        // These responses cannot have a body
+        bool hasBody = response->statusCode != 204 && response->statusCode != 304;
+        if (hasBody && bodySize >= 0)
         {
-            return false;
+            ss << "Content-Length: " << bodySize << "\r\n";
+        }
+        else if (hasBody)
+        {
+            ss << "Transfer-Encoding: chunked\r\n";
         }
-
-        // Write headers
-        ss.str("");
-        ss << "Content-Length: " << response->body.size() << "\r\n";
         for (auto&& it : response->headers)
         {
+            // Whether the connection is kept open is decided by the server
+            if (!less(it.first, connection) && !less(connection, it.first)) continue;
+
             ss << it.first << ": " << it.second << "\r\n";
         }
+        ss << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n";
         ss << "\r\n";
 
-        if (!socket->writeBytes(ss.str(), nullptr))
+        if (!hasBody)
+        {
+            return socket->writeBytes(ss.str(), isCancellationRequested);
+        }
+
+        if (bodySource)
+        {
+            const char* data;
+            size_t size;
+            if (bodySource->getBuffer(data, size))
+            {
+                return sendBufferBody(ss.str(), data, size, socket, isCancellationRequested);
+            }
+
+            if (!socket->writeBytes(ss.str(), isCancellationRequested))
+            {
+                return false;
+            }
+
+            if (bodySize > 0 && bodySource->getFd() != -1 && socket->isSendFileSupported())
+            {
+                return sendFileBody(bodySource, socket, isCancellationRequested);
+            }
+
+            return sendStreamedBody(bodySource, socket, isCancellationRequested);
+        }
+
+        // Small bodies are sent along with the headers, in a single write
+        constexpr size_t kMaxCoalescedBodySize = 16 * 1024;
+        if (response->body.size() <= kMaxCoalescedBodySize)
+        {
+            ss << response->body;
+            return socket->writeBytes(ss.str(), isCancellationRequested);
+        }
+
+        if (!socket->writeBytes(ss.str(), isCancellationRequested))
         {
             return false;
         }
 
-        return response->body.empty() ? true : socket->writeBytes(response->body, nullptr);
+        return socket->writeBytes(response->body, isCancellationRequested);
     }
 } // namespace ix
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "IXCancellationRequest.h"
+#include "IXHttpBodySource.h"
 #include "IXProgressCallback.h"
 #include "IXWebSocketHttpHeaders.h"
 #include <atomic>
@@ -33,6 +35,7 @@ namespace ix
         ChunkReadError = 13,
         CannotReadBody = 14,
         Cancelled = 15,
+        CannotWriteBody = 16,
         Invalid = 100
     };
 
@@ -47,6 +50,10 @@ namespace ix
         uint64_t uploadSize;
         uint64_t downloadSize;
 
+        // Server side only. When set, the body is streamed from this source instead of
+        // being sent from the body string.
+        HttpBodySourcePtr bodySource;
+
         HttpResponse(int s = 0,
                      const std::string& des = std::string(),
                      const HttpErrorCode& c = HttpErrorCode::Ok,
@@ -91,7 +98,13 @@ namespace ix
         Logger logger;
         OnProgressCallback onProgressCallback;
         OnChunkCallback onChunkCallback;
+        // The body is streamed to onBodyCallback and/or written to outputPath as it is
+        // received (decompressed if needed) instead of being stored in the response.
+        // Returning false from onBodyCallback aborts the transfer.
+        OnBodyCallback onBodyCallback;
+        std::string outputPath;
         std::atomic<bool> cancel;
+        int priority = 0; // async requests with a higher priority are executed first
     };
 
     using HttpRequestArgsPtr = std::shared_ptr<HttpRequestArgs>;
@@ -125,7 +138,12 @@ namespace ix
     public:
         static std::tuple<bool, std::string, HttpRequestPtr> parseRequest(
             std::unique_ptr<Socket>& socket, int timeoutSecs);
-        static bool sendResponse(HttpResponsePtr response, std::unique_ptr<Socket>& socket);
+        // Returns false when isCancellationRequested fires before the whole response
+        // could be written, e.g. because the client stopped reading
+        static bool sendResponse(HttpResponsePtr response,
+                                 std::unique_ptr<Socket>& socket,
+                                 bool keepAlive = false,
+                                 const CancellationRequest& isCancellationRequested = nullptr);
 
         static std::pair<std::string, int> parseStatusLine(const std::string& line);
         static std::tuple<std::string, std::string, std::string> parseRequestLine(
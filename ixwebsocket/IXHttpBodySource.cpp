@@ -0,0 +1,267 @@
+/*
+ *  IXHttpBodySource.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXHttpBodySource.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    bool seekFile(FILE* file, uint64_t offset, int whence)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, (__int64) offset, whence) == 0;
+#else
+        return fseeko(file, (off_t) offset, whence) == 0;
+#endif
+    }
+
+    int64_t tellFile(FILE* file)
+    {
+#ifdef _WIN32
+        return _ftelli64(file);
+#else
+        return ftello(file);
+#endif
+    }
+} // namespace
+
+namespace ix
+{
+    bool HttpBodySource::setRange(uint64_t /*offset*/, uint64_t /*length*/)
+    {
+        return false;
+    }
+
+    int HttpBodySource::getFd() const
+    {
+        return -1;
+    }
+
+    uint64_t HttpBodySource::getOffset() const
+    {
+        return 0;
+    }
+
+    void HttpBodySource::consume(uint64_t /*length*/)
+    {
+        ;
+    }
+
+    bool HttpBodySource::getBuffer(const char*& /*data*/, size_t& /*size*/) const
+    {
+        return false;
+    }
+
+    HttpFileBodySource::HttpFileBodySource(FILE* file, uint64_t fileSize)
+        : _file(file)
+        , _fileSize(fileSize)
+        , _offset(0)
+        , _remaining(fileSize)
+    {
+    }
+
+    HttpFileBodySource::~HttpFileBodySource()
+    {
+        fclose(_file);
+    }
+
+    std::shared_ptr<HttpFileBodySource> HttpFileBodySource::create(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return nullptr;
+
+        int64_t size = -1;
+        if (seekFile(file, 0, SEEK_END))
+        {
+            size = tellFile(file);
+        }
+
+        if (size < 0 || !seekFile(file, 0, SEEK_SET))
+        {
+            fclose(file);
+            return nullptr;
+        }
+
+        return std::shared_ptr<HttpFileBodySource>(
+            new HttpFileBodySource(file, (uint64_t) size));
+    }
+
+    int64_t HttpFileBodySource::getSize() const
+    {
+        return (int64_t) _remaining;
+    }
+
+    ssize_t HttpFileBodySource::read(char* buffer, size_t length)
+    {
+        length = (size_t) std::min((uint64_t) length, _remaining);
+        if (length == 0) return 0;
+
+        size_t ret = fread(buffer, 1, length, _file);
+        if (ret == 0) return -1; // the file was truncated
+
+        _offset += ret;
+        _remaining -= ret;
+        return (ssize_t) ret;
+    }
+
+    bool HttpFileBodySource::setRange(uint64_t offset, uint64_t length)
+    {
+        if (offset > _fileSize || length > _fileSize - offset) return false;
+        if (!seekFile(_file, offset, SEEK_SET)) return false;
+
+        _offset = offset;
+        _remaining = length;
+        return true;
+    }
+
+    int HttpFileBodySource::getFd() const
+    {
+#ifdef _WIN32
+        return _fileno(_file);
+#else
+        return fileno(_file);
+#endif
+    }
+
+    uint64_t HttpFileBodySource::getOffset() const
+    {
+        return _offset;
+    }
+
+    void HttpFileBodySource::consume(uint64_t length)
+    {
+        length = std::min(length, _remaining);
+        _offset += length;
+        _remaining -= length;
+        seekFile(_file, _offset, SEEK_SET);
+    }
+
+    uint64_t HttpFileBodySource::getFileSize() const
+    {
+        return _fileSize;
+    }
+
+    HttpStringBodySource::HttpStringBodySource(const std::shared_ptr<const std::string>& body)
+        : _body(body)
+        , _offset(0)
+        , _remaining(body->size())
+    {
+    }
+
+    int64_t HttpStringBodySource::getSize() const
+    {
+        return (int64_t) _remaining;
+    }
+
+    ssize_t HttpStringBodySource::read(char* buffer, size_t length)
+    {
+        length = std::min(length, _remaining);
+        memcpy(buffer, _body->data() + _offset, length);
+        consume(length);
+        return (ssize_t) length;
+    }
+
+    bool HttpStringBodySource::setRange(uint64_t offset, uint64_t length)
+    {
+        if (offset > _body->size() || length > _body->size() - offset) return false;
+
+        _offset = (size_t) offset;
+        _remaining = (size_t) length;
+        return true;
+    }
+
+    void HttpStringBodySource::consume(uint64_t length)
+    {
+        length = std::min(length, (uint64_t) _remaining);
+        _offset += (size_t) length;
+        _remaining -= (size_t) length;
+    }
+
+    bool HttpStringBodySource::getBuffer(const char*& data, size_t& size) const
+    {
+        data = _body->data() + _offset;
+        size = _remaining;
+        return true;
+    }
+
+    HttpGeneratorBodySource::HttpGeneratorBodySource(const Generator& generator, int64_t size)
+        : _generator(generator)
+        , _size(size)
+        , _chunkOffset(0)
+        , _done(false)
+    {
+    }
+
+    int64_t HttpGeneratorBodySource::getSize() const
+    {
+        return _size;
+    }
+
+    ssize_t HttpGeneratorBodySource::read(char* buffer, size_t length)
+    {
+        while (_chunkOffset == _chunk.size())
+        {
+            if (_done) return 0;
+
+            _chunk.clear();
+            _chunkOffset = 0;
+            if (!_generator(_chunk)) return -1;
+            if (_chunk.empty()) _done = true;
+        }
+
+        length = std::min(length, _chunk.size() - _chunkOffset);
+        memcpy(buffer, _chunk.data() + _chunkOffset, length);
+        _chunkOffset += length;
+        return (ssize_t) length;
+    }
+
+    HttpGzipBodySource::HttpGzipBodySource(const HttpBodySourcePtr& source)
+        : _source(source)
+        , _gzipStream(GzipStream::Mode::Compress)
+        , _outputOffset(0)
+    {
+        _initialized = _gzipStream.reset();
+    }
+
+    int64_t HttpGzipBodySource::getSize() const
+    {
+        return -1;
+    }
+
+    ssize_t HttpGzipBodySource::read(char* buffer, size_t length)
+    {
+        if (!_initialized) return -1;
+
+        auto append = [this](const char* data, size_t size) -> bool
+        {
+            _output.append(data, size);
+            return true;
+        };
+
+        // Compress the source until some output is available
+        while (_outputOffset == _output.size())
+        {
+            if (_gzipStream.isFinished()) return 0;
+
+            _output.clear();
+            _outputOffset = 0;
+
+            ssize_t ret = _source->read(buffer, length);
+            if (ret < 0) return -1;
+
+            bool ok = (ret == 0) ? _gzipStream.finish(append)
+                                 : _gzipStream.write(buffer, (size_t) ret, append);
+            if (!ok) return -1;
+        }
+
+        length = std::min(length, _output.size() - _outputOffset);
+        memcpy(buffer, _output.data() + _outputOffset, length);
+        _outputOffset += length;
+        return (ssize_t) length;
+    }
+} // namespace ix
@@ -0,0 +1,145 @@
+/*
+ *  IXHttpBodySource.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Streaming bodies for HttpServer responses, sent in chunks instead of being held
+ *  in memory as a string.
+ */
+
+#pragma once
+
+#include "IXGzipCodec.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+#include <basetsd.h>
+#ifdef _MSC_VER
+typedef SSIZE_T ssize_t;
+#endif
+#endif
+
+namespace ix
+{
+    class HttpBodySource
+    {
+    public:
+        virtual ~HttpBodySource() = default;
+
+        // Size of the body, or -1 when it is not known in advance, in which case the
+        // body is sent with chunked transfer encoding
+        virtual int64_t getSize() const = 0;
+
+        // Read up to length bytes. Returns 0 at the end of the body, -1 on error.
+        virtual ssize_t read(char* buffer, size_t length) = 0;
+
+        // Restrict the body to length bytes starting at offset, for Range requests.
+        // Returns false if the source cannot seek.
+        virtual bool setRange(uint64_t offset, uint64_t length);
+
+        // File descriptor and offset of the remaining bytes, for bodies which can be
+        // sent with sendfile(). Returns -1 for other sources.
+        virtual int getFd() const;
+        virtual uint64_t getOffset() const;
+
+        // The bytes sent with sendfile() are skipped
+        virtual void consume(uint64_t length);
+
+        // Remaining bytes of bodies held in memory, which are sent without being copied.
+        // Returns false for other sources.
+        virtual bool getBuffer(const char*& data, size_t& size) const;
+    };
+
+    using HttpBodySourcePtr = std::shared_ptr<HttpBodySource>;
+
+    class HttpFileBodySource final : public HttpBodySource
+    {
+    public:
+        ~HttpFileBodySource();
+
+        // Returns nullptr if the file cannot be opened
+        static std::shared_ptr<HttpFileBodySource> create(const std::string& path);
+
+        int64_t getSize() const final;
+        ssize_t read(char* buffer, size_t length) final;
+        bool setRange(uint64_t offset, uint64_t length) final;
+
+        int getFd() const final;
+        uint64_t getOffset() const final;
+        void consume(uint64_t length) final;
+
+        // Size of the whole file, whatever the range
+        uint64_t getFileSize() const;
+
+    private:
+        HttpFileBodySource(FILE* file, uint64_t fileSize);
+
+        FILE* _file;
+        uint64_t _fileSize;
+        uint64_t _offset;
+        uint64_t _remaining;
+    };
+
+    // A body held in memory, which can be shared by many responses, e.g. a cached file
+    class HttpStringBodySource final : public HttpBodySource
+    {
+    public:
+        HttpStringBodySource(const std::shared_ptr<const std::string>& body);
+
+        int64_t getSize() const final;
+        ssize_t read(char* buffer, size_t length) final;
+        bool setRange(uint64_t offset, uint64_t length) final;
+
+        void consume(uint64_t length) final;
+        bool getBuffer(const char*& data, size_t& size) const final;
+
+    private:
+        std::shared_ptr<const std::string> _body;
+        size_t _offset;
+        size_t _remaining;
+    };
+
+    // The body is produced by a callback, which appends the next bytes to chunk and
+    // returns true, leaves chunk empty once the body is complete, or returns false on
+    // error. The size is -1 when it is not known in advance.
+    class HttpGeneratorBodySource final : public HttpBodySource
+    {
+    public:
+        using Generator = std::function<bool(std::string& chunk)>;
+
+        HttpGeneratorBodySource(const Generator& generator, int64_t size = -1);
+
+        int64_t getSize() const final;
+        ssize_t read(char* buffer, size_t length) final;
+
+    private:
+        Generator _generator;
+        int64_t _size;
+        std::string _chunk;
+        size_t _chunkOffset;
+        bool _done;
+    };
+
+    // Another body, compressed with gzip as it is sent. The compressed size is not
+    // known in advance, so the body is sent with chunked transfer encoding, and the
+    // response must have a "Content-Encoding: gzip" header.
+    class HttpGzipBodySource final : public HttpBodySource
+    {
+    public:
+        HttpGzipBodySource(const HttpBodySourcePtr& source);
+
+        int64_t getSize() const final;
+        ssize_t read(char* buffer, size_t length) final;
+
+    private:
+        HttpBodySourcePtr _source;
+        GzipStream _gzipStream;
+        bool _initialized;
+        std::string _output;
+        size_t _outputOffset;
+    };
+} // namespace ix
@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <random>
 #include <sstream>
@@ -29,23 +30,51 @@ namespace ix
     const std::string HttpClient::kPut = "PUT";
     const std::string HttpClient::kPatch = "PATCH";
 
-    HttpClient::HttpClient(bool async)
+    const size_t HttpClient::kDefaultWorkerThreadCount(4);
+    const size_t HttpClient::kMaxIdleGzipStreams(8);
+
+    namespace
+    {
+        bool isConnectionCloseRequested(const WebSocketHttpHeaders& headers)
+        {
+            auto it = headers.find("Connection");
+            if (it == headers.end()) return false;
+
+            std::string value(it->second);
+            std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+            return value.find("close") != std::string::npos;
+        }
+    } // namespace
+
+    HttpClient::HttpClient(bool async, size_t workerThreadCount)
         : _async(async)
+        , _pendingRequestsCount(0)
+        , _nextSequence(0)
+        , _maxConcurrentRequestsPerHost(0)
         , _stop(false)
         , _forceBody(false)
     {
         if (!_async) return;
 
-        _thread = std::thread(&HttpClient::run, this);
+        if (workerThreadCount == 0) workerThreadCount = 1;
+
+        for (size_t i = 0; i < workerThreadCount; ++i)
+        {
+            _threads.emplace_back(&HttpClient::run, this);
+        }
     }
 
     HttpClient::~HttpClient()
     {
-        if (!_thread.joinable()) return;
+        if (_threads.empty()) return;
 
         _stop = true;
-        _condition.notify_one();
-        _thread.join();
+        _condition.notify_all();
+
+        for (auto&& thread : _threads)
+        {
+            thread.join();
+        }
     }
 
     void HttpClient::setTLSOptions(const SocketTLSOptions& tlsOptions)
@@ -53,6 +82,11 @@ namespace ix
         _tlsOptions = tlsOptions;
     }
 
+    HttpConnectionPool& HttpClient::getConnectionPool()
+    {
+        return _connectionPool;
+    }
+
     void HttpClient::setForceBody(bool value)
     {
         _forceBody = value;
@@ -73,13 +107,30 @@ namespace ix
                          "in order to call performRequest");
         if (!_async) return false;
 
+        PendingRequest pendingRequest;
+        pendingRequest.args = args;
+        pendingRequest.onResponseCallback = onResponseCallback;
+
+        // Requests are limited per scheme, host and port, the way connections are pooled.
+        // Malformed urls are grouped together, and will fail when executed.
+        std::string protocol, host, path, query;
+        int port;
+        bool isProtocolDefaultPort;
+        if (UrlParser::parse(args->url, protocol, host, path, query, port, isProtocolDefaultPort))
+        {
+            pendingRequest.hostKey = HttpConnectionPool::makeKey(protocol, host, port);
+        }
+
         // Enqueue the task
         {
             // acquire lock
             std::unique_lock<std::mutex> lock(_queueMutex);
 
-            // add the task
-            _queue.push(std::make_pair(args, onResponseCallback));
+            // add the task, after the ones with the same priority
+            pendingRequest.sequence = _nextSequence++;
+            HostQueue& hostQueue = _hostQueues[pendingRequest.hostKey];
+            hostQueue.requests.insert(std::make_pair(args->priority, std::move(pendingRequest)));
+            _pendingRequestsCount++;
         } // release lock
 
         // wake up one thread
@@ -88,34 +139,124 @@ namespace ix
         return true;
     }
 
+    void HttpClient::setMaxConcurrentRequestsPerHost(size_t maxConcurrentRequestsPerHost)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_queueMutex);
+            _maxConcurrentRequestsPerHost = maxConcurrentRequestsPerHost;
+        }
+
+        // Raising the limit can make queued requests runnable
+        _condition.notify_all();
+    }
+
+    size_t HttpClient::getPendingRequestsCount() const
+    {
+        std::unique_lock<std::mutex> lock(_queueMutex);
+        return _pendingRequestsCount;
+    }
+
+    HttpClient::HostQueues::iterator HttpClient::nextHost()
+    {
+        auto next = _hostQueues.end();
+        for (auto it = _hostQueues.begin(); it != _hostQueues.end(); ++it)
+        {
+            const HostQueue& hostQueue = it->second;
+            if (hostQueue.requests.empty()) continue;
+
+            // Cancelled requests are completed first, they do not need a connection
+            const auto& first = *hostQueue.requests.begin();
+            if (first.second.args->cancel) return it;
+
+            if (_maxConcurrentRequestsPerHost != 0 &&
+                hostQueue.activeRequests >= _maxConcurrentRequestsPerHost)
+            {
+                continue;
+            }
+
+            if (next != _hostQueues.end())
+            {
+                const auto& nextFirst = *next->second.requests.begin();
+                if (first.first < nextFirst.first ||
+                    (first.first == nextFirst.first &&
+                     first.second.sequence > nextFirst.second.sequence))
+                {
+                    continue;
+                }
+            }
+            next = it;
+        }
+
+        return next;
+    }
+
     void HttpClient::run()
     {
         while (true)
         {
-            HttpRequestArgsPtr args;
-            OnResponseCallback onResponseCallback;
+            PendingRequest pendingRequest;
+            bool cancelled;
 
             {
                 std::unique_lock<std::mutex> lock(_queueMutex);
 
-                while (!_stop && _queue.empty())
+                auto it = _hostQueues.end();
+                while (!_stop && (it = nextHost()) == _hostQueues.end())
                 {
                     _condition.wait(lock);
                 }
 
                 if (_stop) return;
 
-                auto p = _queue.front();
-                _queue.pop();
+                HostQueue& hostQueue = it->second;
+                pendingRequest = std::move(hostQueue.requests.begin()->second);
+                hostQueue.requests.erase(hostQueue.requests.begin());
+                _pendingRequestsCount--;
 
-                args = p.first;
-                onResponseCallback = p.second;
+                // Read cancel once, so that a request cancelled right now cannot
+                // take a host slot that would never be released
+                cancelled = pendingRequest.args->cancel;
+                if (!cancelled)
+                {
+                    hostQueue.activeRequests++;
+                }
+                else if (hostQueue.requests.empty() && hostQueue.activeRequests == 0)
+                {
+                    _hostQueues.erase(it);
+                }
             }
 
-            if (_stop) return;
+            auto args = pendingRequest.args;
+
+            if (cancelled)
+            {
+                auto response = std::make_shared<HttpResponse>(0,
+                                                               std::string(),
+                                                               HttpErrorCode::Cancelled,
+                                                               WebSocketHttpHeaders(),
+                                                               std::string(),
+                                                               "Request cancelled");
+                pendingRequest.onResponseCallback(response);
+                continue;
+            }
 
             HttpResponsePtr response = request(args->url, args->verb, args->body, args);
-            onResponseCallback(response);
+
+            {
+                std::unique_lock<std::mutex> lock(_queueMutex);
+
+                auto it = _hostQueues.find(pendingRequest.hostKey);
+                HostQueue& hostQueue = it->second;
+                if (--hostQueue.activeRequests == 0 && hostQueue.requests.empty())
+                {
+                    _hostQueues.erase(it);
+                }
+            }
+
+            // Another request to the same host can run now
+            _condition.notify_one();
+
+            pendingRequest.onResponseCallback(response);
 
             if (_stop) return;
         }
@@ -127,10 +268,6 @@ namespace ix
                                         HttpRequestArgsPtr args,
                                         int redirects)
     {
-        // We only have one socket connection, so we cannot
-        // make multiple requests concurrently.
-        std::lock_guard<std::recursive_mutex> lock(_mutex);
-
         uint64_t uploadSize = 0;
         uint64_t downloadSize = 0;
         int code = 0;
@@ -158,19 +295,7 @@ namespace ix
 
         bool tls = protocol == "https";
         std::string errorMsg;
-        _socket = createSocket(tls, -1, errorMsg, _tlsOptions);
-
-        if (!_socket)
-        {
-            return std::make_shared<HttpResponse>(code,
-                                                  description,
-                                                  HttpErrorCode::CannotCreateSocket,
-                                                  headers,
-                                                  payload,
-                                                  errorMsg,
-                                                  uploadSize,
-                                                  downloadSize);
-        }
+        std::string poolKey = HttpConnectionPool::makeKey(protocol, host, port);
 
         // Build request string
         std::stringstream ss;
@@ -182,8 +307,11 @@ namespace ix
         }
         ss << "\r\n";
 
+        // Streamed bodies are decompressed as they are received
+        bool streamBody = args->onBodyCallback || !args->outputPath.empty();
+
 #ifdef IXWEBSOCKET_USE_ZLIB
-        if (args->compress && !args->onChunkCallback)
+        if (args->compress && (!args->onChunkCallback || streamBody))
         {
             ss << "Accept-Encoding: gzip"
                << "\r\n";
@@ -260,39 +388,105 @@ namespace ix
             return cancelled() || _stop;
         };
 
-        bool success = _socket->connect(host, port, errMsg, isCancellationRequested);
-        if (!success)
-        {
-            auto errorCode = args->cancel ? HttpErrorCode::Cancelled : HttpErrorCode::CannotConnect;
-            std::stringstream ss;
-            ss << "Cannot connect to url: " << url << " / error : " << errMsg;
-            return std::make_shared<HttpResponse>(code,
-                                                  description,
-                                                  errorCode,
-                                                  headers,
-                                                  payload,
-                                                  ss.str(),
-                                                  uploadSize,
-                                                  downloadSize);
-        }
+        // Reuse an idle connection to the same host if there is one. The server may
+        // have closed it in the meantime, in which case the request is sent again on
+        // a new connection when it could not be written. Once written, the server may
+        // have processed it, so only idempotent requests are sent again (RFC 9110
+        // section 9.2.2), as long as no response byte was received.
+        std::unique_ptr<Socket> socket = _connectionPool.acquire(poolKey);
+        bool reused = socket != nullptr;
+        bool idempotent =
+            verb == kGet || verb == kHead || verb == kPut || verb == kDelete || verb == "OPTIONS";
 
-        // Make a new cancellation object dealing with transfer timeout
-        cancelled = makeCancellationRequestWithTimeout(args->transferTimeout, args->cancel);
+        bool sent = false;
+        std::pair<bool, std::string> lineResult;
 
-        if (args->verbose)
+        while (true)
         {
-            std::stringstream ss;
-            ss << "Sending " << verb << " request "
-               << "to " << host << ":" << port << std::endl
-               << "request size: " << req.size() << " bytes" << std::endl
-               << "=============" << std::endl
-               << req << "=============" << std::endl
-               << std::endl;
+            if (!reused)
+            {
+                socket = createSocket(tls, -1, errorMsg, _tlsOptions);
 
-            log(ss.str(), args);
+                if (!socket)
+                {
+                    return std::make_shared<HttpResponse>(code,
+                                                          description,
+                                                          HttpErrorCode::CannotCreateSocket,
+                                                          headers,
+                                                          payload,
+                                                          errorMsg,
+                                                          uploadSize,
+                                                          downloadSize);
+                }
+
+                cancelled =
+                    makeCancellationRequestWithTimeout(args->connectTimeout, args->cancel);
+
+                bool success = socket->connect(host, port, errMsg, isCancellationRequested);
+                if (!success)
+                {
+                    auto errorCode =
+                        args->cancel ? HttpErrorCode::Cancelled : HttpErrorCode::CannotConnect;
+                    std::stringstream ss;
+                    ss << "Cannot connect to url: " << url << " / error : " << errMsg;
+                    return std::make_shared<HttpResponse>(code,
+                                                          description,
+                                                          errorCode,
+                                                          headers,
+                                                          payload,
+                                                          ss.str(),
+                                                          uploadSize,
+                                                          downloadSize);
+                }
+
+                if (args->verbose)
+                {
+                    auto timings = socket->getConnectTimings();
+                    std::stringstream ss;
+                    ss << "Connected to " << host << ":" << port << " in "
+                       << timings.resolutionMs + timings.connectMs << " ms (DNS lookup "
+                       << timings.resolutionMs << " ms, " << timings.attempts
+                       << " connection attempt(s))" << std::endl;
+
+                    log(ss.str(), args);
+                }
+            }
+
+            // Make a new cancellation object dealing with transfer timeout
+            cancelled = makeCancellationRequestWithTimeout(args->transferTimeout, args->cancel);
+
+            if (args->verbose)
+            {
+                std::stringstream ss;
+                ss << "Sending " << verb << " request "
+                   << "to " << host << ":" << port << (reused ? " (reused connection)" : "")
+                   << std::endl
+                   << "request size: " << req.size() << " bytes" << std::endl
+                   << "=============" << std::endl
+                   << req << "=============" << std::endl
+                   << std::endl;
+
+                log(ss.str(), args);
+            }
+
+            sent = socket->writeBytes(req, isCancellationRequested);
+            if (sent)
+            {
+                lineResult = socket->readLine(isCancellationRequested);
+            }
+
+            if (reused && (!sent || (idempotent && !lineResult.first)) &&
+                lineResult.second.empty() && !isCancellationRequested())
+            {
+                _connectionPool.recordStaleRetry();
+                reused = false;
+                continue;
+            }
+
+            break;
         }
 
-        if (!_socket->writeBytes(req, isCancellationRequested))
+        if (!sent)
         {
             auto errorCode = args->cancel ? HttpErrorCode::Cancelled : HttpErrorCode::SendError;
             std::string errorMsg("Cannot send request");
@@ -308,7 +502,6 @@ namespace ix
 
         uploadSize = req.size();
 
-        auto lineResult = _socket->readLine(isCancellationRequested);
         auto lineValid = lineResult.first;
         auto line = lineResult.second;
 
@@ -346,7 +539,7 @@ namespace ix
                                                   downloadSize);
         }
 
-        auto result = parseHttpHeaders(_socket, isCancellationRequested);
+        auto result = parseHttpHeaders(socket, isCancellationRequested);
         auto headersValid = result.first;
         headers = result.second;
 
@@ -365,7 +558,8 @@ namespace ix
         }
 
         // Redirect ?
-        if ((code >= 301 && code <= 308) && args->followRedirects)
+        // 304 Not Modified is not a redirect
+        if ((code >= 301 && code <= 308) && code != 304 && args->followRedirects)
         {
             if (headers.find("Location") == headers.end())
             {
@@ -401,6 +595,11 @@ namespace ix
 
         if (verb == "HEAD")
         {
+            if (!isConnectionCloseRequested(headers))
+            {
+                _connectionPool.release(poolKey, std::move(socket));
+            }
+
             return std::make_shared<HttpResponse>(code,
                                                   description,
                                                   HttpErrorCode::Ok,
@@ -411,6 +610,103 @@ namespace ix
                                                   downloadSize);
         }
 
+        // Body chunks are passed to the optional gzip stream, then to the sinks. Unless
+        // only raw chunks were requested, compressed bodies are inflated on the fly.
+        OnChunkCallback onChunkCallback = args->onChunkCallback;
+        std::unique_ptr<GzipStream> gzipStream;
+        std::ofstream outputFile;
+        HttpErrorCode bodyErrorCode = HttpErrorCode::Ok;
+
+        GzipStream::OnOutputCallback writeBody = [&](const char* data, size_t size) -> bool
+        {
+            if (!streamBody)
+            {
+                payload.append(data, size);
+                return true;
+            }
+
+            if (outputFile.is_open() && !outputFile.write(data, size))
+            {
+                bodyErrorCode = HttpErrorCode::CannotWriteBody;
+                errorMsg = "Cannot write body to " + args->outputPath;
+                return false;
+            }
+
+            if (args->onBodyCallback && !args->onBodyCallback(data, size))
+            {
+                bodyErrorCode = HttpErrorCode::CannotWriteBody;
+                errorMsg = "Body callback aborted the transfer";
+                return false;
+            }
+
+            return true;
+        };
+
+        if (headers["Content-Encoding"] == "gzip" && (!args->onChunkCallback || streamBody))
+        {
+            gzipStream = acquireGzipStream();
+            if (!gzipStream)
+            {
+#ifdef IXWEBSOCKET_USE_ZLIB
+                std::string errorMsg("Cannot decompress payload");
+#else
+                std::string errorMsg("ixwebsocket was not compiled with gzip support on");
+#endif
+                return std::make_shared<HttpResponse>(code,
+                                                      description,
+                                                      HttpErrorCode::Gzip,
+                                                      headers,
+                                                      payload,
+                                                      errorMsg,
+                                                      uploadSize,
+                                                      downloadSize);
+            }
+        }
+
+        if (!args->outputPath.empty())
+        {
+            outputFile.open(args->outputPath, std::ios::binary | std::ios::trunc);
+            if (!outputFile.is_open())
+            {
+                std::string errorMsg("Cannot open " + args->outputPath);
+                return std::make_shared<HttpResponse>(code,
+                                                      description,
+                                                      HttpErrorCode::CannotWriteBody,
+                                                      headers,
+                                                      payload,
+                                                      errorMsg,
+                                                      uploadSize,
+                                                      downloadSize);
+            }
+        }
+
+        if (streamBody || gzipStream)
+        {
+            onChunkCallback = [&](const std::string& chunk)
+            {
+                if (bodyErrorCode != HttpErrorCode::Ok) return;
+
+                if (args->onChunkCallback) args->onChunkCallback(chunk);
+                downloadSize += chunk.size();
+
+                if (gzipStream && !gzipStream->write(chunk, writeBody) &&
+                    bodyErrorCode == HttpErrorCode::Ok)
+                {
+                    bodyErrorCode = HttpErrorCode::Gzip;
+                    errorMsg = "Error decompressing payload";
+                }
+                else if (!gzipStream)
+                {
+                    writeBody(chunk.data(), chunk.size());
+                }
+            };
+        }
+
+        // The transfer stops as soon as the body cannot be processed
+        auto isBodyReadCancelled = [&]() {
+            return bodyErrorCode != HttpErrorCode::Ok || isCancellationRequested();
+        };
+
         // Parse response:
         if (headers.find("Content-Length") != headers.end())
         {
@@ -419,14 +715,21 @@ namespace ix
             ss << headers["Content-Length"];
             ss >> contentLength;
 
-            auto chunkResult = _socket->readBytes(contentLength,
+            auto chunkResult = socket->readBytes(contentLength,
                                                   args->onProgressCallback,
-                                                  args->onChunkCallback,
-                                                  isCancellationRequested);
+                                                  onChunkCallback,
+                                                  isBodyReadCancelled);
             if (!chunkResult.first)
             {
                 auto errorCode = args->cancel ? HttpErrorCode::Cancelled : HttpErrorCode::ChunkReadError;
-                errorMsg = "Cannot read chunk";
+                if (bodyErrorCode != HttpErrorCode::Ok)
+                {
+                    errorCode = bodyErrorCode;
+                }
+                else
+                {
+                    errorMsg = "Cannot read chunk";
+                }
                 return std::make_shared<HttpResponse>(code,
                                                       description,
                                                       errorCode,
@@ -437,7 +740,7 @@ namespace ix
                                                       downloadSize);
             }
 
-            if (!args->onChunkCallback)
+            if (!onChunkCallback)
             {
                 payload.reserve(contentLength);
                 payload += chunkResult.second;
@@ -451,7 +754,7 @@ namespace ix
             while (true)
             {
                 auto errorCode = args->cancel ? HttpErrorCode::Cancelled : HttpErrorCode::ChunkReadError;
-                lineResult = _socket->readLine(isCancellationRequested);
+                lineResult = socket->readLine(isCancellationRequested);
                 line = lineResult.second;
 
                 if (!lineResult.first)
@@ -479,14 +782,21 @@ namespace ix
                 }
 
                 // Read a chunk
-                auto chunkResult = _socket->readBytes((size_t) chunkSize,
+                auto chunkResult = socket->readBytes((size_t) chunkSize,
                                                       args->onProgressCallback,
-                                                      args->onChunkCallback,
-                                                      isCancellationRequested);
+                                                      onChunkCallback,
+                                                      isBodyReadCancelled);
                 if (!chunkResult.first)
                 {
                     auto errorCode = args->cancel ? HttpErrorCode::Cancelled : HttpErrorCode::ChunkReadError;
-                    errorMsg = "Cannot read chunk";
+                    if (bodyErrorCode != HttpErrorCode::Ok)
+                    {
+                        errorCode = bodyErrorCode;
+                    }
+                    else
+                    {
+                        errorMsg = "Cannot read chunk";
+                    }
                     return std::make_shared<HttpResponse>(code,
                                                           description,
                                                           errorCode,
@@ -497,14 +807,14 @@ namespace ix
                                                           downloadSize);
                 }
 
-                if (!args->onChunkCallback)
+                if (!onChunkCallback)
                 {
                     payload.reserve(payload.size() + (size_t) chunkSize);
                     payload += chunkResult.second;
                 }
 
                 // Read the line that terminates the chunk (\r\n)
-                lineResult = _socket->readLine(isCancellationRequested);
+                lineResult = socket->readLine(isCancellationRequested);
 
                 if (!lineResult.first)
                 {
@@ -522,9 +832,9 @@ namespace ix
                 if (chunkSize == 0) break;
             }
         }
-        else if (code == 204)
+        else if (code == 204 || code == 304)
         {
-            ; // 204 is NoContent response code
+            ; // NoContent and NotModified responses do not have a body
         }
         else
         {
@@ -539,37 +849,46 @@ namespace ix
                                                   downloadSize);
         }
 
-        downloadSize = payload.size();
+        // Accumulated bodies which were not compressed
+        if (!streamBody && !gzipStream)
+        {
+            downloadSize = payload.size();
+        }
 
-        // If the content was compressed with gzip, decode it
-        if (headers["Content-Encoding"] == "gzip")
+        // The whole response was read, the connection can be used for another request
+        if (!isConnectionCloseRequested(headers))
+        {
+            _connectionPool.release(poolKey, std::move(socket));
+        }
+
+        // Errors in the last chunk do not interrupt the read and are reported here
+        if (bodyErrorCode == HttpErrorCode::Ok && gzipStream && !gzipStream->finish(writeBody))
+        {
+            bodyErrorCode = HttpErrorCode::Gzip;
+            errorMsg = "Error decompressing payload";
+        }
+
+        if (bodyErrorCode == HttpErrorCode::Ok && outputFile.is_open() && !outputFile.flush())
+        {
+            bodyErrorCode = HttpErrorCode::CannotWriteBody;
+            errorMsg = "Cannot write body to " + args->outputPath;
+        }
+
+        if (bodyErrorCode != HttpErrorCode::Ok)
         {
-#ifdef IXWEBSOCKET_USE_ZLIB
-            std::string decompressedPayload;
-            if (!gzipDecompress(payload, decompressedPayload))
-            {
-                std::string errorMsg("Error decompressing payload");
-                return std::make_shared<HttpResponse>(code,
-                                                      description,
-                                                      HttpErrorCode::Gzip,
-                                                      headers,
-                                                      payload,
-                                                      errorMsg,
-                                                      uploadSize,
-                                                      downloadSize);
-            }
-            payload = decompressedPayload;
-#else
-            std::string errorMsg("ixwebsocket was not compiled with gzip support on");
             return std::make_shared<HttpResponse>(code,
                                                   description,
-                                                  HttpErrorCode::Gzip,
+                                                  bodyErrorCode,
                                                   headers,
                                                   payload,
                                                   errorMsg,
                                                   uploadSize,
                                                   downloadSize);
-#endif
+        }
+
+        if (gzipStream)
+        {
+            releaseGzipStream(std::move(gzipStream));
         }
 
         return std::make_shared<HttpResponse>(code,
@@ -582,6 +901,36 @@ namespace ix
                                               downloadSize);
     }
 
+    std::unique_ptr<GzipStream> HttpClient::acquireGzipStream()
+    {
+        std::unique_ptr<GzipStream> gzipStream;
+        {
+            std::lock_guard<std::mutex> lock(_gzipStreamsMutex);
+            if (!_gzipStreams.empty())
+            {
+                gzipStream = std::move(_gzipStreams.back());
+                _gzipStreams.pop_back();
+            }
+        }
+
+        if (!gzipStream)
+        {
+            gzipStream.reset(new GzipStream(GzipStream::Mode::Decompress));
+        }
+
+        if (!gzipStream->reset()) return nullptr;
+        return gzipStream;
+    }
+
+    void HttpClient::releaseGzipStream(std::unique_ptr<GzipStream> gzipStream)
+    {
+        std::lock_guard<std::mutex> lock(_gzipStreamsMutex);
+        if (_gzipStreams.size() < kMaxIdleGzipStreams)
+        {
+            _gzipStreams.push_back(std::move(gzipStream));
+        }
+    }
+
     HttpResponsePtr HttpClient::get(const std::string& url, HttpRequestArgsPtr args)
     {
         return request(url, kGet, std::string(), args);
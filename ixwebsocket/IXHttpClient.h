@@ -6,7 +6,9 @@
 
 #pragma once
 
+#include "IXGzipCodec.h"
 #include "IXHttp.h"
+#include "IXHttpConnectionPool.h"
 #include "IXSocket.h"
 #include "IXSocketTLSOptions.h"
 #include "IXWebSocketHttpHeaders.h"
@@ -17,15 +19,18 @@
 #include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace ix
 {
     class HttpClient
     {
     public:
-        HttpClient(bool async = false);
+        // In async mode, requests are executed by workerThreadCount threads
+        HttpClient(bool async = false,
+                   size_t workerThreadCount = HttpClient::kDefaultWorkerThreadCount);
         ~HttpClient();
 
         HttpResponsePtr get(const std::string& url, HttpRequestArgsPtr args);
@@ -74,12 +79,26 @@ namespace ix
         HttpRequestArgsPtr createRequest(const std::string& url = std::string(),
                                          const std::string& verb = HttpClient::kGet);
 
+        // Queue a request. Requests with a higher args->priority are executed first.
+        // A queued request whose args->cancel flag is set completes with
+        // HttpErrorCode::Cancelled once it is the next request of its host, without
+        // waiting for the per host limit.
         bool performRequest(HttpRequestArgsPtr request,
                             const OnResponseCallback& onResponseCallback);
 
+        // Max number of async requests executed concurrently for the same scheme, host
+        // and port. 0 means no limit other than the number of worker threads.
+        void setMaxConcurrentRequestsPerHost(size_t maxConcurrentRequestsPerHost);
+
+        size_t getPendingRequestsCount() const;
+
         // TLS
         void setTLSOptions(const SocketTLSOptions& tlsOptions);
 
+        // Idle keep-alive connections, reused by the following requests to the same
+        // scheme, host and port
+        HttpConnectionPool& getConnectionPool();
+
         std::string serializeHttpParameters(const HttpParameters& httpParameters);
 
         std::string serializeHttpFormDataParameters(
@@ -98,26 +117,62 @@ namespace ix
         const static std::string kPut;
         const static std::string kPatch;
 
+        const static size_t kDefaultWorkerThreadCount;
+
     private:
         void log(const std::string& msg, HttpRequestArgsPtr args);
 
-        // Async API background thread runner
+        // Async API worker threads runner
         void run();
+
+        // Decompression streams are kept for the following requests, so that their
+        // zlib state is not allocated for every response
+        std::unique_ptr<GzipStream> acquireGzipStream();
+        void releaseGzipStream(std::unique_ptr<GzipStream> gzipStream);
+
+        struct PendingRequest
+        {
+            HttpRequestArgsPtr args;
+            OnResponseCallback onResponseCallback;
+            std::string hostKey;
+            uint64_t sequence;
+        };
+
+        // Highest priority first, then in submission order
+        using RequestQueue = std::multimap<int, PendingRequest, std::greater<int>>;
+
+        // Requests are queued per host, so that finding the next one to run only looks
+        // at the first request of each host
+        struct HostQueue
+        {
+            RequestQueue requests;
+            size_t activeRequests = 0;
+        };
+        using HostQueues = std::map<std::string, HostQueue>;
+
+        // The host of the first queued request which can run without exceeding the per
+        // host limit. Must be called with _queueMutex held.
+        HostQueues::iterator nextHost();
+
         // Async API
         bool _async;
-        std::queue<std::pair<HttpRequestArgsPtr, OnResponseCallback>> _queue;
+        HostQueues _hostQueues;
+        size_t _pendingRequestsCount;
+        uint64_t _nextSequence;
+        size_t _maxConcurrentRequestsPerHost;
         mutable std::mutex _queueMutex;
         std::condition_variable _condition;
         std::atomic<bool> _stop;
-        std::thread _thread;
-
-        std::unique_ptr<Socket> _socket;
-        std::recursive_mutex _mutex; // to protect accessing the _socket (only one socket per
-                                     // client) the mutex needs to be recursive as this function
-                                     // might be called recursively to follow HTTP redirections
+        std::vector<std::thread> _threads;
 
         SocketTLSOptions _tlsOptions;
 
+        HttpConnectionPool _connectionPool;
+
+        std::vector<std::unique_ptr<GzipStream>> _gzipStreams;
+        std::mutex _gzipStreamsMutex;
+        const static size_t kMaxIdleGzipStreams;
+
         bool _forceBody;
     };
 } // namespace ix
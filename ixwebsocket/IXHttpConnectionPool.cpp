@@ -0,0 +1,187 @@
+/*
+ *  IXHttpConnectionPool.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXHttpConnectionPool.h"
+
+#include <sstream>
+
+namespace ix
+{
+    const size_t HttpConnectionPool::kDefaultMaxIdleConnections(64);
+    const size_t HttpConnectionPool::kDefaultMaxIdleConnectionsPerHost(8);
+    const int HttpConnectionPool::kDefaultIdleTimeoutSecs(30);
+
+    HttpConnectionPool::HttpConnectionPool()
+        : _idleConnectionsCount(0)
+        , _maxIdleConnections(kDefaultMaxIdleConnections)
+        , _maxIdleConnectionsPerHost(kDefaultMaxIdleConnectionsPerHost)
+        , _idleTimeout(kDefaultIdleTimeoutSecs)
+    {
+    }
+
+    void HttpConnectionPool::setMaxIdleConnections(size_t maxIdleConnections)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _maxIdleConnections = maxIdleConnections;
+
+        while (_idleConnectionsCount > _maxIdleConnections)
+        {
+            evictOldestConnection();
+        }
+    }
+
+    void HttpConnectionPool::setMaxIdleConnectionsPerHost(size_t maxIdleConnectionsPerHost)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _maxIdleConnectionsPerHost = maxIdleConnectionsPerHost;
+    }
+
+    void HttpConnectionPool::setIdleTimeout(int idleTimeoutSecs)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _idleTimeout = std::chrono::seconds(idleTimeoutSecs);
+    }
+
+    std::string HttpConnectionPool::makeKey(const std::string& protocol,
+                                            const std::string& host,
+                                            int port)
+    {
+        std::stringstream ss;
+        ss << protocol << "://" << host << ":" << port;
+        return ss.str();
+    }
+
+    std::unique_ptr<Socket> HttpConnectionPool::acquire(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        evictExpiredConnections(std::chrono::steady_clock::now());
+
+        auto it = _idleConnections.find(key);
+        while (it != _idleConnections.end() && !it->second.empty())
+        {
+            std::unique_ptr<Socket> socket = std::move(it->second.back().socket);
+            it->second.pop_back();
+            _idleConnectionsCount--;
+
+            // An idle connection has nothing to read, unless the peer closed it or
+            // sent unexpected data
+            if (socket->isReadAheadBufferEmpty() &&
+                socket->isReadyToRead(0) == PollResultType::Timeout)
+            {
+                if (it->second.empty()) _idleConnections.erase(it);
+                _stats.hits++;
+                return socket;
+            }
+
+            _stats.evictions++;
+        }
+
+        if (it != _idleConnections.end()) _idleConnections.erase(it);
+
+        _stats.misses++;
+        return nullptr;
+    }
+
+    void HttpConnectionPool::release(const std::string& key, std::unique_ptr<Socket> socket)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_maxIdleConnections == 0 || _maxIdleConnectionsPerHost == 0) return;
+
+        auto& connections = _idleConnections[key];
+        if (connections.size() >= _maxIdleConnectionsPerHost)
+        {
+            connections.pop_front();
+            _idleConnectionsCount--;
+            _stats.evictions++;
+        }
+
+        IdleConnection connection;
+        connection.socket = std::move(socket);
+        connection.releaseTime = std::chrono::steady_clock::now();
+        connections.push_back(std::move(connection));
+        _idleConnectionsCount++;
+
+        while (_idleConnectionsCount > _maxIdleConnections)
+        {
+            evictOldestConnection();
+        }
+    }
+
+    void HttpConnectionPool::recordStaleRetry()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.staleRetries++;
+    }
+
+    void HttpConnectionPool::evictIdleConnections()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        evictExpiredConnections(std::chrono::steady_clock::now());
+    }
+
+    void HttpConnectionPool::clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.evictions += _idleConnectionsCount;
+        _idleConnections.clear();
+        _idleConnectionsCount = 0;
+    }
+
+    HttpConnectionPoolStats HttpConnectionPool::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        HttpConnectionPoolStats stats = _stats;
+        stats.idleConnections = _idleConnectionsCount;
+        return stats;
+    }
+
+    void HttpConnectionPool::evictOldestConnection()
+    {
+        auto oldest = _idleConnections.end();
+        for (auto it = _idleConnections.begin(); it != _idleConnections.end(); ++it)
+        {
+            if (it->second.empty()) continue;
+
+            if (oldest == _idleConnections.end() ||
+                it->second.front().releaseTime < oldest->second.front().releaseTime)
+            {
+                oldest = it;
+            }
+        }
+
+        if (oldest == _idleConnections.end()) return;
+
+        oldest->second.pop_front();
+        if (oldest->second.empty()) _idleConnections.erase(oldest);
+        _idleConnectionsCount--;
+        _stats.evictions++;
+    }
+
+    void HttpConnectionPool::evictExpiredConnections(std::chrono::steady_clock::time_point now)
+    {
+        for (auto it = _idleConnections.begin(); it != _idleConnections.end();)
+        {
+            auto& connections = it->second;
+            while (!connections.empty() && now - connections.front().releaseTime >= _idleTimeout)
+            {
+                connections.pop_front();
+                _idleConnectionsCount--;
+                _stats.evictions++;
+            }
+
+            if (connections.empty())
+            {
+                it = _idleConnections.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+} // namespace ix
@@ -0,0 +1,92 @@
+/*
+ *  IXHttpConnectionPool.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Idle HTTP/1.1 connections kept open by HttpClient, so that following requests to
+ *  the same scheme, host and port skip the TCP (and TLS) connection setup.
+ */
+
+#pragma once
+
+#include "IXSocket.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ix
+{
+    struct HttpConnectionPoolStats
+    {
+        uint64_t hits = 0;         // requests sent on a pooled connection
+        uint64_t misses = 0;       // requests which needed a new connection
+        uint64_t evictions = 0;    // idle connections closed by the pool
+        uint64_t staleRetries = 0; // requests resent after a pooled connection failed
+        size_t idleConnections = 0;
+    };
+
+    class HttpConnectionPool
+    {
+    public:
+        HttpConnectionPool();
+
+        // Setting the max number of idle connections to 0 disables the pool
+        void setMaxIdleConnections(size_t maxIdleConnections);
+        void setMaxIdleConnectionsPerHost(size_t maxIdleConnectionsPerHost);
+        void setIdleTimeout(int idleTimeoutSecs);
+
+        // Key used to pool the connections of an url
+        static std::string makeKey(const std::string& protocol,
+                                   const std::string& host,
+                                   int port);
+
+        // Return the most recently used idle connection for key, or nullptr if there
+        // is none. Idle connections which were closed by the peer are evicted.
+        std::unique_ptr<Socket> acquire(const std::string& key);
+
+        // Give back a connection, after a complete response was read from it
+        void release(const std::string& key, std::unique_ptr<Socket> socket);
+
+        // A request failed on a pooled connection, and is sent again on a new one
+        void recordStaleRetry();
+
+        // Close the connections idle for longer than the idle timeout
+        void evictIdleConnections();
+
+        // Close all the idle connections
+        void clear();
+
+        HttpConnectionPoolStats getStats() const;
+
+        const static size_t kDefaultMaxIdleConnections;
+        const static size_t kDefaultMaxIdleConnectionsPerHost;
+        const static int kDefaultIdleTimeoutSecs;
+
+    private:
+        struct IdleConnection
+        {
+            std::unique_ptr<Socket> socket;
+            std::chrono::steady_clock::time_point releaseTime;
+        };
+
+        // Close the least recently used connection of all hosts
+        void evictOldestConnection();
+        void evictExpiredConnections(std::chrono::steady_clock::time_point now);
+
+        // Oldest connections first
+        std::map<std::string, std::deque<IdleConnection>> _idleConnections;
+        size_t _idleConnectionsCount;
+
+        size_t _maxIdleConnections;
+        size_t _maxIdleConnectionsPerHost;
+        std::chrono::seconds _idleTimeout;
+
+        HttpConnectionPoolStats _stats;
+        mutable std::mutex _mutex;
+    };
+} // namespace ix
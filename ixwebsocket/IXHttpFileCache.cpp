@@ -0,0 +1,202 @@
+/*
+ *  IXHttpFileCache.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXHttpFileCache.h"
+
+#include "IXGzipCodec.h"
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace
+{
+    bool readFile(const std::string& path, uint64_t expectedSize, std::string& content)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        std::stringstream ss;
+        ss << file.rdbuf();
+        content = ss.str();
+
+        // The file changed while being read
+        return content.size() == expectedSize;
+    }
+} // namespace
+
+namespace ix
+{
+    const size_t HttpFileCache::kDefaultMaxSize(64 * 1024 * 1024);
+
+    double HttpFileCacheStats::getHitRatio() const
+    {
+        uint64_t requests = hits + misses;
+        return (requests == 0) ? 0 : (double) hits / requests;
+    }
+
+    HttpFileCache::HttpFileCache(size_t maxSize)
+        : _maxSize(maxSize)
+    {
+    }
+
+    void HttpFileCache::setMaxSize(size_t maxSize)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _maxSize = maxSize;
+
+        while (_stats.size > _maxSize)
+        {
+            _stats.size -= getEntrySize(_lru.back().second);
+            _index.erase(_lru.back().first);
+            _lru.pop_back();
+        }
+        _stats.entries = _lru.size();
+    }
+
+    bool HttpFileCache::getFileInfo(const std::string& path,
+                                    uint64_t& fileSize,
+                                    int64_t& modificationTime)
+    {
+#ifdef _WIN32
+        struct _stat64 st;
+        if (_stat64(path.c_str(), &st) != 0 || (st.st_mode & _S_IFREG) == 0) return false;
+#else
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+#endif
+
+        fileSize = (uint64_t) st.st_size;
+        modificationTime = (int64_t) st.st_mtime;
+        return true;
+    }
+
+    std::shared_ptr<const HttpFileCache::Entry> HttpFileCache::get(const std::string& path,
+                                                                   uint64_t fileSize,
+                                                                   int64_t modificationTime,
+                                                                   bool gzip)
+    {
+        EntryPtr cachedEntry;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto it = _index.find(path);
+            if (it != _index.end() && it->second->second->fileSize == fileSize &&
+                it->second->second->modificationTime == modificationTime)
+            {
+                cachedEntry = it->second->second;
+                if (!gzip || cachedEntry->gzipBody)
+                {
+                    _lru.splice(_lru.begin(), _lru, it->second);
+                    _stats.hits++;
+                    return cachedEntry;
+                }
+            }
+
+            _stats.misses++;
+        }
+
+        // Files are read and compressed without holding the lock
+        auto entry = std::make_shared<Entry>();
+        entry->fileSize = fileSize;
+        entry->modificationTime = modificationTime;
+
+        if (cachedEntry)
+        {
+            entry->body = cachedEntry->body;
+        }
+        else
+        {
+            auto body = std::make_shared<std::string>();
+            if (!readFile(path, fileSize, *body)) return nullptr;
+            entry->body = body;
+        }
+
+        if (gzip)
+        {
+            // A precompressed file is used when it is not older than the file
+            auto gzipBody = std::make_shared<std::string>();
+            std::string gzipPath(path + ".gz");
+            uint64_t gzipFileSize;
+            int64_t gzipModificationTime;
+
+            if (!getFileInfo(gzipPath, gzipFileSize, gzipModificationTime) ||
+                gzipModificationTime < modificationTime ||
+                !readFile(gzipPath, gzipFileSize, *gzipBody))
+            {
+                *gzipBody = gzipCompress(*entry->body);
+            }
+
+            if (gzipBody->size() < entry->body->size())
+            {
+                entry->gzipBody = gzipBody;
+            }
+            else
+            {
+                entry->gzipBody = entry->body;
+            }
+        }
+
+        insert(path, entry);
+        return entry;
+    }
+
+    void HttpFileCache::recordNotModified(uint64_t fileSize)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.notModified++;
+        _stats.bytesSaved += fileSize;
+    }
+
+    void HttpFileCache::recordBytesSaved(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.bytesSaved += bytes;
+    }
+
+    HttpFileCacheStats HttpFileCache::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+    size_t HttpFileCache::getEntrySize(const EntryPtr& entry)
+    {
+        bool hasGzipBody = entry->gzipBody && entry->gzipBody != entry->body;
+        return entry->body->size() + (hasGzipBody ? entry->gzipBody->size() : 0);
+    }
+
+    void HttpFileCache::insert(const std::string& path, const EntryPtr& entry)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _index.find(path);
+        if (it != _index.end())
+        {
+            _stats.size -= getEntrySize(it->second->second);
+            _lru.erase(it->second);
+            _index.erase(it);
+        }
+
+        // Entries larger than the whole cache are not kept
+        size_t entrySize = getEntrySize(entry);
+        if (entrySize <= _maxSize)
+        {
+            _lru.emplace_front(path, entry);
+            _index[path] = _lru.begin();
+            _stats.size += entrySize;
+
+            while (_stats.size > _maxSize)
+            {
+                _stats.size -= getEntrySize(_lru.back().second);
+                _index.erase(_lru.back().first);
+                _lru.pop_back();
+            }
+        }
+
+        _stats.entries = _lru.size();
+    }
+} // namespace ix
@@ -0,0 +1,88 @@
+/*
+ *  IXHttpFileCache.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  In memory LRU cache of the static files served by HttpServer, holding their raw
+ *  and gzip compressed content, so that files are not read and compressed again for
+ *  every request.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ix
+{
+    struct HttpFileCacheStats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t notModified = 0; // 304 responses
+        uint64_t bytesSaved = 0;  // body bytes not sent, thanks to compression and 304s
+        size_t size = 0;          // bytes held by the cache
+        size_t entries = 0;
+
+        double getHitRatio() const;
+    };
+
+    class HttpFileCache
+    {
+    public:
+        struct Entry
+        {
+            uint64_t fileSize;
+            int64_t modificationTime;
+            std::shared_ptr<const std::string> body;
+            // Null until requested, the same as body when compressing does not make it
+            // smaller, in which case the raw body is served
+            std::shared_ptr<const std::string> gzipBody;
+        };
+
+        HttpFileCache(size_t maxSize = HttpFileCache::kDefaultMaxSize);
+
+        // Bound on the total size of the cached bodies. 0 disables the cache.
+        void setMaxSize(size_t maxSize);
+
+        // Size and modification time (in seconds) of a regular file
+        static bool getFileInfo(const std::string& path,
+                                uint64_t& fileSize,
+                                int64_t& modificationTime);
+
+        // Content of path, read from disk on a miss or when the file changed. With gzip,
+        // the compressed variant is loaded from a sibling .gz file when it is up to date,
+        // or compressed once. Returns nullptr if the file cannot be read.
+        std::shared_ptr<const Entry> get(const std::string& path,
+                                         uint64_t fileSize,
+                                         int64_t modificationTime,
+                                         bool gzip);
+
+        void recordNotModified(uint64_t fileSize);
+        void recordBytesSaved(uint64_t bytes);
+
+        HttpFileCacheStats getStats() const;
+
+        const static size_t kDefaultMaxSize;
+
+    private:
+        using EntryPtr = std::shared_ptr<const Entry>;
+        using LruList = std::list<std::pair<std::string, EntryPtr>>;
+
+        static size_t getEntrySize(const EntryPtr& entry);
+        void insert(const std::string& path, const EntryPtr& entry);
+
+        // Most recently used first
+        LruList _lru;
+        std::unordered_map<std::string, LruList::iterator> _index;
+
+        size_t _maxSize;
+        HttpFileCacheStats _stats;
+        mutable std::mutex _mutex;
+    };
+} // namespace ix
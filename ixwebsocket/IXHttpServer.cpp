@@ -10,36 +10,165 @@
 #include "IXNetSystem.h"
 #include "IXSocketConnect.h"
 #include "IXUserAgent.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
+#include <ctime>
 #include <sstream>
 #include <vector>
 
 namespace
 {
-    std::pair<bool, std::vector<uint8_t>> load(const std::string& path)
+    // Weak, as the compressed and raw variants of a file share it
+    std::string makeETag(uint64_t fileSize, int64_t modificationTime)
     {
-        std::vector<uint8_t> memblock;
+        std::stringstream ss;
+        ss << "W/\"" << std::hex << fileSize << "-" << modificationTime << "\"";
+        return ss.str();
+    }
+
+    std::string formatHttpDate(int64_t time)
+    {
+        time_t t = (time_t) time;
+        struct tm tm;
+#ifdef _WIN32
+        gmtime_s(&tm, &t);
+#else
+        gmtime_r(&t, &tm);
+#endif
+        char buffer[64];
+        strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        return buffer;
+    }
+
+    // If-Modified-Since is ignored when If-None-Match is present, and only matches the
+    // exact Last-Modified date
+    bool isNotModified(const ix::HttpRequestPtr& request,
+                       const std::string& etag,
+                       const std::string& lastModified)
+    {
+        auto it = request->headers.find("If-None-Match");
+        if (it != request->headers.end())
+        {
+            return it->second == "*" || it->second.find(etag) != std::string::npos;
+        }
+
+        it = request->headers.find("If-Modified-Since");
+        return it != request->headers.end() && it->second == lastModified;
+    }
+
+    std::string toLower(std::string str)
+    {
+        std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+        return str;
+    }
 
-        std::ifstream file(path);
-        if (!file.is_open()) return std::make_pair(false, memblock);
+    // HTTP/1.1 connections are persistent unless the client or the application asks
+    // to close them. HTTP/1.0 connections only when the client asks for it.
+    bool isKeepAliveRequested(const ix::HttpRequestPtr& request,
+                              const ix::HttpResponsePtr& response)
+    {
+        auto it = response->headers.find("Connection");
+        if (it != response->headers.end() && toLower(it->second).find("close") != std::string::npos)
+        {
+            return false;
+        }
+
+        // The body of chunked requests is not read, it cannot be told apart from the
+        // next request
+        if (request->headers.find("Transfer-Encoding") != request->headers.end())
+        {
+            return false;
+        }
+
+        std::string connection;
+        it = request->headers.find("Connection");
+        if (it != request->headers.end())
+        {
+            connection = toLower(it->second);
+        }
+
+        if (connection.find("close") != std::string::npos)
+        {
+            return false;
+        }
+
+        if (request->version == "HTTP/1.0")
+        {
+            return connection.find("keep-alive") != std::string::npos;
+        }
 
-        file.seekg(0, file.end);
-        std::streamoff size = file.tellg();
-        file.seekg(0, file.beg);
+        return true;
+    }
 
-        memblock.resize((size_t) size);
-        file.read((char*) &memblock.front(), static_cast<std::streamsize>(size));
+    bool parseUint64(const std::string& str, uint64_t& value)
+    {
+        if (str.empty() || str.size() > 19) return false;
 
-        return std::make_pair(true, memblock);
+        value = 0;
+        for (auto c : str)
+        {
+            if (c < '0' || c > '9') return false;
+            value = value * 10 + (uint64_t) (c - '0');
+        }
+        return true;
     }
 
-    std::pair<bool, std::string> readAsString(const std::string& path)
+    enum class RangeResult
+    {
+        None,          // no valid range, the whole body is sent
+        Satisfiable,   // 206 Partial Content
+        Unsatisfiable, // 416 Range Not Satisfiable
+    };
+
+    // Only single byte ranges are supported: bytes=first-last, bytes=first- and
+    // bytes=-suffixLength. Multiple ranges are ignored.
+    RangeResult parseRange(const std::string& value,
+                           uint64_t size,
+                           uint64_t& offset,
+                           uint64_t& length)
     {
-        auto res = load(path);
-        auto vec = res.second;
-        return std::make_pair(res.first, std::string(vec.begin(), vec.end()));
+        const std::string prefix("bytes=");
+        if (value.compare(0, prefix.size(), prefix) != 0) return RangeResult::None;
+
+        std::string spec = value.substr(prefix.size());
+        auto dash = spec.find('-');
+        if (dash == std::string::npos || spec.find(',') != std::string::npos)
+        {
+            return RangeResult::None;
+        }
+
+        std::string first = spec.substr(0, dash);
+        std::string last = spec.substr(dash + 1);
+        uint64_t start, end;
+
+        if (first.empty())
+        {
+            uint64_t suffixLength;
+            if (!parseUint64(last, suffixLength)) return RangeResult::None;
+            if (suffixLength == 0 || size == 0) return RangeResult::Unsatisfiable;
+
+            length = std::min(suffixLength, size);
+            offset = size - length;
+            return RangeResult::Satisfiable;
+        }
+
+        if (!parseUint64(first, start)) return RangeResult::None;
+        if (last.empty())
+        {
+            end = (size == 0) ? 0 : size - 1;
+        }
+        else if (!parseUint64(last, end) || end < start)
+        {
+            return RangeResult::None;
+        }
+
+        if (start >= size) return RangeResult::Unsatisfiable;
+
+        offset = start;
+        length = std::min(end, size - 1) - start + 1;
+        return RangeResult::Satisfiable;
     }
 
     std::string response_head_file(const std::string& file_name){
@@ -69,6 +198,11 @@ namespace
 namespace ix
 {
     const int HttpServer::kDefaultTimeoutSecs(30);
+    const int HttpServer::kDefaultKeepAliveTimeoutSecs(5);
+    const int HttpServer::kDefaultMaxKeepAliveRequests(100);
+    const int HttpServer::kKeepAlivePollIntervalMs(100);
+    const int HttpServer::kDefaultWriteTimeoutSecs(300);
+    const uint64_t HttpServer::kMaxCachedFileSize(1024 * 1024);
 
     HttpServer::HttpServer(int port,
                            const std::string& host,
@@ -79,6 +213,10 @@ namespace ix
                            int handshakeTimeoutSecs)
         : WebSocketServer(port, host, backlog, maxConnections, handshakeTimeoutSecs, addressFamily)
         , _timeoutSecs(timeoutSecs)
+        , _writeTimeoutSecs(kDefaultWriteTimeoutSecs)
+        , _keepAlive(false)
+        , _keepAliveTimeoutSecs(kDefaultKeepAliveTimeoutSecs)
+        , _maxKeepAliveRequests(kDefaultMaxKeepAliveRequests)
     {
         setDefaultConnectionCallback();
     }
@@ -91,29 +229,99 @@ namespace ix
     void HttpServer::handleConnection(std::unique_ptr<Socket> socket,
                                       std::shared_ptr<ConnectionState> connectionState)
     {
-        auto ret = Http::parseRequest(socket, _timeoutSecs);
-        // FIXME: handle errors in parseRequest
+        // In event loop mode, waiting for the next request would block a handshake thread
+        bool keepAlive = _keepAlive && getEventLoop() == nullptr;
 
-        if (std::get<0>(ret))
+        for (int requestCount = 1;; ++requestCount)
         {
+            auto ret = Http::parseRequest(socket, _timeoutSecs);
+            // FIXME: handle errors in parseRequest
+            if (!std::get<0>(ret)) break;
+
             auto request = std::get<2>(ret);
-            std::shared_ptr<ix::HttpResponse> response;
             if (request->headers["Upgrade"] == "websocket")
             {
-                WebSocketServer::handleUpgrade(std::move(socket), connectionState, request);
-            }
-            else
-            {
-                auto response = _onConnectionCallback(request, connectionState);
-                if (!Http::sendResponse(response, socket))
+                if (WebSocketServer::handleUpgrade(std::move(socket), connectionState, request))
                 {
-                    logError("Cannot send response");
+                    // The event loop now owns the connection
+                    return;
                 }
+                break;
+            }
+
+            auto response = _onConnectionCallback(request, connectionState);
+
+            keepAlive = keepAlive && requestCount < _maxKeepAliveRequests && !isStopping() &&
+                        isKeepAliveRequested(request, response);
+
+            auto start = std::chrono::steady_clock::now();
+            auto writeTimeout = std::chrono::seconds(_writeTimeoutSecs);
+            auto isCancellationRequested = [this, start, writeTimeout]() -> bool {
+                return isStopping() || std::chrono::steady_clock::now() - start > writeTimeout;
+            };
+
+            if (!Http::sendResponse(response, socket, keepAlive, isCancellationRequested))
+            {
+                logError("Cannot send response");
+                break;
             }
+
+            if (!keepAlive || !waitForNextRequest(socket)) break;
         }
+
         connectionState->setTerminated();
     }
 
+    bool HttpServer::waitForNextRequest(std::unique_ptr<Socket>& socket)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        // Pipelined requests are already buffered
+        while (socket->isReadAheadBufferEmpty())
+        {
+            if (isStopping() || std::chrono::steady_clock::now() - start >=
+                                    std::chrono::seconds(_keepAliveTimeoutSecs))
+            {
+                return false;
+            }
+
+            // Wake up regularly to notice that the server is stopping
+            PollResultType pollResult = socket->isReadyToRead(kKeepAlivePollIntervalMs);
+            if (pollResult == PollResultType::ReadyForRead)
+            {
+                return true;
+            }
+            else if (pollResult != PollResultType::Timeout)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void HttpServer::setWriteTimeout(int timeoutSecs)
+    {
+        _writeTimeoutSecs = timeoutSecs;
+    }
+
+    void HttpServer::enableKeepAlive(int idleTimeoutSecs, int maxRequests)
+    {
+        _keepAlive = true;
+        _keepAliveTimeoutSecs = idleTimeoutSecs;
+        _maxKeepAliveRequests = maxRequests;
+    }
+
+    void HttpServer::disableKeepAlive()
+    {
+        _keepAlive = false;
+    }
+
+    bool HttpServer::isKeepAliveEnabled() const
+    {
+        return _keepAlive;
+    }
+
     void HttpServer::setDefaultConnectionCallback()
     {
         setOnConnectionCallback(
@@ -131,42 +339,127 @@ namespace ix
                 headers["Content-Type"] = response_head_file(uri);
 
                 std::string path("." + uri);
-                auto res = readAsString(path);
-                bool found = res.first;
-                if (!found)
+                uint64_t fileSize;
+                int64_t modificationTime;
+                if (!HttpFileCache::getFileInfo(path, fileSize, modificationTime))
                 {
                     return std::make_shared<HttpResponse>(
                         404, "Not Found", HttpErrorCode::Ok, WebSocketHttpHeaders(), std::string());
                 }
 
-                std::string content = res.second;
+                headers["Accept-Ranges"] = "bytes";
+                headers["ETag"] = makeETag(fileSize, modificationTime);
+                headers["Last-Modified"] = formatHttpDate(modificationTime);
 
-#ifdef IXWEBSOCKET_USE_ZLIB
-                std::string acceptEncoding = request->headers["Accept-encoding"];
-                if (acceptEncoding == "*" || acceptEncoding.find("gzip") != std::string::npos)
+                if (isNotModified(request, headers["ETag"], headers["Last-Modified"]))
+                {
+                    _fileCache.recordNotModified(fileSize);
+                    return std::make_shared<HttpResponse>(
+                        304, "Not Modified", HttpErrorCode::Ok, headers, std::string());
+                }
+
+                int statusCode = 200;
+                std::string description("OK");
+
+                auto range = request->headers.find("Range");
+                uint64_t offset = 0;
+                uint64_t length = fileSize;
+                RangeResult rangeResult = (range == request->headers.end())
+                                              ? RangeResult::None
+                                              : parseRange(range->second, fileSize, offset, length);
+
+                if (rangeResult == RangeResult::Unsatisfiable)
                 {
-                    content = gzipCompress(content);
-                    headers["Content-Encoding"] = "gzip";
+                    headers["Content-Range"] = "bytes */" + std::to_string(fileSize);
+                    return std::make_shared<HttpResponse>(
+                        416, "Range Not Satisfiable", HttpErrorCode::Ok, headers, std::string());
                 }
+
+                bool gzip = false;
+#ifdef IXWEBSOCKET_USE_ZLIB
+                std::string acceptEncoding = request->headers["Accept-encoding"];
+                gzip = acceptEncoding == "*" || acceptEncoding.find("gzip") != std::string::npos;
                 headers["Accept-Encoding"] = "gzip";
+                headers["Vary"] = "Accept-Encoding";
 #endif
 
+                auto response = std::make_shared<HttpResponse>(
+                    statusCode, description, HttpErrorCode::Ok, headers, std::string());
+
+                // Small files are served from the cache, large files and ranges are
+                // streamed from disk as is
+                if (rangeResult == RangeResult::None && fileSize <= kMaxCachedFileSize)
+                {
+                    auto entry = _fileCache.get(path, fileSize, modificationTime, gzip);
+                    if (!entry)
+                    {
+                        return std::make_shared<HttpResponse>(404,
+                                                              "Not Found",
+                                                              HttpErrorCode::Ok,
+                                                              WebSocketHttpHeaders(),
+                                                              std::string());
+                    }
+
+                    // The cached body is shared, not copied
+                    auto body = entry->body;
+                    if (gzip && entry->gzipBody != entry->body)
+                    {
+                        body = entry->gzipBody;
+                        response->headers["Content-Encoding"] = "gzip";
+                        _fileCache.recordBytesSaved(entry->body->size() - body->size());
+                    }
+                    response->bodySource = std::make_shared<HttpStringBodySource>(body);
+                    length = body->size();
+                }
+                else
+                {
+                    auto file = HttpFileBodySource::create(path);
+                    if (!file)
+                    {
+                        return std::make_shared<HttpResponse>(404,
+                                                              "Not Found",
+                                                              HttpErrorCode::Ok,
+                                                              WebSocketHttpHeaders(),
+                                                              std::string());
+                    }
+
+                    if (rangeResult == RangeResult::Satisfiable && file->setRange(offset, length))
+                    {
+                        response->statusCode = 206;
+                        response->description = "Partial Content";
+
+                        std::stringstream ss;
+                        ss << "bytes " << offset << "-" << offset + length - 1 << "/" << fileSize;
+                        response->headers["Content-Range"] = ss.str();
+                    }
+                    else
+                    {
+                        length = fileSize;
+                    }
+                    response->bodySource = file;
+                }
+
                 // Log request
                 std::stringstream ss;
                 ss << connectionState->getRemoteIp() << ":" << connectionState->getRemotePort()
                    << " " << request->method << " " << request->headers["User-Agent"] << " "
-                   << request->uri << " " << content.size();
+                   << request->uri << " " << length;
                 logInfo(ss.str());
 
-                // FIXME: check extensions to set the content type
-                // headers["Content-Type"] = "application/octet-stream";
-                headers["Accept-Ranges"] = "none";
-
-                return std::make_shared<HttpResponse>(
-                    200, "OK", HttpErrorCode::Ok, headers, content);
+                return response;
             });
     }
 
+    HttpFileCacheStats HttpServer::getFileCacheStats() const
+    {
+        return _fileCache.getStats();
+    }
+
+    void HttpServer::setFileCacheMaxSize(size_t maxSize)
+    {
+        _fileCache.setMaxSize(maxSize);
+    }
+
     void HttpServer::makeRedirectServer(const std::string& redirectUrl)
     {
         //
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "IXHttp.h"
+#include "IXHttpFileCache.h"
 #include "IXWebSocket.h"
 #include "IXWebSocketServer.h"
 #include <functional>
@@ -41,17 +42,54 @@ namespace ix
 
         int getTimeoutSecs();
 
+        // Persistent connections, disabled by default: each connection owns a thread,
+        // which an idle client holds until idleTimeoutSecs have passed. A connection is
+        // also closed after maxRequests requests. Pipelined requests are answered in
+        // order. In event loop mode, connections are closed after each response.
+        void enableKeepAlive(int idleTimeoutSecs = HttpServer::kDefaultKeepAliveTimeoutSecs,
+                             int maxRequests = HttpServer::kDefaultMaxKeepAliveRequests);
+        void disableKeepAlive();
+        bool isKeepAliveEnabled() const;
+
+        // A response which is not fully sent after timeoutSecs is abandoned and its
+        // connection closed, so that a client which stops reading does not hold a
+        // thread forever. Responses are also abandoned when the server stops.
+        void setWriteTimeout(int timeoutSecs);
+
+        // Cache of the files served by the default callback, bounded by maxSize bytes
+        HttpFileCacheStats getFileCacheStats() const;
+        void setFileCacheMaxSize(size_t maxSize);
+
+        const static int kDefaultKeepAliveTimeoutSecs;
+        const static int kDefaultMaxKeepAliveRequests;
+        const static int kDefaultWriteTimeoutSecs;
+
     private:
         // Member variables
         OnConnectionCallback _onConnectionCallback;
 
         const static int kDefaultTimeoutSecs;
         int _timeoutSecs;
+        int _writeTimeoutSecs;
+
+        bool _keepAlive;
+        int _keepAliveTimeoutSecs;
+        int _maxKeepAliveRequests;
+        const static int kKeepAlivePollIntervalMs;
+
+        // Files served by the default callback are cached and compressed up to this
+        // size, larger ones are streamed from disk
+        const static uint64_t kMaxCachedFileSize;
+        HttpFileCache _fileCache;
 
         // Methods
         virtual void handleConnection(std::unique_ptr<Socket>,
                                       std::shared_ptr<ConnectionState> connectionState) final;
 
+        // Wait until the next request of a persistent connection can be read. Returns
+        // false on idle timeout, server shutdown or socket error.
+        bool waitForNextRequest(std::unique_ptr<Socket>& socket);
+
         void setDefaultConnectionCallback();
     };
 } // namespace ix
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <string>
 
@@ -13,4 +14,5 @@ namespace ix
 {
     using OnProgressCallback = std::function<bool(int current, int total)>;
     using OnChunkCallback = std::function<void(const std::string&)>;
+    using OnBodyCallback = std::function<bool(const char* data, size_t size)>;
 }
@@ -20,6 +20,10 @@
 #include <sys/types.h>
 #include <vector>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #ifdef min
 #undef min
 #endif
@@ -28,9 +32,14 @@ namespace ix
 {
     const int Socket::kDefaultPollNoTimeout = -1; // No poll timeout by default
     const int Socket::kDefaultPollTimeout = kDefaultPollNoTimeout;
+    const size_t Socket::kReadAheadBufferSize = 4096;
+    constexpr size_t Socket::kMaxSendBuffers;
+    constexpr size_t Socket::kCoalescedSendSize;
 
     Socket::Socket(int fd)
         : _sockfd(fd)
+        , _readAheadStart(0)
+        , _readAheadEnd(0)
         , _selectInterrupt(createSelectInterrupt())
     {
         ;
@@ -207,6 +216,16 @@ namespace ix
         return _selectInterrupt->getFd() != -1 || _selectInterrupt->getEvent() != nullptr;
     }
 
+    int Socket::getFd() const
+    {
+        return _sockfd;
+    }
+
+    int Socket::getSelectInterruptFd() const
+    {
+        return _selectInterrupt->getFd();
+    }
+
     bool Socket::accept(std::string& errMsg)
     {
         if (_sockfd == -1)
@@ -226,10 +245,16 @@ namespace ix
 
         if (!_selectInterrupt->clear()) return false;
 
-        _sockfd = SocketConnect::connect(host, port, errMsg, isCancellationRequested);
+        _sockfd = SocketConnect::connect(
+            host, port, errMsg, isCancellationRequested, &_connectTimings);
         return _sockfd != -1;
     }
 
+    SocketConnectTimings Socket::getConnectTimings() const
+    {
+        return _connectTimings;
+    }
+
     void Socket::close()
     {
         std::lock_guard<std::mutex> lock(_socketMutex);
@@ -255,6 +280,78 @@ namespace ix
         return send((char*) &buffer[0], buffer.size());
     }
 
+    ssize_t Socket::send(const SendBuffer* buffers, size_t count)
+    {
+#ifdef _WIN32
+        return sendCoalesced(buffers, count);
+#else
+        count = std::min(count, kMaxSendBuffers);
+
+        struct iovec iov[kMaxSendBuffers];
+        for (size_t i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = const_cast<char*>(buffers[i].data);
+            iov[i].iov_len = buffers[i].size;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL;
+#endif
+
+        return ::sendmsg(_sockfd, &msg, flags);
+#endif
+    }
+
+    bool Socket::isSendFileSupported() const
+    {
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    ssize_t Socket::sendFile(int fd, uint64_t offset, size_t length)
+    {
+#ifdef __linux__
+        off_t fileOffset = (off_t) offset;
+        return ::sendfile(_sockfd, fd, &fileOffset, length);
+#else
+        (void) fd;
+        (void) offset;
+        (void) length;
+        return -1;
+#endif
+    }
+
+    ssize_t Socket::sendCoalesced(const SendBuffer* buffers, size_t count)
+    {
+        if (count == 0) return 0;
+
+        // Large buffers are sent as is
+        if (count == 1 || buffers[0].size >= kCoalescedSendSize)
+        {
+            return send(const_cast<char*>(buffers[0].data), buffers[0].size);
+        }
+
+        std::array<char, kCoalescedSendSize> data;
+        size_t size = 0;
+        for (size_t i = 0; i < count && size < kCoalescedSendSize; ++i)
+        {
+            size_t len = std::min(buffers[i].size, kCoalescedSendSize - size);
+            memcpy(&data[size], buffers[i].data, len);
+            size += len;
+        }
+
+        return send(&data[0], size);
+    }
+
     ssize_t Socket::recv(void* buffer, size_t length)
     {
         int flags = 0;
@@ -343,18 +440,25 @@ namespace ix
         }
     }
 
-    bool Socket::readByte(void* buffer, const CancellationRequest& isCancellationRequested)
+    bool Socket::fillReadAheadBuffer(const CancellationRequest& isCancellationRequested)
     {
+        if (_readAheadBuffer.empty())
+        {
+            _readAheadBuffer.resize(kReadAheadBufferSize);
+        }
+        _readAheadStart = 0;
+        _readAheadEnd = 0;
+
         while (true)
         {
             if (isCancellationRequested && isCancellationRequested()) return false;
 
-            ssize_t ret;
-            ret = recv(buffer, 1);
+            ssize_t ret = recv(&_readAheadBuffer[0], _readAheadBuffer.size());
 
-            // We read one byte, as needed, all good.
-            if (ret == 1)
+            // We read some bytes, as needed, all good.
+            if (ret > 0)
             {
+                _readAheadEnd = (size_t) ret;
                 return true;
             }
             // There is possibly something to be read, try again
@@ -375,25 +479,48 @@ namespace ix
         }
     }
 
+    bool Socket::readByte(void* buffer, const CancellationRequest& isCancellationRequested)
+    {
+        if (_readAheadStart == _readAheadEnd && !fillReadAheadBuffer(isCancellationRequested))
+        {
+            return false;
+        }
+
+        *((char*) buffer) = _readAheadBuffer[_readAheadStart++];
+        return true;
+    }
+
     std::pair<bool, std::string> Socket::readLine(
         const CancellationRequest& isCancellationRequested)
     {
-        char c;
         std::string line;
         line.reserve(64);
 
-        for (int i = 0; i < 2 || (line[i - 2] != '\r' && line[i - 1] != '\n'); ++i)
+        while (true)
         {
-            if (!readByte(&c, isCancellationRequested))
+            if (_readAheadStart == _readAheadEnd && !fillReadAheadBuffer(isCancellationRequested))
             {
                 // Return what we were able to read
                 return std::make_pair(false, line);
             }
 
-            line += c;
-        }
+            // Consume up to the end of the line, or all the buffered bytes
+            const char* begin = &_readAheadBuffer[_readAheadStart];
+            size_t size = _readAheadEnd - _readAheadStart;
+            const char* eol = (const char*) memchr(begin, '\n', size);
+            if (eol != nullptr)
+            {
+                size = (size_t) (eol - begin) + 1;
+            }
+
+            line.append(begin, size);
+            _readAheadStart += size;
 
-        return std::make_pair(true, line);
+            if (eol != nullptr && line.size() >= 2)
+            {
+                return std::make_pair(true, line);
+            }
+        }
     }
 
     std::pair<bool, std::string> Socket::readBytes(
@@ -406,6 +533,25 @@ namespace ix
         std::vector<uint8_t> output;
         size_t bytesRead = 0;
 
+        // Start with the bytes already received by readLine or readByte
+        if (_readAheadStart != _readAheadEnd && length != 0)
+        {
+            size_t size = std::min(_readAheadEnd - _readAheadStart, length);
+            const char* begin = &_readAheadBuffer[_readAheadStart];
+            if (onChunkCallback)
+            {
+                onChunkCallback(std::string(begin, size));
+            }
+            else
+            {
+                output.insert(output.end(), begin, begin + size);
+            }
+            _readAheadStart += size;
+            bytesRead += size;
+
+            if (onProgressCallback) onProgressCallback((int) bytesRead, (int) length);
+        }
+
         while (bytesRead != length)
         {
             if (isCancellationRequested && isCancellationRequested())
@@ -440,7 +586,7 @@ namespace ix
 
             // Wait with a 1ms timeout until the socket is ready to read.
             // This way we are not busy looping
-            if (isReadyToRead(1) == PollResultType::Error)
+            if (bytesRead != length && isReadyToRead(1) == PollResultType::Error)
             {
                 const std::string errorMsg("Poll Error");
                 return std::make_pair(false, errorMsg);
@@ -449,4 +595,23 @@ namespace ix
 
         return std::make_pair(true, std::string(output.begin(), output.end()));
     }
+
+    bool Socket::isReadAheadBufferEmpty() const
+    {
+        return _readAheadStart == _readAheadEnd;
+    }
+
+    std::string Socket::releaseReadAheadBuffer()
+    {
+        std::string data;
+        if (_readAheadStart != _readAheadEnd)
+        {
+            data.assign(&_readAheadBuffer[_readAheadStart], _readAheadEnd - _readAheadStart);
+        }
+
+        std::vector<char>().swap(_readAheadBuffer);
+        _readAheadStart = 0;
+        _readAheadEnd = 0;
+        return data;
+    }
 } // namespace ix
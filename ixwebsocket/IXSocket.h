@@ -12,6 +12,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #ifdef __APPLE__
 #include <sys/types.h>
@@ -27,6 +28,7 @@ typedef SSIZE_T ssize_t;
 #include "IXCancellationRequest.h"
 #include "IXProgressCallback.h"
 #include "IXSelectInterrupt.h"
+#include "IXSocketConnect.h"
 
 namespace ix
 {
@@ -40,6 +42,13 @@ namespace ix
         CloseRequest = 5
     };
 
+    // One of the buffers of a scatter gather send
+    struct SendBuffer
+    {
+        const char* data;
+        size_t size;
+    };
+
     class Socket
     {
     public:
@@ -55,6 +64,10 @@ namespace ix
         PollResultType isReadyToWrite(int timeoutMs);
         PollResultType isReadyToRead(int timeoutMs);
 
+        // Used by the server event loop to watch the socket and its wake up pipe
+        int getFd() const;
+        int getSelectInterruptFd() const;
+
         // Virtual methods
         virtual bool accept(std::string& errMsg);
 
@@ -64,12 +77,29 @@ namespace ix
                              const CancellationRequest& isCancellationRequested);
         virtual void close();
 
+        // DNS lookup and connection attempts of the last connect call, once it returned
+        SocketConnectTimings getConnectTimings() const;
+
         virtual ssize_t send(char* buffer, size_t length);
         ssize_t send(const std::string& buffer);
+
+        // Send multiple buffers at once, with sendmsg on plain sockets. Returns the
+        // number of bytes sent, which can stop in the middle of any buffer. At most
+        // kMaxSendBuffers buffers are sent by a single call.
+        virtual ssize_t send(const SendBuffer* buffers, size_t count);
+        static constexpr size_t kMaxSendBuffers = 64;
         virtual ssize_t recv(void* buffer, size_t length);
 
+        // Send length bytes of the file fd starting at offset, without copying them
+        // to user space. Only plain sockets on Linux support it, TLS sockets need to
+        // encrypt the data, unless the kernel does it (kTLS).
+        virtual bool isSendFileSupported() const;
+        virtual ssize_t sendFile(int fd, uint64_t offset, size_t length);
+
         // Blocking and cancellable versions, working with socket that can be set
         // to non blocking mode. Used during HTTP upgrade.
+        // Reads go through a read ahead buffer, so that lines and headers do not cost
+        // a recv call per byte.
         bool readByte(void* buffer, const CancellationRequest& isCancellationRequested);
         bool writeBytes(const std::string& str, const CancellationRequest& isCancellationRequested);
 
@@ -79,6 +109,14 @@ namespace ix
                                                const OnChunkCallback& onChunkCallback,
                                                const CancellationRequest& isCancellationRequested);
 
+        // Bytes received by the read ahead buffer but not consumed yet, e.g. the first
+        // WebSocket frames following a handshake. The buffer memory is released.
+        std::string releaseReadAheadBuffer();
+
+        // False when received bytes are waiting in the read ahead buffer, e.g. pipelined
+        // HTTP requests. The socket will not be readable for them.
+        bool isReadAheadBufferEmpty() const;
+
         static int getErrno();
         static bool isWaitNeeded();
         static void closeSocket(int fd);
@@ -91,14 +129,28 @@ namespace ix
     protected:
         std::atomic<int> _sockfd;
         std::mutex _socketMutex;
+        SocketConnectTimings _connectTimings;
+
+        // Copy the first bytes of the buffers into a single send, so that TLS
+        // sockets do not create a record per buffer
+        ssize_t sendCoalesced(const SendBuffer* buffers, size_t count);
+        static constexpr size_t kCoalescedSendSize = 16 * 1024; // Maximum TLS record size
 
         static bool readSelectInterruptRequest(const SelectInterruptPtr& selectInterrupt,
                                                PollResultType* pollResult);
 
     private:
+        // Wait for data and receive it into the read ahead buffer
+        bool fillReadAheadBuffer(const CancellationRequest& isCancellationRequested);
+
         static const int kDefaultPollTimeout;
         static const int kDefaultPollNoTimeout;
 
+        std::vector<char> _readAheadBuffer;
+        size_t _readAheadStart;
+        size_t _readAheadEnd;
+        const static size_t kReadAheadBufferSize;
+
         SelectInterruptPtr _selectInterrupt;
     };
 } // namespace ix
@@ -196,7 +196,8 @@ namespace ix
         {
             std::lock_guard<std::mutex> lock(_mutex);
 
-            _sockfd = SocketConnect::connect(host, port, errMsg, isCancellationRequested);
+            _sockfd = SocketConnect::connect(
+                host, port, errMsg, isCancellationRequested, &_connectTimings);
             if (_sockfd == -1) return false;
 
             _sslContext = SSLCreateContext(kCFAllocatorDefault, kSSLClientSide, kSSLStreamType);
@@ -280,6 +281,11 @@ namespace ix
         return -1;
     }
 
+    ssize_t SocketAppleSSL::send(const SendBuffer* buffers, size_t count)
+    {
+        return sendCoalesced(buffers, count);
+    }
+
     // No wait support
     ssize_t SocketAppleSSL::recv(void* buf, size_t nbyte)
     {
@@ -310,6 +316,11 @@ namespace ix
         return -1;
     }
 
+    bool SocketAppleSSL::isSendFileSupported() const
+    {
+        return false;
+    }
+
 } // namespace ix
 
 #endif // IXWEBSOCKET_USE_SECURE_TRANSPORT
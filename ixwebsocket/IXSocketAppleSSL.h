@@ -31,7 +31,9 @@ namespace ix
         virtual void close() final;
 
         virtual ssize_t send(char* buffer, size_t length) final;
+        virtual ssize_t send(const SendBuffer* buffers, size_t count) final;
         virtual ssize_t recv(void* buffer, size_t length) final;
+        virtual bool isSendFileSupported() const final;
 
     private:
         static std::string getSSLErrorDescription(OSStatus status);
@@ -7,35 +7,64 @@
 #include "IXSocketConnect.h"
 
 #include "IXDNSLookup.h"
+#include "IXDNSResolver.h"
 #include "IXNetSystem.h"
-#include "IXSelectInterrupt.h"
 #include "IXSocket.h"
-#include "IXUniquePtr.h"
+#include <chrono>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/types.h>
+#include <vector>
 
 // Android needs extra headers for TCP_NODELAY and IPPROTO_TCP
 #ifdef ANDROID
 #include <linux/in.h>
 #include <linux/tcp.h>
 #endif
-#include <ixwebsocket/IXSelectInterruptFactory.h>
 
-namespace ix
+namespace
 {
-    //
-    // This function can be cancelled every 50 ms
-    // This is important so that we don't block the main UI thread when shutting down a
-    // connection which is already trying to reconnect, and can be blocked waiting for
-    // ::connect to respond.
-    //
-    int SocketConnect::connectToAddress(const struct addrinfo* address,
-                                        std::string& errMsg,
-                                        const CancellationRequest& isCancellationRequested)
+    int64_t getElapsedMs(const std::chrono::steady_clock::time_point& start)
     {
-        errMsg = "no error";
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+    // Alternate the address families, starting with the family of the first address
+    // which is the preferred one (RFC 8305 section 4)
+    std::vector<const struct addrinfo*> sortAddresses(const struct addrinfo* addresses)
+    {
+        std::vector<const struct addrinfo*> preferred;
+        std::vector<const struct addrinfo*> others;
+        for (auto address = addresses; address != nullptr; address = address->ai_next)
+        {
+            if (address->ai_family == addresses->ai_family)
+            {
+                preferred.push_back(address);
+            }
+            else
+            {
+                others.push_back(address);
+            }
+        }
+
+        std::vector<const struct addrinfo*> sorted;
+        for (size_t i = 0; i < preferred.size() || i < others.size(); ++i)
+        {
+            if (i < preferred.size()) sorted.push_back(preferred[i]);
+            if (i < others.size()) sorted.push_back(others[i]);
+        }
+        return sorted;
+    }
+} // namespace
 
+namespace ix
+{
+    const int SocketConnect::kConnectionAttemptDelayMs(250);
+
+    int SocketConnect::startConnection(const struct addrinfo* address, std::string& errMsg)
+    {
         socket_t fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
         if (fd < 0)
         {
@@ -56,72 +85,184 @@ namespace ix
             return -1;
         }
 
-        for (;;)
+        return fd;
+    }
+
+    //
+    // This function can be cancelled every 10 ms
+    // This is important so that we don't block the main UI thread when shutting down a
+    // connection which is already trying to reconnect, and can be blocked waiting for
+    // ::connect to respond.
+    //
+    int SocketConnect::connectToAddresses(const struct addrinfo* addresses,
+                                          std::string& errMsg,
+                                          const CancellationRequest& isCancellationRequested,
+                                          SocketConnectTimings* timings)
+    {
+        errMsg = "no error";
+
+        std::vector<const struct addrinfo*> sortedAddresses = sortAddresses(addresses);
+        size_t nextAddress = 0;
+
+        // Attempts in progress
+        std::vector<struct pollfd> fds;
+        std::vector<const struct addrinfo*> fdAddresses;
+
+        auto closeAttempts = [&fds]() {
+            for (auto&& pfd : fds)
+            {
+                Socket::closeSocket(pfd.fd);
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        auto nextAttemptTime = start;
+        int attempts = 0;
+        int sockfd = -1;
+        const struct addrinfo* connectedAddress = nullptr;
+
+        while (sockfd == -1)
         {
             if (isCancellationRequested && isCancellationRequested()) // Must handle timeout as well
             {
-                Socket::closeSocket(fd);
                 errMsg = "Cancelled";
-                return -1;
+                break;
             }
 
-            int timeoutMs = 10;
-            bool readyToRead = false;
-            SelectInterruptPtr selectInterrupt = ix::createSelectInterrupt();
-            PollResultType pollResult = Socket::poll(readyToRead, timeoutMs, fd, selectInterrupt);
-
-            if (pollResult == PollResultType::Timeout)
+            auto now = std::chrono::steady_clock::now();
+            if (nextAddress < sortedAddresses.size() && (fds.empty() || now >= nextAttemptTime))
             {
+                const struct addrinfo* address = sortedAddresses[nextAddress++];
+                attempts++;
+
+                int fd = startConnection(address, errMsg);
+                if (fd != -1)
+                {
+                    struct pollfd pfd;
+                    pfd.fd = fd;
+                    pfd.events = POLLOUT;
+                    pfd.revents = 0;
+                    fds.push_back(pfd);
+                    fdAddresses.push_back(address);
+                    nextAttemptTime = now + std::chrono::milliseconds(kConnectionAttemptDelayMs);
+                }
+                else
+                {
+                    nextAttemptTime = now;
+                }
                 continue;
             }
-            else if (pollResult == PollResultType::Error)
+
+            if (fds.empty()) break; // every address failed
+
+            // Wake up to check the cancellation request, and to start the next attempt
+            int timeoutMs = 10;
+            if (nextAddress < sortedAddresses.size())
             {
-                Socket::closeSocket(fd);
-                errMsg = std::string("Connect error: ") + strerror(Socket::getErrno());
-                return -1;
+                auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    nextAttemptTime - now);
+                if (delay.count() < timeoutMs) timeoutMs = (int) delay.count() + 1;
             }
-            else if (pollResult == PollResultType::ReadyForWrite)
+
+            int ret = ix::poll(&fds.front(), fds.size(), timeoutMs, nullptr);
+            if (ret < 0 && !Socket::isWaitNeeded())
             {
-                return fd;
+                errMsg = std::string("Connect error: ") + strerror(Socket::getErrno());
+                break;
             }
-            else
+            if (ret <= 0) continue;
+
+            for (size_t i = 0; i < fds.size();)
             {
-                Socket::closeSocket(fd);
-                errMsg = std::string("Connect error: ") + strerror(Socket::getErrno());
-                return -1;
+                if (fds[i].revents == 0)
+                {
+                    ++i;
+                    continue;
+                }
+
+                int optval = -1;
+#ifdef _WIN32
+                // On connect error, in async mode, windows will write to the exceptions fds
+                if ((fds[i].revents & POLLERR) == 0) optval = 0;
+#else
+                // getsockopt() puts the errno value for connect into optval so 0
+                // means no-error.
+                socklen_t optlen = sizeof(optval);
+                if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &optval, &optlen) == -1)
+                {
+                    optval = Socket::getErrno();
+                }
+#endif
+                if (optval == 0 && (fds[i].revents & POLLOUT))
+                {
+                    sockfd = fds[i].fd;
+                    connectedAddress = fdAddresses[i];
+                    fds.erase(fds.begin() + i);
+                    fdAddresses.erase(fdAddresses.begin() + i);
+                    break;
+                }
+
+                errMsg = std::string("Connect error: ") + strerror(optval > 0 ? optval : EIO);
+                Socket::closeSocket(fds[i].fd);
+                fds.erase(fds.begin() + i);
+                fdAddresses.erase(fdAddresses.begin() + i);
+
+                // Do not wait for the delay to try the next address
+                nextAttemptTime = std::chrono::steady_clock::now();
             }
         }
+
+        // Losing attempts are cancelled
+        closeAttempts();
+
+        if (sockfd != -1)
+        {
+            errMsg = "no error";
+        }
+
+        if (timings != nullptr)
+        {
+            timings->connectMs = getElapsedMs(start);
+            timings->attempts = attempts;
+            timings->addressFamily = connectedAddress ? connectedAddress->ai_family : 0;
+        }
+
+        return sockfd;
     }
 
     int SocketConnect::connect(const std::string& hostname,
                                int port,
                                std::string& errMsg,
-                               const CancellationRequest& isCancellationRequested)
+                               const CancellationRequest& isCancellationRequested,
+                               SocketConnectTimings* timings)
     {
         //
         // First do DNS resolution
         //
+        auto start = std::chrono::steady_clock::now();
         auto dnsLookup = std::make_shared<DNSLookup>(hostname, port);
         auto res = dnsLookup->resolve(errMsg, isCancellationRequested);
+
+        if (timings != nullptr)
+        {
+            *timings = SocketConnectTimings();
+            timings->resolutionMs = getElapsedMs(start);
+        }
+
         if (res == nullptr)
         {
             return -1;
         }
 
-        int sockfd = -1;
+        //
+        // Second race the connections to the addresses of the host
+        //
+        int sockfd = connectToAddresses(res.get(), errMsg, isCancellationRequested, timings);
 
-        // iterate through the records to find a working peer
-        struct addrinfo* address;
-        for (address = res.get(); address != nullptr; address = address->ai_next)
+        // The host may have moved, look it up again on the next connection
+        if (sockfd == -1)
         {
-            //
-            // Second try to connect to the remote host
-            //
-            sockfd = connectToAddress(address, errMsg, isCancellationRequested);
-            if (sockfd != -1)
-            {
-                break;
-            }
+            DNSResolver::getInstance().invalidate(hostname);
         }
 
         return sockfd;
@@ -7,25 +7,44 @@
 #pragma once
 
 #include "IXCancellationRequest.h"
+#include <cstdint>
 #include <string>
 
 struct addrinfo;
 
 namespace ix
 {
+    struct SocketConnectTimings
+    {
+        int64_t resolutionMs = 0; // DNS lookup
+        int64_t connectMs = 0;    // from the first connection attempt to the connected socket
+        int attempts = 0;         // connection attempts started
+        int addressFamily = 0;    // of the connected address, AF_INET or AF_INET6
+    };
+
     class SocketConnect
     {
     public:
         static int connect(const std::string& hostname,
                            int port,
                            std::string& errMsg,
-                           const CancellationRequest& isCancellationRequested);
+                           const CancellationRequest& isCancellationRequested,
+                           SocketConnectTimings* timings = nullptr);
+
+        // Happy Eyeballs (RFC 8305). The addresses are tried alternating between IPv6 and
+        // IPv4. A new attempt starts every kConnectionAttemptDelayMs, or as soon as the
+        // previous one fails, while the previous ones are still pending. The first
+        // connected socket is returned and the other attempts are closed.
+        static int connectToAddresses(const struct addrinfo* addresses,
+                                      std::string& errMsg,
+                                      const CancellationRequest& isCancellationRequested,
+                                      SocketConnectTimings* timings = nullptr);
 
         static void configure(int sockfd);
 
+        const static int kConnectionAttemptDelayMs;
+
     private:
-        static int connectToAddress(const struct addrinfo* address,
-                                    std::string& errMsg,
-                                    const CancellationRequest& isCancellationRequested);
+        static int startConnection(const struct addrinfo* address, std::string& errMsg);
     };
 } // namespace ix
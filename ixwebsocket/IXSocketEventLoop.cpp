@@ -0,0 +1,387 @@
+/*
+ *  IXSocketEventLoop.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXSocketEventLoop.h"
+
+#include "IXSelectInterruptFactory.h"
+#include "IXSetThreadName.h"
+#include "IXUniquePtr.h"
+#include <sstream>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+namespace ix
+{
+    const size_t SocketEventLoop::kDefaultThreadCount(4);
+    const int SocketEventLoop::kTickIntervalMs(100);
+
+    SocketEventLoop::SocketEventLoop(size_t threadCount)
+        : _threadCount(threadCount == 0 ? 1 : threadCount)
+        , _stop(false)
+        , _started(false)
+    {
+    }
+
+    SocketEventLoop::~SocketEventLoop()
+    {
+        stop();
+    }
+
+    bool SocketEventLoop::isSupported()
+    {
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool SocketEventLoop::start(std::string& errorMsg)
+    {
+        if (_started) return true;
+
+#ifdef __linux__
+        _stop = false;
+
+        for (size_t i = 0; i < _threadCount; ++i)
+        {
+            auto ioThread = ix::make_unique<IoThread>();
+            ioThread->connectionsCount = 0;
+            ioThread->epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (ioThread->epollFd < 0)
+            {
+                std::stringstream ss;
+                ss << "SocketEventLoop::start() error in epoll_create1: " << strerror(errno);
+                errorMsg = ss.str();
+                closeIoThreads();
+                return false;
+            }
+
+            // Keep the I/O thread in the list so that its epoll fd gets closed on errors
+            IoThread* ioThreadPtr = ioThread.get();
+            _ioThreads.push_back(std::move(ioThread));
+
+            ioThreadPtr->wakeUp = createSelectInterrupt();
+            if (!ioThreadPtr->wakeUp->init(errorMsg))
+            {
+                closeIoThreads();
+                return false;
+            }
+
+            // A null pointer as event data identifies the wake up pipe
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.ptr = nullptr;
+
+            if (epoll_ctl(ioThreadPtr->epollFd,
+                          EPOLL_CTL_ADD,
+                          ioThreadPtr->wakeUp->getFd(),
+                          &event) < 0)
+            {
+                std::stringstream ss;
+                ss << "SocketEventLoop::start() error in epoll_ctl: " << strerror(errno);
+                errorMsg = ss.str();
+                closeIoThreads();
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < _ioThreads.size(); ++i)
+        {
+            _ioThreads[i]->thread = std::thread(&SocketEventLoop::run, this, _ioThreads[i].get(), i);
+        }
+
+        _started = true;
+        return true;
+#else
+        errorMsg = "SocketEventLoop::start() epoll is not available on this platform";
+        return false;
+#endif
+    }
+
+    void SocketEventLoop::stop()
+    {
+        if (!_started) return;
+
+        _stop = true;
+
+        for (auto&& ioThread : _ioThreads)
+        {
+            ioThread->wakeUp->notify(SelectInterrupt::kCloseRequest);
+        }
+
+        for (auto&& ioThread : _ioThreads)
+        {
+            if (ioThread->thread.joinable()) ioThread->thread.join();
+        }
+
+        closeIoThreads();
+        _started = false;
+    }
+
+    void SocketEventLoop::closeIoThreads()
+    {
+#ifdef __linux__
+        for (auto&& ioThread : _ioThreads)
+        {
+            if (ioThread->epollFd >= 0)
+            {
+                ::close(ioThread->epollFd);
+            }
+        }
+#endif
+        _ioThreads.clear();
+    }
+
+    bool SocketEventLoop::add(int fd,
+                              int interruptFd,
+                              const OnEventCallback& onEventCallback,
+                              const HasPendingWritesCallback& hasPendingWritesCallback,
+                              std::string& errorMsg)
+    {
+#ifdef __linux__
+        if (!_started || _stop)
+        {
+            errorMsg = "SocketEventLoop::add() the event loop is not running";
+            return false;
+        }
+
+        // Pick the least loaded I/O thread
+        IoThread* ioThread = _ioThreads.front().get();
+        for (auto&& candidate : _ioThreads)
+        {
+            if (candidate->connectionsCount < ioThread->connectionsCount)
+            {
+                ioThread = candidate.get();
+            }
+        }
+
+        auto connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        connection->interruptFd = interruptFd;
+        connection->onEventCallback = onEventCallback;
+        connection->hasPendingWritesCallback = hasPendingWritesCallback;
+        connection->writeInterest = false;
+        connection->registered = false;
+        connection->removed = false;
+
+        {
+            std::lock_guard<std::mutex> lock(ioThread->connectionsMutex);
+            ioThread->connections[connection.get()] = connection;
+            ioThread->connectionsCount++;
+        }
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = connection.get();
+
+        bool success = epoll_ctl(ioThread->epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+        if (success && interruptFd != -1)
+        {
+            success = epoll_ctl(ioThread->epollFd, EPOLL_CTL_ADD, interruptFd, &event) == 0;
+            if (!success)
+            {
+                int err = errno;
+                epoll_ctl(ioThread->epollFd, EPOLL_CTL_DEL, fd, &event);
+                errno = err;
+            }
+        }
+
+        if (!success)
+        {
+            std::stringstream ss;
+            ss << "SocketEventLoop::add() error in epoll_ctl: " << strerror(errno);
+            errorMsg = ss.str();
+
+            std::lock_guard<std::mutex> lock(ioThread->connectionsMutex);
+            ioThread->connections.erase(connection.get());
+            ioThread->connectionsCount--;
+            return false;
+        }
+
+        connection->registered = true;
+        return true;
+#else
+        (void) fd;
+        (void) interruptFd;
+        (void) onEventCallback;
+        (void) hasPendingWritesCallback;
+        errorMsg = "SocketEventLoop::add() epoll is not available on this platform";
+        return false;
+#endif
+    }
+
+    size_t SocketEventLoop::getThreadCount() const
+    {
+        return _threadCount;
+    }
+
+    size_t SocketEventLoop::getConnectionsCount() const
+    {
+        size_t count = 0;
+        for (auto&& ioThread : _ioThreads)
+        {
+            count += ioThread->connectionsCount;
+        }
+        return count;
+    }
+
+    std::vector<SocketEventLoop::Connection*> SocketEventLoop::getConnections(IoThread* ioThread)
+    {
+        // Only the I/O thread removes connections, so the pointers stay valid while
+        // it iterates over them
+        std::vector<Connection*> connections;
+
+        std::lock_guard<std::mutex> lock(ioThread->connectionsMutex);
+        connections.reserve(ioThread->connections.size());
+        for (auto&& it : ioThread->connections)
+        {
+            connections.push_back(it.first);
+        }
+        return connections;
+    }
+
+    void SocketEventLoop::processEvent(IoThread* ioThread, Connection* connection, Event event)
+    {
+        if (connection->removed || !connection->registered) return;
+
+        if (!connection->onEventCallback(event))
+        {
+            remove(ioThread, connection);
+            return;
+        }
+
+        updateWriteInterest(ioThread, connection);
+    }
+
+    void SocketEventLoop::updateWriteInterest(IoThread* ioThread, Connection* connection)
+    {
+        if (!connection->hasPendingWritesCallback) return;
+
+        // A slow peer must not make the I/O thread wait: the data left to send stays
+        // queued, and is sent once epoll reports that the socket is writable
+        bool writeInterest = connection->hasPendingWritesCallback();
+        if (writeInterest == connection->writeInterest) return;
+
+#ifdef __linux__
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = writeInterest ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.ptr = connection;
+
+        if (epoll_ctl(ioThread->epollFd, EPOLL_CTL_MOD, connection->fd, &event) == 0)
+        {
+            connection->writeInterest = writeInterest;
+        }
+#else
+        (void) ioThread;
+#endif
+    }
+
+    void SocketEventLoop::remove(IoThread* ioThread, Connection* connection)
+    {
+        connection->removed = true;
+
+#ifdef __linux__
+        // The socket was closed by its owner, which removed it from the epoll set.
+        // Calling EPOLL_CTL_DEL on it could unregister a new connection which reused
+        // the same fd number. The wake up pipe is still open, it must be removed.
+        if (connection->interruptFd != -1)
+        {
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            epoll_ctl(ioThread->epollFd, EPOLL_CTL_DEL, connection->interruptFd, &event);
+        }
+#endif
+
+        std::lock_guard<std::mutex> lock(ioThread->connectionsMutex);
+        auto it = ioThread->connections.find(connection);
+        if (it != ioThread->connections.end())
+        {
+            ioThread->removedConnections.push_back(std::move(it->second));
+            ioThread->connections.erase(it);
+            ioThread->connectionsCount--;
+        }
+    }
+
+    void SocketEventLoop::run(IoThread* ioThread, size_t index)
+    {
+#ifdef __linux__
+        // Use a cryptic name to stay within the 16 bytes limit thread name limitation
+        setThreadName("Srv:io:" + std::to_string(index));
+
+        const int kMaxEvents = 256;
+        struct epoll_event events[kMaxEvents];
+
+        auto lastTick = std::chrono::steady_clock::now();
+        bool stopNotified = false;
+
+        for (;;)
+        {
+            int ret = epoll_wait(ioThread->epollFd, events, kMaxEvents, kTickIntervalMs);
+            if (ret < 0 && errno != EINTR)
+            {
+                break;
+            }
+
+            for (int i = 0; i < ret; ++i)
+            {
+                Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+                if (connection == nullptr)
+                {
+                    ioThread->wakeUp->read();
+                    continue;
+                }
+
+                processEvent(ioThread, connection, Event::Ready);
+            }
+
+            // Ping and closing timeouts are only checked periodically
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastTick >= std::chrono::milliseconds(kTickIntervalMs))
+            {
+                lastTick = now;
+                for (auto&& connection : getConnections(ioThread))
+                {
+                    processEvent(ioThread, connection, Event::Tick);
+                }
+            }
+
+            // Ask every connection to close, and keep running until they all are
+            if (_stop)
+            {
+                if (!stopNotified)
+                {
+                    stopNotified = true;
+                    for (auto&& connection : getConnections(ioThread))
+                    {
+                        processEvent(ioThread, connection, Event::Stop);
+                    }
+                }
+
+                if (ioThread->connectionsCount == 0)
+                {
+                    break;
+                }
+            }
+
+            ioThread->removedConnections.clear();
+        }
+
+        ioThread->removedConnections.clear();
+#else
+        (void) ioThread;
+        (void) index;
+#endif
+    }
+} // namespace ix
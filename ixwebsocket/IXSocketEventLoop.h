@@ -0,0 +1,114 @@
+/*
+ *  IXSocketEventLoop.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  A fixed pool of I/O threads, each one owning an epoll instance, which drive
+ *  many non blocking sockets. Used by SocketServer in event loop mode, instead of
+ *  running one thread per connection.
+ */
+
+#pragma once
+
+#include "IXSelectInterrupt.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ix
+{
+    class SocketEventLoop
+    {
+    public:
+        enum class Event
+        {
+            Ready, // the socket or its wake up pipe is readable, or the socket is writable
+                   // while data is waiting to be sent
+            Tick,  // periodic timer, used for ping and closing timeouts
+            Stop   // the event loop is stopping, the connection should be closed
+        };
+
+        // Invoked on the I/O thread owning the connection. Returns false once the
+        // connection is done, in which case its socket must have been closed.
+        using OnEventCallback = std::function<bool(Event)>;
+
+        // Invoked after each event, tells whether data is waiting to be sent. The
+        // connection is then woken up with Ready events once its socket is writable.
+        using HasPendingWritesCallback = std::function<bool()>;
+
+        SocketEventLoop(size_t threadCount = SocketEventLoop::kDefaultThreadCount);
+        ~SocketEventLoop();
+
+        // epoll is only available on Linux
+        static bool isSupported();
+
+        bool start(std::string& errorMsg);
+
+        // Notify all connections with a Stop event, and wait for them to be closed
+        void stop();
+
+        // fd is the connection socket, interruptFd the read end of its wake up pipe
+        // (can be -1). The connection is assigned to the least loaded I/O thread.
+        bool add(int fd,
+                 int interruptFd,
+                 const OnEventCallback& onEventCallback,
+                 const HasPendingWritesCallback& hasPendingWritesCallback,
+                 std::string& errorMsg);
+
+        size_t getThreadCount() const;
+        size_t getConnectionsCount() const;
+
+        const static size_t kDefaultThreadCount;
+        const static int kTickIntervalMs;
+
+    private:
+        struct Connection
+        {
+            int fd;
+            int interruptFd;
+            OnEventCallback onEventCallback;
+            HasPendingWritesCallback hasPendingWritesCallback;
+
+            // Whether the socket is registered for writability (EPOLLOUT)
+            bool writeInterest;
+
+            // Events are ignored until add() has registered both file descriptors
+            std::atomic<bool> registered;
+            bool removed;
+        };
+
+        struct IoThread
+        {
+            int epollFd;
+            SelectInterruptPtr wakeUp;
+            std::thread thread;
+
+            std::mutex connectionsMutex;
+            std::map<Connection*, std::shared_ptr<Connection>> connections;
+            std::atomic<size_t> connectionsCount;
+
+            // Connections removed while processing a batch of events are kept alive
+            // until the end of the batch, as later events can still refer to them
+            std::vector<std::shared_ptr<Connection>> removedConnections;
+        };
+
+        void run(IoThread* ioThread, size_t index);
+        void processEvent(IoThread* ioThread, Connection* connection, Event event);
+        void remove(IoThread* ioThread, Connection* connection);
+        void updateWriteInterest(IoThread* ioThread, Connection* connection);
+        std::vector<Connection*> getConnections(IoThread* ioThread);
+        void closeIoThreads();
+
+        size_t _threadCount;
+        std::vector<std::unique_ptr<IoThread>> _ioThreads;
+        std::atomic<bool> _stop;
+        bool _started;
+    };
+} // namespace ix
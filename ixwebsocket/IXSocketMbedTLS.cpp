@@ -15,6 +15,9 @@
 #include "IXSocket.h"
 #include "IXSocketConnect.h"
 #include <cstdint>
+#include <map>
+#include <mbedtls/ssl_ticket.h>
+#include <memory>
 #include <string.h>
 
 #ifdef _WIN32
@@ -22,8 +25,100 @@
 #include <wincrypt.h>
 #endif
 
+namespace
+{
+    // Client sessions, by host, port and TLS options
+    struct CachedSession
+    {
+        std::shared_ptr<mbedtls_ssl_session> session;
+        uint64_t lastUse;
+    };
+
+    struct SessionCache
+    {
+        std::mutex mutex;
+        std::map<std::string, CachedSession> sessions;
+        uint64_t useCount = 0;
+    };
+
+    SessionCache& getSessionCache()
+    {
+        static SessionCache* sessionCache = new SessionCache();
+        return *sessionCache;
+    }
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_TICKET_C) && \
+    defined(MBEDTLS_SSL_SRV_C)
+    // Session tickets of the servers, shared by all the accepted connections
+    struct Tickets
+    {
+        std::mutex mutex;
+        mbedtls_entropy_context entropy;
+        mbedtls_ctr_drbg_context ctrDrbg;
+        mbedtls_ssl_ticket_context context;
+    };
+
+    // Returns nullptr if the ticket keys could not be set up
+    Tickets* getTickets()
+    {
+        static Tickets* tickets = nullptr;
+        static std::once_flag ticketsInitFlag;
+        std::call_once(ticketsInitFlag, [] {
+            Tickets* t = new Tickets();
+            mbedtls_entropy_init(&t->entropy);
+            mbedtls_ctr_drbg_init(&t->ctrDrbg);
+            mbedtls_ssl_ticket_init(&t->context);
+
+            const char* pers = "IXSocketMbedTLS tickets";
+            if (mbedtls_ctr_drbg_seed(&t->ctrDrbg,
+                                      mbedtls_entropy_func,
+                                      &t->entropy,
+                                      (const unsigned char*) pers,
+                                      strlen(pers)) != 0 ||
+                mbedtls_ssl_ticket_setup(&t->context,
+                                         mbedtls_ctr_drbg_random,
+                                         &t->ctrDrbg,
+                                         MBEDTLS_CIPHER_AES_256_GCM,
+                                         ix::SocketMbedTLS::kTicketLifetimeSecs) != 0)
+            {
+                mbedtls_ssl_ticket_free(&t->context);
+                mbedtls_ctr_drbg_free(&t->ctrDrbg);
+                mbedtls_entropy_free(&t->entropy);
+                delete t;
+                return;
+            }
+            tickets = t;
+        });
+        return tickets;
+    }
+
+    // The ticket context is only thread safe with MBEDTLS_THREADING_C
+    int writeTicket(void* p,
+                    const mbedtls_ssl_session* session,
+                    unsigned char* start,
+                    const unsigned char* end,
+                    size_t* tlen,
+                    uint32_t* lifetime)
+    {
+        Tickets* tickets = static_cast<Tickets*>(p);
+        std::lock_guard<std::mutex> lock(tickets->mutex);
+        return mbedtls_ssl_ticket_write(&tickets->context, session, start, end, tlen, lifetime);
+    }
+
+    int parseTicket(void* p, mbedtls_ssl_session* session, unsigned char* buf, size_t len)
+    {
+        Tickets* tickets = static_cast<Tickets*>(p);
+        std::lock_guard<std::mutex> lock(tickets->mutex);
+        return mbedtls_ssl_ticket_parse(&tickets->context, session, buf, len);
+    }
+#endif
+} // namespace
+
 namespace ix
 {
+    const size_t SocketMbedTLS::kMaxCachedSessions(1024);
+    const uint32_t SocketMbedTLS::kTicketLifetimeSecs(3600);
+
     SocketMbedTLS::SocketMbedTLS(const SocketTLSOptions& tlsOptions, int fd)
         : Socket(fd)
         , _tlsOptions(tlsOptions)
@@ -197,6 +292,24 @@ namespace ix
             mbedtls_ssl_conf_ca_chain(&_conf, &_cacert, NULL);
         }
 
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        if (isClient && _tlsOptions.disable_session_resumption)
+        {
+            mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+        }
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_TICKET_C) && \
+    defined(MBEDTLS_SSL_SRV_C)
+        if (!isClient && !_tlsOptions.disable_session_resumption)
+        {
+            Tickets* tickets = getTickets();
+            if (tickets != nullptr)
+            {
+                mbedtls_ssl_conf_session_tickets_cb(&_conf, writeTicket, parseTicket, tickets);
+            }
+        }
+#endif
+
         if (mbedtls_ssl_setup(&_ssl, &_conf) != 0)
         {
             errMsg = "SSL setup failed";
@@ -266,7 +379,8 @@ namespace ix
     {
         {
             std::lock_guard<std::mutex> lock(_mutex);
-            _sockfd = SocketConnect::connect(host, port, errMsg, isCancellationRequested);
+            _sockfd = SocketConnect::connect(
+                host, port, errMsg, isCancellationRequested, &_connectTimings);
             if (_sockfd == -1) return false;
         }
 
@@ -278,6 +392,13 @@ namespace ix
             return false;
         }
 
+        std::string sessionKey;
+        if (!_tlsOptions.disable_session_resumption)
+        {
+            sessionKey = getSessionCacheKey(host, port);
+            setCachedSession(sessionKey);
+        }
+
         mbedtls_ssl_set_bio(&_ssl, &_sockfd, mbedtls_net_send, mbedtls_net_recv, NULL);
 
         int res;
@@ -304,13 +425,88 @@ namespace ix
             errMsg = "error in handshake : ";
             errMsg += buf;
 
+            // The session of a failed handshake is not offered again
+            if (!sessionKey.empty()) removeCachedSession(sessionKey);
+
             close();
             return false;
         }
 
+        if (!sessionKey.empty()) cacheSession(sessionKey);
+
         return true;
     }
 
+    std::string SocketMbedTLS::getSessionCacheKey(const std::string& host, int port) const
+    {
+        // Sessions are only offered again with the settings they were verified with
+        return host + ":" + std::to_string(port) + '\n' + _tlsOptions.certFile + '\n' +
+               _tlsOptions.keyFile + '\n' + _tlsOptions.caFile + '\n' + _tlsOptions.ciphers +
+               '\n' + (_tlsOptions.disable_hostname_validation ? "1" : "0");
+    }
+
+    void SocketMbedTLS::setCachedSession(const std::string& key)
+    {
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> cacheLock(sessionCache.mutex);
+
+        auto it = sessionCache.sessions.find(key);
+        if (it == sessionCache.sessions.end()) return;
+
+        // The session is copied in the connection
+        std::lock_guard<std::mutex> lock(_mutex);
+        mbedtls_ssl_set_session(&_ssl, it->second.session.get());
+        it->second.lastUse = ++sessionCache.useCount;
+    }
+
+    void SocketMbedTLS::cacheSession(const std::string& key)
+    {
+        std::shared_ptr<mbedtls_ssl_session> session(new mbedtls_ssl_session,
+                                                     [](mbedtls_ssl_session* s) {
+                                                         mbedtls_ssl_session_free(s);
+                                                         delete s;
+                                                     });
+        mbedtls_ssl_session_init(session.get());
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (mbedtls_ssl_get_session(&_ssl, session.get()) != 0) return;
+        }
+
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> cacheLock(sessionCache.mutex);
+
+        if (sessionCache.sessions.find(key) == sessionCache.sessions.end() &&
+            sessionCache.sessions.size() >= kMaxCachedSessions)
+        {
+            // Drop the least recently used session
+            auto oldest = sessionCache.sessions.begin();
+            for (auto jt = sessionCache.sessions.begin(); jt != sessionCache.sessions.end(); ++jt)
+            {
+                if (jt->second.lastUse < oldest->second.lastUse) oldest = jt;
+            }
+            sessionCache.sessions.erase(oldest);
+        }
+
+        CachedSession cachedSession;
+        cachedSession.session = session;
+        cachedSession.lastUse = ++sessionCache.useCount;
+        sessionCache.sessions[key] = cachedSession;
+    }
+
+    void SocketMbedTLS::removeCachedSession(const std::string& key)
+    {
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> lock(sessionCache.mutex);
+        sessionCache.sessions.erase(key);
+    }
+
+    void SocketMbedTLS::clearSessionCache()
+    {
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> lock(sessionCache.mutex);
+        sessionCache.sessions.clear();
+    }
+
     void SocketMbedTLS::close()
     {
         std::lock_guard<std::mutex> lock(_mutex);
@@ -346,6 +542,11 @@ namespace ix
         }
     }
 
+    ssize_t SocketMbedTLS::send(const SendBuffer* buffers, size_t count)
+    {
+        return sendCoalesced(buffers, count);
+    }
+
     ssize_t SocketMbedTLS::recv(void* buf, size_t nbyte)
     {
         while (true)
@@ -372,6 +573,11 @@ namespace ix
         }
     }
 
+    bool SocketMbedTLS::isSendFileSupported() const
+    {
+        return false;
+    }
+
 } // namespace ix
 
 #endif // IXWEBSOCKET_USE_MBED_TLS
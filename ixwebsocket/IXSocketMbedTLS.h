@@ -15,6 +15,7 @@
 #include <mbedtls/error.h>
 #include <mbedtls/net_sockets.h>
 #include <mbedtls/platform.h>
+#include <mbedtls/ssl.h>
 #include <mbedtls/x509.h>
 #include <mbedtls/x509_crt.h>
 #include <mutex>
@@ -36,7 +37,17 @@ namespace ix
         virtual void close() final;
 
         virtual ssize_t send(char* buffer, size_t length) final;
+        virtual ssize_t send(const SendBuffer* buffers, size_t count) final;
         virtual ssize_t recv(void* buffer, size_t length) final;
+        virtual bool isSendFileSupported() const final;
+
+        // Client sessions are cached per host, port and TLS options, up to a maximum
+        static void clearSessionCache();
+        const static size_t kMaxCachedSessions;
+
+        // Lifetime of the session tickets of the servers, mbedTLS rotates their keys at the
+        // same interval
+        const static uint32_t kTicketLifetimeSecs;
 
     private:
         mbedtls_ssl_context _ssl;
@@ -53,6 +64,10 @@ namespace ix
         bool init(const std::string& host, bool isClient, std::string& errMsg);
         void initMBedTLS();
         bool loadSystemCertificates(std::string& errMsg);
+        std::string getSessionCacheKey(const std::string& host, int port) const;
+        void setCachedSession(const std::string& key);
+        void cacheSession(const std::string& key);
+        static void removeCachedSession(const std::string& key);
     };
 
 } // namespace ix
@@ -10,15 +10,26 @@
 #include "IXSocketOpenSSL.h"
 
 #include "IXSocketConnect.h"
+#include "IXSocketTLSSessionCache.h"
 #include "IXUniquePtr.h"
 #include <cassert>
+#include <chrono>
+#include <cstring>
 #include <errno.h>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
 #include <vector>
 #ifdef _WIN32
 #include <shlwapi.h>
 #else
 #include <fnmatch.h>
 #endif
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 #include <openssl/x509v3.h>
 #endif
@@ -81,6 +92,206 @@ namespace
 } // namespace
 #endif
 
+namespace
+{
+    // Shared context of the servers using the same TLS options
+    struct ServerContextEntry
+    {
+        std::shared_ptr<SSL_CTX> context;
+        std::string fileStamps;
+        std::chrono::steady_clock::time_point nextCheck;
+    };
+
+    // Tells whether a file changed without reading it. Files rewritten in place get a new
+    // modification time, and files replaced by a rename a new inode.
+    std::string getFileStamp(const std::string& path)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return "-";
+
+        std::stringstream ss;
+        ss << st.st_mtime << ":" << st.st_size << ":" << st.st_ino;
+#ifdef __linux__
+        ss << ":" << st.st_mtim.tv_nsec;
+#endif
+        return ss.str();
+    }
+
+    std::string getFileStamps(const ix::SocketTLSOptions& tlsOptions)
+    {
+        std::string fileStamps = getFileStamp(tlsOptions.certFile) + " " +
+                                 getFileStamp(tlsOptions.keyFile);
+
+        if (!tlsOptions.isPeerVerifyDisabled() && !tlsOptions.isUsingSystemDefaults() &&
+            !tlsOptions.isUsingInMemoryCAs())
+        {
+            fileStamps += " " + getFileStamp(tlsOptions.caFile);
+        }
+        return fileStamps;
+    }
+
+    // Client sessions, by host, port and TLS options
+    struct CachedSession
+    {
+        SSL_SESSION* session;
+        uint64_t lastUse;
+    };
+
+    struct SessionCache
+    {
+        std::mutex mutex;
+        std::map<std::string, CachedSession> sessions;
+        uint64_t useCount = 0;
+    };
+
+    SessionCache& getSessionCache()
+    {
+        // Never destroyed, as OpenSSL may be cleaned up before static objects at exit
+        static SessionCache* sessionCache = new SessionCache();
+        return *sessionCache;
+    }
+
+    // Keys of the session tickets, shared by all the server contexts so that tickets
+    // outlive certificate rotations
+    struct TicketKey
+    {
+        unsigned char name[16];
+        unsigned char aesKey[32];
+        unsigned char hmacKey[32];
+    };
+
+    class TicketKeys
+    {
+    public:
+        // Returns false if no key could be generated
+        bool getCurrentKey(TicketKey& key)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_current || std::chrono::steady_clock::now() >= _nextRotation)
+            {
+                rotateKeys();
+            }
+            if (!_current) return false;
+
+            key = *_current;
+            return true;
+        }
+
+        // Returns 0 for an unknown key, 1 for the current key and 2 for the previous one
+        int findKey(const unsigned char* name, TicketKey& key)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_current && memcmp(_current->name, name, sizeof(key.name)) == 0)
+            {
+                key = *_current;
+                return 1;
+            }
+            if (_previous && memcmp(_previous->name, name, sizeof(key.name)) == 0)
+            {
+                key = *_previous;
+                return 2;
+            }
+            return 0;
+        }
+
+        void rotate()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            rotateKeys();
+        }
+
+    private:
+        void rotateKeys()
+        {
+            auto key = std::make_shared<TicketKey>();
+            if (RAND_bytes(key->name, sizeof(key->name)) != 1 ||
+                RAND_bytes(key->aesKey, sizeof(key->aesKey)) != 1 ||
+                RAND_bytes(key->hmacKey, sizeof(key->hmacKey)) != 1)
+            {
+                return;
+            }
+
+            _previous = _current;
+            _current = key;
+            _nextRotation = std::chrono::steady_clock::now() +
+                            std::chrono::seconds(ix::SocketOpenSSL::kTicketKeyRotationIntervalSecs);
+        }
+
+        std::mutex _mutex;
+        std::shared_ptr<TicketKey> _current;
+        std::shared_ptr<TicketKey> _previous;
+        std::chrono::steady_clock::time_point _nextRotation;
+    };
+
+    TicketKeys& getTicketKeys()
+    {
+        static TicketKeys* ticketKeys = new TicketKeys();
+        return *ticketKeys;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    bool initTicketMac(EVP_MAC_CTX* macContext, const TicketKey& key)
+    {
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*) "SHA256", 0),
+            OSSL_PARAM_construct_end()};
+        return EVP_MAC_init(macContext, key.hmacKey, sizeof(key.hmacKey), params) == 1;
+    }
+
+    int ticketKeyCallback(SSL* /*ssl*/,
+                          unsigned char* keyName,
+                          unsigned char* iv,
+                          EVP_CIPHER_CTX* cipherContext,
+                          EVP_MAC_CTX* macContext,
+                          int enc)
+#else
+    bool initTicketMac(HMAC_CTX* macContext, const TicketKey& key)
+    {
+        return HMAC_Init_ex(macContext, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), nullptr) ==
+               1;
+    }
+
+    int ticketKeyCallback(SSL* /*ssl*/,
+                          unsigned char* keyName,
+                          unsigned char* iv,
+                          EVP_CIPHER_CTX* cipherContext,
+                          HMAC_CTX* macContext,
+                          int enc)
+#endif
+    {
+        TicketKey key;
+        const EVP_CIPHER* cipher = EVP_aes_256_cbc();
+
+        if (enc == 1)
+        {
+            if (!getTicketKeys().getCurrentKey(key) ||
+                RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) != 1)
+            {
+                return -1;
+            }
+
+            memcpy(keyName, key.name, sizeof(key.name));
+            if (EVP_EncryptInit_ex(cipherContext, cipher, nullptr, key.aesKey, iv) != 1 ||
+                !initTicketMac(macContext, key))
+            {
+                return -1;
+            }
+            return 1;
+        }
+
+        // Unknown keys lead to a full handshake, tickets of the previous key are renewed
+        int found = getTicketKeys().findKey(keyName, key);
+        if (found == 0) return 0;
+
+        if (EVP_DecryptInit_ex(cipherContext, cipher, nullptr, key.aesKey, iv) != 1 ||
+            !initTicketMac(macContext, key))
+        {
+            return -1;
+        }
+        return found;
+    }
+} // namespace
+
 namespace ix
 {
     const std::string kDefaultCiphers =
@@ -91,6 +302,10 @@ namespace ix
         "DHE-RSA-AES128-GCM-SHA256 DHE-RSA-AES256-GCM-SHA384 DHE-RSA-AES128-SHA "
         "DHE-RSA-AES256-SHA DHE-RSA-AES128-SHA256 DHE-RSA-AES256-SHA256 AES128-SHA";
 
+    const int SocketOpenSSL::kServerContextCheckIntervalMs(1000);
+    const size_t SocketOpenSSL::kMaxCachedSessions(1024);
+    const int SocketOpenSSL::kTicketKeyRotationIntervalSecs(3600);
+
     std::atomic<bool> SocketOpenSSL::_openSSLInitializationSuccessful(false);
     std::once_flag SocketOpenSSL::_openSSLInitFlag;
     std::vector<std::unique_ptr<std::mutex>> openSSLMutexes;
@@ -100,6 +315,8 @@ namespace ix
         , _ssl_connection(nullptr)
         , _ssl_context(nullptr)
         , _tlsOptions(tlsOptions)
+        , _kernelTLSSend(false)
+        , _kernelTLSRecv(false)
     {
         std::call_once(_openSSLInitFlag, &SocketOpenSSL::openSSLInitialize, this);
     }
@@ -229,10 +446,10 @@ namespace ix
         return ctx;
     }
 
-    bool SocketOpenSSL::openSSLAddCARootsFromString(const std::string roots)
+    bool SocketOpenSSL::openSSLAddCARootsFromString(SSL_CTX* ctx, const std::string roots)
     {
         // Create certificate store
-        X509_STORE* certificate_store = SSL_CTX_get_cert_store(_ssl_context);
+        X509_STORE* certificate_store = SSL_CTX_get_cert_store(ctx);
         if (certificate_store == nullptr) return false;
 
         // Configure to allow intermediate certs
@@ -413,7 +630,7 @@ namespace ix
             bool rc = false;
             if (reason == SSL_ERROR_WANT_READ || reason == SSL_ERROR_WANT_WRITE)
             {
-                rc = true;
+                rc = waitForHandshake(reason);
             }
             else
             {
@@ -428,6 +645,15 @@ namespace ix
         }
     }
 
+    bool SocketOpenSSL::waitForHandshake(int reason)
+    {
+        // Wait for the peer instead of spinning, which starves it of cpu time when both
+        // ends run on the same cores. The short timeout keeps cancellation checks going.
+        PollResultType pollResult =
+            (reason == SSL_ERROR_WANT_READ) ? isReadyToRead(1) : isReadyToWrite(1);
+        return pollResult != PollResultType::Error;
+    }
+
     bool SocketOpenSSL::openSSLServerHandshake(std::string& errMsg)
     {
         while (true)
@@ -448,7 +674,7 @@ namespace ix
             bool rc = false;
             if (reason == SSL_ERROR_WANT_READ || reason == SSL_ERROR_WANT_WRITE)
             {
-                rc = true;
+                rc = waitForHandshake(reason);
             }
             else
             {
@@ -517,7 +743,7 @@ namespace ix
                 if (_tlsOptions.isUsingInMemoryCAs())
                 {
                     // Load from memory
-                    openSSLAddCARootsFromString(_tlsOptions.caFile);
+                    openSSLAddCARootsFromString(_ssl_context, _tlsOptions.caFile);
                 }
                 else
                 {
@@ -566,152 +792,237 @@ namespace ix
         return true;
     }
 
-    bool SocketOpenSSL::accept(std::string& errMsg)
+    SSL_CTX* SocketOpenSSL::openSSLCreateServerContext(const SocketTLSOptions& tlsOptions,
+                                                       std::string& errMsg)
     {
-        bool handshakeSuccessful = false;
+        const SSL_METHOD* method = SSLv23_server_method();
+        if (method == nullptr)
         {
-            std::lock_guard<std::mutex> lock(_mutex);
+            errMsg = "SSLv23_server_method failure";
+            return nullptr;
+        }
 
-            if (!_openSSLInitializationSuccessful)
-            {
-                errMsg = "OPENSSL_init_ssl failure";
-                return false;
-            }
+        SSL_CTX* ctx = SSL_CTX_new(method);
+        if (ctx == nullptr)
+        {
+            errMsg = "OpenSSL failed - SSL_CTX_new failed";
+            return nullptr;
+        }
 
-            if (_sockfd == -1)
-            {
-                return false;
-            }
+        SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        SSL_CTX_set_options(ctx, SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
 
-            {
-                const SSL_METHOD* method = SSLv23_server_method();
-                if (method == nullptr)
-                {
-                    errMsg = "SSLv23_server_method failure";
-                    _ssl_context = nullptr;
-                }
-                else
-                {
-                    _ssl_method = method;
+        // Sessions cached by the shared context can be resumed by clients, which
+        // OpenSSL refuses when peers are verified unless a session id context is set
+        static const unsigned char kSessionIdContext[] = "ixwebsocket";
+        SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
 
-                    _ssl_context = SSL_CTX_new(_ssl_method);
-                    if (_ssl_context)
-                    {
-                        SSL_CTX_set_mode(_ssl_context, SSL_MODE_ENABLE_PARTIAL_WRITE);
-                        SSL_CTX_set_mode(_ssl_context, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
-                        SSL_CTX_set_options(_ssl_context,
-                                            SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
-                    }
-                }
+        if (tlsOptions.disable_session_resumption)
+        {
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        }
+        else
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticketKeyCallback);
+#else
+            SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+#endif
+        }
+
+        ERR_clear_error();
+        if (tlsOptions.hasCertAndKey())
+        {
+            if (SSL_CTX_use_certificate_chain_file(ctx, tlsOptions.certFile.c_str()) != 1)
+            {
+                auto sslErr = ERR_get_error();
+                errMsg = "OpenSSL failed - SSL_CTX_use_certificate_chain_file(\"" +
+                         tlsOptions.certFile + "\") failed: ";
+                errMsg += ERR_error_string(sslErr, nullptr);
+                SSL_CTX_free(ctx);
+                return nullptr;
             }
 
-            if (_ssl_context == nullptr)
+            // Also fails when the key does not match the certificate, such as in the
+            // middle of a rotation
+            if (SSL_CTX_use_PrivateKey_file(ctx, tlsOptions.keyFile.c_str(), SSL_FILETYPE_PEM) !=
+                1)
             {
-                return false;
+                auto sslErr = ERR_get_error();
+                errMsg = "OpenSSL failed - SSL_CTX_use_PrivateKey_file(\"" +
+                         tlsOptions.keyFile + "\") failed: ";
+                errMsg += ERR_error_string(sslErr, nullptr);
+                SSL_CTX_free(ctx);
+                return nullptr;
             }
+        }
 
-            ERR_clear_error();
-            if (_tlsOptions.hasCertAndKey())
+        ERR_clear_error();
+        if (!tlsOptions.isPeerVerifyDisabled())
+        {
+            if (tlsOptions.isUsingSystemDefaults())
             {
-                if (SSL_CTX_use_certificate_chain_file(_ssl_context,
-                                                       _tlsOptions.certFile.c_str()) != 1)
+                if (SSL_CTX_set_default_verify_paths(ctx) == 0)
                 {
                     auto sslErr = ERR_get_error();
-                    errMsg = "OpenSSL failed - SSL_CTX_use_certificate_chain_file(\"" +
-                             _tlsOptions.certFile + "\") failed: ";
-                    errMsg += ERR_error_string(sslErr, nullptr);
-                }
-                else if (SSL_CTX_use_PrivateKey_file(
-                             _ssl_context, _tlsOptions.keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
-                {
-                    auto sslErr = ERR_get_error();
-                    errMsg = "OpenSSL failed - SSL_CTX_use_PrivateKey_file(\"" +
-                             _tlsOptions.keyFile + "\") failed: ";
+                    errMsg = "OpenSSL failed - SSL_CTX_default_verify_paths loading failed: ";
                     errMsg += ERR_error_string(sslErr, nullptr);
+                    SSL_CTX_free(ctx);
+                    return nullptr;
                 }
             }
-
-
-            ERR_clear_error();
-            if (!_tlsOptions.isPeerVerifyDisabled())
+            else
             {
-                if (_tlsOptions.isUsingSystemDefaults())
+                if (tlsOptions.isUsingInMemoryCAs())
                 {
-                    if (SSL_CTX_set_default_verify_paths(_ssl_context) == 0)
-                    {
-                        auto sslErr = ERR_get_error();
-                        errMsg = "OpenSSL failed - SSL_CTX_default_verify_paths loading failed: ";
-                        errMsg += ERR_error_string(sslErr, nullptr);
-                    }
+                    // Load from memory
+                    openSSLAddCARootsFromString(ctx, tlsOptions.caFile);
                 }
                 else
                 {
-                    if (_tlsOptions.isUsingInMemoryCAs())
+                    const char* root_ca_file = tlsOptions.caFile.c_str();
+                    STACK_OF(X509_NAME) * rootCAs;
+                    rootCAs = SSL_load_client_CA_file(root_ca_file);
+                    if (rootCAs == NULL)
                     {
-                        // Load from memory
-                        openSSLAddCARootsFromString(_tlsOptions.caFile);
+                        auto sslErr = ERR_get_error();
+                        errMsg = "OpenSSL failed - SSL_load_client_CA_file('" +
+                                 tlsOptions.caFile + "') failed: ";
+                        errMsg += ERR_error_string(sslErr, nullptr);
+                        SSL_CTX_free(ctx);
+                        return nullptr;
                     }
-                    else
+
+                    SSL_CTX_set_client_CA_list(ctx, rootCAs);
+                    if (SSL_CTX_load_verify_locations(ctx, root_ca_file, nullptr) != 1)
                     {
-                        const char* root_ca_file = _tlsOptions.caFile.c_str();
-                        STACK_OF(X509_NAME) * rootCAs;
-                        rootCAs = SSL_load_client_CA_file(root_ca_file);
-                        if (rootCAs == NULL)
-                        {
-                            auto sslErr = ERR_get_error();
-                            errMsg = "OpenSSL failed - SSL_load_client_CA_file('" +
-                                     _tlsOptions.caFile + "') failed: ";
-                            errMsg += ERR_error_string(sslErr, nullptr);
-                        }
-                        else
-                        {
-                            SSL_CTX_set_client_CA_list(_ssl_context, rootCAs);
-                            if (SSL_CTX_load_verify_locations(
-                                    _ssl_context, root_ca_file, nullptr) != 1)
-                            {
-                                auto sslErr = ERR_get_error();
-                                errMsg = "OpenSSL failed - SSL_CTX_load_verify_locations(\"" +
-                                         _tlsOptions.caFile + "\") failed: ";
-                                errMsg += ERR_error_string(sslErr, nullptr);
-                            }
-                        }
+                        auto sslErr = ERR_get_error();
+                        errMsg = "OpenSSL failed - SSL_CTX_load_verify_locations(\"" +
+                                 tlsOptions.caFile + "\") failed: ";
+                        errMsg += ERR_error_string(sslErr, nullptr);
+                        SSL_CTX_free(ctx);
+                        return nullptr;
                     }
                 }
+            }
+
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
+            SSL_CTX_set_verify_depth(ctx, 4);
+        }
+        else
+        {
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+        }
 
-                SSL_CTX_set_verify(
-                    _ssl_context, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
-                SSL_CTX_set_verify_depth(_ssl_context, 4);
+        const std::string& ciphers =
+            tlsOptions.isUsingDefaultCiphers() ? kDefaultCiphers : tlsOptions.ciphers;
+        if (SSL_CTX_set_cipher_list(ctx, ciphers.c_str()) != 1)
+        {
+            errMsg = "OpenSSL failed - SSL_CTX_set_cipher_list(\"" + ciphers + "\") failed";
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
+
+        return ctx;
+    }
+
+    std::shared_ptr<SSL_CTX> SocketOpenSSL::getServerContext(const SocketTLSOptions& tlsOptions,
+                                                             std::string& errMsg)
+    {
+        // Never destroyed, as OpenSSL may be cleaned up before static objects at exit
+        static std::mutex* contextsMutex = new std::mutex();
+        static auto* contexts = new std::map<std::string, ServerContextEntry>();
+
+        std::string key = tlsOptions.certFile + '\n' + tlsOptions.keyFile + '\n' +
+                          tlsOptions.caFile + '\n' + tlsOptions.ciphers + '\n' +
+                          (tlsOptions.disable_session_resumption ? "1" : "0");
+        auto now = std::chrono::steady_clock::now();
+
+        std::shared_ptr<SSL_CTX> context;
+        std::string fileStamps;
+        {
+            std::lock_guard<std::mutex> lock(*contextsMutex);
+            ServerContextEntry& entry = (*contexts)[key];
+            if (entry.context && now < entry.nextCheck)
+            {
+                return entry.context;
             }
-            else
+
+            // The other connections keep using the current context while it is checked
+            entry.nextCheck = now + std::chrono::milliseconds(kServerContextCheckIntervalMs);
+            context = entry.context;
+            fileStamps = entry.fileStamps;
+        }
+
+        std::string currentFileStamps = getFileStamps(tlsOptions);
+        if (context && currentFileStamps == fileStamps)
+        {
+            return context;
+        }
+
+        SSL_CTX* ctx = openSSLCreateServerContext(tlsOptions, errMsg);
+        if (ctx == nullptr)
+        {
+            // Rotated files may not all be written yet, keep the previous certificates
+            // until the next check
+            if (context) errMsg.clear();
+            return context;
+        }
+
+        // Connections accepted with the previous context keep a reference to it
+        std::shared_ptr<SSL_CTX> newContext(ctx, SSL_CTX_free);
+        std::lock_guard<std::mutex> lock(*contextsMutex);
+        ServerContextEntry& entry = (*contexts)[key];
+        entry.context = newContext;
+        entry.fileStamps = currentFileStamps;
+        return newContext;
+    }
+
+    bool SocketOpenSSL::accept(std::string& errMsg)
+    {
+        bool handshakeSuccessful = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (!_openSSLInitializationSuccessful)
             {
-                SSL_CTX_set_verify(_ssl_context, SSL_VERIFY_NONE, nullptr);
+                errMsg = "OPENSSL_init_ssl failure";
+                return false;
             }
-            if (_tlsOptions.isUsingDefaultCiphers())
+
+            if (_sockfd == -1)
             {
-                if (SSL_CTX_set_cipher_list(_ssl_context, kDefaultCiphers.c_str()) != 1)
-                {
-                    return false;
-                }
+                return false;
             }
-            else if (SSL_CTX_set_cipher_list(_ssl_context, _tlsOptions.ciphers.c_str()) != 1)
+
+            _serverContext = getServerContext(_tlsOptions, errMsg);
+            if (!_serverContext)
             {
                 return false;
             }
+            _ssl_context = _serverContext.get();
 
             _ssl_connection = SSL_new(_ssl_context);
             if (_ssl_connection == nullptr)
             {
                 errMsg = "OpenSSL failed to connect";
-                SSL_CTX_free(_ssl_context);
                 _ssl_context = nullptr;
+                _serverContext.reset();
                 return false;
             }
 
             SSL_set_ecdh_auto(_ssl_connection, 1);
 
             SSL_set_fd(_ssl_connection, _sockfd);
+            enableKernelTLS();
 
             handshakeSuccessful = openSSLServerHandshake(errMsg);
+            if (handshakeSuccessful)
+            {
+                recordTLSHandshake(false, SSL_session_reused(_ssl_connection) == 1);
+                checkKernelTLS();
+            }
         }
 
         if (!handshakeSuccessful)
@@ -738,7 +1049,8 @@ namespace ix
                 return false;
             }
 
-            _sockfd = SocketConnect::connect(host, port, errMsg, isCancellationRequested);
+            _sockfd = SocketConnect::connect(
+                host, port, errMsg, isCancellationRequested, &_connectTimings);
             if (_sockfd == -1) return false;
 
             _ssl_context = openSSLCreateContext(errMsg);
@@ -761,6 +1073,7 @@ namespace ix
                 return false;
             }
             SSL_set_fd(_ssl_connection, _sockfd);
+            enableKernelTLS();
 
             // SNI support
             SSL_set_tlsext_host_name(_ssl_connection, host.c_str());
@@ -776,7 +1089,32 @@ namespace ix
                 X509_VERIFY_PARAM_set1_host(param, host.c_str(), host.size());
             }
 #endif
+            std::string sessionKey;
+            if (!_tlsOptions.disable_session_resumption)
+            {
+                sessionKey = getSessionCacheKey(host, port);
+                setCachedSession(_ssl_connection, sessionKey);
+            }
+
             handshakeSuccessful = openSSLClientHandshake(host, errMsg, isCancellationRequested);
+            if (handshakeSuccessful)
+            {
+                recordTLSHandshake(true, SSL_session_reused(_ssl_connection) == 1);
+                checkKernelTLS();
+            }
+
+            if (!_tlsOptions.disable_session_resumption)
+            {
+                // The session of a failed handshake is not offered again
+                if (handshakeSuccessful)
+                {
+                    cacheSession(_ssl_connection, sessionKey);
+                }
+                else
+                {
+                    removeCachedSession(sessionKey);
+                }
+            }
         }
 
         if (!handshakeSuccessful)
@@ -788,20 +1126,146 @@ namespace ix
         return true;
     }
 
+    std::string SocketOpenSSL::getSessionCacheKey(const std::string& host, int port) const
+    {
+        // Sessions are only offered again with the settings they were verified with
+        return host + ":" + std::to_string(port) + '\n' + _tlsOptions.certFile + '\n' +
+               _tlsOptions.keyFile + '\n' + _tlsOptions.caFile + '\n' + _tlsOptions.ciphers +
+               '\n' + (_tlsOptions.disable_hostname_validation ? "1" : "0");
+    }
+
+    void SocketOpenSSL::setCachedSession(SSL* ssl, const std::string& key)
+    {
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> lock(sessionCache.mutex);
+
+        auto it = sessionCache.sessions.find(key);
+        if (it == sessionCache.sessions.end()) return;
+
+        // The connection holds its own reference to the session
+        SSL_set_session(ssl, it->second.session);
+        it->second.lastUse = ++sessionCache.useCount;
+    }
+
+    void SocketOpenSSL::cacheSession(SSL* ssl, const std::string& key)
+    {
+        SSL_SESSION* session = SSL_get1_session(ssl);
+        if (session == nullptr) return;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        if (!SSL_SESSION_is_resumable(session))
+        {
+            SSL_SESSION_free(session);
+            return;
+        }
+#endif
+
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> lock(sessionCache.mutex);
+
+        auto it = sessionCache.sessions.find(key);
+        if (it != sessionCache.sessions.end())
+        {
+            SSL_SESSION_free(it->second.session);
+            sessionCache.sessions.erase(it);
+        }
+        else if (sessionCache.sessions.size() >= kMaxCachedSessions)
+        {
+            // Drop the least recently used session
+            auto oldest = sessionCache.sessions.begin();
+            for (auto jt = sessionCache.sessions.begin(); jt != sessionCache.sessions.end(); ++jt)
+            {
+                if (jt->second.lastUse < oldest->second.lastUse) oldest = jt;
+            }
+            SSL_SESSION_free(oldest->second.session);
+            sessionCache.sessions.erase(oldest);
+        }
+
+        CachedSession cachedSession;
+        cachedSession.session = session;
+        cachedSession.lastUse = ++sessionCache.useCount;
+        sessionCache.sessions[key] = cachedSession;
+    }
+
+    void SocketOpenSSL::removeCachedSession(const std::string& key)
+    {
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> lock(sessionCache.mutex);
+
+        auto it = sessionCache.sessions.find(key);
+        if (it == sessionCache.sessions.end()) return;
+
+        SSL_SESSION_free(it->second.session);
+        sessionCache.sessions.erase(it);
+    }
+
+    void SocketOpenSSL::clearSessionCache()
+    {
+        SessionCache& sessionCache = getSessionCache();
+        std::lock_guard<std::mutex> lock(sessionCache.mutex);
+
+        for (auto&& it : sessionCache.sessions)
+        {
+            SSL_SESSION_free(it.second.session);
+        }
+        sessionCache.sessions.clear();
+    }
+
+    void SocketOpenSSL::rotateTicketKeys()
+    {
+        getTicketKeys().rotate();
+    }
+
+    void SocketOpenSSL::enableKernelTLS()
+    {
+#ifdef SSL_OP_ENABLE_KTLS
+        // OpenSSL hands the keys to the kernel at the end of the handshake, if the
+        // kernel tls module is loaded and the cipher is supported
+        if (_tlsOptions.enable_ktls)
+        {
+            SSL_set_options(_ssl_connection, SSL_OP_ENABLE_KTLS);
+        }
+#endif
+    }
+
+    void SocketOpenSSL::checkKernelTLS()
+    {
+#ifdef SSL_OP_ENABLE_KTLS
+        if (!_tlsOptions.enable_ktls) return;
+
+        _kernelTLSSend = BIO_get_ktls_send(SSL_get_wbio(_ssl_connection)) > 0;
+        _kernelTLSRecv = BIO_get_ktls_recv(SSL_get_rbio(_ssl_connection)) > 0;
+        if (_kernelTLSSend || _kernelTLSRecv)
+        {
+            recordKernelTLSConnection();
+        }
+#endif
+    }
+
     void SocketOpenSSL::close()
     {
         std::lock_guard<std::mutex> lock(_mutex);
 
         if (_ssl_connection != nullptr)
         {
+            // Connections are not closed with a close_notify alert, which no longer prevents
+            // their session from being resumed (RFC 5246 section 7.2.1)
+            if (SSL_is_init_finished(_ssl_connection))
+            {
+                SSL_set_shutdown(_ssl_connection, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+            }
             SSL_free(_ssl_connection);
             _ssl_connection = nullptr;
         }
         if (_ssl_context != nullptr)
         {
-            SSL_CTX_free(_ssl_context);
+            // Server contexts are shared by the accepted connections
+            if (!_serverContext) SSL_CTX_free(_ssl_context);
             _ssl_context = nullptr;
         }
+        _serverContext.reset();
+        _kernelTLSSend = false;
+        _kernelTLSRecv = false;
 
         Socket::close();
     }
@@ -815,6 +1279,11 @@ namespace ix
             return 0;
         }
 
+        if (_kernelTLSSend)
+        {
+            return Socket::send(buf, nbyte);
+        }
+
         ERR_clear_error();
         ssize_t write_result = SSL_write(_ssl_connection, buf, (int) nbyte);
         int reason = SSL_get_error(_ssl_connection, (int) write_result);
@@ -834,6 +1303,24 @@ namespace ix
         }
     }
 
+    ssize_t SocketOpenSSL::send(const SendBuffer* buffers, size_t count)
+    {
+        if (_kernelTLSSend)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_ssl_connection == nullptr || _ssl_context == nullptr)
+            {
+                return 0;
+            }
+
+            // The kernel splits the buffers into records
+            return Socket::send(buffers, count);
+        }
+
+        return sendCoalesced(buffers, count);
+    }
+
     ssize_t SocketOpenSSL::recv(void* buf, size_t nbyte)
     {
         while (true)
@@ -845,6 +1332,17 @@ namespace ix
                 return 0;
             }
 
+            // Records other than application data, such as alerts, make recv fail with
+            // EIO. They are left to SSL_read, which may also keep decrypted data.
+            if (_kernelTLSRecv && SSL_pending(_ssl_connection) == 0)
+            {
+                ssize_t ret = Socket::recv(buf, nbyte);
+                if (ret >= 0 || getErrno() != EIO)
+                {
+                    return ret;
+                }
+            }
+
             ERR_clear_error();
             ssize_t read_result = SSL_read(_ssl_connection, buf, (int) nbyte);
 
@@ -863,6 +1361,23 @@ namespace ix
         }
     }
 
+    bool SocketOpenSSL::isSendFileSupported() const
+    {
+        return _kernelTLSSend;
+    }
+
+    ssize_t SocketOpenSSL::sendFile(int fd, uint64_t offset, size_t length)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_ssl_connection == nullptr || !_kernelTLSSend)
+        {
+            return -1;
+        }
+
+        return Socket::sendFile(fd, offset, length);
+    }
+
 } // namespace ix
 
 #endif // IXWEBSOCKET_USE_OPEN_SSL
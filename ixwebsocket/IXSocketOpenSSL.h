@@ -10,6 +10,7 @@
 #include "IXCancellationRequest.h"
 #include "IXSocket.h"
 #include "IXSocketTLSOptions.h"
+#include <memory>
 #include <mutex>
 #include <openssl/bio.h>
 #include <openssl/conf.h>
@@ -34,13 +35,34 @@ namespace ix
         virtual void close() final;
 
         virtual ssize_t send(char* buffer, size_t length) final;
+        virtual ssize_t send(const SendBuffer* buffers, size_t count) final;
         virtual ssize_t recv(void* buffer, size_t length) final;
+        virtual bool isSendFileSupported() const final;
+        virtual ssize_t sendFile(int fd, uint64_t offset, size_t length) final;
+
+        // Accepted connections share a server context built from the TLS options, which is
+        // built again when the certificate, key or ca files change. The files are checked
+        // at most once per interval.
+        const static int kServerContextCheckIntervalMs;
+
+        // Client sessions are cached per host, port and TLS options, up to a maximum
+        static void clearSessionCache();
+        const static size_t kMaxCachedSessions;
+
+        // Session tickets of the servers are encrypted with a key replaced at each
+        // interval, the previous key being kept to decrypt the tickets still in use
+        static void rotateTicketKeys();
+        const static int kTicketKeyRotationIntervalSecs;
 
     private:
         void openSSLInitialize();
         std::string getSSLError(int ret);
         SSL_CTX* openSSLCreateContext(std::string& errMsg);
-        bool openSSLAddCARootsFromString(const std::string roots);
+        static SSL_CTX* openSSLCreateServerContext(const SocketTLSOptions& tlsOptions,
+                                                   std::string& errMsg);
+        static std::shared_ptr<SSL_CTX> getServerContext(const SocketTLSOptions& tlsOptions,
+                                                         std::string& errMsg);
+        static bool openSSLAddCARootsFromString(SSL_CTX* ctx, const std::string roots);
         bool openSSLClientHandshake(const std::string& hostname,
                                     std::string& errMsg,
                                     const CancellationRequest& isCancellationRequested);
@@ -48,15 +70,28 @@ namespace ix
         bool checkHost(const std::string& host, const char* pattern);
         bool handleTLSOptions(std::string& errMsg);
         bool openSSLServerHandshake(std::string& errMsg);
+        bool waitForHandshake(int reason);
+        void enableKernelTLS();
+        void checkKernelTLS();
+        std::string getSessionCacheKey(const std::string& host, int port) const;
+        static void setCachedSession(SSL* ssl, const std::string& key);
+        static void cacheSession(SSL* ssl, const std::string& key);
+        static void removeCachedSession(const std::string& key);
 
         // Required for OpenSSL < 1.1
         static void openSSLLockingCallback(int mode, int type, const char* /*file*/, int /*line*/);
 
         SSL* _ssl_connection;
         SSL_CTX* _ssl_context;
+        std::shared_ptr<SSL_CTX> _serverContext; // owns _ssl_context for servers
         const SSL_METHOD* _ssl_method;
         SocketTLSOptions _tlsOptions;
 
+        // With kTLS, the socket is written to and read from directly, the kernel
+        // encrypting and decrypting the records
+        std::atomic<bool> _kernelTLSSend;
+        std::atomic<bool> _kernelTLSRecv;
+
         mutable std::mutex _mutex; // OpenSSL routines are not thread-safe
 
         static std::once_flag _openSSLInitFlag;
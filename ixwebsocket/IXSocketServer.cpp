@@ -13,6 +13,7 @@
 #include "IXSocket.h"
 #include "IXSocketConnect.h"
 #include "IXSocketFactory.h"
+#include "IXUniquePtr.h"
 #include <assert.h>
 #include <sstream>
 #include <stdio.h>
@@ -25,6 +26,7 @@ namespace ix
     const int SocketServer::kDefaultTcpBacklog(5);
     const size_t SocketServer::kDefaultMaxConnections(128);
     const int SocketServer::kDefaultAddressFamily(AF_INET);
+    const size_t SocketServer::kDefaultHandshakeThreads(4);
 
     SocketServer::SocketServer(
         int port, const std::string& host, int backlog, size_t maxConnections, int addressFamily)
@@ -38,6 +40,9 @@ namespace ix
         , _stopGc(false)
         , _connectionStateFactory(&ConnectionState::createConnectionState)
         , _acceptSelectInterrupt(createSelectInterrupt())
+        , _eventLoopThreads(0)
+        , _handshakeThreadsCount(0)
+        , _stopHandshakeThreads(false)
     {
     }
 
@@ -179,6 +184,7 @@ namespace ix
 
         if (!_thread.joinable())
         {
+            startEventLoop();
             _thread = std::thread(&SocketServer::run, this);
         }
 
@@ -202,9 +208,9 @@ namespace ix
     void SocketServer::stop()
     {
         // Stop accepting connections, and close the 'accept' thread
+        _stop = true;
         if (_thread.joinable())
         {
-            _stop = true;
             // Wake up select
             if (!_acceptSelectInterrupt->notify(SelectInterrupt::kCloseRequest))
             {
@@ -212,9 +218,11 @@ namespace ix
             }
 
             _thread.join();
-            _stop = false;
         }
 
+        // Close the connections driven by the event loop
+        stopEventLoop();
+
         // Join all threads and make sure that all connections are terminated
         if (_gcThread.joinable())
         {
@@ -228,10 +236,17 @@ namespace ix
             _stopGc = false;
         }
 
+        _stop = false;
+
         _conditionVariable.notify_one();
         Socket::closeSocket(_serverFd);
     }
 
+    bool SocketServer::isStopping() const
+    {
+        return _stop;
+    }
+
     void SocketServer::setConnectionStateFactory(
         const ConnectionStateFactory& connectionStateFactory)
     {
@@ -326,7 +341,7 @@ namespace ix
                 continue;
             }
 
-            if (getConnectedClientsCount() >= _maxConnections)
+            if (getConnectedClientsCount() + getPendingConnectionsCount() >= _maxConnections)
             {
                 std::stringstream ss;
                 ss << "SocketServer::run() reached max connections = " << _maxConnections << ". "
@@ -415,6 +430,18 @@ namespace ix
                 continue;
             }
 
+            // In event loop mode, an handshake thread runs handleConnection, which
+            // hands the connection over to the event loop once upgraded.
+            if (_eventLoop)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(_pendingConnectionsMutex);
+                    _pendingConnections.push(std::make_pair(std::move(socket), connectionState));
+                }
+                _pendingConnectionsCondition.notify_one();
+                continue;
+            }
+
             // Launch the handleConnection work asynchronously in its own thread.
             std::lock_guard<std::mutex> lock(_connectionsThreadsMutex);
             _connectionsThreads.push_back(std::make_pair(
@@ -430,6 +457,14 @@ namespace ix
         return _connectionsThreads.size();
     }
 
+    size_t SocketServer::getPendingConnectionsCount()
+    {
+        // Connections taken by an handshake thread are not counted: a websocket is a
+        // client before its handshake, and HTTP requests are bounded by the thread count
+        std::lock_guard<std::mutex> lock(_pendingConnectionsMutex);
+        return _pendingConnections.size();
+    }
+
     void SocketServer::runGC()
     {
         // Use a cryptic name to stay within the 16 bytes limit thread name limitation
@@ -468,6 +503,99 @@ namespace ix
         _socketTLSOptions = socketTLSOptions;
     }
 
+    void SocketServer::enableEventLoop(size_t ioThreads, size_t handshakeThreads)
+    {
+        _eventLoopThreads = ioThreads;
+        _handshakeThreadsCount = (handshakeThreads == 0) ? 1 : handshakeThreads;
+    }
+
+    bool SocketServer::isEventLoopEnabled() const
+    {
+        return _eventLoopThreads > 0;
+    }
+
+    SocketEventLoop* SocketServer::getEventLoop()
+    {
+        return _eventLoop.get();
+    }
+
+    void SocketServer::startEventLoop()
+    {
+        if (!isEventLoopEnabled() || _eventLoop) return;
+
+        auto eventLoop = ix::make_unique<SocketEventLoop>(_eventLoopThreads);
+
+        std::string errorMsg;
+        if (!eventLoop->start(errorMsg))
+        {
+            logError("SocketServer::start() cannot start the event loop, using one thread per "
+                     "connection: " +
+                     errorMsg);
+            return;
+        }
+
+        _eventLoop = std::move(eventLoop);
+
+        _stopHandshakeThreads = false;
+        for (size_t i = 0; i < _handshakeThreadsCount; ++i)
+        {
+            _handshakeThreads.push_back(std::thread(&SocketServer::runHandshakeThread, this));
+        }
+    }
+
+    void SocketServer::stopEventLoop()
+    {
+        if (!_eventLoop) return;
+
+        {
+            std::lock_guard<std::mutex> lock(_pendingConnectionsMutex);
+            _stopHandshakeThreads = true;
+        }
+        _pendingConnectionsCondition.notify_all();
+
+        for (auto&& thread : _handshakeThreads)
+        {
+            thread.join();
+        }
+        _handshakeThreads.clear();
+
+        // Drop the connections which were never handled
+        while (!_pendingConnections.empty())
+        {
+            _pendingConnections.front().second->setTerminated();
+            _pendingConnections.pop();
+        }
+
+        _eventLoop->stop();
+        _eventLoop.reset();
+    }
+
+    void SocketServer::runHandshakeThread()
+    {
+        // Use a cryptic name to stay within the 16 bytes limit thread name limitation
+        setThreadName("Srv:hs:" + std::to_string(_port));
+
+        for (;;)
+        {
+            std::unique_ptr<Socket> socket;
+            std::shared_ptr<ConnectionState> connectionState;
+
+            {
+                std::unique_lock<std::mutex> lock(_pendingConnectionsMutex);
+                _pendingConnectionsCondition.wait(
+                    lock, [this] { return _stopHandshakeThreads || !_pendingConnections.empty(); });
+
+                if (_stopHandshakeThreads) return;
+
+                socket = std::move(_pendingConnections.front().first);
+                connectionState = _pendingConnections.front().second;
+                _pendingConnections.pop();
+            }
+
+            handleConnection(std::move(socket), connectionState);
+        }
+    }
+
     void SocketServer::onSetTerminatedCallback()
     {
         // a connection got terminated, we can run the connection thread GC,
@@ -9,6 +9,7 @@
 #include "IXConnectionState.h"
 #include "IXNetSystem.h"
 #include "IXSelectInterrupt.h"
+#include "IXSocketEventLoop.h"
 #include "IXSocketTLSOptions.h"
 #include <atomic>
 #include <condition_variable>
@@ -16,10 +17,12 @@
 #include <list>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <set>
 #include <string>
 #include <thread>
 #include <utility> // pair
+#include <vector>
 
 namespace ix
 {
@@ -53,6 +56,7 @@ namespace ix
         const static int kDefaultTcpBacklog;
         const static size_t kDefaultMaxConnections;
         const static int kDefaultAddressFamily;
+        const static size_t kDefaultHandshakeThreads;
 
         void start();
         std::pair<bool, std::string> listen();
@@ -60,6 +64,17 @@ namespace ix
 
         void setTLSOptions(const SocketTLSOptions& socketTLSOptions);
 
+        // Event loop mode, Linux only (epoll), to be called before start().
+        // Established connections are driven by a fixed pool of ioThreads I/O threads
+        // instead of one thread per connection. The websocket handshake (or the HTTP
+        // request) of new connections is processed by a pool of handshakeThreads threads,
+        // and connections waiting for one of them count against maxConnections.
+        // Message callbacks are invoked on the I/O threads and should not block.
+        // Falls back to one thread per connection when epoll is not available.
+        void enableEventLoop(size_t ioThreads = SocketEventLoop::kDefaultThreadCount,
+                             size_t handshakeThreads = SocketServer::kDefaultHandshakeThreads);
+        bool isEventLoopEnabled() const;
+
         int  getPort();
         std::string getHost();
         int getBacklog();
@@ -72,6 +87,12 @@ namespace ix
 
         void stopAcceptingConnections();
 
+        // True while the server is stopping, until all its connections are closed
+        bool isStopping() const;
+
+        // Returns nullptr unless the server is running in event loop mode
+        SocketEventLoop* getEventLoop();
+
     private:
         // Member variables
         int _port;
@@ -122,6 +143,23 @@ namespace ix
         // to wake up from select
         SelectInterruptPtr _acceptSelectInterrupt;
 
+        // Event loop mode
+        size_t _eventLoopThreads;
+        size_t _handshakeThreadsCount;
+        std::unique_ptr<SocketEventLoop> _eventLoop;
+        void startEventLoop();
+        void stopEventLoop();
+
+        // Accepted connections waiting for an handshake thread
+        std::queue<std::pair<std::unique_ptr<Socket>, std::shared_ptr<ConnectionState>>>
+            _pendingConnections;
+        std::mutex _pendingConnectionsMutex;
+        std::condition_variable _pendingConnectionsCondition;
+        bool _stopHandshakeThreads;
+        size_t getPendingConnectionsCount();
+        std::vector<std::thread> _handshakeThreads;
+        void runHandshakeThread();
+
         // used by the gc thread, to know that a thread needs to be garbage collected
         // as a connection
         std::condition_variable _conditionVariableGC;
@@ -88,6 +88,8 @@ namespace ix
         ss << "  caFile   = " << caFile << std::endl;
         ss << "  ciphers  = " << ciphers << std::endl;
         ss << "  tls      = " << tls << std::endl;
+        ss << "  disable_session_resumption = " << disable_session_resumption << std::endl;
+        ss << "  enable_ktls = " << enable_ktls << std::endl;
         return ss.str();
     }
 } // namespace ix
@@ -36,6 +36,15 @@ namespace ix
         // whether to skip validating the peer's hostname against the certificate presented
         bool disable_hostname_validation = false;
 
+        // whether to do a full handshake for each connection, without session tickets
+        // or session cache (see IXSocketTLSSessionCache.h)
+        bool disable_session_resumption = false;
+
+        // whether to let the kernel encrypt and decrypt the records once the handshake is
+        // done (kTLS), with OpenSSL 3 on Linux. Connections fall back to encrypting in user
+        // space when the kernel, OpenSSL or the negotiated cipher do not support it.
+        bool enable_ktls = false;
+
         bool hasCertAndKey() const;
 
         bool isUsingSystemDefaults() const;
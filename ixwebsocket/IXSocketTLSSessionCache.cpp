@@ -0,0 +1,76 @@
+/*
+ *  IXSocketTLSSessionCache.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXSocketTLSSessionCache.h"
+
+#include <atomic>
+
+#ifdef IXWEBSOCKET_USE_TLS
+#ifdef IXWEBSOCKET_USE_MBED_TLS
+#include "IXSocketMbedTLS.h"
+#elif defined(IXWEBSOCKET_USE_OPEN_SSL)
+#include "IXSocketOpenSSL.h"
+#endif
+#endif
+
+namespace
+{
+    std::atomic<uint64_t> clientFullHandshakes(0);
+    std::atomic<uint64_t> clientResumedHandshakes(0);
+    std::atomic<uint64_t> serverFullHandshakes(0);
+    std::atomic<uint64_t> serverResumedHandshakes(0);
+    std::atomic<uint64_t> kernelTLSConnections(0);
+} // namespace
+
+namespace ix
+{
+    SocketTLSSessionStats getTLSSessionStats()
+    {
+        SocketTLSSessionStats stats;
+        stats.clientFullHandshakes = clientFullHandshakes;
+        stats.clientResumedHandshakes = clientResumedHandshakes;
+        stats.serverFullHandshakes = serverFullHandshakes;
+        stats.serverResumedHandshakes = serverResumedHandshakes;
+        stats.kernelTLSConnections = kernelTLSConnections;
+        return stats;
+    }
+
+    void recordTLSHandshake(bool isClient, bool resumed)
+    {
+        if (isClient)
+        {
+            ++(resumed ? clientResumedHandshakes : clientFullHandshakes);
+        }
+        else
+        {
+            ++(resumed ? serverResumedHandshakes : serverFullHandshakes);
+        }
+    }
+
+    void recordKernelTLSConnection()
+    {
+        ++kernelTLSConnections;
+    }
+
+    void clearTLSSessionCache()
+    {
+#ifdef IXWEBSOCKET_USE_TLS
+#ifdef IXWEBSOCKET_USE_MBED_TLS
+        SocketMbedTLS::clearSessionCache();
+#elif defined(IXWEBSOCKET_USE_OPEN_SSL)
+        SocketOpenSSL::clearSessionCache();
+#endif
+#endif
+    }
+
+    void rotateTLSTicketKeys()
+    {
+#if defined(IXWEBSOCKET_USE_TLS) && defined(IXWEBSOCKET_USE_OPEN_SSL) && \
+    !defined(IXWEBSOCKET_USE_MBED_TLS)
+        SocketOpenSSL::rotateTicketKeys();
+#endif
+    }
+} // namespace ix
@@ -0,0 +1,44 @@
+/*
+ *  IXSocketTLSSessionCache.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  TLS session resumption. Clients keep the session of their last connection to a host
+ *  and port, and offer it again on the next connection to skip the full handshake.
+ *  Servers hand out session tickets, encrypted with keys which are rotated.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace ix
+{
+    // Process wide counters of the handshakes, the resumed ones reused a session of a
+    // previous connection. Only maintained by the OpenSSL sockets.
+    struct SocketTLSSessionStats
+    {
+        uint64_t clientFullHandshakes = 0;
+        uint64_t clientResumedHandshakes = 0;
+        uint64_t serverFullHandshakes = 0;
+        uint64_t serverResumedHandshakes = 0;
+
+        // Connections whose records are encrypted by the kernel (enable_ktls), in at
+        // least one direction
+        uint64_t kernelTLSConnections = 0;
+    };
+
+    SocketTLSSessionStats getTLSSessionStats();
+
+    // Called by the TLS sockets once a handshake completed
+    void recordTLSHandshake(bool isClient, bool resumed);
+    void recordKernelTLSConnection();
+
+    // Forget the sessions of the client connections
+    void clearTLSSessionCache();
+
+    // Encrypt the next tickets with a new key. Tickets encrypted with the previous key are
+    // still accepted and renewed, older ones lead to a full handshake. Keys are also
+    // rotated periodically. OpenSSL only, mbedTLS rotates its keys on its own.
+    void rotateTLSTicketKeys();
+} // namespace ix
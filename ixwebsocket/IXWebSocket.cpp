@@ -34,11 +34,18 @@ namespace ix
     WebSocket::WebSocket()
         : _onMessageCallback(OnMessageCallback())
         , _stop(false)
+        , _stopRequested(false)
         , _automaticReconnection(true)
         , _maxWaitBetweenReconnectionRetries(kDefaultMaxWaitBetweenReconnectionRetries)
         , _minWaitBetweenReconnectionRetries(kDefaultMinWaitBetweenReconnectionRetries)
         , _handshakeTimeoutSecs(kDefaultHandShakeTimeoutSecs)
         , _enablePong(kDefaultEnablePong)
+        , _maxMessageSize(0)
+        , _enableMessageStreaming(false)
+        , _enableOwnedMessages(false)
+        , _compressionThreshold(0)
+        , _enableCompressionProbe(true)
+        , _blockingSend(true)
         , _pingIntervalSecs(kDefaultPingIntervalSecs)
         , _pingType(SendMessageKind::Ping)
         , _autoThreadName(true)
@@ -139,6 +146,72 @@ namespace ix
         _enablePong = false;
     }
 
+    void WebSocket::setMaxMessageSize(size_t maxMessageSize)
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _maxMessageSize = maxMessageSize;
+    }
+
+    void WebSocket::enableMessageStreaming()
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _enableMessageStreaming = true;
+    }
+
+    void WebSocket::disableMessageStreaming()
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _enableMessageStreaming = false;
+    }
+
+    void WebSocket::setCompressionThreshold(size_t threshold)
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _compressionThreshold = threshold;
+    }
+
+    void WebSocket::enableCompressionProbe()
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _enableCompressionProbe = true;
+    }
+
+    void WebSocket::disableCompressionProbe()
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _enableCompressionProbe = false;
+    }
+
+    void WebSocket::enableOwnedMessages()
+    {
+        _enableOwnedMessages = true;
+    }
+
+    void WebSocket::disableOwnedMessages()
+    {
+        _enableOwnedMessages = false;
+    }
+
+    void WebSocket::setBufferPoolMaxSize(size_t maxSize)
+    {
+        _ws.getBufferPool()->setMaxSize(maxSize);
+    }
+
+    void WebSocket::setBufferAllocator(const std::shared_ptr<BufferAllocator>& allocator)
+    {
+        _ws.getBufferPool()->setAllocator(allocator);
+    }
+
+    BufferPoolStats WebSocket::getBufferPoolStats() const
+    {
+        return _ws.getBufferPool()->getStats();
+    }
+
+    WebSocketPerMessageDeflateStats WebSocket::getPerMessageDeflateStats() const
+    {
+        return _ws.getPerMessageDeflateStats();
+    }
+
     void WebSocket::enablePerMessageDeflate()
     {
         std::lock_guard<std::mutex> lock(_configMutex);
@@ -186,6 +259,9 @@ namespace ix
 
     void WebSocket::stop(uint16_t code, const std::string& reason)
     {
+        // Otherwise the working thread can reconnect as soon as the connection is closed,
+        // before _stop is set, and never exit
+        _stopRequested = true;
         close(code, reason);
 
         if (_thread.joinable())
@@ -197,14 +273,21 @@ namespace ix
             _thread.join();
             _stop = false;
         }
+        _stopRequested = false;
     }
 
     WebSocketInitResult WebSocket::connect(int timeoutSecs)
     {
         {
             std::lock_guard<std::mutex> lock(_configMutex);
-            _ws.configure(
-                _perMessageDeflateOptions, _socketTLSOptions, _enablePong, _pingIntervalSecs);
+            _ws.configure(_perMessageDeflateOptions,
+                          _socketTLSOptions,
+                          _enablePong,
+                          _pingIntervalSecs,
+                          _maxMessageSize,
+                          _enableMessageStreaming,
+                          _compressionThreshold,
+                          _enableCompressionProbe);
         }
 
         WebSocketHttpHeaders headers(_extraHeaders);
@@ -260,8 +343,14 @@ namespace ix
     {
         {
             std::lock_guard<std::mutex> lock(_configMutex);
-            _ws.configure(
-                _perMessageDeflateOptions, _socketTLSOptions, _enablePong, _pingIntervalSecs);
+            _ws.configure(_perMessageDeflateOptions,
+                          _socketTLSOptions,
+                          _enablePong,
+                          _pingIntervalSecs,
+                          _maxMessageSize,
+                          _enableMessageStreaming,
+                          _compressionThreshold,
+                          _enableCompressionProbe);
         }
 
         WebSocketInitResult status =
@@ -271,6 +360,14 @@ namespace ix
             return status;
         }
 
+        {
+            std::lock_guard<std::mutex> lock(_configMutex);
+            if (!_blockingSend)
+            {
+                _ws.disableBlockingSend();
+            }
+        }
+
         _onMessageCallback(
             ix::make_unique<WebSocketMessage>(WebSocketMessageType::Open,
                                               emptyMsg,
@@ -313,7 +410,7 @@ namespace ix
         // Try to connect perpertually
         while (true)
         {
-            if (isConnected() || isClosing() || _stop)
+            if (isConnected() || isClosing() || _stop || _stopRequested)
             {
                 break;
             }
@@ -398,58 +495,150 @@ namespace ix
             WebSocketTransport::PollResult pollResult = _ws.poll();
 
             // 3. Dispatch the incoming messages
-            _ws.dispatch(
-                pollResult,
-                [this](const std::string& msg,
-                       size_t wireSize,
-                       bool decompressionError,
-                       WebSocketTransport::MessageKind messageKind)
-                {
-                    WebSocketMessageType webSocketMessageType {WebSocketMessageType::Error};
-                    switch (messageKind)
-                    {
-                        case WebSocketTransport::MessageKind::MSG_TEXT:
-                        case WebSocketTransport::MessageKind::MSG_BINARY:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Message;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::PING:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Ping;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::PONG:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Pong;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::FRAGMENT:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Fragment;
-                        }
-                        break;
-                    }
-
-                    WebSocketErrorInfo webSocketErrorInfo;
-                    webSocketErrorInfo.decompressionError = decompressionError;
-
-                    bool binary = messageKind == WebSocketTransport::MessageKind::MSG_BINARY;
-
-                    _onMessageCallback(ix::make_unique<WebSocketMessage>(webSocketMessageType,
-                                                                         msg,
-                                                                         wireSize,
-                                                                         webSocketErrorInfo,
-                                                                         WebSocketOpenInfo(),
-                                                                         WebSocketCloseInfo(),
-                                                                         binary));
-
-                    WebSocket::invokeTrafficTrackerCallback(wireSize, true);
-                });
+            _ws.dispatch(pollResult,
+                         [this](std::string& msg,
+                                size_t wireSize,
+                                bool decompressionError,
+                                WebSocketTransport::MessageKind messageKind)
+                         { handleTransportMessage(msg, wireSize, decompressionError, messageKind); },
+                         [this](const std::string& part,
+                                size_t wireSize,
+                                bool decompressionError,
+                                bool binary,
+                                uint64_t offset,
+                                bool last) {
+                             handleTransportMessagePart(
+                                 part, wireSize, decompressionError, binary, offset, last);
+                         });
+        }
+    }
+
+    bool WebSocket::runOnce(bool timerOnly)
+    {
+        if (getReadyState() != ReadyState::Closed && (!timerOnly || _ws.hasPendingTimeout()))
+        {
+            WebSocketTransport::PollResult pollResult = _ws.poll(false);
+
+            _ws.dispatch(pollResult,
+                         [this](std::string& msg,
+                                size_t wireSize,
+                                bool decompressionError,
+                                WebSocketTransport::MessageKind messageKind)
+                         { handleTransportMessage(msg, wireSize, decompressionError, messageKind); },
+                         [this](const std::string& part,
+                                size_t wireSize,
+                                bool decompressionError,
+                                bool binary,
+                                uint64_t offset,
+                                bool last) {
+                             handleTransportMessagePart(
+                                 part, wireSize, decompressionError, binary, offset, last);
+                         });
+        }
+
+        if (getReadyState() == ReadyState::Closed)
+        {
+            // Make sure the socket is closed, so that it leaves the event loop
+            _ws.closeSocket();
+            return false;
         }
+
+        return true;
+    }
+
+    void WebSocket::disableBlockingSend()
+    {
+        std::lock_guard<std::mutex> lock(_configMutex);
+        _blockingSend = false;
+    }
+
+    void WebSocket::handleTransportMessage(std::string& msg,
+                                           size_t wireSize,
+                                           bool decompressionError,
+                                           WebSocketTransport::MessageKind messageKind)
+    {
+        WebSocketMessageType webSocketMessageType {WebSocketMessageType::Error};
+        switch (messageKind)
+        {
+            case WebSocketTransport::MessageKind::MSG_TEXT:
+            case WebSocketTransport::MessageKind::MSG_BINARY:
+            {
+                webSocketMessageType = WebSocketMessageType::Message;
+            }
+            break;
+
+            case WebSocketTransport::MessageKind::PING:
+            {
+                webSocketMessageType = WebSocketMessageType::Ping;
+            }
+            break;
+
+            case WebSocketTransport::MessageKind::PONG:
+            {
+                webSocketMessageType = WebSocketMessageType::Pong;
+            }
+            break;
+
+            case WebSocketTransport::MessageKind::FRAGMENT:
+            {
+                webSocketMessageType = WebSocketMessageType::Fragment;
+            }
+            break;
+        }
+
+        WebSocketErrorInfo webSocketErrorInfo;
+        webSocketErrorInfo.decompressionError = decompressionError;
+
+        bool binary = messageKind == WebSocketTransport::MessageKind::MSG_BINARY;
+
+        // The payload is moved out of the transport, str refers to it. Its buffer goes
+        // back to the pool once released.
+        std::shared_ptr<std::string> payload;
+        if (_enableOwnedMessages)
+        {
+            payload = _ws.getBufferPool()->share(std::move(msg));
+        }
+
+        auto message = ix::make_unique<WebSocketMessage>(webSocketMessageType,
+                                                         payload ? *payload : msg,
+                                                         wireSize,
+                                                         webSocketErrorInfo,
+                                                         WebSocketOpenInfo(),
+                                                         WebSocketCloseInfo(),
+                                                         binary);
+        message->payload = std::move(payload);
+
+        // Without streaming, fragments only signal that more frames are coming
+        message->last = messageKind != WebSocketTransport::MessageKind::FRAGMENT;
+
+        _onMessageCallback(message);
+
+        WebSocket::invokeTrafficTrackerCallback(wireSize, true);
+    }
+
+    void WebSocket::handleTransportMessagePart(const std::string& part,
+                                               size_t wireSize,
+                                               bool decompressionError,
+                                               bool binary,
+                                               uint64_t offset,
+                                               bool last)
+    {
+        WebSocketErrorInfo webSocketErrorInfo;
+        webSocketErrorInfo.decompressionError = decompressionError;
+
+        auto message = ix::make_unique<WebSocketMessage>(WebSocketMessageType::Fragment,
+                                                         part,
+                                                         wireSize,
+                                                         webSocketErrorInfo,
+                                                         WebSocketOpenInfo(),
+                                                         WebSocketCloseInfo(),
+                                                         binary);
+        message->offset = offset;
+        message->last = last;
+
+        _onMessageCallback(message);
+
+        WebSocket::invokeTrafficTrackerCallback(wireSize, true);
     }
 
     void WebSocket::setOnMessageCallback(const OnMessageCallback& callback)
@@ -576,6 +765,22 @@ namespace ix
         return webSocketSendInfo;
     }
 
+    WebSocketSendInfo WebSocket::sendEncodedFrame(const std::shared_ptr<const std::string>& frame,
+                                                  size_t payloadSize)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        WebSocketSendInfo webSocketSendInfo;
+        {
+            std::lock_guard<std::mutex> lock(_writeMutex);
+            webSocketSendInfo = _ws.sendEncodedFrame(frame, payloadSize);
+        }
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
     ReadyState WebSocket::getReadyState() const
     {
         switch (_ws.getReadyState())
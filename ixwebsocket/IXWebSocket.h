@@ -59,8 +59,42 @@ namespace ix
         void setPingInterval(int pingIntervalSecs);
         void enablePong();
         void disablePong();
+
+        // Messages larger than maxMessageSize bytes, once decompressed, are rejected and
+        // the connection is closed with code 1009. 0 means no limit.
+        void setMaxMessageSize(size_t maxMessageSize);
+
+        // Deliver data messages as Fragment messages as their payload is received,
+        // instead of reassembling them in memory
+        void enableMessageStreaming();
+        void disableMessageStreaming();
+
+        // With per message deflate, messages smaller than threshold bytes are sent
+        // uncompressed. The probe also skips messages which look incompressible, such as
+        // images or encrypted data, based on the entropy of a sample. It is enabled by
+        // default.
+        void setCompressionThreshold(size_t threshold);
+        void enableCompressionProbe();
+        void disableCompressionProbe();
+
+        // Deliver messages owning their payload in WebSocketMessage::payload, so that
+        // callbacks can keep or forward it without copying it
+        void enableOwnedMessages();
+        void disableOwnedMessages();
+
+        // Buffers of the received and queued messages are recycled by a pool holding
+        // up to maxSize bytes, 0 disables it. Buffers are allocated with allocator
+        // when the pool has none, which must be thread safe if it is shared.
+        void setBufferPoolMaxSize(size_t maxSize);
+        void setBufferAllocator(const std::shared_ptr<BufferAllocator>& allocator);
+        BufferPoolStats getBufferPoolStats() const;
+
         void enablePerMessageDeflate();
         void disablePerMessageDeflate();
+
+        // Memory held by the zlib states of the connection
+        WebSocketPerMessageDeflateStats getPerMessageDeflateStats() const;
+
         void addSubProtocol(const std::string& subProtocol);
         void setHandshakeTimeout(int handshakeTimeoutSecs);
 
@@ -126,11 +160,36 @@ namespace ix
                                       SendMessageKind sendMessageKind,
                                       const OnProgressCallback& callback = nullptr);
 
+        // Server broadcast, queue a frame encoded by WebSocketTransport::encodeFrame
+        WebSocketSendInfo sendEncodedFrame(const std::shared_ptr<const std::string>& frame,
+                                           size_t payloadSize);
+
         bool isConnected() const;
         bool isClosing() const;
         void checkConnection(bool firstConnectionAttempt);
         static void invokeTrafficTrackerCallback(size_t size, bool incoming);
 
+        void handleTransportMessage(std::string& msg,
+                                    size_t wireSize,
+                                    bool decompressionError,
+                                    WebSocketTransport::MessageKind messageKind);
+        void handleTransportMessagePart(const std::string& part,
+                                        size_t wireSize,
+                                        bool decompressionError,
+                                        bool binary,
+                                        uint64_t offset,
+                                        bool last);
+
+        // Server event loop mode: poll the transport without blocking and dispatch the
+        // incoming messages. With timerOnly, the transport is only polled when a ping or
+        // a closing timeout is due. Returns false once the connection is closed.
+        bool runOnce(bool timerOnly);
+
+        // Server event loop mode, to be called before connectToSocket: sends only queue
+        // the data, which is sent by the I/O thread once the socket is writable. Waiting
+        // for a slow peer would stall the other connections of the thread.
+        void disableBlockingSend();
+
         // Server
         WebSocketInitResult connectToSocket(std::unique_ptr<Socket>,
                                             int timeoutSecs,
@@ -152,6 +211,7 @@ namespace ix
         static OnTrafficTrackerCallback _onTrafficTrackerCallback;
 
         std::atomic<bool> _stop;
+        std::atomic<bool> _stopRequested; // no reconnection while stop closes the connection
         std::thread _thread;
         std::mutex _writeMutex;
 
@@ -173,6 +233,16 @@ namespace ix
         bool _enablePong;
         static const bool kDefaultEnablePong;
 
+        // Incoming messages
+        size_t _maxMessageSize;
+        bool _enableMessageStreaming;
+        std::atomic<bool> _enableOwnedMessages;
+
+        // Outgoing messages
+        size_t _compressionThreshold;
+        bool _enableCompressionProbe;
+        bool _blockingSend;
+
         // Optional ping and pong timeout
         int _pingIntervalSecs;
         int _pingTimeoutSecs;
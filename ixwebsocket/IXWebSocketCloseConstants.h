@@ -19,6 +19,7 @@ namespace ix
         static const uint16_t kProtocolErrorCode;
         static const uint16_t kNoStatusCodeErrorCode;
         static const uint16_t kInvalidFramePayloadData;
+        static const uint16_t kMessageTooBigCode;
 
         static const std::string kNormalClosureMessage;
         static const std::string kInternalErrorMessage;
@@ -33,5 +34,6 @@ namespace ix
         static const std::string kProtocolErrorCodeContinuationOpCodeOutOfSequence;
         static const std::string kInvalidFramePayloadDataMessage;
         static const std::string kInvalidCloseCodeMessage;
+        static const std::string kMessageTooBigMessage;
     };
 } // namespace ix
@@ -0,0 +1,78 @@
+/*
+ *  IXWebSocketCompressionCodec.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Interfaces of the codecs compressing the payload of WebSocket messages, so that
+ *  another implementation than zlib can be used by WebSocketPerMessageDeflate.
+ */
+
+#pragma once
+
+#include "IXWebSocketSendData.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace ix
+{
+    class WebSocketCompressor
+    {
+    public:
+        virtual ~WebSocketCompressor() = default;
+
+        // With lazy, the state is allocated when the first message is compressed
+        virtual bool init(uint8_t windowBits,
+                          bool noContextTakeOver,
+                          uint8_t memLevel,
+                          bool lazy) = 0;
+        virtual bool compress(const IXWebSocketSendData& in, std::string& out) = 0;
+
+        // Free the state, which is allocated again by the next message
+        virtual void release() = 0;
+        virtual bool isAllocated() const = 0;
+        virtual size_t getMemoryUsage() const = 0;
+    };
+
+    class WebSocketDecompressor
+    {
+    public:
+        // The output is passed to onOutput in pieces, and returning false from onOutput
+        // stops the decompression
+        using OnOutputCallback = std::function<bool(const char* data, size_t size)>;
+
+        virtual ~WebSocketDecompressor() = default;
+
+        // noContextTakeOver is set when the peer does not use context takeover
+        virtual bool init(uint8_t windowBits, bool noContextTakeOver, bool lazy) = 0;
+
+        // Decompress a message received in parts, fin being set for its last part
+        virtual bool decompress(const char* in,
+                                size_t size,
+                                bool fin,
+                                const OnOutputCallback& onOutput) = 0;
+
+        // Free the state between messages. Returns false when it cannot be freed.
+        virtual bool release() = 0;
+        virtual bool isAllocated() const = 0;
+        virtual size_t getMemoryUsage() const = 0;
+    };
+
+    // Creates the compressor and decompressor of each connection. A permessage-deflate
+    // codec must produce raw DEFLATE data as described in RFC 7692 section 7.2.1, which
+    // any peer can inflate. The messages of a compressor which does not keep a stream
+    // between messages may end with a final block instead of an empty one (section
+    // 7.2.3.4). Its decompressor must accept both.
+    class WebSocketCompressionCodec
+    {
+    public:
+        virtual ~WebSocketCompressionCodec() = default;
+
+        virtual std::unique_ptr<WebSocketCompressor> createCompressor() const = 0;
+        virtual std::unique_ptr<WebSocketDecompressor> createDecompressor() const = 0;
+    };
+
+    using WebSocketCompressionCodecPtr = std::shared_ptr<const WebSocketCompressionCodec>;
+} // namespace ix
@@ -230,6 +230,9 @@ namespace ix
             std::string header = headers["sec-websocket-extensions"];
             WebSocketPerMessageDeflateOptions webSocketPerMessageDeflateOptions(header);
 
+            // Local settings are not part of the response
+            webSocketPerMessageDeflateOptions.copyLocalSettings(_perMessageDeflateOptions);
+
             // If the server does not support that extension, disable it.
             if (!webSocketPerMessageDeflateOptions.enabled())
             {
@@ -367,11 +370,26 @@ namespace ix
         WebSocketPerMessageDeflateOptions webSocketPerMessageDeflateOptions(header);
 
         // If the client has requested that extension,
+        _enablePerMessageDeflate = false;
+        if (webSocketPerMessageDeflateOptions.enabled() && enablePerMessageDeflate)
+        {
+            // The configured options are the server policy, otherwise the permessage-deflate
+            // offer is accepted as is
+            WebSocketPerMessageDeflateOptions policy(true);
+            if (_perMessageDeflateOptions.enabled()) policy = _perMessageDeflateOptions;
+
+            webSocketPerMessageDeflateOptions = policy.negotiate(webSocketPerMessageDeflateOptions);
+        }
+
         if (webSocketPerMessageDeflateOptions.enabled() && enablePerMessageDeflate)
         {
             _enablePerMessageDeflate = true;
 
-            if (!_perMessageDeflate->init(webSocketPerMessageDeflateOptions))
+            // Remember the negotiated parameters, broadcast needs them
+            _perMessageDeflateOptions = webSocketPerMessageDeflateOptions;
+
+            bool server = true;
+            if (!_perMessageDeflate->init(webSocketPerMessageDeflateOptions, server))
             {
                 return WebSocketInitResult(
                     false, 0, "Failed to initialize per message deflate engine");
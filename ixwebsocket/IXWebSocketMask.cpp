@@ -0,0 +1,197 @@
+/*
+ *  IXWebSocketMask.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXWebSocketMask.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define IXWEBSOCKET_MASK_USE_AVX2
+#endif
+
+#if defined(IXWEBSOCKET_MASK_USE_AVX2) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IXWEBSOCKET_MASK_USE_SSE2
+#endif
+
+#ifdef IXWEBSOCKET_MASK_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef IXWEBSOCKET_MASK_USE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define IXWEBSOCKET_TARGET_AVX2
+#else
+#define IXWEBSOCKET_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace ix
+{
+    namespace
+    {
+        // The key repeated to fill 4 bytes, in memory order
+        uint32_t loadMaskingKey(const uint8_t* maskingKey)
+        {
+            uint32_t key;
+            memcpy(&key, maskingKey, sizeof(key));
+            return key;
+        }
+
+        // Finish with the bytes left after the wide loops. offset is a multiple of 4.
+        void maskTail(
+            const uint8_t* src, uint8_t* dst, size_t offset, size_t size, const uint8_t* maskingKey)
+        {
+            for (size_t i = offset; i < size; ++i)
+            {
+                dst[i] = src[i] ^ maskingKey[i & 0x3];
+            }
+        }
+
+        // Portable version, working on 64 bits words
+        void maskScalar(const uint8_t* src, uint8_t* dst, size_t size, const uint8_t* maskingKey)
+        {
+            uint32_t key32 = loadMaskingKey(maskingKey);
+            uint64_t key = ((uint64_t) key32 << 32) | key32;
+
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t word;
+                memcpy(&word, src + i, sizeof(word));
+                word ^= key;
+                memcpy(dst + i, &word, sizeof(word));
+            }
+
+            maskTail(src, dst, i, size, maskingKey);
+        }
+
+#ifdef IXWEBSOCKET_MASK_USE_SSE2
+        void maskSSE2(const uint8_t* src, uint8_t* dst, size_t size, const uint8_t* maskingKey)
+        {
+            __m128i key = _mm_set1_epi32((int) loadMaskingKey(maskingKey));
+
+            size_t i = 0;
+            for (; i + 64 <= size; i += 64)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+                __m128i b = _mm_loadu_si128((const __m128i*) (src + i + 16));
+                __m128i c = _mm_loadu_si128((const __m128i*) (src + i + 32));
+                __m128i d = _mm_loadu_si128((const __m128i*) (src + i + 48));
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(a, key));
+                _mm_storeu_si128((__m128i*) (dst + i + 16), _mm_xor_si128(b, key));
+                _mm_storeu_si128((__m128i*) (dst + i + 32), _mm_xor_si128(c, key));
+                _mm_storeu_si128((__m128i*) (dst + i + 48), _mm_xor_si128(d, key));
+            }
+
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(a, key));
+            }
+
+            maskTail(src, dst, i, size, maskingKey);
+        }
+#endif
+
+#ifdef IXWEBSOCKET_MASK_USE_AVX2
+        IXWEBSOCKET_TARGET_AVX2
+        void maskAVX2(const uint8_t* src, uint8_t* dst, size_t size, const uint8_t* maskingKey)
+        {
+            __m256i key = _mm256_set1_epi32((int) loadMaskingKey(maskingKey));
+
+            size_t i = 0;
+            for (; i + 128 <= size; i += 128)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+                __m256i b = _mm256_loadu_si256((const __m256i*) (src + i + 32));
+                __m256i c = _mm256_loadu_si256((const __m256i*) (src + i + 64));
+                __m256i d = _mm256_loadu_si256((const __m256i*) (src + i + 96));
+                _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(a, key));
+                _mm256_storeu_si256((__m256i*) (dst + i + 32), _mm256_xor_si256(b, key));
+                _mm256_storeu_si256((__m256i*) (dst + i + 64), _mm256_xor_si256(c, key));
+                _mm256_storeu_si256((__m256i*) (dst + i + 96), _mm256_xor_si256(d, key));
+            }
+
+            for (; i + 32 <= size; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+                _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(a, key));
+            }
+
+            maskTail(src, dst, i, size, maskingKey);
+        }
+
+        bool isAVX2Supported()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) return false;
+
+            // The OS must save the AVX registers (OSXSAVE and XCR0 bits 1 and 2)
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        std::vector<std::pair<std::string, WebSocketMaskFunction>> detectImplementations()
+        {
+            std::vector<std::pair<std::string, WebSocketMaskFunction>> implementations;
+            implementations.push_back(std::make_pair("scalar", &maskScalar));
+#ifdef IXWEBSOCKET_MASK_USE_SSE2
+            implementations.push_back(std::make_pair("sse2", &maskSSE2));
+#endif
+#ifdef IXWEBSOCKET_MASK_USE_AVX2
+            if (isAVX2Supported())
+            {
+                implementations.push_back(std::make_pair("avx2", &maskAVX2));
+            }
+#endif
+            return implementations;
+        }
+
+        const std::pair<std::string, WebSocketMaskFunction>& getBestImplementation()
+        {
+            static const std::pair<std::string, WebSocketMaskFunction> best =
+                detectImplementations().back();
+            return best;
+        }
+    } // namespace
+
+    void webSocketMask(const uint8_t* src, uint8_t* dst, size_t size, const uint8_t* maskingKey)
+    {
+        // The wide loops do not pay off for small payloads, such as control frames
+        if (size < 16)
+        {
+            maskTail(src, dst, 0, size, maskingKey);
+            return;
+        }
+
+        getBestImplementation().second(src, dst, size, maskingKey);
+    }
+
+    std::string getWebSocketMaskImplementation()
+    {
+        return getBestImplementation().first;
+    }
+
+    std::vector<std::pair<std::string, WebSocketMaskFunction>> getWebSocketMaskImplementations()
+    {
+        return detectImplementations();
+    }
+} // namespace ix
@@ -0,0 +1,35 @@
+/*
+ *  IXWebSocketMask.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Masking of client frames payload (https://tools.ietf.org/html/rfc6455#section-5.3)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ix
+{
+    using WebSocketMaskFunction = void (*)(const uint8_t* src,
+                                           uint8_t* dst,
+                                           size_t size,
+                                           const uint8_t* maskingKey);
+
+    // XOR size bytes of src with the 4 bytes masking key repeated, and write the result
+    // to dst. src and dst can be the same buffer, to mask or unmask in place.
+    // The fastest implementation supported by the CPU is picked on first use.
+    void webSocketMask(const uint8_t* src, uint8_t* dst, size_t size, const uint8_t* maskingKey);
+
+    // Name of the implementation used by webSocketMask: avx2, sse2 or scalar
+    std::string getWebSocketMaskImplementation();
+
+    // All the implementations supported by the CPU, the fastest one last.
+    // Used by unittests and benchmarks.
+    std::vector<std::pair<std::string, WebSocketMaskFunction>> getWebSocketMaskImplementations();
+} // namespace ix
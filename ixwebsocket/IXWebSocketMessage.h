@@ -25,6 +25,16 @@ namespace ix
         WebSocketCloseInfo closeInfo;
         bool binary;
 
+        // With message streaming, large messages are delivered as Fragment messages,
+        // each holding the part of the payload starting at offset. The last part of a
+        // message can be empty.
+        uint64_t offset = 0;
+        bool last = true;
+
+        // With owned messages, the buffer str refers to. Callbacks can keep it, or
+        // forward it with IXWebSocketSendData, without copying the payload.
+        std::shared_ptr<std::string> payload;
+
         WebSocketMessage(WebSocketMessageType t,
                          const std::string& s,
                          size_t w,
@@ -46,6 +46,7 @@
  *
  */
 
+#include <algorithm>
 #include <cstdint>
 
 #include "IXWebSocketPerMessageDeflate.h"
@@ -56,9 +57,18 @@
 
 namespace ix
 {
+    size_t WebSocketPerMessageDeflateStats::getMemoryPerConnection() const
+    {
+        return (connections == 0) ? 0 : memory / connections;
+    }
+
     WebSocketPerMessageDeflate::WebSocketPerMessageDeflate()
         : _compressor(ix::make_unique<WebSocketPerMessageDeflateCompressor>())
         , _decompressor(ix::make_unique<WebSocketPerMessageDeflateDecompressor>())
+        , _idleTimeout(0)
+        , _releaseDecompressor(false)
+        , _decompressing(false)
+        , _releases(0)
     {
         ;
     }
@@ -69,30 +79,152 @@ namespace ix
     }
 
     bool WebSocketPerMessageDeflate::init(
-        const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions)
+        const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions, bool server)
     {
         bool clientNoContextTakeover = perMessageDeflateOptions.getClientNoContextTakeover();
+        bool serverNoContextTakeover = perMessageDeflateOptions.getServerNoContextTakeover();
+        uint8_t clientBits = perMessageDeflateOptions.getClientMaxWindowBits();
+        uint8_t serverBits = perMessageDeflateOptions.getServerMaxWindowBits();
+
+        uint8_t deflateBits = server ? serverBits : clientBits;
+        uint8_t inflateBits = server ? clientBits : serverBits;
+        bool deflateNoContextTakeover = server ? serverNoContextTakeover : clientNoContextTakeover;
+        bool inflateNoContextTakeover = server ? clientNoContextTakeover : serverNoContextTakeover;
+
+        WebSocketCompressionCodecPtr codec = perMessageDeflateOptions.getCodec();
+        if (perMessageDeflateOptions.isZstdEnabled())
+        {
+            // Both ends must have the dictionary of the response
+            auto zstdCodec = perMessageDeflateOptions.getZstdCodec();
+            if (!zstdCodec ||
+                zstdCodec->getDictionaryId() != perMessageDeflateOptions.getZstdDictionaryId())
+            {
+                return false;
+            }
+            codec = zstdCodec;
 
-        uint8_t deflateBits = perMessageDeflateOptions.getClientMaxWindowBits();
-        uint8_t inflateBits = perMessageDeflateOptions.getServerMaxWindowBits();
+            // zstd messages never refer to the previous ones
+            inflateNoContextTakeover = true;
+        }
 
-        return _compressor->init(deflateBits, clientNoContextTakeover) &&
-               _decompressor->init(inflateBits, clientNoContextTakeover);
+        bool lazy = perMessageDeflateOptions.isLazyAllocationEnabled();
+        _idleTimeout = std::chrono::seconds(perMessageDeflateOptions.getIdleTimeoutSecs());
+        _releaseDecompressor = inflateNoContextTakeover;
+        _decompressing = false;
+
+        std::lock_guard<std::mutex> lock(_compressorMutex);
+        _compressor = codec->createCompressor();
+        _decompressor = codec->createDecompressor();
+        return _compressor->init(deflateBits,
+                                 deflateNoContextTakeover,
+                                 perMessageDeflateOptions.getMemLevel(),
+                                 lazy) &&
+               _decompressor->init(inflateBits, inflateNoContextTakeover, lazy);
     }
 
     bool WebSocketPerMessageDeflate::compress(const IXWebSocketSendData& in, std::string& out)
     {
+        std::lock_guard<std::mutex> lock(_compressorMutex);
+        if (_idleTimeout.count() > 0) _lastCompressionTime = std::chrono::steady_clock::now();
+
         return _compressor->compress(in, out);
     }
 
     bool WebSocketPerMessageDeflate::compress(const std::string& in, std::string& out)
     {
-        return _compressor->compress(in, out);
+        std::lock_guard<std::mutex> lock(_compressorMutex);
+        if (_idleTimeout.count() > 0) _lastCompressionTime = std::chrono::steady_clock::now();
+
+        return _compressor->compress(IXWebSocketSendData(in), out);
     }
 
     bool WebSocketPerMessageDeflate::decompress(const std::string& in, std::string& out)
     {
-        return _decompressor->decompress(in, out);
+        out.clear();
+
+        return decompress(in.data(), in.size(), true, [&out](const char* data, size_t size) {
+            out.append(data, size);
+            return true;
+        });
+    }
+
+    bool WebSocketPerMessageDeflate::decompress(
+        const char* in,
+        size_t size,
+        bool fin,
+        const std::function<bool(const char* data, size_t size)>& onOutput)
+    {
+        if (_idleTimeout.count() > 0) _lastDecompressionTime = std::chrono::steady_clock::now();
+        _decompressing = !fin;
+
+        return _decompressor->decompress(in, size, fin, onOutput);
+    }
+
+    int WebSocketPerMessageDeflate::releaseIdleStates()
+    {
+        return checkIdleStates(true);
+    }
+
+    int WebSocketPerMessageDeflate::getIdleStatesDelayMs()
+    {
+        return checkIdleStates(false);
+    }
+
+    int WebSocketPerMessageDeflate::checkIdleStates(bool release)
+    {
+        if (_idleTimeout.count() <= 0) return -1;
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::milliseconds delay(-1);
+
+        // Returns true if the state can be released now
+        auto releaseIfIdle = [&](std::chrono::steady_clock::time_point lastUseTime) -> bool {
+            auto idleTime =
+                std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUseTime);
+            auto remaining = std::max(_idleTimeout - idleTime, std::chrono::milliseconds(0));
+            if (remaining.count() == 0 && release) return true;
+
+            if (delay.count() < 0 || remaining < delay)
+            {
+                delay = remaining;
+            }
+            return false;
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(_compressorMutex);
+            if (_compressor->isAllocated() && releaseIfIdle(_lastCompressionTime))
+            {
+                _compressor->release();
+                _releases++;
+            }
+        }
+
+        // The rest of a message being received is decompressed with the same state
+        if (_releaseDecompressor && !_decompressing && _decompressor->isAllocated() &&
+            releaseIfIdle(_lastDecompressionTime) && _decompressor->release())
+        {
+            _releases++;
+        }
+
+        return (int) delay.count();
+    }
+
+    WebSocketPerMessageDeflateStats WebSocketPerMessageDeflate::getStats() const
+    {
+        WebSocketPerMessageDeflateStats stats;
+        stats.connections = 1;
+
+        // The codecs are replaced by init
+        std::lock_guard<std::mutex> lock(_compressorMutex);
+        size_t compressorMemory = _compressor->getMemoryUsage();
+        size_t decompressorMemory = _decompressor->getMemoryUsage();
+        stats.compressors = (compressorMemory > 0) ? 1 : 0;
+        stats.decompressors = (decompressorMemory > 0) ? 1 : 0;
+        stats.memory = compressorMemory + decompressorMemory;
+        stats.releases = _releases;
+
+        return stats;
     }
 
 } // namespace ix
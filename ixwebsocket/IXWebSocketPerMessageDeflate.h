@@ -34,15 +34,31 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include "IXWebSocketSendData.h"
 
 namespace ix
 {
     class WebSocketPerMessageDeflateOptions;
-    class WebSocketPerMessageDeflateCompressor;
-    class WebSocketPerMessageDeflateDecompressor;
+    class WebSocketCompressor;
+    class WebSocketDecompressor;
+
+    struct WebSocketPerMessageDeflateStats
+    {
+        size_t connections = 0;   // connections which negotiated per message deflate
+        size_t compressors = 0;   // allocated deflate (or zstd) states
+        size_t decompressors = 0; // allocated inflate (or zstd) states
+        size_t memory = 0;        // bytes held by the codecs and their buffers
+        uint64_t releases = 0;    // states freed after being idle
+
+        size_t getMemoryPerConnection() const;
+    };
 
     class WebSocketPerMessageDeflate
     {
@@ -50,14 +66,39 @@ namespace ix
         WebSocketPerMessageDeflate();
         ~WebSocketPerMessageDeflate();
 
-        bool init(const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions);
+        // The negotiated options apply to each direction depending on the role. The
+        // codecs are the ones of the negotiated extension.
+        bool init(const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions,
+                  bool server = false);
         bool compress(const IXWebSocketSendData& in, std::string& out);
         bool compress(const std::string& in, std::string& out);
         bool decompress(const std::string& in, std::string& out);
+        bool decompress(const char* in,
+                        size_t size,
+                        bool fin,
+                        const std::function<bool(const char* data, size_t size)>& onOutput);
+
+        // Free the codec states unused for the idle timeout of the options. Returns the
+        // delay in milliseconds until the next state can be freed, -1 if none.
+        int releaseIdleStates();
+        int getIdleStatesDelayMs();
+
+        WebSocketPerMessageDeflateStats getStats() const;
 
     private:
-        std::unique_ptr<WebSocketPerMessageDeflateCompressor> _compressor;
-        std::unique_ptr<WebSocketPerMessageDeflateDecompressor> _decompressor;
+        std::unique_ptr<WebSocketCompressor> _compressor;
+        std::unique_ptr<WebSocketDecompressor> _decompressor;
+
+        // Messages are compressed by the sending threads, and decompressed and idle
+        // states released by the receiving one
+        mutable std::mutex _compressorMutex;
+        std::chrono::steady_clock::time_point _lastCompressionTime;
+        std::chrono::steady_clock::time_point _lastDecompressionTime;
+        std::chrono::milliseconds _idleTimeout;
+        int checkIdleStates(bool release);
+        bool _releaseDecompressor;
+        bool _decompressing;
+        std::atomic<uint64_t> _releases;
     };
 
     using WebSocketPerMessageDeflatePtr = std::unique_ptr<WebSocketPerMessageDeflate>;
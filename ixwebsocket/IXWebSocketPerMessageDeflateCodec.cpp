@@ -6,8 +6,12 @@
 
 #include "IXWebSocketPerMessageDeflateCodec.h"
 
+#include "IXUniquePtr.h"
 #include "IXWebSocketPerMessageDeflateOptions.h"
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
 #include <string.h>
 
 namespace
@@ -16,52 +20,120 @@ namespace
     // is treated as a char* and the null termination (\x00) makes it
     // look like an empty string.
     const std::string kEmptyUncompressedBlock = std::string("\x00\x00\xff\xff", 4);
+
+    const size_t kInflateBufferSize = 1 << 14;
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+    // zlib allocations are counted in the memory usage of their codec, passed as opaque.
+    // The size of each block is stored in front of it.
+    voidpf allocateBlock(voidpf opaque, uInt items, uInt size)
+    {
+        size_t bytes = (size_t) items * size;
+        auto block = static_cast<max_align_t*>(malloc(sizeof(max_align_t) + bytes));
+        if (block == nullptr) return Z_NULL;
+
+        *reinterpret_cast<size_t*>(block) = bytes;
+        *static_cast<std::atomic<size_t>*>(opaque) += bytes;
+        return block + 1;
+    }
+
+    void freeBlock(voidpf opaque, voidpf address)
+    {
+        auto block = static_cast<max_align_t*>(address) - 1;
+        *static_cast<std::atomic<size_t>*>(opaque) -= *reinterpret_cast<size_t*>(block);
+        free(block);
+    }
+#endif
 } // namespace
 
 namespace ix
 {
+    const size_t WebSocketPerMessageDeflateCompressor::kMinProbeSize(512);
+
     //
     // Compressor
     //
     WebSocketPerMessageDeflateCompressor::WebSocketPerMessageDeflateCompressor()
+        : _flush(0)
+        , _deflateBits(0)
+        , _memLevel(0)
+        , _allocated(false)
+        , _memory(0)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
         memset(&_deflateState, 0, sizeof(_deflateState));
-
-        _deflateState.zalloc = Z_NULL;
-        _deflateState.zfree = Z_NULL;
-        _deflateState.opaque = Z_NULL;
 #endif
     }
 
     WebSocketPerMessageDeflateCompressor::~WebSocketPerMessageDeflateCompressor()
     {
+        release();
+    }
+
+    bool WebSocketPerMessageDeflateCompressor::init(uint8_t deflateBits,
+                                                    bool noContextTakeOver,
+                                                    uint8_t memLevel,
+                                                    bool lazy)
+    {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        deflateEnd(&_deflateState);
+        release();
+
+        _deflateBits = deflateBits;
+        _memLevel = memLevel;
+        _flush = (noContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+
+        return lazy || allocate();
+#else
+        (void) deflateBits;
+        (void) noContextTakeOver;
+        (void) memLevel;
+        (void) lazy;
+        return false;
 #endif
     }
 
-    bool WebSocketPerMessageDeflateCompressor::init(uint8_t deflateBits,
-                                                    bool clientNoContextTakeOver)
+    bool WebSocketPerMessageDeflateCompressor::allocate()
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
+        memset(&_deflateState, 0, sizeof(_deflateState));
+        _deflateState.zalloc = allocateBlock;
+        _deflateState.zfree = freeBlock;
+        _deflateState.opaque = &_memory;
+
         int ret = deflateInit2(&_deflateState,
                                Z_DEFAULT_COMPRESSION,
                                Z_DEFLATED,
-                               -1 * deflateBits,
-                               4, // memory level 1-9
+                               -1 * _deflateBits,
+                               _memLevel,
                                Z_DEFAULT_STRATEGY);
 
-        if (ret != Z_OK) return false;
-
-        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
-
-        return true;
+        _allocated = (ret == Z_OK);
+        return _allocated;
 #else
         return false;
 #endif
     }
 
+    void WebSocketPerMessageDeflateCompressor::release()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_allocated) return;
+
+        deflateEnd(&_deflateState);
+        _allocated = false;
+#endif
+    }
+
+    bool WebSocketPerMessageDeflateCompressor::isAllocated() const
+    {
+        return _allocated;
+    }
+
+    size_t WebSocketPerMessageDeflateCompressor::getMemoryUsage() const
+    {
+        return _memory;
+    }
+
     template<typename T>
     bool WebSocketPerMessageDeflateCompressor::endsWithEmptyUnCompressedBlock(const T& value)
     {
@@ -102,6 +174,51 @@ namespace ix
         return compressData(in, out);
     }
 
+    bool WebSocketPerMessageDeflateCompressor::isIncompressible(const char* data, size_t size)
+    {
+        // Smaller samples underestimate the entropy
+        if (size < kMinProbeSize) return false;
+
+        // Up to 16 slices of 64 bytes, spread over the data
+        const size_t sliceSize = 64;
+        const size_t sliceCount = 16;
+        size_t step = (size >= sliceSize * sliceCount) ? size / sliceCount : sliceSize;
+
+        std::array<uint32_t, 256> counts = {};
+        size_t sampleSize = 0;
+        for (size_t offset = 0; offset + sliceSize <= size && sampleSize < sliceSize * sliceCount;
+             offset += step)
+        {
+            for (size_t i = 0; i < sliceSize; ++i)
+            {
+                counts[(uint8_t) data[offset + i]]++;
+            }
+            sampleSize += sliceSize;
+        }
+
+        // The entropy is at most log2 of the number of distinct bytes, so text never
+        // gets past this check
+        size_t distinctBytes = 0;
+        for (auto count : counts)
+        {
+            if (count != 0) distinctBytes++;
+        }
+        if (distinctBytes <= 128) return false;
+
+        double entropy = 0;
+        for (auto count : counts)
+        {
+            if (count == 0) continue;
+
+            double p = (double) count / sampleSize;
+            entropy -= p * std::log2(p);
+        }
+
+        // Bits per byte. Text, JSON or base64 are below 6, random bytes are above 7.5
+        // with a 1KB sample.
+        return entropy > 7.0;
+    }
+
     template<typename T, typename S>
     bool WebSocketPerMessageDeflateCompressor::compressData(const T& in, S& out)
     {
@@ -123,8 +240,6 @@ namespace ix
         //        (possibly part of) the DEFLATE header bits with the "BTYPE" bits
         //        set to 00.
         //
-        size_t output;
-
         // Clear output
         out.clear();
 
@@ -140,22 +255,30 @@ namespace ix
             return true;
         }
 
+        if (!_allocated && !allocate()) return false;
+
         _deflateState.avail_in = (uInt) in.size();
         _deflateState.next_in = (Bytef*) in.data();
 
+        // Deflate straight into the output, which is large enough in most cases. The
+        // bound does not include the flush marker.
+        size_t output = 0;
+        size_t outputSize = deflateBound(&_deflateState, (uLong) in.size()) + 16;
+
         do
         {
-            // Output to local buffer
-            _deflateState.avail_out = (uInt) _compressBuffer.size();
-            _deflateState.next_out = &_compressBuffer.front();
+            out.resize(outputSize);
+            _deflateState.avail_out = (uInt) (outputSize - output);
+            _deflateState.next_out = (Bytef*) &out[output];
 
             deflate(&_deflateState, _flush);
 
-            output = _compressBuffer.size() - _deflateState.avail_out;
-
-            out.insert(out.end(), _compressBuffer.begin(), _compressBuffer.begin() + output);
+            output = outputSize - _deflateState.avail_out;
+            outputSize *= 2;
         } while (_deflateState.avail_out == 0);
 
+        out.resize(output);
+
         if (endsWithEmptyUnCompressedBlock(out))
         {
             out.resize(out.size() - 4);
@@ -171,44 +294,151 @@ namespace ix
     // Decompressor
     //
     WebSocketPerMessageDeflateDecompressor::WebSocketPerMessageDeflateDecompressor()
+        : _inflateBits(0)
+        , _noContextTakeOver(false)
+        , _allocated(false)
+        , _streamEnded(false)
+        , _memory(0)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
         memset(&_inflateState, 0, sizeof(_inflateState));
-
-        _inflateState.zalloc = Z_NULL;
-        _inflateState.zfree = Z_NULL;
-        _inflateState.opaque = Z_NULL;
-        _inflateState.avail_in = 0;
-        _inflateState.next_in = Z_NULL;
 #endif
     }
 
     WebSocketPerMessageDeflateDecompressor::~WebSocketPerMessageDeflateDecompressor()
     {
+        freeState();
+    }
+
+    bool WebSocketPerMessageDeflateDecompressor::init(uint8_t inflateBits,
+                                                      bool noContextTakeOver,
+                                                      bool lazy)
+    {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        inflateEnd(&_inflateState);
+        freeState();
+
+        _inflateBits = inflateBits;
+        _noContextTakeOver = noContextTakeOver;
+
+        return lazy || allocate();
+#else
+        (void) inflateBits;
+        (void) noContextTakeOver;
+        (void) lazy;
+        return false;
 #endif
     }
 
-    bool WebSocketPerMessageDeflateDecompressor::init(uint8_t inflateBits,
-                                                      bool clientNoContextTakeOver)
+    bool WebSocketPerMessageDeflateDecompressor::allocate()
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        int ret = inflateInit2(&_inflateState, -1 * inflateBits);
+        memset(&_inflateState, 0, sizeof(_inflateState));
+        _inflateState.zalloc = allocateBlock;
+        _inflateState.zfree = freeBlock;
+        _inflateState.opaque = &_memory;
+        _inflateState.avail_in = 0;
+        _inflateState.next_in = Z_NULL;
 
+        int ret = inflateInit2(&_inflateState, -1 * _inflateBits);
         if (ret != Z_OK) return false;
 
-        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
-
+        _compressBuffer.resize(kInflateBufferSize);
+        _memory += _compressBuffer.capacity();
+        _allocated = true;
         return true;
 #else
         return false;
 #endif
     }
 
+    bool WebSocketPerMessageDeflateDecompressor::release()
+    {
+        if (!_allocated || !_noContextTakeOver) return false;
+
+        freeState();
+        return true;
+    }
+
+    void WebSocketPerMessageDeflateDecompressor::freeState()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_allocated) return;
+
+        inflateEnd(&_inflateState);
+        _streamEnded = false;
+        _memory -= _compressBuffer.capacity();
+        std::vector<unsigned char>().swap(_compressBuffer);
+        _allocated = false;
+#endif
+    }
+
+    bool WebSocketPerMessageDeflateDecompressor::isAllocated() const
+    {
+        return _allocated;
+    }
+
+    size_t WebSocketPerMessageDeflateDecompressor::getMemoryUsage() const
+    {
+        return _memory;
+    }
+
     bool WebSocketPerMessageDeflateDecompressor::decompress(const std::string& in, std::string& out)
     {
+        // Clear output
+        out.clear();
+
+        return decompress(in.data(), in.size(), true, [&out](const char* data, size_t size) {
+            out.append(data, size);
+            return true;
+        });
+    }
+
+    bool WebSocketPerMessageDeflateDecompressor::decompress(const char* in,
+                                                            size_t size,
+                                                            bool fin,
+                                                            const OnOutputCallback& onOutput)
+    {
 #ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_allocated && !allocate()) return false;
+
+        auto inflateInput = [this, &onOutput](const char* data, size_t dataSize) -> bool {
+            // A message may end with a final block (RFC 7692 section 7.2.3.4), the rest
+            // of the message is ignored
+            if (_streamEnded) return true;
+
+            _inflateState.avail_in = (uInt) dataSize;
+            _inflateState.next_in = (unsigned char*) (const_cast<char*>(data));
+
+            do
+            {
+                _inflateState.avail_out = (uInt) _compressBuffer.size();
+                _inflateState.next_out = &_compressBuffer.front();
+
+                int ret = inflate(&_inflateState, Z_SYNC_FLUSH);
+
+                if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
+                {
+                    return false; // zlib error
+                }
+
+                size_t outputSize = _compressBuffer.size() - _inflateState.avail_out;
+                if (outputSize > 0 &&
+                    !onOutput(reinterpret_cast<char*>(&_compressBuffer.front()), outputSize))
+                {
+                    return false;
+                }
+
+                // The next message starts a new stream
+                if (ret == Z_STREAM_END)
+                {
+                    _streamEnded = true;
+                    return inflateReset(&_inflateState) == Z_OK;
+                }
+            } while (_inflateState.avail_out == 0);
+
+            return true;
+        };
+
         //
         // 7.2.2.  Decompression
         //
@@ -219,34 +449,31 @@ namespace ix
         //
         //    2.  Decompress the resulting data using DEFLATE.
         //
-        std::string inFixed(in);
-        inFixed += kEmptyUncompressedBlock;
-
-        _inflateState.avail_in = (uInt) inFixed.size();
-        _inflateState.next_in = (unsigned char*) (const_cast<char*>(inFixed.data()));
-
-        // Clear output
-        out.clear();
-
-        do
-        {
-            _inflateState.avail_out = (uInt) _compressBuffer.size();
-            _inflateState.next_out = &_compressBuffer.front();
-
-            int ret = inflate(&_inflateState, Z_SYNC_FLUSH);
-
-            if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
-            {
-                return false; // zlib error
-            }
+        if (size > 0 && !inflateInput(in, size)) return false;
+        if (!fin) return true;
 
-            out.append(reinterpret_cast<char*>(&_compressBuffer.front()),
-                       _compressBuffer.size() - _inflateState.avail_out);
-        } while (_inflateState.avail_out == 0);
-
-        return true;
+        bool ok = inflateInput(kEmptyUncompressedBlock.data(), kEmptyUncompressedBlock.size());
+        _streamEnded = false;
+        return ok;
 #else
+        (void) in;
+        (void) size;
+        (void) fin;
+        (void) onOutput;
         return false;
 #endif
     }
+
+    //
+    // Codec
+    //
+    std::unique_ptr<WebSocketCompressor> WebSocketZlibCodec::createCompressor() const
+    {
+        return ix::make_unique<WebSocketPerMessageDeflateCompressor>();
+    }
+
+    std::unique_ptr<WebSocketDecompressor> WebSocketZlibCodec::createDecompressor() const
+    {
+        return ix::make_unique<WebSocketPerMessageDeflateDecompressor>();
+    }
 } // namespace ix
@@ -10,56 +10,113 @@
 #include "zlib.h"
 #endif
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
+#include "IXWebSocketCompressionCodec.h"
+#include "IXWebSocketPerMessageDeflateOptions.h"
 #include "IXWebSocketSendData.h"
 
 namespace ix
 {
-    class WebSocketPerMessageDeflateCompressor
+    class WebSocketPerMessageDeflateCompressor final : public WebSocketCompressor
     {
     public:
         WebSocketPerMessageDeflateCompressor();
         ~WebSocketPerMessageDeflateCompressor();
 
-        bool init(uint8_t deflateBits, bool clientNoContextTakeOver);
-        bool compress(const IXWebSocketSendData& in, std::string& out);
+        // With lazy, the zlib state is allocated when the first message is compressed
+        bool init(uint8_t deflateBits,
+                  bool noContextTakeOver,
+                  uint8_t memLevel = WebSocketPerMessageDeflateOptions::kDefaultMemLevel,
+                  bool lazy = false) final;
+        bool compress(const IXWebSocketSendData& in, std::string& out) final;
         bool compress(const std::string& in, std::string& out);
         bool compress(const std::string& in, std::vector<uint8_t>& out);
         bool compress(const std::vector<uint8_t>& in, std::string& out);
         bool compress(const std::vector<uint8_t>& in, std::vector<uint8_t>& out);
 
+        // Cheap estimate of the entropy of a sample of the data, for messages which
+        // are not worth compressing, such as already compressed or encrypted data
+        static bool isIncompressible(const char* data, size_t size);
+
+        const static size_t kMinProbeSize;
+
+        // Free the zlib state, which is allocated again by the next message. That
+        // message does not refer to the previous ones, which is always valid.
+        void release() final;
+        bool isAllocated() const final;
+
+        // Bytes allocated by zlib
+        size_t getMemoryUsage() const final;
+
     private:
         template<typename T, typename S>
         bool compressData(const T& in, S& out);
         template<typename T>
         bool endsWithEmptyUnCompressedBlock(const T& value);
+        bool allocate();
 
         int _flush;
-        std::array<unsigned char, 1 << 14> _compressBuffer;
+        uint8_t _deflateBits;
+        uint8_t _memLevel;
+        bool _allocated;
+        std::atomic<size_t> _memory;
 
 #ifdef IXWEBSOCKET_USE_ZLIB
         z_stream _deflateState;
 #endif
     };
 
-    class WebSocketPerMessageDeflateDecompressor
+    class WebSocketPerMessageDeflateDecompressor final : public WebSocketDecompressor
     {
     public:
         WebSocketPerMessageDeflateDecompressor();
         ~WebSocketPerMessageDeflateDecompressor();
 
-        bool init(uint8_t inflateBits, bool clientNoContextTakeOver);
+        // noContextTakeOver is set when the peer does not use context takeover
+        bool init(uint8_t inflateBits, bool noContextTakeOver, bool lazy = false) final;
         bool decompress(const std::string& in, std::string& out);
 
+        // Decompress a message received in parts, fin being set for its last part. The
+        // output is passed to onOutput in pieces of at most 16KB.
+        bool decompress(const char* in,
+                        size_t size,
+                        bool fin,
+                        const OnOutputCallback& onOutput) final;
+
+        // Free the zlib state between messages, which is only possible when the peer
+        // does not use context takeover. Returns false otherwise.
+        bool release() final;
+        bool isAllocated() const final;
+
+        // Bytes allocated by zlib and for the output buffer
+        size_t getMemoryUsage() const final;
+
     private:
-        int _flush;
-        std::array<unsigned char, 1 << 14> _compressBuffer;
+        bool allocate();
+        void freeState();
+
+        uint8_t _inflateBits;
+        bool _noContextTakeOver;
+        bool _allocated;
+        bool _streamEnded;
+        std::atomic<size_t> _memory;
+        std::vector<unsigned char> _compressBuffer;
 
 #ifdef IXWEBSOCKET_USE_ZLIB
         z_stream _inflateState;
 #endif
     };
 
+    // The default codec, with zlib
+    class WebSocketZlibCodec final : public WebSocketCompressionCodec
+    {
+    public:
+        std::unique_ptr<WebSocketCompressor> createCompressor() const final;
+        std::unique_ptr<WebSocketDecompressor> createDecompressor() const final;
+    };
+
 } // namespace ix
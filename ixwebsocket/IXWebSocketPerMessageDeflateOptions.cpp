@@ -6,6 +6,7 @@
 
 #include "IXWebSocketPerMessageDeflateOptions.h"
 
+#include "IXWebSocketPerMessageDeflateCodec.h"
 #include <algorithm>
 #include <cctype>
 #include <sstream>
@@ -21,6 +22,12 @@ namespace ix
     static const uint8_t minClientMaxWindowBits = 8;
     static const uint8_t maxClientMaxWindowBits = 15;
 
+    const uint8_t WebSocketPerMessageDeflateOptions::kDefaultMemLevel = 4;
+    static const uint8_t minMemLevel = 1;
+    static const uint8_t maxMemLevel = 9;
+
+    const std::string WebSocketPerMessageDeflateOptions::kZstdExtension("x-permessage-zstd");
+
     WebSocketPerMessageDeflateOptions::WebSocketPerMessageDeflateOptions(
         bool enabled,
         bool clientNoContextTakeover,
@@ -33,6 +40,12 @@ namespace ix
         _serverNoContextTakeover = serverNoContextTakeover;
         _clientMaxWindowBits = clientMaxWindowBits;
         _serverMaxWindowBits = serverMaxWindowBits;
+        _clientMaxWindowBitsOffered = true;
+        _memLevel = kDefaultMemLevel;
+        _lazyAllocation = false;
+        _idleTimeoutSecs = 0;
+        _zstd = false;
+        _zstdDictionaryId = 0;
 
         sanitizeClientMaxWindowBits();
     }
@@ -51,6 +64,11 @@ namespace ix
     // Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover;
     // server_no_context_takeover
     //
+    // A client can also list several offers, by order of preference:
+    //
+    // Sec-WebSocket-Extensions: x-permessage-zstd; dictionary_id=1234,
+    // permessage-deflate; client_max_window_bits
+    //
     WebSocketPerMessageDeflateOptions::WebSocketPerMessageDeflateOptions(std::string extension)
     {
         extension = removeSpaces(extension);
@@ -60,52 +78,84 @@ namespace ix
         _serverNoContextTakeover = false;
         _clientMaxWindowBits = kDefaultClientMaxWindowBits;
         _serverMaxWindowBits = kDefaultServerMaxWindowBits;
+        _clientMaxWindowBitsOffered = false;
+        _memLevel = kDefaultMemLevel;
+        _lazyAllocation = false;
+        _idleTimeoutSecs = 0;
+        _zstd = false;
+        _zstdDictionaryId = 0;
 
-#ifdef IXWEBSOCKET_USE_ZLIB
-        // Split by ;
-        std::string token;
-        std::stringstream tokenStream(extension);
+        // Split by , then by ;. Only the first offer of each extension is used.
+        std::string offer;
+        std::stringstream offerStream(extension);
 
-        while (std::getline(tokenStream, token, ';'))
+        while (std::getline(offerStream, offer, ','))
         {
-            if (token == "permessage-deflate")
-            {
-                _enabled = true;
-            }
+            std::string token;
+            std::stringstream tokenStream(offer);
+            std::getline(tokenStream, token, ';');
 
-            if (token == "server_no_context_takeover")
+            if (token == kZstdExtension && !_zstd)
             {
-                _serverNoContextTakeover = true;
-            }
+                _zstd = true;
 
-            if (token == "client_no_context_takeover")
-            {
-                _clientNoContextTakeover = true;
+                while (std::getline(tokenStream, token, ';'))
+                {
+                    if (startsWith(token, "dictionary_id="))
+                    {
+                        _zstdDictionaryId = (uint32_t) strtoul(
+                            token.substr(token.find_last_of("=") + 1).c_str(), nullptr, 10);
+                    }
+                }
+                continue;
             }
 
-            if (startsWith(token, "server_max_window_bits="))
-            {
-                uint8_t x = strtol(token.substr(token.find_last_of("=") + 1).c_str(), nullptr, 10);
+            if (token != "permessage-deflate" || _enabled) continue;
 
-                // Sanitize values to be in the proper range [8, 15] in
-                // case a server would give us bogus values
-                _serverMaxWindowBits =
-                    std::min(maxServerMaxWindowBits, std::max(x, minServerMaxWindowBits));
-            }
+            _enabled = true;
 
-            if (startsWith(token, "client_max_window_bits="))
+            while (std::getline(tokenStream, token, ';'))
             {
-                uint8_t x = strtol(token.substr(token.find_last_of("=") + 1).c_str(), nullptr, 10);
+                if (token == "server_no_context_takeover")
+                {
+                    _serverNoContextTakeover = true;
+                }
 
-                // Sanitize values to be in the proper range [8, 15] in
-                // case a server would give us bogus values
-                _clientMaxWindowBits =
-                    std::min(maxClientMaxWindowBits, std::max(x, minClientMaxWindowBits));
+                if (token == "client_no_context_takeover")
+                {
+                    _clientNoContextTakeover = true;
+                }
 
-                sanitizeClientMaxWindowBits();
+                if (startsWith(token, "server_max_window_bits="))
+                {
+                    uint8_t x =
+                        strtol(token.substr(token.find_last_of("=") + 1).c_str(), nullptr, 10);
+
+                    // Sanitize values to be in the proper range [8, 15] in
+                    // case a server would give us bogus values
+                    _serverMaxWindowBits =
+                        std::min(maxServerMaxWindowBits, std::max(x, minServerMaxWindowBits));
+                }
+
+                if (startsWith(token, "client_max_window_bits"))
+                {
+                    _clientMaxWindowBitsOffered = true;
+                }
+
+                if (startsWith(token, "client_max_window_bits="))
+                {
+                    uint8_t x =
+                        strtol(token.substr(token.find_last_of("=") + 1).c_str(), nullptr, 10);
+
+                    // Sanitize values to be in the proper range [8, 15] in
+                    // case a server would give us bogus values
+                    _clientMaxWindowBits =
+                        std::min(maxClientMaxWindowBits, std::max(x, minClientMaxWindowBits));
+
+                    sanitizeClientMaxWindowBits();
+                }
             }
         }
-#endif
     }
 
     void WebSocketPerMessageDeflateOptions::sanitizeClientMaxWindowBits()
@@ -120,31 +170,47 @@ namespace ix
 
     std::string WebSocketPerMessageDeflateOptions::generateHeader()
     {
-#ifdef IXWEBSOCKET_USE_ZLIB
         std::stringstream ss;
-        ss << "Sec-WebSocket-Extensions: permessage-deflate";
 
-        if (_clientNoContextTakeover) ss << "; client_no_context_takeover";
-        if (_serverNoContextTakeover) ss << "; server_no_context_takeover";
+        // Offered first, as it is preferred
+        if (isZstdEnabled())
+        {
+            ss << kZstdExtension;
+            if (_zstdDictionaryId != 0) ss << "; dictionary_id=" << _zstdDictionaryId;
+        }
 
-        ss << "; server_max_window_bits=" << static_cast<int>(_serverMaxWindowBits);
-        ss << "; client_max_window_bits=" << static_cast<int>(_clientMaxWindowBits);
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (_enabled)
+        {
+            if (isZstdEnabled()) ss << ", ";
+            ss << "permessage-deflate";
 
-        ss << "\r\n";
+            if (_clientNoContextTakeover) ss << "; client_no_context_takeover";
+            if (_serverNoContextTakeover) ss << "; server_no_context_takeover";
 
-        return ss.str();
-#else
-        return std::string();
+            ss << "; server_max_window_bits=" << static_cast<int>(_serverMaxWindowBits);
+
+            // A server must not respond with this parameter unless the client offered it
+            // (RFC 7692 section 7.1.2.2)
+            if (_clientMaxWindowBitsOffered)
+            {
+                ss << "; client_max_window_bits=" << static_cast<int>(_clientMaxWindowBits);
+            }
+        }
 #endif
+
+        std::string extensions = ss.str();
+        if (extensions.empty()) return std::string();
+
+        return "Sec-WebSocket-Extensions: " + extensions + "\r\n";
     }
 
     bool WebSocketPerMessageDeflateOptions::enabled() const
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        return _enabled;
-#else
-        return false;
+        if (_enabled) return true;
 #endif
+        return isZstdEnabled();
     }
 
     bool WebSocketPerMessageDeflateOptions::getClientNoContextTakeover() const
@@ -167,6 +233,111 @@ namespace ix
         return _serverMaxWindowBits;
     }
 
+    void WebSocketPerMessageDeflateOptions::setMemLevel(uint8_t memLevel)
+    {
+        _memLevel = std::min(maxMemLevel, std::max(memLevel, minMemLevel));
+    }
+
+    uint8_t WebSocketPerMessageDeflateOptions::getMemLevel() const
+    {
+        return _memLevel;
+    }
+
+    void WebSocketPerMessageDeflateOptions::enableLazyAllocation(int idleTimeoutSecs)
+    {
+        _lazyAllocation = true;
+        _idleTimeoutSecs = std::max(0, idleTimeoutSecs);
+    }
+
+    bool WebSocketPerMessageDeflateOptions::isLazyAllocationEnabled() const
+    {
+        return _lazyAllocation;
+    }
+
+    int WebSocketPerMessageDeflateOptions::getIdleTimeoutSecs() const
+    {
+        return _idleTimeoutSecs;
+    }
+
+    void WebSocketPerMessageDeflateOptions::setCodec(const WebSocketCompressionCodecPtr& codec)
+    {
+        _codec = codec;
+    }
+
+    WebSocketCompressionCodecPtr WebSocketPerMessageDeflateOptions::getCodec() const
+    {
+        static const WebSocketCompressionCodecPtr zlibCodec =
+            std::make_shared<WebSocketZlibCodec>();
+
+        return _codec ? _codec : zlibCodec;
+    }
+
+    bool WebSocketPerMessageDeflateOptions::enableZstd(int level, const std::string& dictionary)
+    {
+        auto codec = WebSocketZstdCodec::create(level, dictionary);
+        if (!codec) return false;
+
+        _zstd = true;
+        _zstdDictionaryId = codec->getDictionaryId();
+        _zstdCodec = codec;
+        return true;
+    }
+
+    bool WebSocketPerMessageDeflateOptions::isZstdEnabled() const
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        return _zstd;
+#else
+        return false;
+#endif
+    }
+
+    uint32_t WebSocketPerMessageDeflateOptions::getZstdDictionaryId() const
+    {
+        return _zstdDictionaryId;
+    }
+
+    std::shared_ptr<const WebSocketZstdCodec> WebSocketPerMessageDeflateOptions::getZstdCodec()
+        const
+    {
+        return _zstdCodec;
+    }
+
+    WebSocketPerMessageDeflateOptions WebSocketPerMessageDeflateOptions::negotiate(
+        const WebSocketPerMessageDeflateOptions& offer) const
+    {
+        WebSocketPerMessageDeflateOptions response(offer);
+
+        response._serverNoContextTakeover |= _serverNoContextTakeover;
+        response._clientNoContextTakeover |= _clientNoContextTakeover;
+        response._serverMaxWindowBits = std::min(offer._serverMaxWindowBits, _serverMaxWindowBits);
+        if (offer._clientMaxWindowBitsOffered)
+        {
+            response._clientMaxWindowBits =
+                std::min(offer._clientMaxWindowBits, _clientMaxWindowBits);
+        }
+
+        response.copyLocalSettings(*this);
+
+        // zstd is used instead of permessage-deflate when both ends enable it with the
+        // same dictionary, otherwise it is declined
+        response._zstd = isZstdEnabled() && _zstdCodec && offer._zstd &&
+                         offer._zstdDictionaryId == _zstdDictionaryId;
+        response._enabled = _enabled && offer._enabled && !response._zstd;
+
+        return response;
+    }
+
+    void WebSocketPerMessageDeflateOptions::copyLocalSettings(
+        const WebSocketPerMessageDeflateOptions& other)
+    {
+        _memLevel = other._memLevel;
+        _lazyAllocation = other._lazyAllocation;
+        _idleTimeoutSecs = other._idleTimeoutSecs;
+        _codec = other._codec;
+        _zstdCodec = other._zstdCodec;
+    }
+
     bool WebSocketPerMessageDeflateOptions::startsWith(const std::string& str,
                                                        const std::string& start)
     {
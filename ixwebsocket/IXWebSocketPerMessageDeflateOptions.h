@@ -6,7 +6,10 @@
 
 #pragma once
 
+#include "IXWebSocketCompressionCodec.h"
+#include "IXWebSocketZstdCodec.h"
 #include <cstdint>
+#include <memory>
 #include <string>
 
 namespace ix
@@ -30,11 +33,50 @@ namespace ix
         uint8_t getServerMaxWindowBits() const;
         uint8_t getClientMaxWindowBits() const;
 
+        // Local settings, which are not negotiated with the peer.
+        // zlib memory level (1-9) of the compressor. Lower levels use less memory, at
+        // the cost of speed and compression ratio.
+        void setMemLevel(uint8_t memLevel);
+        uint8_t getMemLevel() const;
+
+        // Allocate the zlib states when the first message is compressed or decompressed,
+        // and free them once unused for idleTimeoutSecs (0 keeps them). A decompressor is
+        // only freed when the peer does not use context takeover.
+        void enableLazyAllocation(int idleTimeoutSecs = 0);
+        bool isLazyAllocationEnabled() const;
+        int getIdleTimeoutSecs() const;
+
+        // Codec of permessage-deflate, zlib by default. Another raw DEFLATE implementation
+        // can be used, see IXWebSocketCompressionCodec.h.
+        void setCodec(const WebSocketCompressionCodecPtr& codec);
+        WebSocketCompressionCodecPtr getCodec() const;
+
+        // Offer or accept the x-permessage-zstd extension, which is used instead of
+        // permessage-deflate when both ends enable it with the same dictionary. Returns
+        // false without zstd support (USE_ZSTD), or if the dictionary is invalid.
+        bool enableZstd(int level = WebSocketZstdCodec::kDefaultLevel,
+                        const std::string& dictionary = std::string());
+        bool isZstdEnabled() const;
+        uint32_t getZstdDictionaryId() const;
+        std::shared_ptr<const WebSocketZstdCodec> getZstdCodec() const;
+
+        // Response of a server using these options as its policy to the offer of a
+        // client: context takeover is disabled if either side asks for it, and the window
+        // sizes are the smallest of both. The client window is only reduced when the
+        // client offered to.
+        WebSocketPerMessageDeflateOptions negotiate(
+            const WebSocketPerMessageDeflateOptions& offer) const;
+
+        // Copy the settings which are not part of the handshake
+        void copyLocalSettings(const WebSocketPerMessageDeflateOptions& other);
+
         static bool startsWith(const std::string& str, const std::string& start);
         static std::string removeSpaces(const std::string& str);
 
         static uint8_t const kDefaultClientMaxWindowBits;
         static uint8_t const kDefaultServerMaxWindowBits;
+        static uint8_t const kDefaultMemLevel;
+        static const std::string kZstdExtension;
 
     private:
         bool _enabled;
@@ -42,6 +84,16 @@ namespace ix
         bool _serverNoContextTakeover;
         uint8_t _clientMaxWindowBits;
         uint8_t _serverMaxWindowBits;
+        bool _clientMaxWindowBitsOffered;
+
+        uint8_t _memLevel;
+        bool _lazyAllocation;
+        int _idleTimeoutSecs;
+        WebSocketCompressionCodecPtr _codec;
+
+        bool _zstd;
+        uint32_t _zstdDictionaryId;
+        std::shared_ptr<const WebSocketZstdCodec> _zstdCodec;
 
         void sanitizeClientMaxWindowBits();
     };
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iterator>
@@ -81,6 +82,20 @@ namespace ix
         {
         }
 
+        /*
+         * The buffer (std::string, std::vector<char> or std::vector<uint8_t>) is shared with
+         * the send queue, which keeps it alive until it has been sent, without copying it.
+         * It must not be modified afterward.
+         */
+        template<typename T>
+        IXWebSocketSendData(const std::shared_ptr<T>& buffer)
+            : _data(buffer ? reinterpret_cast<const char*>(buffer->data()) : nullptr)
+            , _size(buffer ? buffer->size() : 0)
+            , _owner(buffer)
+        {
+            static_assert(sizeof(*buffer->data()) == 1, "buffer elements must be bytes");
+        }
+
         bool empty() const
         {
             return _data == nullptr || _size == 0;
@@ -101,6 +116,12 @@ namespace ix
             return _size;
         }
 
+        /* Set when the data is shared, null when it is only borrowed */
+        const std::shared_ptr<const void>& owner() const
+        {
+            return _owner;
+        }
+
         inline const_iterator begin() const
         {
             return const_iterator(const_cast<char*>(_data));
@@ -124,6 +145,7 @@ namespace ix
     private:
         const char* _data;
         const size_t _size;
+        std::shared_ptr<const void> _owner;
     };
 
 }
\ No newline at end of file
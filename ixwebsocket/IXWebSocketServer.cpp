@@ -9,8 +9,12 @@
 #include "IXNetSystem.h"
 #include "IXSetThreadName.h"
 #include "IXSocketConnect.h"
+#include "IXUniquePtr.h"
+#include "IXUtf8Validator.h"
 #include "IXWebSocket.h"
+#include "IXWebSocketPerMessageDeflateCodec.h"
 #include "IXWebSocketTransport.h"
+#include <algorithm>
 #include <future>
 #include <sstream>
 #include <string.h>
@@ -33,6 +37,13 @@ namespace ix
         , _enablePong(kDefaultEnablePong)
         , _enablePerMessageDeflate(true)
         , _pingIntervalSeconds(pingIntervalSeconds)
+        , _maxMessageSize(0)
+        , _enableMessageStreaming(false)
+        , _enableOwnedMessages(false)
+        , _compressionThreshold(0)
+        , _enableCompressionProbe(true)
+        , _bufferPoolMaxSize(BufferPool::kDefaultMaxSize)
+        , _clients(std::make_shared<const std::vector<std::shared_ptr<WebSocket>>>())
     {
     }
 
@@ -45,11 +56,7 @@ namespace ix
     {
         stopAcceptingConnections();
 
-        auto clients = getClients();
-        for (auto client : clients)
-        {
-            client->close();
-        }
+        forEachClient([](const std::shared_ptr<WebSocket>& client) { client->close(); });
 
         SocketServer::stop();
     }
@@ -69,6 +76,62 @@ namespace ix
         _enablePerMessageDeflate = false;
     }
 
+    void WebSocketServer::setPerMessageDeflateOptions(
+        const WebSocketPerMessageDeflateOptions& options)
+    {
+        _perMessageDeflateOptions = options;
+        _enablePerMessageDeflate = options.enabled();
+    }
+
+    WebSocketPerMessageDeflateStats WebSocketServer::getPerMessageDeflateStats() const
+    {
+        WebSocketPerMessageDeflateStats stats;
+        forEachClient([&stats](const std::shared_ptr<WebSocket>& client) {
+            auto clientStats = client->getPerMessageDeflateStats();
+            stats.connections += clientStats.connections;
+            stats.compressors += clientStats.compressors;
+            stats.decompressors += clientStats.decompressors;
+            stats.memory += clientStats.memory;
+            stats.releases += clientStats.releases;
+        });
+        return stats;
+    }
+
+    void WebSocketServer::setMaxMessageSize(size_t maxMessageSize)
+    {
+        _maxMessageSize = maxMessageSize;
+    }
+
+    void WebSocketServer::enableMessageStreaming()
+    {
+        _enableMessageStreaming = true;
+    }
+
+    void WebSocketServer::enableOwnedMessages()
+    {
+        _enableOwnedMessages = true;
+    }
+
+    void WebSocketServer::setCompressionThreshold(size_t threshold)
+    {
+        _compressionThreshold = threshold;
+    }
+
+    void WebSocketServer::disableCompressionProbe()
+    {
+        _enableCompressionProbe = false;
+    }
+
+    void WebSocketServer::setBufferPoolMaxSize(size_t maxSize)
+    {
+        _bufferPoolMaxSize = maxSize;
+    }
+
+    void WebSocketServer::setBufferAllocator(const std::shared_ptr<BufferAllocator>& allocator)
+    {
+        _bufferAllocator = allocator;
+    }
+
     void WebSocketServer::setOnConnectionCallback(const OnConnectionCallback& callback)
     {
         _onConnectionCallback = callback;
@@ -82,16 +145,21 @@ namespace ix
     void WebSocketServer::handleConnection(std::unique_ptr<Socket> socket,
                                            std::shared_ptr<ConnectionState> connectionState)
     {
-        handleUpgrade(std::move(socket), connectionState);
-
-        connectionState->setTerminated();
+        if (!handleUpgrade(std::move(socket), connectionState))
+        {
+            connectionState->setTerminated();
+        }
     }
 
-    void WebSocketServer::handleUpgrade(std::unique_ptr<Socket> socket,
+    bool WebSocketServer::handleUpgrade(std::unique_ptr<Socket> socket,
                                         std::shared_ptr<ConnectionState> connectionState,
                                         HttpRequestPtr request)
     {
-        setThreadName("Srv:ws:" + connectionState->getId());
+        // In event loop mode this is running on a shared handshake thread
+        if (getEventLoop() == nullptr)
+        {
+            setThreadName("Srv:ws:" + connectionState->getId());
+        }
 
         auto webSocket = std::make_shared<WebSocket>();
 
@@ -108,7 +176,7 @@ namespace ix
                          "registered.");
                 logError("Missing call to setOnMessageCallback inside setOnConnectionCallback.");
                 connectionState->setTerminated();
-                return;
+                return false;
             }
         }
         else if (_onClientMessageCallback)
@@ -124,7 +192,7 @@ namespace ix
                 "WebSocketServer Application developer error: No server callback is registerered.");
             logError("Missing call to setOnConnectionCallback or setOnClientMessageCallback.");
             connectionState->setTerminated();
-            return;
+            return false;
         }
 
         webSocket->disableAutomaticReconnection();
@@ -138,16 +206,52 @@ namespace ix
             webSocket->disablePong();
         }
 
-        // Add this client to our client set
+        if (_perMessageDeflateOptions.enabled())
         {
-            std::lock_guard<std::mutex> lock(_clientsMutex);
-            _clients.insert(webSocket);
+            webSocket->setPerMessageDeflateOptions(_perMessageDeflateOptions);
         }
+        webSocket->setMaxMessageSize(_maxMessageSize);
+        if (_enableMessageStreaming)
+        {
+            webSocket->enableMessageStreaming();
+        }
+        if (_enableOwnedMessages)
+        {
+            webSocket->enableOwnedMessages();
+        }
+        webSocket->setCompressionThreshold(_compressionThreshold);
+        if (!_enableCompressionProbe)
+        {
+            webSocket->disableCompressionProbe();
+        }
+        webSocket->setBufferPoolMaxSize(_bufferPoolMaxSize);
+        if (_bufferAllocator)
+        {
+            webSocket->setBufferAllocator(_bufferAllocator);
+        }
+
+        // Callbacks run on the shared handshake and I/O threads, where sends must not
+        // wait for the peer
+        if (getEventLoop() != nullptr)
+        {
+            webSocket->disableBlockingSend();
+        }
+
+        // Add this client to our client set
+        addClient(webSocket);
+
+        int fd = socket->getFd();
+        int interruptFd = socket->getSelectInterruptFd();
 
         auto status = webSocket->connectToSocket(
             std::move(socket), _handshakeTimeoutSecs, _enablePerMessageDeflate, request);
         if (status.success)
         {
+            if (addToEventLoop(webSocket, connectionState, fd, interruptFd))
+            {
+                return true;
+            }
+
             // Process incoming messages and execute callbacks
             // until the connection is closed
             webSocket->run();
@@ -160,33 +264,198 @@ namespace ix
             logError(ss.str());
         }
 
+        removeClient(webSocket);
+        return false;
+    }
+
+    bool WebSocketServer::addToEventLoop(std::shared_ptr<WebSocket> webSocket,
+                                         std::shared_ptr<ConnectionState> connectionState,
+                                         int fd,
+                                         int interruptFd)
+    {
+        SocketEventLoop* eventLoop = getEventLoop();
+        if (eventLoop == nullptr) return false;
+
+        std::string errorMsg;
+        bool added = eventLoop->add(
+            fd,
+            interruptFd,
+            [this, webSocket, connectionState](SocketEventLoop::Event event) -> bool
+            {
+                if (event == SocketEventLoop::Event::Stop)
+                {
+                    webSocket->close();
+                }
+
+                // Tick and Stop events only need to process ping and closing timeouts
+                bool timerOnly = event != SocketEventLoop::Event::Ready;
+                if (webSocket->runOnce(timerOnly))
+                {
+                    return true;
+                }
+
+                removeClient(webSocket);
+                connectionState->setTerminated();
+                return false;
+            },
+            [webSocket]() -> bool { return webSocket->bufferedAmount() > 0; },
+            errorMsg);
+
+        if (!added)
+        {
+            logError("WebSocketServer::handleUpgrade() cannot use the event loop: " + errorMsg);
+        }
+
+        return added;
+    }
+
+    void WebSocketServer::addClient(const std::shared_ptr<WebSocket>& webSocket)
+    {
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+        auto clients = std::make_shared<std::vector<std::shared_ptr<WebSocket>>>();
+        clients->reserve(_clients->size() + 1);
+        *clients = *_clients;
+        clients->push_back(webSocket);
+        std::atomic_store(&_clients, ClientsSnapshot(std::move(clients)));
+    }
+
+    void WebSocketServer::removeClient(const std::shared_ptr<WebSocket>& webSocket)
+    {
         webSocket->setOnMessageCallback(nullptr);
 
         // Remove this client from our client set
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+        auto it = std::find(_clients->begin(), _clients->end(), webSocket);
+        if (it == _clients->end())
         {
-            std::lock_guard<std::mutex> lock(_clientsMutex);
-            if (_clients.erase(webSocket) != 1)
-            {
-                logError("Cannot delete client");
-            }
+            logError("Cannot delete client");
+            return;
         }
+
+        auto clients = std::make_shared<std::vector<std::shared_ptr<WebSocket>>>();
+        clients->reserve(_clients->size() - 1);
+        clients->insert(clients->end(), _clients->begin(), it);
+        clients->insert(clients->end(), it + 1, _clients->end());
+        std::atomic_store(&_clients, ClientsSnapshot(std::move(clients)));
     }
 
     std::set<std::shared_ptr<WebSocket>> WebSocketServer::getClients()
     {
-        std::lock_guard<std::mutex> lock(_clientsMutex);
-        return _clients;
+        auto clients = getClientsSnapshot();
+        return std::set<std::shared_ptr<WebSocket>>(clients->begin(), clients->end());
+    }
+
+    WebSocketServer::ClientsSnapshot WebSocketServer::getClientsSnapshot() const
+    {
+        return std::atomic_load(&_clients);
+    }
+
+    void WebSocketServer::forEachClient(const OnClientCallback& visitor) const
+    {
+        auto clients = getClientsSnapshot();
+        for (auto&& client : *clients)
+        {
+            visitor(client);
+        }
     }
 
     size_t WebSocketServer::getConnectedClientsCount()
     {
-        std::lock_guard<std::mutex> lock(_clientsMutex);
-        return _clients.size();
+        return getClientsSnapshot()->size();
     }
 
     //
     // Classic servers
     //
+    size_t WebSocketServer::broadcast(const IXWebSocketSendData& data,
+                                      bool binary,
+                                      const WebSocket* skip)
+    {
+        if (!binary)
+        {
+            Utf8Validator validator;
+            if (!validator.decode(data.data(), data.data() + data.size()) ||
+                !validator.complete())
+            {
+                return 0;
+            }
+        }
+
+        std::shared_ptr<const std::string> frame;
+        std::map<uint8_t, std::shared_ptr<const std::string>> compressedFrames;
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+        bool compress = data.size() >= _compressionThreshold &&
+                        (!_enableCompressionProbe ||
+                         !WebSocketPerMessageDeflateCompressor::isIncompressible(data.data(),
+                                                                                 data.size()));
+#endif
+
+        size_t count = 0;
+        auto clients = getClientsSnapshot();
+        for (auto&& client : *clients)
+        {
+            if (client.get() == skip) continue;
+
+            // Clients are listed before their handshake, which negotiates the compression
+            // options. They are only read once the connection is open.
+            if (client->getReadyState() != ReadyState::Open) continue;
+
+            std::shared_ptr<const std::string> clientFrame;
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+            uint8_t bits = client->_ws.getEncodedFrameCompressionBits();
+            if (bits != 0 && compress)
+            {
+                auto it = compressedFrames.find(bits);
+                if (it == compressedFrames.end())
+                {
+                    std::shared_ptr<const std::string> compressedFrame;
+
+                    std::lock_guard<std::mutex> lock(_broadcastMutex);
+                    auto& compressor = _broadcastCompressors[bits];
+                    if (!compressor)
+                    {
+                        compressor = _perMessageDeflateOptions.getCodec()->createCompressor();
+                        if (!compressor->init(
+                                bits, true, _perMessageDeflateOptions.getMemLevel(), false))
+                        {
+                            compressor.reset();
+                        }
+                    }
+
+                    std::string compressed;
+                    if (compressor && compressor->compress(data, compressed))
+                    {
+                        compressedFrame =
+                            WebSocketTransport::encodeFrame(compressed, binary, true);
+                    }
+
+                    // A null frame means that this setting falls back to no compression
+                    it = compressedFrames.emplace(bits, compressedFrame).first;
+                }
+                clientFrame = it->second;
+            }
+#endif
+
+            if (!clientFrame)
+            {
+                if (!frame)
+                {
+                    frame = WebSocketTransport::encodeFrame(data, binary, false);
+                }
+                clientFrame = frame;
+            }
+
+            if (client->sendEncodedFrame(clientFrame, data.size()).success)
+            {
+                count++;
+            }
+        }
+
+        return count;
+    }
+
     void WebSocketServer::makeBroadcastServer()
     {
         setOnClientMessageCallback(
@@ -197,20 +466,7 @@ namespace ix
                 auto remoteIp = connectionState->getRemoteIp();
                 if (msg->type == ix::WebSocketMessageType::Message)
                 {
-                    for (auto&& client : getClients())
-                    {
-                        if (client.get() != &webSocket)
-                        {
-                            client->send(msg->str, msg->binary);
-
-                            // Make sure the OS send buffer is flushed before moving on
-                            do
-                            {
-                                std::chrono::duration<double, std::milli> duration(500);
-                                std::this_thread::sleep_for(duration);
-                            } while (client->bufferedAmount() != 0);
-                        }
-                    }
+                    broadcast(msg->str, msg->binary, &webSocket);
                 }
             });
     }
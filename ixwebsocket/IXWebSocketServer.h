@@ -8,14 +8,17 @@
 
 #include "IXSocketServer.h"
 #include "IXWebSocket.h"
+#include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
 #include <thread>
 #include <utility> // pair
+#include <vector>
 
 namespace ix
 {
@@ -42,11 +45,52 @@ namespace ix
         void disablePong();
         void disablePerMessageDeflate();
 
+        // Compression policy: the options offered by the clients are restricted to these
+        // ones, which can require no context takeover or smaller windows, and set the
+        // zlib memory level and lazy allocation of the connections.
+        void setPerMessageDeflateOptions(const WebSocketPerMessageDeflateOptions& options);
+
+        // Sum of the zlib memory of the connected clients
+        WebSocketPerMessageDeflateStats getPerMessageDeflateStats() const;
+
+        // Applied to the connected clients, see WebSocket
+        void setMaxMessageSize(size_t maxMessageSize);
+        void enableMessageStreaming();
+        void enableOwnedMessages();
+        void setCompressionThreshold(size_t threshold);
+        void disableCompressionProbe();
+
+        // The allocator is shared by the buffer pools of all the clients
+        void setBufferPoolMaxSize(size_t maxSize);
+        void setBufferAllocator(const std::shared_ptr<BufferAllocator>& allocator);
+
         void setOnConnectionCallback(const OnConnectionCallback& callback);
         void setOnClientMessageCallback(const OnClientMessageCallback& callback);
 
+        // Immutable list of the connected clients. The list is replaced as a whole when a
+        // client connects or disconnects, which copies it (O(N) per connection change).
+        // Readers do not copy it, and do not wait for _clientsMutex: only a short lived
+        // lock, from the pool used by the atomic shared_ptr functions of the standard
+        // library, is held while the snapshot pointer is loaded.
+        using ClientsSnapshot = std::shared_ptr<const std::vector<std::shared_ptr<WebSocket>>>;
+        using OnClientCallback = std::function<void(const std::shared_ptr<WebSocket>&)>;
+
         // Get all the connected clients
         std::set<std::shared_ptr<WebSocket>> getClients();
+        ClientsSnapshot getClientsSnapshot() const;
+
+        // Invoke visitor on every connected client, without copying the client list
+        void forEachClient(const OnClientCallback& visitor) const;
+
+        // Send a message to all the connected clients, except skip. The frame is encoded
+        // once, and compressed once per compression setting for the clients which
+        // negotiated per message deflate without context takeover. The other clients
+        // receive an uncompressed frame, as do all the clients when the message is below
+        // the compression threshold or looks incompressible. Returns the number of
+        // clients the message was queued for.
+        size_t broadcast(const IXWebSocketSendData& data,
+                         bool binary,
+                         const WebSocket* skip = nullptr);
 
         void makeBroadcastServer();
         bool listenAndStart();
@@ -62,13 +106,29 @@ namespace ix
         int _handshakeTimeoutSecs;
         bool _enablePong;
         bool _enablePerMessageDeflate;
+        WebSocketPerMessageDeflateOptions _perMessageDeflateOptions;
         int _pingIntervalSeconds;
+        size_t _maxMessageSize;
+        bool _enableMessageStreaming;
+        std::atomic<bool> _enableOwnedMessages;
+        size_t _compressionThreshold;
+        bool _enableCompressionProbe;
+        size_t _bufferPoolMaxSize;
+        std::shared_ptr<BufferAllocator> _bufferAllocator;
 
         OnConnectionCallback _onConnectionCallback;
         OnClientMessageCallback _onClientMessageCallback;
 
+        // Copy on write: writers serialize on _clientsMutex, build a new list, and
+        // publish it with std::atomic_store. Readers load it with std::atomic_load,
+        // which libstdc++ and libc++ implement with a pool of mutexes, not lock free.
         std::mutex _clientsMutex;
-        std::set<std::shared_ptr<WebSocket>> _clients;
+        ClientsSnapshot _clients;
+
+        // Broadcast compressors, one per window bits value. They do not keep any
+        // context between messages.
+        std::mutex _broadcastMutex;
+        std::map<uint8_t, std::unique_ptr<WebSocketCompressor>> _broadcastCompressors;
 
         const static bool kDefaultEnablePong;
         const static int kPingIntervalSeconds;
@@ -78,8 +138,17 @@ namespace ix
                                       std::shared_ptr<ConnectionState> connectionState);
         virtual size_t getConnectedClientsCount() final;
 
+        bool addToEventLoop(std::shared_ptr<WebSocket> webSocket,
+                            std::shared_ptr<ConnectionState> connectionState,
+                            int fd,
+                            int interruptFd);
+        void addClient(const std::shared_ptr<WebSocket>& webSocket);
+        void removeClient(const std::shared_ptr<WebSocket>& webSocket);
+
     protected:
-        void handleUpgrade(std::unique_ptr<Socket> socket,
+        // Returns true when the connection was handed over to the event loop. In that
+        // case the connection state is terminated later, once the connection is closed.
+        bool handleUpgrade(std::unique_ptr<Socket> socket,
                            std::shared_ptr<ConnectionState> connectionState,
                            HttpRequestPtr request = nullptr);
     };
@@ -41,9 +41,12 @@
 #include "IXUtf8Validator.h"
 #include "IXWebSocketHandshake.h"
 #include "IXWebSocketHttpHeaders.h"
+#include "IXWebSocketMask.h"
+#include "IXWebSocketPerMessageDeflateCodec.h"
 #include <chrono>
 #include <cstdarg>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <string.h>
 #include <string>
@@ -57,16 +60,34 @@ namespace ix
     const bool WebSocketTransport::kDefaultEnablePong(true);
     const int WebSocketTransport::kClosingMaximumWaitingDelayInMs(300);
     constexpr size_t WebSocketTransport::kChunkSize;
+    constexpr size_t WebSocketTransport::kMaxStreamedReceiveSize;
 
     WebSocketTransport::WebSocketTransport()
         : _useMask(true)
         , _blockingSend(false)
+        , _rxbufStart(0)
+        , _rxbufEnd(0)
+        , _receivedDataPending(false)
+        , _receiveBufferFull(false)
+        , _txbufSize(0)
         , _receivedMessageCompressed(false)
+        , _receivedMessageSize(0)
+        , _maxMessageSize(0)
+        , _partialFrameOffset(0)
+        , _partialFrameRemaining(0)
+        , _discardingMessage(false)
+        , _enableMessageStreaming(false)
+        , _receivingStreamedMessage(false)
+        , _messagePartOffset(0)
+        , _utf8Validator(ix::make_unique<Utf8Validator>())
         , _readyState(ReadyState::CLOSED)
         , _closeCode(WebSocketCloseConstants::kInternalErrorCode)
         , _closeWireSize(0)
         , _closeRemote(false)
         , _enablePerMessageDeflate(false)
+        , _compressionThreshold(0)
+        , _enableCompressionProbe(true)
+        , _bufferPool(std::make_shared<BufferPool>())
         , _requestInitCancellation(false)
         , _closingTimePoint(std::chrono::steady_clock::now())
         , _enablePong(kDefaultEnablePong)
@@ -79,7 +100,6 @@ namespace ix
         , _lastSendPingTimePoint(std::chrono::steady_clock::now())
     {
         setCloseReason(WebSocketCloseConstants::kInternalErrorMessage);
-        _readbuf.resize(kChunkSize);
     }
 
     WebSocketTransport::~WebSocketTransport()
@@ -91,13 +111,21 @@ namespace ix
         const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions,
         const SocketTLSOptions& socketTLSOptions,
         bool enablePong,
-        int pingIntervalSecs)
+        int pingIntervalSecs,
+        size_t maxMessageSize,
+        bool enableMessageStreaming,
+        size_t compressionThreshold,
+        bool enableCompressionProbe)
     {
         _perMessageDeflateOptions = perMessageDeflateOptions;
         _enablePerMessageDeflate = _perMessageDeflateOptions.enabled();
         _socketTLSOptions = socketTLSOptions;
         _enablePong = enablePong;
         _pingIntervalSecs = pingIntervalSecs;
+        _maxMessageSize = maxMessageSize;
+        _enableMessageStreaming = enableMessageStreaming;
+        _compressionThreshold = compressionThreshold;
+        _enableCompressionProbe = enableCompressionProbe;
     }
 
     // Client
@@ -126,7 +154,7 @@ namespace ix
             std::string errorMsg;
             bool tls = protocol == "wss";
             _socket = createSocket(tls, -1, errorMsg, _socketTLSOptions);
-            _perMessageDeflate = ix::make_unique<WebSocketPerMessageDeflate>();
+            resetPerMessageDeflate();
 
             if (!_socket)
             {
@@ -160,6 +188,7 @@ namespace ix
 
             if (result.success)
             {
+                takeHandshakeLeftover();
                 setReadyState(ReadyState::OPEN);
             }
             return result;
@@ -181,7 +210,7 @@ namespace ix
         _blockingSend = true;
 
         _socket = std::move(socket);
-        _perMessageDeflate = ix::make_unique<WebSocketPerMessageDeflate>();
+        resetPerMessageDeflate();
 
         WebSocketHandshake webSocketHandshake(_requestInitCancellation,
                                               _socket,
@@ -193,11 +222,44 @@ namespace ix
             webSocketHandshake.serverHandshake(timeoutSecs, enablePerMessageDeflate, request);
         if (result.success)
         {
+            takeHandshakeLeftover();
             setReadyState(ReadyState::OPEN);
         }
         return result;
     }
 
+    void WebSocketTransport::resetPerMessageDeflate()
+    {
+        std::lock_guard<std::mutex> lock(_perMessageDeflateMutex);
+        _perMessageDeflate = ix::make_unique<WebSocketPerMessageDeflate>();
+    }
+
+    WebSocketPerMessageDeflateStats WebSocketTransport::getPerMessageDeflateStats() const
+    {
+        std::lock_guard<std::mutex> lock(_perMessageDeflateMutex);
+        if (!_enablePerMessageDeflate || !_perMessageDeflate)
+        {
+            return WebSocketPerMessageDeflateStats();
+        }
+        return _perMessageDeflate->getStats();
+    }
+
+    void WebSocketTransport::takeHandshakeLeftover()
+    {
+        // The peer can send frames right after the handshake, they may have been
+        // received by the socket read ahead buffer along with the http headers
+        std::string leftover = _socket->releaseReadAheadBuffer();
+        if (leftover.empty()) return;
+
+        _rxbuf.insert(_rxbuf.begin() + _rxbufEnd, leftover.begin(), leftover.end());
+        _rxbufEnd += leftover.size();
+
+        // The socket will not be readable for these bytes, make sure that the next poll
+        // returns so that they get dispatched
+        _receivedDataPending = true;
+        _socket->wakeUpFromPoll(SelectInterrupt::kSendRequest);
+    }
+
     WebSocketTransport::ReadyState WebSocketTransport::getReadyState() const
     {
         return _readyState;
@@ -305,8 +367,14 @@ namespace ix
         return now - _closingTimePoint > std::chrono::milliseconds(kClosingMaximumWaitingDelayInMs);
     }
 
-    WebSocketTransport::PollResult WebSocketTransport::poll()
+    WebSocketTransport::PollResult WebSocketTransport::poll(bool blocking)
     {
+        if (_receivedDataPending)
+        {
+            _receivedDataPending = false;
+            return PollResult::Succeeded;
+        }
+
         if (_readyState == ReadyState::OPEN)
         {
             if (pingIntervalExceeded())
@@ -340,6 +408,17 @@ namespace ix
             lastingTimeoutDelayInMs = (1000 * _pingIntervalSecs) - timeSinceLastPingMs;
         }
 
+        // Wake up to free the zlib states once idle
+        if (_readyState == ReadyState::OPEN && _enablePerMessageDeflate)
+        {
+            int idleDelayMs = _perMessageDeflate->releaseIdleStates();
+            if (idleDelayMs >= 0 &&
+                (lastingTimeoutDelayInMs < 0 || idleDelayMs < lastingTimeoutDelayInMs))
+            {
+                lastingTimeoutDelayInMs = idleDelayMs;
+            }
+        }
+
         // The platform may not have select interrupt capabilities, so wait with a small timeout
         if (lastingTimeoutDelayInMs <= 0 && !_socket->isWakeUpFromPollSupported())
         {
@@ -353,14 +432,39 @@ namespace ix
             lastingTimeoutDelayInMs = 100;
         }
 
-        // poll the socket
-        PollResultType pollResult = _socket->isReadyToRead(lastingTimeoutDelayInMs);
+        // When driven by the server event loop, the socket is known to be ready
+        // and we must not block the I/O thread
+        if (!blocking)
+        {
+            lastingTimeoutDelayInMs = 0;
+        }
+
+        // poll the socket, unless data was left to read
+        PollResultType pollResult = PollResultType::ReadyForRead;
+        if (_receiveBufferFull)
+        {
+            _receiveBufferFull = false;
+        }
+        else
+        {
+            pollResult = _socket->isReadyToRead(lastingTimeoutDelayInMs);
+        }
 
         // Make sure we send all the buffered data
         // there can be a lot of it for large messages.
+        // In non blocking mode the sender is flushing already, only send what the socket
+        // can take right now.
         if (pollResult == PollResultType::SendRequest)
         {
-            if (!flushSendBuffer())
+            if (!(blocking ? flushSendBuffer() : sendOnSocket()))
+            {
+                return PollResult::CannotFlushSendBuffer;
+            }
+        }
+        else if (pollResult == PollResultType::Timeout && !blocking && !isSendBufferEmpty())
+        {
+            // Event loop tick, retry to send what the socket could not take earlier
+            if (!sendOnSocket())
             {
                 return PollResult::CannotFlushSendBuffer;
             }
@@ -371,10 +475,18 @@ namespace ix
             {
                 return PollResult::AbnormalClose;
             }
+
+            // A peer which keeps sending must not delay what we have to send
+            if (!blocking && !isSendBufferEmpty() && !sendOnSocket())
+            {
+                return PollResult::CannotFlushSendBuffer;
+            }
         }
         else if (pollResult == PollResultType::Error)
         {
+            // The socket is closed, make sure that dispatch switches to the CLOSED state
             closeSocket();
+            return PollResult::AbnormalClose;
         }
         else if (pollResult == PollResultType::CloseRequest)
         {
@@ -383,7 +495,7 @@ namespace ix
 
         if (_readyState == ReadyState::CLOSING && closingDelayExceeded())
         {
-            _rxbuf.clear();
+            clearReceiveBuffer();
             // close code and reason were set when calling close()
             closeSocket();
             setReadyState(ReadyState::CLOSED);
@@ -392,44 +504,119 @@ namespace ix
         return PollResult::Succeeded;
     }
 
+    void WebSocketTransport::disableBlockingSend()
+    {
+        _blockingSend = false;
+    }
+
+    bool WebSocketTransport::hasPendingTimeout()
+    {
+        if (_receiveBufferFull)
+        {
+            return true;
+        }
+        else if (_readyState == ReadyState::OPEN)
+        {
+            // Also retry to send data which did not fit in the socket buffer, and free
+            // idle zlib states
+            return pingIntervalExceeded() || !isSendBufferEmpty() ||
+                   (_enablePerMessageDeflate && _perMessageDeflate->getIdleStatesDelayMs() == 0);
+        }
+        else if (_readyState == ReadyState::CLOSING)
+        {
+            return closingDelayExceeded();
+        }
+
+        return false;
+    }
+
     bool WebSocketTransport::isSendBufferEmpty() const
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
         return _txbuf.empty();
     }
 
-    template<class Iterator>
-    void WebSocketTransport::appendToSendBuffer(const std::vector<uint8_t>& header,
-                                                Iterator begin,
-                                                Iterator end,
-                                                uint64_t message_size,
-                                                uint8_t masking_key[4])
+    // Must be called with _txbufMutex held
+    void WebSocketTransport::appendToSendBuffer(SendFrame& frame, uint8_t masking_key[4])
     {
-        std::lock_guard<std::mutex> lock(_txbufMutex);
-
-        _txbuf.insert(_txbuf.end(), header.begin(), header.end());
-        _txbuf.insert(_txbuf.end(), begin, end);
-
-        if (_useMask)
+        if (_useMask && frame.payloadSize != 0)
         {
-            for (size_t i = 0; i != (size_t) message_size; ++i)
+            // Mask into a reusable buffer when the frame is likely to be sent right away,
+            // into a buffer owned by the frame when other frames are waiting
+            char* masked = nullptr;
+            if (_txbuf.empty())
             {
-                *(_txbuf.end() - (size_t) message_size + i) ^= masking_key[i & 0x3];
+                if (_maskingBuffer.size() < frame.payloadSize)
+                {
+                    _maskingBuffer.resize(frame.payloadSize);
+                }
+                masked = &_maskingBuffer[0];
+                frame.owner.reset();
             }
+            else
+            {
+                auto buffer = _bufferPool->share(_bufferPool->acquire(frame.payloadSize));
+                buffer->resize(frame.payloadSize);
+                masked = &(*buffer)[0];
+                frame.owner = buffer;
+            }
+
+            webSocketMask((const uint8_t*) frame.payload,
+                          (uint8_t*) masked,
+                          frame.payloadSize,
+                          masking_key);
+            frame.payload = masked;
         }
+
+        _txbufSize += frame.headerSize + frame.payloadSize;
+        _txbuf.push_back(std::move(frame));
+    }
+
+    // Must be called with _txbufMutex held. Only the last queued frame can be borrowed.
+    void WebSocketTransport::detachBorrowedPayload()
+    {
+        if (_txbuf.empty() || _txbuf.back().owner || _txbuf.back().payloadSize == 0) return;
+
+        SendFrame& frame = _txbuf.back();
+        size_t payloadSent = (frame.sent > frame.headerSize) ? frame.sent - frame.headerSize : 0;
+
+        auto buffer = _bufferPool->share(_bufferPool->acquire(frame.payloadSize - payloadSent));
+        buffer->assign(frame.payload + payloadSent, frame.payload + frame.payloadSize);
+        frame.payload = buffer->data();
+        frame.payloadSize -= payloadSent;
+        frame.sent -= payloadSent;
+        frame.owner = buffer;
     }
 
     void WebSocketTransport::unmaskReceiveBuffer(const wsheader_type& ws)
     {
         if (ws.mask)
         {
-            for (size_t j = 0; j != ws.N; ++j)
-            {
-                _rxbuf[j + ws.header_size] ^= ws.masking_key[j & 0x3];
-            }
+            uint8_t* payload = &_rxbuf[_rxbufStart + ws.header_size];
+            webSocketMask(payload, payload, (size_t) ws.N, ws.masking_key);
         }
     }
 
+    size_t WebSocketTransport::getReceiveBufferSize() const
+    {
+        return _rxbufEnd - _rxbufStart;
+    }
+
+    void WebSocketTransport::clearReceiveBuffer()
+    {
+        _rxbufStart = 0;
+        _rxbufEnd = 0;
+    }
+
+    void WebSocketTransport::compactReceiveBuffer()
+    {
+        if (_rxbufStart == 0) return;
+
+        std::memmove(&_rxbuf[0], &_rxbuf[_rxbufStart], getReceiveBufferSize());
+        _rxbufEnd -= _rxbufStart;
+        _rxbufStart = 0;
+    }
+
     //
     // http://tools.ietf.org/html/rfc6455#section-5.2  Base Framing Protocol
     //
@@ -453,13 +640,53 @@ namespace ix
     // +---------------------------------------------------------------+
     //
     void WebSocketTransport::dispatch(WebSocketTransport::PollResult pollResult,
-                                      const OnMessageCallback& onMessageCallback)
+                                      const OnMessageCallback& onMessageCallback,
+                                      const OnMessagePartCallback& onMessagePartCallback)
     {
         while (true)
         {
+            // Payload of a data frame whose header was already consumed, streamed or
+            // discarded as it is received
+            if (_partialFrameRemaining > 0)
+            {
+                size_t size = (size_t) std::min((uint64_t) getReceiveBufferSize(),
+                                                _partialFrameRemaining);
+                if (size == 0) break;
+
+                uint8_t* payload = &_rxbuf[_rxbufStart];
+                _partialFrameRemaining -= size;
+                bool last = _partialFrame.fin && _partialFrameRemaining == 0;
+
+                if (!_discardingMessage)
+                {
+                    if (_partialFrame.mask)
+                    {
+                        // The masking key is applied from the start of the frame
+                        uint8_t maskingKey[4];
+                        for (size_t i = 0; i < 4; ++i)
+                        {
+                            maskingKey[i] = _partialFrame.masking_key[(_partialFrameOffset + i) % 4];
+                        }
+                        webSocketMask(payload, payload, size, maskingKey);
+                    }
+
+                    emitMessagePart((const char*) payload, size, last, onMessagePartCallback);
+                }
+
+                if (last) _discardingMessage = false;
+
+                _partialFrameOffset += size;
+                _rxbufStart += size;
+                if (_rxbufStart == _rxbufEnd)
+                {
+                    clearReceiveBuffer();
+                }
+                continue;
+            }
+
             wsheader_type ws;
-            if (_rxbuf.size() < 2) break;                /* Need at least 2 */
-            const uint8_t* data = (uint8_t*) &_rxbuf[0]; // peek, but don't consume
+            if (getReceiveBufferSize() < 2) break;                  /* Need at least 2 */
+            const uint8_t* data = (uint8_t*) &_rxbuf[_rxbufStart]; // peek, but don't consume
             ws.fin = (data[0] & 0x80) == 0x80;
             ws.rsv1 = (data[0] & 0x40) == 0x40;
             ws.rsv2 = (data[0] & 0x20) == 0x20;
@@ -469,13 +696,14 @@ namespace ix
             ws.N0 = (data[1] & 0x7f);
             ws.header_size =
                 2 + (ws.N0 == 126 ? 2 : 0) + (ws.N0 == 127 ? 8 : 0) + (ws.mask ? 4 : 0);
-            if (_rxbuf.size() < ws.header_size) break; /* Need: ws.header_size - _rxbuf.size() */
+            if (getReceiveBufferSize() < ws.header_size)
+                break; /* Need: ws.header_size - getReceiveBufferSize() */
 
             if ((ws.rsv1 && !_enablePerMessageDeflate) || ws.rsv2 || ws.rsv3)
             {
                 close(WebSocketCloseConstants::kProtocolErrorCode,
                       WebSocketCloseConstants::kProtocolErrorReservedBitUsed,
-                      _rxbuf.size());
+                      getReceiveBufferSize());
                 return;
             }
 
@@ -539,9 +767,75 @@ namespace ix
                 return;
             }
 
-            if (_rxbuf.size() < ws.header_size + ws.N)
+            bool isDataFrame = ws.opcode == wsheader_type::TEXT_FRAME ||
+                               ws.opcode == wsheader_type::BINARY_FRAME ||
+                               ws.opcode == wsheader_type::CONTINUATION;
+
+            uint64_t messageSize = ws.N;
+            if (ws.opcode == wsheader_type::CONTINUATION)
             {
-                return; /* Need: ws.header_size+ws.N - _rxbuf.size() */
+                messageSize += _receivedMessageSize;
+            }
+
+            // Messages which are too large are rejected before their payload is
+            // buffered, and dropped as they are received
+            if (isDataFrame && (_discardingMessage ||
+                                (_maxMessageSize != 0 && messageSize > _maxMessageSize)))
+            {
+                if (!_discardingMessage)
+                {
+                    close(WebSocketCloseConstants::kMessageTooBigCode,
+                          WebSocketCloseConstants::kMessageTooBigMessage);
+                    _discardingMessage = true;
+                    _chunks.clear();
+                    _receivingStreamedMessage = false;
+                }
+
+                startPartialFrame(ws, messageSize);
+                if (ws.N == 0 && ws.fin) _discardingMessage = false;
+                continue;
+            }
+
+            if (isDataFrame && _enableMessageStreaming)
+            {
+                if (ws.opcode != wsheader_type::CONTINUATION)
+                {
+                    _fragmentedMessageKind = (ws.opcode == wsheader_type::TEXT_FRAME)
+                                                 ? MessageKind::MSG_TEXT
+                                                 : MessageKind::MSG_BINARY;
+
+                    _receivedMessageCompressed = _enablePerMessageDeflate && ws.rsv1;
+                    _messagePartOffset = 0;
+                    _utf8Validator->reset();
+
+                    // Continuation message needs to follow a non-fin TEXT or BINARY message
+                    if (_receivingStreamedMessage)
+                    {
+                        close(WebSocketCloseConstants::kProtocolErrorCode,
+                              WebSocketCloseConstants::kProtocolErrorCodeDataOpcodeOutOfSequence);
+                    }
+                }
+                else if (!_receivingStreamedMessage)
+                {
+                    // Continuation message need to follow a non-fin TEXT or BINARY message
+                    close(
+                        WebSocketCloseConstants::kProtocolErrorCode,
+                        WebSocketCloseConstants::kProtocolErrorCodeContinuationOpCodeOutOfSequence);
+                }
+                _receivingStreamedMessage = !ws.fin;
+
+                startPartialFrame(ws, messageSize);
+                if (ws.N == 0)
+                {
+                    emitMessagePart(nullptr, 0, ws.fin, onMessagePartCallback);
+                    if (ws.fin) _discardingMessage = false;
+                }
+                continue;
+            }
+
+            if (getReceiveBufferSize() < ws.header_size + ws.N)
+            {
+                return; /* Need: ws.header_size+ws.N - getReceiveBufferSize() */
             }
 
             if (!ws.fin && (ws.opcode == wsheader_type::PING || ws.opcode == wsheader_type::PONG ||
@@ -554,8 +848,9 @@ namespace ix
             }
 
             unmaskReceiveBuffer(ws);
-            std::string frameData(_rxbuf.begin() + ws.header_size,
-                                  _rxbuf.begin() + ws.header_size + (size_t) ws.N);
+            const uint8_t* payload = data + ws.header_size;
+            std::string frameData = _bufferPool->acquire((size_t) ws.N);
+            frameData.append((const char*) payload, (size_t) ws.N);
 
             // We got a whole message, now do something with it:
             if (ws.opcode == wsheader_type::TEXT_FRAME ||
@@ -584,6 +879,7 @@ namespace ix
                         WebSocketCloseConstants::kProtocolErrorCode,
                         WebSocketCloseConstants::kProtocolErrorCodeContinuationOpCodeOutOfSequence);
                 }
+                _receivedMessageSize = ws.fin ? 0 : messageSize;
 
                 //
                 // Usual case. Small unfragmented messages
@@ -606,21 +902,28 @@ namespace ix
                     // the internal buffer which is slow and can let the internal OS
                     // receive buffer fill out.
                     //
-                    _chunks.emplace_back(frameData);
+                    _chunks.emplace_back(std::move(frameData));
 
                     if (ws.fin)
                     {
+                        std::string message = getMergedChunks();
                         emitMessage(_fragmentedMessageKind,
-                                    getMergedChunks(),
+                                    message,
                                     _receivedMessageCompressed,
                                     onMessageCallback);
 
+                        _bufferPool->release(std::move(message));
+                        for (auto&& chunk : _chunks)
+                        {
+                            _bufferPool->release(std::move(chunk));
+                        }
                         _chunks.clear();
                         _receivedMessageCompressed = false;
                     }
                     else
                     {
-                        emitMessage(MessageKind::FRAGMENT, std::string(), false, onMessageCallback);
+                        std::string empty;
+                        emitMessage(MessageKind::FRAGMENT, empty, false, onMessageCallback);
                     }
                 }
             }
@@ -657,8 +960,8 @@ namespace ix
                 if (ws.N >= 2)
                 {
                     // Extract the close code first, available as the first 2 bytes
-                    code |= ((uint64_t) _rxbuf[ws.header_size]) << 8;
-                    code |= ((uint64_t) _rxbuf[ws.header_size + 1]) << 0;
+                    code |= ((uint64_t) payload[0]) << 8;
+                    code |= ((uint64_t) payload[1]) << 0;
 
                     // Get the reason.
                     if (ws.N > 2)
@@ -706,7 +1009,7 @@ namespace ix
                     wakeUpFromPoll(SelectInterrupt::kCloseRequest);
 
                     bool remote = true;
-                    closeSocketAndSwitchToClosedState(code, reason, _rxbuf.size(), remote);
+                    closeSocketAndSwitchToClosedState(code, reason, getReceiveBufferSize(), remote);
                 }
                 else
                 {
@@ -717,7 +1020,8 @@ namespace ix
                     if (identicalReason)
                     {
                         bool remote = false;
-                        closeSocketAndSwitchToClosedState(code, reason, _rxbuf.size(), remote);
+                        closeSocketAndSwitchToClosedState(
+                            code, reason, getReceiveBufferSize(), remote);
                     }
                 }
             }
@@ -726,18 +1030,24 @@ namespace ix
                 // Unexpected frame type
                 close(WebSocketCloseConstants::kProtocolErrorCode,
                       WebSocketCloseConstants::kProtocolErrorMessage,
-                      _rxbuf.size());
+                      getReceiveBufferSize());
             }
 
-            // Erase the message that has been processed from the input/read buffer
-            _rxbuf.erase(_rxbuf.begin(), _rxbuf.begin() + ws.header_size + (size_t) ws.N);
+            _bufferPool->release(std::move(frameData));
+
+            // Consume the message that has been processed from the input/read buffer
+            _rxbufStart += ws.header_size + (size_t) ws.N;
+            if (_rxbufStart == _rxbufEnd)
+            {
+                clearReceiveBuffer();
+            }
         }
 
         // if an abnormal closure was raised in poll, and nothing else triggered a CLOSED state in
         // the received and processed data then close the connection
         if (pollResult != PollResult::Succeeded)
         {
-            _rxbuf.clear();
+            clearReceiveBuffer();
 
             // if we previously closed the connection (CLOSING state), then set state to CLOSED
             // (code/reason were set before)
@@ -757,6 +1067,112 @@ namespace ix
         }
     }
 
+    void WebSocketTransport::startPartialFrame(const wsheader_type& ws, uint64_t messageSize)
+    {
+        _partialFrame = ws;
+        _partialFrameOffset = 0;
+        _partialFrameRemaining = ws.N;
+        _receivedMessageSize = ws.fin ? 0 : messageSize;
+
+        _rxbufStart += ws.header_size;
+        if (_rxbufStart == _rxbufEnd)
+        {
+            clearReceiveBuffer();
+        }
+    }
+
+    void WebSocketTransport::emitMessagePart(const char* data,
+                                             size_t size,
+                                             bool last,
+                                             const OnMessagePartCallback& onMessagePartCallback)
+    {
+        if (!_receivedMessageCompressed)
+        {
+            deliverMessagePart(data, size, size, last, false, onMessagePartCallback);
+            return;
+        }
+
+        // The wire size is reported with the first decompressed piece
+        size_t wireSize = size;
+        bool success = _perMessageDeflate->decompress(
+            data, size, last, [&](const char* output, size_t outputSize) -> bool {
+                deliverMessagePart(
+                    output, outputSize, wireSize, false, false, onMessagePartCallback);
+                wireSize = 0;
+                return !_discardingMessage;
+            });
+
+        if (_discardingMessage) return;
+
+        if (!success)
+        {
+            // The rest of the message cannot be decompressed
+            deliverMessagePart(nullptr, 0, wireSize, true, true, onMessagePartCallback);
+            _discardingMessage = !last;
+        }
+        else if (last)
+        {
+            deliverMessagePart(nullptr, 0, wireSize, true, false, onMessagePartCallback);
+        }
+    }
+
+    void WebSocketTransport::deliverMessagePart(const char* data,
+                                                size_t size,
+                                                size_t wireSize,
+                                                bool last,
+                                                bool decompressionError,
+                                                const OnMessagePartCallback& onMessagePartCallback)
+    {
+        // Decompressed messages can exceed the limit checked on their wire size
+        if (_maxMessageSize != 0 && _messagePartOffset + size > _maxMessageSize)
+        {
+            close(WebSocketCloseConstants::kMessageTooBigCode,
+                  WebSocketCloseConstants::kMessageTooBigMessage);
+            _discardingMessage = true;
+            return;
+        }
+
+        // Text messages are validated as they are received, a character can be split
+        // between two parts
+        bool binary = _fragmentedMessageKind == MessageKind::MSG_BINARY;
+        if (!binary && !decompressionError &&
+            (!_utf8Validator->decode(data, data + size) ||
+             (last && !_utf8Validator->complete())))
+        {
+            close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                  WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+            _discardingMessage = true;
+            return;
+        }
+
+        if (size == 0)
+        {
+            _messagePart.clear();
+        }
+        else
+        {
+            _messagePart.assign(data, size);
+        }
+
+        if (onMessagePartCallback)
+        {
+            onMessagePartCallback(
+                _messagePart, wireSize, decompressionError, binary, _messagePartOffset, last);
+        }
+
+        _messagePartOffset += size;
+        if (last)
+        {
+            _messagePartOffset = 0;
+            _utf8Validator->reset();
+        }
+    }
+
+    const BufferPoolPtr& WebSocketTransport::getBufferPool() const
+    {
+        return _bufferPool;
+    }
+
     std::string WebSocketTransport::getMergedChunks() const
     {
         size_t length = 0;
@@ -765,8 +1181,7 @@ namespace ix
             length += chunk.size();
         }
 
-        std::string msg;
-        msg.reserve(length);
+        std::string msg = _bufferPool->acquire(length);
 
         for (auto&& chunk : _chunks)
         {
@@ -777,7 +1192,7 @@ namespace ix
     }
 
     void WebSocketTransport::emitMessage(MessageKind messageKind,
-                                         const std::string& message,
+                                         std::string& message,
                                          bool compressedMessage,
                                          const OnMessageCallback& onMessageCallback)
     {
@@ -786,7 +1201,32 @@ namespace ix
         // When the RSV1 bit is 1 it means the message is compressed
         if (compressedMessage && messageKind != MessageKind::FRAGMENT)
         {
-            bool success = _perMessageDeflate->decompress(message, _decompressedMessage);
+            // The decompressed size is bounded as well
+            bool tooBig = false;
+            _decompressedMessage.clear();
+
+            // The previous buffer can have been moved out by the callback
+            if (_decompressedMessage.capacity() < message.size())
+            {
+                _decompressedMessage = _bufferPool->acquire(2 * message.size());
+            }
+            bool success = _perMessageDeflate->decompress(
+                message.data(), message.size(), true, [&](const char* data, size_t size) -> bool {
+                    if (_maxMessageSize != 0 && _decompressedMessage.size() + size > _maxMessageSize)
+                    {
+                        tooBig = true;
+                        return false;
+                    }
+                    _decompressedMessage.append(data, size);
+                    return true;
+                });
+
+            if (tooBig)
+            {
+                close(WebSocketCloseConstants::kMessageTooBigCode,
+                      WebSocketCloseConstants::kMessageTooBigMessage);
+                return;
+            }
 
             if (messageKind == MessageKind::MSG_TEXT && !validateUtf8(_decompressedMessage))
             {
@@ -834,12 +1274,18 @@ namespace ix
         size_t wireSize = message.size();
         bool compressionError = false;
 
-        auto message_begin = message.cbegin();
-        auto message_end = message.cend();
+        const char* payload = message.data();
+        std::shared_ptr<const void> owner = message.owner();
 
-        if (compress)
+        if (compress && shouldCompress(message))
         {
-            if (!_perMessageDeflate->compress(message, _compressedMessage))
+            // The previous buffer can still be waiting in the send queue
+            if (!_compressedMessage || _compressedMessage.use_count() != 1)
+            {
+                _compressedMessage = _bufferPool->share(_bufferPool->acquire(message.size()));
+            }
+
+            if (!_perMessageDeflate->compress(message, *_compressedMessage))
             {
                 bool success = false;
                 compressionError = true;
@@ -848,16 +1294,15 @@ namespace ix
                 return WebSocketSendInfo(success, compressionError, payloadSize, wireSize);
             }
             compressionError = false;
-            wireSize = _compressedMessage.size();
+            wireSize = _compressedMessage->size();
 
-            IXWebSocketSendData compressedSendData(_compressedMessage);
-            message_begin = compressedSendData.cbegin();
-            message_end = compressedSendData.cend();
+            // Frames which cannot be sent right away keep the buffer instead of a copy
+            payload = _compressedMessage->data();
+            owner = _compressedMessage;
         }
-
+        else
         {
-            std::lock_guard<std::mutex> lock(_txbufMutex);
-            _txbuf.reserve(wireSize);
+            compress = false;
         }
 
         bool success = true;
@@ -865,7 +1310,7 @@ namespace ix
         // Common case for most message. No fragmentation required.
         if (wireSize < kChunkSize)
         {
-            success = sendFragment(type, true, message_begin, message_end, compress);
+            success = sendFragment(type, true, payload, wireSize, owner, compress);
 
             if (onProgressCallback)
             {
@@ -884,8 +1329,7 @@ namespace ix
             //
             auto steps = wireSize / kChunkSize;
 
-            auto begin = message_begin;
-            auto end = message_end;
+            size_t offset = 0;
 
             for (uint64_t i = 0; i < steps; ++i)
             {
@@ -893,10 +1337,10 @@ namespace ix
                 bool lastStep = (i + 1) == steps;
                 bool fin = lastStep;
 
-                end = begin + kChunkSize;
+                size_t size = kChunkSize;
                 if (lastStep)
                 {
-                    end = message_end;
+                    size = wireSize - offset;
                 }
 
                 auto opcodeType = type;
@@ -906,7 +1350,7 @@ namespace ix
                 }
 
                 // Send message
-                if (!sendFragment(opcodeType, fin, begin, end, compress))
+                if (!sendFragment(opcodeType, fin, payload + offset, size, owner, compress))
                 {
                     return WebSocketSendInfo(false);
                 }
@@ -916,7 +1360,7 @@ namespace ix
                     break;
                 }
 
-                begin += kChunkSize;
+                offset += kChunkSize;
             }
         }
 
@@ -935,26 +1379,23 @@ namespace ix
         return WebSocketSendInfo(success, compressionError, payloadSize, wireSize);
     }
 
-    template<class Iterator>
-    bool WebSocketTransport::sendFragment(wsheader_type::opcode_type type,
-                                          bool fin,
-                                          Iterator message_begin,
-                                          Iterator message_end,
-                                          bool compress)
+    bool WebSocketTransport::shouldCompress(const IXWebSocketSendData& message) const
     {
-        uint64_t message_size = static_cast<uint64_t>(message_end - message_begin);
+        if (message.size() < _compressionThreshold) return false;
 
-        unsigned x = getRandomUnsigned();
-        uint8_t masking_key[4] = {};
-        masking_key[0] = (x >> 24);
-        masking_key[1] = (x >> 16) & 0xff;
-        masking_key[2] = (x >> 8) & 0xff;
-        masking_key[3] = (x) &0xff;
+        return !_enableCompressionProbe ||
+               !WebSocketPerMessageDeflateCompressor::isIncompressible(message.data(),
+                                                                       message.size());
+    }
 
-        std::vector<uint8_t> header;
-        header.assign(2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) +
-                          (_useMask ? 4 : 0),
-                      0);
+    size_t WebSocketTransport::encodeFrameHeader(uint8_t* header,
+                                                 wsheader_type::opcode_type type,
+                                                 bool fin,
+                                                 bool compress,
+                                                 uint64_t message_size,
+                                                 bool useMask,
+                                                 const uint8_t* masking_key)
+    {
         header[0] = type;
 
         // The fin bit indicate that this is the last fragment. Fin is French for end.
@@ -972,9 +1413,9 @@ namespace ix
 
         if (message_size < 126)
         {
-            header[1] = (message_size & 0xff) | (_useMask ? 0x80 : 0);
+            header[1] = (message_size & 0xff) | (useMask ? 0x80 : 0);
 
-            if (_useMask)
+            if (useMask)
             {
                 header[2] = masking_key[0];
                 header[3] = masking_key[1];
@@ -984,11 +1425,11 @@ namespace ix
         }
         else if (message_size < 65536)
         {
-            header[1] = 126 | (_useMask ? 0x80 : 0);
+            header[1] = 126 | (useMask ? 0x80 : 0);
             header[2] = (message_size >> 8) & 0xff;
             header[3] = (message_size >> 0) & 0xff;
 
-            if (_useMask)
+            if (useMask)
             {
                 header[4] = masking_key[0];
                 header[5] = masking_key[1];
@@ -998,7 +1439,7 @@ namespace ix
         }
         else
         { // TODO: run coverage testing here
-            header[1] = 127 | (_useMask ? 0x80 : 0);
+            header[1] = 127 | (useMask ? 0x80 : 0);
             header[2] = (message_size >> 56) & 0xff;
             header[3] = (message_size >> 48) & 0xff;
             header[4] = (message_size >> 40) & 0xff;
@@ -1008,7 +1449,7 @@ namespace ix
             header[8] = (message_size >> 8) & 0xff;
             header[9] = (message_size >> 0) & 0xff;
 
-            if (_useMask)
+            if (useMask)
             {
                 header[10] = masking_key[0];
                 header[11] = masking_key[1];
@@ -1017,11 +1458,107 @@ namespace ix
             }
         }
 
+
+        return 2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) +
+               (useMask ? 4 : 0);
+    }
+
+    bool WebSocketTransport::sendFragment(wsheader_type::opcode_type type,
+                                          bool fin,
+                                          const char* payload,
+                                          size_t payloadSize,
+                                          const std::shared_ptr<const void>& owner,
+                                          bool compress)
+    {
+        unsigned x = getRandomUnsigned();
+        uint8_t masking_key[4] = {};
+        masking_key[0] = (x >> 24);
+        masking_key[1] = (x >> 16) & 0xff;
+        masking_key[2] = (x >> 8) & 0xff;
+        masking_key[3] = (x) &0xff;
+
+        SendFrame frame;
+        frame.headerSize = encodeFrameHeader(
+            &frame.header[0], type, fin, compress, payloadSize, _useMask, masking_key);
+        frame.payload = payload;
+        frame.payloadSize = payloadSize;
+        frame.owner = owner;
+        frame.sent = 0;
+
+        std::lock_guard<std::mutex> lock(_txbufMutex);
+
         // _txbuf will keep growing until it can be transmitted over the socket:
-        appendToSendBuffer(header, message_begin, message_end, message_size, masking_key);
+        appendToSendBuffer(frame, masking_key);
+
+        // Now actually send this data, and keep a copy of what could not be sent
+        bool success = sendQueuedFrames();
+        detachBorrowedPayload();
+
+        return success;
+    }
+
+    std::shared_ptr<const std::string> WebSocketTransport::encodeFrame(
+        const IXWebSocketSendData& payload, bool binary, bool compressed)
+    {
+        auto type = binary ? wsheader_type::BINARY_FRAME : wsheader_type::TEXT_FRAME;
+
+        std::array<uint8_t, 14> header;
+        size_t headerSize =
+            encodeFrameHeader(&header[0], type, true, compressed, payload.size(), false, nullptr);
+
+        auto frame = std::make_shared<std::string>();
+        frame->reserve(headerSize + payload.size());
+        frame->append((const char*) &header[0], headerSize);
+        frame->append(payload.data(), payload.size());
+        return frame;
+    }
+
+    uint8_t WebSocketTransport::getEncodedFrameCompressionBits() const
+    {
+        // Without context takeover, the compressor is reset after each message, so
+        // other compressed messages can be sent in between. Broadcast messages are
+        // not compressed with zstd.
+        if (!_enablePerMessageDeflate || _perMessageDeflateOptions.isZstdEnabled() ||
+            !_perMessageDeflateOptions.getServerNoContextTakeover())
+        {
+            return 0;
+        }
+
+        // Same window as the one used by our own compressor, broadcast is server side
+        return _perMessageDeflateOptions.getServerMaxWindowBits();
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendEncodedFrame(
+        const std::shared_ptr<const std::string>& frame, size_t payloadSize)
+    {
+        if (_readyState != ReadyState::OPEN || _useMask || !frame)
+        {
+            return WebSocketSendInfo(false);
+        }
 
-        // Now actually send this data
-        return sendOnSocket();
+        SendFrame sendFrame;
+        sendFrame.headerSize = 0;
+        sendFrame.payload = frame->data();
+        sendFrame.payloadSize = frame->size();
+        sendFrame.owner = frame;
+        sendFrame.sent = 0;
+
+        bool success = true;
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            _txbufSize += sendFrame.payloadSize;
+            _txbuf.push_back(std::move(sendFrame));
+            success = sendQueuedFrames();
+        }
+
+        // Unlike sendData, do not wait for a slow connection to be flushed, the polling
+        // thread takes care of it
+        if (success && !isSendBufferEmpty())
+        {
+            wakeUpFromPoll(SelectInterrupt::kSendRequest);
+        }
+
+        return WebSocketSendInfo(success, false, payloadSize, frame->size());
     }
 
     WebSocketSendInfo WebSocketTransport::sendPing(const IXWebSocketSendData& message)
@@ -1057,13 +1594,41 @@ namespace ix
     bool WebSocketTransport::sendOnSocket()
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
+        return sendQueuedFrames();
+    }
 
-        while (_txbuf.size())
+    // Must be called with _txbufMutex held
+    bool WebSocketTransport::sendQueuedFrames()
+    {
+        while (!_txbuf.empty())
         {
+            // Gather the headers and payloads of as many frames as possible
+            SendBuffer buffers[Socket::kMaxSendBuffers];
+            size_t count = 0;
+            for (auto it = _txbuf.begin();
+                 it != _txbuf.end() && count + 2 <= Socket::kMaxSendBuffers;
+                 ++it)
+            {
+                if (it->sent < it->headerSize)
+                {
+                    buffers[count].data = (const char*) &it->header[it->sent];
+                    buffers[count].size = it->headerSize - it->sent;
+                    count++;
+                }
+
+                size_t payloadSent = (it->sent > it->headerSize) ? it->sent - it->headerSize : 0;
+                if (payloadSent < it->payloadSize)
+                {
+                    buffers[count].data = it->payload + payloadSent;
+                    buffers[count].size = it->payloadSize - payloadSent;
+                    count++;
+                }
+            }
+
             ssize_t ret = 0;
             {
                 std::lock_guard<std::mutex> lock(_socketMutex);
-                ret = _socket->send((char*) &_txbuf[0], _txbuf.size());
+                ret = _socket->send(buffers, count);
             }
 
             if (ret < 0 && Socket::isWaitNeeded())
@@ -1081,7 +1646,23 @@ namespace ix
             }
             else
             {
-                _txbuf.erase(_txbuf.begin(), _txbuf.begin() + ret);
+                // Release the frames which were fully sent
+                size_t sent = (size_t) ret;
+                _txbufSize -= sent;
+
+                while (sent > 0)
+                {
+                    SendFrame& frame = _txbuf.front();
+                    size_t remaining = frame.headerSize + frame.payloadSize - frame.sent;
+                    if (sent < remaining)
+                    {
+                        frame.sent += sent;
+                        break;
+                    }
+
+                    sent -= remaining;
+                    _txbuf.pop_front();
+                }
             }
         }
 
@@ -1090,9 +1671,26 @@ namespace ix
 
     bool WebSocketTransport::receiveFromSocket()
     {
+        // Reclaim the space used by the frames processed during the last dispatch
+        compactReceiveBuffer();
+
         while (true)
         {
-            ssize_t ret = _socket->recv((char*) &_readbuf[0], _readbuf.size());
+            // Streamed and discarded messages are not buffered as a whole
+            if ((_enableMessageStreaming || _discardingMessage) &&
+                _rxbufEnd - _rxbufStart >= kMaxStreamedReceiveSize)
+            {
+                _receiveBufferFull = true;
+                break;
+            }
+
+            // Receive straight into the free space at the end of the buffer
+            if (_rxbuf.size() - _rxbufEnd < kChunkSize)
+            {
+                _rxbuf.resize(_rxbufEnd + kChunkSize);
+            }
+
+            ssize_t ret = _socket->recv((char*) &_rxbuf[_rxbufEnd], _rxbuf.size() - _rxbufEnd);
 
             if (ret < 0 && Socket::isWaitNeeded())
             {
@@ -1109,7 +1707,7 @@ namespace ix
             }
             else
             {
-                _rxbuf.insert(_rxbuf.end(), _readbuf.begin(), _readbuf.begin() + ret);
+                _rxbufEnd += (size_t) ret;
             }
         }
 
@@ -1216,7 +1814,7 @@ namespace ix
     size_t WebSocketTransport::bufferedAmount() const
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
-        return _txbuf.size();
+        return _txbufSize;
     }
 
     bool WebSocketTransport::flushSendBuffer()
@@ -10,6 +10,7 @@
 // Adapted from https://github.com/dhbaird/easywsclient
 //
 
+#include "IXBufferPool.h"
 #include "IXCancellationRequest.h"
 #include "IXProgressCallback.h"
 #include "IXSocketTLSOptions.h"
@@ -20,8 +21,10 @@
 #include "IXWebSocketPerMessageDeflateOptions.h"
 #include "IXWebSocketSendData.h"
 #include "IXWebSocketSendInfo.h"
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
@@ -31,6 +34,8 @@
 
 namespace ix
 {
+    class Utf8Validator;
+
     class Socket;
 
     enum class SendMessageKind
@@ -67,17 +72,33 @@ namespace ix
             CannotFlushSendBuffer
         };
 
-        using OnMessageCallback =
-            std::function<void(const std::string&, size_t, bool, MessageKind)>;
+        // The message is owned by the transport until the callback returns, the callback
+        // can move it out
+        using OnMessageCallback = std::function<void(std::string&, size_t, bool, MessageKind)>;
+
+        // Streaming mode: part of a data message, at offset in the (decompressed) message
+        using OnMessagePartCallback = std::function<void(const std::string& part,
+                                                         size_t wireSize,
+                                                         bool decompressionError,
+                                                         bool binary,
+                                                         uint64_t offset,
+                                                         bool last)>;
         using OnCloseCallback = std::function<void(uint16_t, const std::string&, size_t, bool)>;
 
         WebSocketTransport();
         ~WebSocketTransport();
 
+        // Data messages larger than maxMessageSize (0 for no limit) close the connection.
+        // With enableMessageStreaming, data messages are passed to the message part
+        // callback of dispatch as they are received, instead of being reassembled.
         void configure(const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions,
                        const SocketTLSOptions& socketTLSOptions,
                        bool enablePong,
-                       int pingIntervalSecs);
+                       int pingIntervalSecs,
+                       size_t maxMessageSize = 0,
+                       bool enableMessageStreaming = false,
+                       size_t compressionThreshold = 0,
+                       bool enableCompressionProbe = true);
 
         // Client
         WebSocketInitResult connectToUrl(const std::string& url,
@@ -90,13 +111,34 @@ namespace ix
                                             bool enablePerMessageDeflate,
                                             HttpRequestPtr request = nullptr);
 
-        PollResult poll();
+        // blocking is false when driven by the server event loop
+        PollResult poll(bool blocking = true);
+
+        // Server sends wait for the data to be flushed by default. Without it, the data
+        // left to send is flushed by poll.
+        void disableBlockingSend();
+
+        // True when a ping needs to be sent or the closing delay has expired,
+        // e.g. when poll should be called even if the socket has no activity
+        bool hasPendingTimeout();
+
         WebSocketSendInfo sendBinary(const IXWebSocketSendData& message,
                                      const OnProgressCallback& onProgressCallback);
         WebSocketSendInfo sendText(const IXWebSocketSendData& message,
                                    const OnProgressCallback& onProgressCallback);
         WebSocketSendInfo sendPing(const IXWebSocketSendData& message);
 
+        // Server broadcast: an unmasked frame is encoded once, and queued as is on
+        // many connections. Compressed frames can only be shared with connections whose
+        // deflate compressor does not use context takeover; the window bits to compress
+        // with are returned, 0 meaning that only uncompressed frames can be sent.
+        static std::shared_ptr<const std::string> encodeFrame(const IXWebSocketSendData& payload,
+                                                              bool binary,
+                                                              bool compressed);
+        uint8_t getEncodedFrameCompressionBits() const;
+        WebSocketSendInfo sendEncodedFrame(const std::shared_ptr<const std::string>& frame,
+                                           size_t payloadSize);
+
         void close(uint16_t code = WebSocketCloseConstants::kNormalClosureCode,
                    const std::string& reason = WebSocketCloseConstants::kNormalClosureMessage,
                    size_t closeWireSize = 0,
@@ -107,9 +149,18 @@ namespace ix
         ReadyState getReadyState() const;
         void setReadyState(ReadyState readyState);
         void setOnCloseCallback(const OnCloseCallback& onCloseCallback);
-        void dispatch(PollResult pollResult, const OnMessageCallback& onMessageCallback);
+        void dispatch(PollResult pollResult,
+                      const OnMessageCallback& onMessageCallback,
+                      const OnMessagePartCallback& onMessagePartCallback = nullptr);
         size_t bufferedAmount() const;
 
+        // Recycles the buffers of the received frames, decompressed messages and
+        // queued frames
+        const BufferPoolPtr& getBufferPool() const;
+
+        // zlib states allocated by this connection
+        WebSocketPerMessageDeflateStats getPerMessageDeflateStats() const;
+
         // set ping heartbeat message
         void setPingMessage(const std::string& message, SendMessageKind pingType);
 
@@ -150,18 +201,46 @@ namespace ix
         // saying that a send is complete. This is the mode for server code.
         std::atomic<bool> _blockingSend;
 
-        // Buffer for reading from our socket. That buffer is never resized.
-        std::vector<uint8_t> _readbuf;
-
-        // Contains all messages that were fetched in the last socket read.
+        // Contains all messages that were fetched from the socket and not processed yet.
         // This could be a mix of control messages (Close, Ping, etc...) and
-        // data messages. That buffer is resized
+        // data messages. Data is received in place after _rxbufEnd, and frames are
+        // parsed in place from _rxbufStart. Consumed bytes are reclaimed at most
+        // once per poll, by moving the pending bytes to the front of the buffer.
         std::vector<uint8_t> _rxbuf;
+        size_t _rxbufStart;
+        size_t _rxbufEnd;
+
+        // Set when frames received during the handshake were moved to _rxbuf, so that
+        // the next poll returns right away to dispatch them
+        std::atomic<bool> _receivedDataPending;
+
+        // Set when receiving stopped before the socket was drained, because enough of a
+        // streamed or discarded message is buffered. The next poll reads without waiting.
+        bool _receiveBufferFull;
+
+        // A frame waiting to be sent. Its payload is either kept alive by owner, or
+        // borrowed from the caller (owner is null) while the frame is being queued.
+        // Borrowed payloads which could not be sent right away are copied before
+        // the send call returns.
+        struct SendFrame
+        {
+            std::array<uint8_t, 14> header;
+            size_t headerSize;
+            const char* payload;
+            size_t payloadSize;
+            std::shared_ptr<const void> owner;
+            size_t sent; // header and payload bytes already written on the socket
+        };
 
-        // Contains all messages that are waiting to be sent
-        std::vector<uint8_t> _txbuf;
+        // Contains all frames that are waiting to be sent, flushed with scatter gather
+        // writes
+        std::deque<SendFrame> _txbuf;
+        size_t _txbufSize;
         mutable std::mutex _txbufMutex;
 
+        // Masked payloads are written there when they can be sent right away
+        std::vector<char> _maskingBuffer;
+
         // Hold fragments for multi-fragments messages in a list. We support receiving very large
         // messages (tested messages up to 700M) and we cannot put them in a single
         // buffer that is resized, as this operation can be slow when a buffer has its
@@ -176,9 +255,35 @@ namespace ix
         // Ditto for whether a message is compressed
         bool _receivedMessageCompressed;
 
+        // Payload size of the data message being received, checked against
+        // _maxMessageSize as soon as the header of each of its frames is received
+        uint64_t _receivedMessageSize;
+        size_t _maxMessageSize;
+
+        // The payload of a data frame can be processed before the whole frame is
+        // received, in streaming mode or when it is discarded. Its header is consumed
+        // first, then its payload as it is received.
+        wsheader_type _partialFrame;
+        uint64_t _partialFrameOffset;
+        uint64_t _partialFrameRemaining;
+
+        // Set when the rest of a data message is dropped, after it was found too large
+        // or invalid
+        bool _discardingMessage;
+
+        // Streaming mode
+        bool _enableMessageStreaming;
+        bool _receivingStreamedMessage;
+        uint64_t _messagePartOffset;
+        std::string _messagePart;
+        std::unique_ptr<Utf8Validator> _utf8Validator;
+
         // Fragments are 32K long
         static constexpr size_t kChunkSize = 1 << 15;
 
+        // Bound on the received data buffered while streaming a message
+        static constexpr size_t kMaxStreamedReceiveSize = 4 * kChunkSize;
+
         // Underlying TCP socket
         std::unique_ptr<Socket> _socket;
         std::mutex _socketMutex;
@@ -198,8 +303,24 @@ namespace ix
         WebSocketPerMessageDeflateOptions _perMessageDeflateOptions;
         std::atomic<bool> _enablePerMessageDeflate;
 
+        // Held when replacing _perMessageDeflate, which stats are read from by other
+        // threads
+        mutable std::mutex _perMessageDeflateMutex;
+        void resetPerMessageDeflate();
+
         std::string _decompressedMessage;
-        std::string _compressedMessage;
+
+        // Compressed messages are written in a buffer shared with the send queue, reused
+        // once the queue is done with it
+        std::shared_ptr<std::string> _compressedMessage;
+
+        // Messages smaller than the threshold, or which look incompressible, are sent
+        // uncompressed
+        size_t _compressionThreshold;
+        bool _enableCompressionProbe;
+        bool shouldCompress(const IXWebSocketSendData& message) const;
+
+        BufferPoolPtr _bufferPool;
 
         // Used to control TLS connection behavior
         SocketTLSOptions _socketTLSOptions;
@@ -256,27 +377,57 @@ namespace ix
                                    bool compress,
                                    const OnProgressCallback& onProgressCallback = nullptr);
 
-        template<class Iterator>
-        bool sendFragment(
-            wsheader_type::opcode_type type, bool fin, Iterator begin, Iterator end, bool compress);
+        void takeHandshakeLeftover();
+
+        static size_t encodeFrameHeader(uint8_t* header,
+                                        wsheader_type::opcode_type type,
+                                        bool fin,
+                                        bool compress,
+                                        uint64_t message_size,
+                                        bool useMask,
+                                        const uint8_t* masking_key);
+
+        bool sendFragment(wsheader_type::opcode_type type,
+                          bool fin,
+                          const char* payload,
+                          size_t payloadSize,
+                          const std::shared_ptr<const void>& owner,
+                          bool compress);
 
         void emitMessage(MessageKind messageKind,
-                         const std::string& message,
+                         std::string& message,
                          bool compressedMessage,
                          const OnMessageCallback& onMessageCallback);
 
+        // Consume the header of a data frame, whose payload is then processed in parts
+        void startPartialFrame(const wsheader_type& ws, uint64_t messageSize);
+
+        // Streaming mode: pass a part of the payload of a data message, decompressing it
+        // if needed, then the decompressed data
+        void emitMessagePart(const char* data,
+                             size_t size,
+                             bool last,
+                             const OnMessagePartCallback& onMessagePartCallback);
+        void deliverMessagePart(const char* data,
+                                size_t size,
+                                size_t wireSize,
+                                bool last,
+                                bool decompressionError,
+                                const OnMessagePartCallback& onMessagePartCallback);
+
         bool isSendBufferEmpty() const;
 
-        template<class Iterator>
-        void appendToSendBuffer(const std::vector<uint8_t>& header,
-                                Iterator begin,
-                                Iterator end,
-                                uint64_t message_size,
-                                uint8_t masking_key[4]);
+        void appendToSendBuffer(SendFrame& frame, uint8_t masking_key[4]);
+        bool sendQueuedFrames();
+        void detachBorrowedPayload();
 
         unsigned getRandomUnsigned();
         void unmaskReceiveBuffer(const wsheader_type& ws);
 
+        size_t getReceiveBufferSize() const;
+        void clearReceiveBuffer();
+        void compactReceiveBuffer();
+
         std::string getMergedChunks() const;
 
         void setCloseReason(const std::string& reason);
@@ -0,0 +1,365 @@
+/*
+ *  IXWebSocketZstdCodec.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXWebSocketZstdCodec.h"
+
+#include "IXUniquePtr.h"
+#include <algorithm>
+
+#ifdef IXWEBSOCKET_USE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+namespace
+{
+    const size_t kOutputBufferSize = 1 << 14;
+
+#ifdef IXWEBSOCKET_USE_ZSTD
+    // Raw content dictionaries have no id, both ends hash their content instead
+    uint32_t hashDictionary(const std::string& dictionary)
+    {
+        uint32_t hash = 2166136261u; // FNV-1a
+        for (unsigned char c : dictionary)
+        {
+            hash = (hash ^ c) * 16777619u;
+        }
+        return (hash == 0) ? 1 : hash;
+    }
+#endif
+} // namespace
+
+namespace ix
+{
+    const int WebSocketZstdCodec::kDefaultLevel(3);
+    const size_t WebSocketZstdCodec::kDefaultDictionarySize(32 * 1024);
+    const int WebSocketZstdDecompressor::kMaxWindowLog(23);
+
+    //
+    // Codec
+    //
+    WebSocketZstdCodec::WebSocketZstdCodec(int level)
+        : _level(level)
+        , _dictionaryId(0)
+        , _compressionDictionary(nullptr)
+        , _decompressionDictionary(nullptr)
+    {
+    }
+
+    WebSocketZstdCodec::~WebSocketZstdCodec()
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        ZSTD_freeCDict(_compressionDictionary);
+        ZSTD_freeDDict(_decompressionDictionary);
+#endif
+    }
+
+    std::shared_ptr<WebSocketZstdCodec> WebSocketZstdCodec::create(int level,
+                                                                   const std::string& dictionary)
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        level = std::min(ZSTD_maxCLevel(), std::max(ZSTD_minCLevel(), level));
+        auto codec = std::shared_ptr<WebSocketZstdCodec>(new WebSocketZstdCodec(level));
+        if (dictionary.empty()) return codec;
+
+        codec->_compressionDictionary =
+            ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+        codec->_decompressionDictionary = ZSTD_createDDict(dictionary.data(), dictionary.size());
+        if (codec->_compressionDictionary == nullptr ||
+            codec->_decompressionDictionary == nullptr)
+        {
+            return nullptr;
+        }
+
+        codec->_dictionaryId = ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+        if (codec->_dictionaryId == 0)
+        {
+            codec->_dictionaryId = hashDictionary(dictionary);
+        }
+        return codec;
+#else
+        (void) level;
+        (void) dictionary;
+        return nullptr;
+#endif
+    }
+
+    std::string WebSocketZstdCodec::trainDictionary(const std::vector<std::string>& samples,
+                                                    size_t dictionarySize)
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        std::string content;
+        std::vector<size_t> sampleSizes;
+        sampleSizes.reserve(samples.size());
+        for (auto&& sample : samples)
+        {
+            content += sample;
+            sampleSizes.push_back(sample.size());
+        }
+
+        std::string dictionary(dictionarySize, 0);
+        size_t ret = ZDICT_trainFromBuffer(&dictionary[0],
+                                           dictionary.size(),
+                                           content.data(),
+                                           sampleSizes.data(),
+                                           (unsigned) sampleSizes.size());
+        if (ZDICT_isError(ret)) return std::string();
+
+        dictionary.resize(ret);
+        return dictionary;
+#else
+        (void) samples;
+        (void) dictionarySize;
+        return std::string();
+#endif
+    }
+
+    std::unique_ptr<WebSocketCompressor> WebSocketZstdCodec::createCompressor() const
+    {
+        return ix::make_unique<WebSocketZstdCompressor>(
+            _level, shared_from_this(), _compressionDictionary);
+    }
+
+    std::unique_ptr<WebSocketDecompressor> WebSocketZstdCodec::createDecompressor() const
+    {
+        return ix::make_unique<WebSocketZstdDecompressor>(shared_from_this(),
+                                                          _decompressionDictionary);
+    }
+
+    uint32_t WebSocketZstdCodec::getDictionaryId() const
+    {
+        return _dictionaryId;
+    }
+
+    //
+    // Compressor
+    //
+    WebSocketZstdCompressor::WebSocketZstdCompressor(
+        int level,
+        const std::shared_ptr<const WebSocketZstdCodec>& codec,
+        ZSTD_CDict_s* dictionary)
+        : _level(level)
+        , _codec(codec)
+        , _dictionary(dictionary)
+        , _context(nullptr)
+        , _memory(0)
+    {
+    }
+
+    WebSocketZstdCompressor::~WebSocketZstdCompressor()
+    {
+        release();
+    }
+
+    bool WebSocketZstdCompressor::init(uint8_t /*windowBits*/,
+                                       bool /*noContextTakeOver*/,
+                                       uint8_t /*memLevel*/,
+                                       bool lazy)
+    {
+        release();
+        return lazy || allocate();
+    }
+
+    bool WebSocketZstdCompressor::allocate()
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        _context = ZSTD_createCCtx();
+        if (_context == nullptr) return false;
+
+        // The dictionary was agreed on in the handshake
+        ZSTD_CCtx_setParameter(_context, ZSTD_c_compressionLevel, _level);
+        ZSTD_CCtx_setParameter(_context, ZSTD_c_dictIDFlag, 0);
+        if (_dictionary != nullptr && ZSTD_isError(ZSTD_CCtx_refCDict(_context, _dictionary)))
+        {
+            release();
+            return false;
+        }
+
+        _memory = ZSTD_sizeof_CCtx(_context);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void WebSocketZstdCompressor::release()
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        ZSTD_freeCCtx(_context);
+        _context = nullptr;
+        _memory = 0;
+#endif
+    }
+
+    bool WebSocketZstdCompressor::isAllocated() const
+    {
+        return _context != nullptr;
+    }
+
+    size_t WebSocketZstdCompressor::getMemoryUsage() const
+    {
+        return _memory;
+    }
+
+    bool WebSocketZstdCompressor::compress(const IXWebSocketSendData& in, std::string& out)
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        if (_context == nullptr && !allocate()) return false;
+
+        // Each message is a whole frame, decoded on its own
+        out.resize(ZSTD_compressBound(in.size()));
+        size_t ret = ZSTD_compress2(_context, &out[0], out.size(), in.data(), in.size());
+        if (ZSTD_isError(ret))
+        {
+            out.clear();
+            return false;
+        }
+
+        out.resize(ret);
+
+        // The context grows with the size of the messages
+        _memory = ZSTD_sizeof_CCtx(_context);
+        return true;
+#else
+        (void) in;
+        (void) out;
+        return false;
+#endif
+    }
+
+    //
+    // Decompressor
+    //
+    WebSocketZstdDecompressor::WebSocketZstdDecompressor(
+        const std::shared_ptr<const WebSocketZstdCodec>& codec, ZSTD_DDict_s* dictionary)
+        : _codec(codec)
+        , _dictionary(dictionary)
+        , _context(nullptr)
+        , _frameComplete(true)
+        , _memory(0)
+    {
+    }
+
+    WebSocketZstdDecompressor::~WebSocketZstdDecompressor()
+    {
+        release();
+    }
+
+    bool WebSocketZstdDecompressor::init(uint8_t /*windowBits*/,
+                                         bool /*noContextTakeOver*/,
+                                         bool lazy)
+    {
+        release();
+        return lazy || allocate();
+    }
+
+    bool WebSocketZstdDecompressor::allocate()
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        _context = ZSTD_createDCtx();
+        if (_context == nullptr) return false;
+
+        // A peer cannot make us allocate more than a window of 8MB
+        ZSTD_DCtx_setParameter(_context, ZSTD_d_windowLogMax, kMaxWindowLog);
+        if (_dictionary != nullptr && ZSTD_isError(ZSTD_DCtx_refDDict(_context, _dictionary)))
+        {
+            release();
+            return false;
+        }
+
+        _outputBuffer.resize(kOutputBufferSize);
+        _memory = ZSTD_sizeof_DCtx(_context) + _outputBuffer.capacity();
+        _frameComplete = true;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool WebSocketZstdDecompressor::release()
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        if (_context == nullptr) return false;
+
+        ZSTD_freeDCtx(_context);
+        _context = nullptr;
+        std::vector<char>().swap(_outputBuffer);
+        _memory = 0;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void WebSocketZstdDecompressor::resetFrame()
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        // The next message starts a new frame
+        ZSTD_DCtx_reset(_context, ZSTD_reset_session_only);
+        _frameComplete = true;
+#endif
+    }
+
+    bool WebSocketZstdDecompressor::isAllocated() const
+    {
+        return _context != nullptr;
+    }
+
+    size_t WebSocketZstdDecompressor::getMemoryUsage() const
+    {
+        return _memory;
+    }
+
+    bool WebSocketZstdDecompressor::decompress(const char* in,
+                                               size_t size,
+                                               bool fin,
+                                               const OnOutputCallback& onOutput)
+    {
+#ifdef IXWEBSOCKET_USE_ZSTD
+        if (_context == nullptr && !allocate()) return false;
+
+        ZSTD_inBuffer input = {in, size, 0};
+        bool outputFull = false;
+
+        while (input.pos < input.size || outputFull)
+        {
+            ZSTD_outBuffer output = {&_outputBuffer[0], _outputBuffer.size(), 0};
+
+            size_t ret = ZSTD_decompressStream(_context, &output, &input);
+            if (ZSTD_isError(ret))
+            {
+                resetFrame();
+                return false;
+            }
+
+            _frameComplete = (ret == 0);
+            outputFull = (output.pos == output.size);
+
+            if (output.pos > 0 && !onOutput(&_outputBuffer[0], output.pos))
+            {
+                resetFrame();
+                return false;
+            }
+        }
+
+        _memory = ZSTD_sizeof_DCtx(_context) + _outputBuffer.capacity();
+
+        // A truncated frame is an error
+        if (fin && !_frameComplete)
+        {
+            resetFrame();
+            return false;
+        }
+        return true;
+#else
+        (void) in;
+        (void) size;
+        (void) fin;
+        (void) onOutput;
+        return false;
+#endif
+    }
+} // namespace ix
@@ -0,0 +1,122 @@
+/*
+ *  IXWebSocketZstdCodec.h
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ *
+ *  Codec of the x-permessage-zstd extension, which is only understood by IXWebSocket
+ *  peers. Each message is compressed as a zstd frame, optionally with a dictionary
+ *  shared by both ends, and is decoded on its own. Only available when built with zstd
+ *  (USE_ZSTD).
+ */
+
+#pragma once
+
+#include "IXWebSocketCompressionCodec.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace ix
+{
+    class WebSocketZstdCodec final : public WebSocketCompressionCodec,
+                                     public std::enable_shared_from_this<WebSocketZstdCodec>
+    {
+    public:
+        ~WebSocketZstdCodec();
+
+        // A dictionary is typically trained with trainDictionary on recorded messages.
+        // Returns nullptr if the dictionary is invalid, or without zstd support.
+        static std::shared_ptr<WebSocketZstdCodec> create(
+            int level = kDefaultLevel, const std::string& dictionary = std::string());
+
+        // Returns an empty dictionary if the samples are too few or too small
+        static std::string trainDictionary(const std::vector<std::string>& samples,
+                                           size_t dictionarySize = kDefaultDictionarySize);
+
+        std::unique_ptr<WebSocketCompressor> createCompressor() const final;
+        std::unique_ptr<WebSocketDecompressor> createDecompressor() const final;
+
+        // Identifies the dictionary in the handshake, 0 without dictionary
+        uint32_t getDictionaryId() const;
+
+        const static int kDefaultLevel;
+        const static size_t kDefaultDictionarySize;
+
+    private:
+        WebSocketZstdCodec(int level);
+
+        int _level;
+        uint32_t _dictionaryId;
+
+        // Shared by all the connections, they are read only once created
+        ZSTD_CDict_s* _compressionDictionary;
+        ZSTD_DDict_s* _decompressionDictionary;
+    };
+
+    class WebSocketZstdCompressor final : public WebSocketCompressor
+    {
+    public:
+        WebSocketZstdCompressor(int level,
+                                const std::shared_ptr<const WebSocketZstdCodec>& codec,
+                                ZSTD_CDict_s* dictionary);
+        ~WebSocketZstdCompressor();
+
+        // The window size and memory level of permessage-deflate do not apply
+        bool init(uint8_t windowBits, bool noContextTakeOver, uint8_t memLevel, bool lazy) final;
+        bool compress(const IXWebSocketSendData& in, std::string& out) final;
+
+        void release() final;
+        bool isAllocated() const final;
+        size_t getMemoryUsage() const final;
+
+    private:
+        bool allocate();
+
+        int _level;
+        std::shared_ptr<const WebSocketZstdCodec> _codec; // owns the dictionary
+        ZSTD_CDict_s* _dictionary;
+        ZSTD_CCtx_s* _context;
+        std::atomic<size_t> _memory;
+    };
+
+    class WebSocketZstdDecompressor final : public WebSocketDecompressor
+    {
+    public:
+        WebSocketZstdDecompressor(const std::shared_ptr<const WebSocketZstdCodec>& codec,
+                                  ZSTD_DDict_s* dictionary);
+        ~WebSocketZstdDecompressor();
+
+        bool init(uint8_t windowBits, bool noContextTakeOver, bool lazy) final;
+        bool decompress(const char* in,
+                        size_t size,
+                        bool fin,
+                        const OnOutputCallback& onOutput) final;
+
+        // Messages do not refer to the previous ones, so the state can always be freed
+        // between messages
+        bool release() final;
+        bool isAllocated() const final;
+        size_t getMemoryUsage() const final;
+
+        // Bound on the window of the frames, which sizes the state of the decompressor
+        const static int kMaxWindowLog;
+
+    private:
+        bool allocate();
+        void resetFrame();
+
+        std::shared_ptr<const WebSocketZstdCodec> _codec;
+        ZSTD_DDict_s* _dictionary;
+        ZSTD_DCtx_s* _context;
+        bool _frameComplete;
+        std::atomic<size_t> _memory;
+        std::vector<char> _outputBuffer;
+    };
+} // namespace ix
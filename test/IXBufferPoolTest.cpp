@@ -0,0 +1,133 @@
+/*
+ *  IXBufferPoolTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "catch.hpp"
+#include <atomic>
+#include <ixwebsocket/IXBufferPool.h>
+#include <thread>
+
+using namespace ix;
+
+namespace
+{
+    class CountingAllocator : public BufferAllocator
+    {
+    public:
+        std::string allocate(size_t capacity) final
+        {
+            allocations++;
+            return BufferAllocator::allocate(capacity);
+        }
+
+        void deallocate(std::string&& buffer) final
+        {
+            deallocations++;
+            BufferAllocator::deallocate(std::move(buffer));
+        }
+
+        std::atomic<int> allocations {0};
+        std::atomic<int> deallocations {0};
+    };
+} // namespace
+
+TEST_CASE("buffer_pool", "[buffer_pool]")
+{
+    SECTION("Buffers are reused by size class")
+    {
+        auto pool = std::make_shared<BufferPool>();
+
+        std::string buffer = pool->acquire(1000);
+        REQUIRE(buffer.empty());
+        REQUIRE(buffer.capacity() >= 1024);
+        buffer.assign(1000, 'a');
+        const char* data = buffer.data();
+        pool->release(std::move(buffer));
+
+        auto stats = pool->getStats();
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.buffers == 1);
+
+        // Same class, and up to 4 times smaller
+        buffer = pool->acquire(600);
+        REQUIRE(buffer.empty());
+        REQUIRE(buffer.data() == data);
+        pool->release(std::move(buffer));
+
+        buffer = pool->acquire(256);
+        REQUIRE(buffer.data() == data);
+        pool->release(std::move(buffer));
+
+        // Too small to use a 1K buffer, or too large
+        std::string small = pool->acquire(100);
+        std::string large = pool->acquire(2000);
+        REQUIRE(small.capacity() < 1024);
+        REQUIRE(large.capacity() >= 2000);
+
+        stats = pool->getStats();
+        REQUIRE(stats.hits == 2);
+        REQUIRE(stats.misses == 3);
+        REQUIRE(stats.buffers == 1);
+
+        // Small strings do not allocate, and are not counted
+        std::string tiny = pool->acquire(4);
+        pool->release(std::move(tiny));
+        REQUIRE(pool->getStats().hits == 2);
+        REQUIRE(pool->getStats().misses == 3);
+    }
+
+    SECTION("The pool size is bounded")
+    {
+        auto allocator = std::make_shared<CountingAllocator>();
+        auto pool = std::make_shared<BufferPool>(8 * 1024);
+        pool->setAllocator(allocator);
+
+        std::vector<std::string> buffers;
+        for (int i = 0; i < 4; ++i)
+        {
+            buffers.push_back(pool->acquire(4 * 1024));
+        }
+        REQUIRE(allocator->allocations == 4);
+
+        for (auto&& buffer : buffers)
+        {
+            pool->release(std::move(buffer));
+        }
+        REQUIRE(pool->getStats().buffers == 2);
+        REQUIRE(pool->getStats().size == 8 * 1024);
+        REQUIRE(allocator->deallocations == 2);
+
+        // Larger than the largest class
+        pool->release(pool->acquire(4 * 1024 * 1024));
+        REQUIRE(allocator->allocations == 5);
+        REQUIRE(allocator->deallocations == 3);
+
+        pool->setMaxSize(0);
+        REQUIRE(pool->getStats().buffers == 0);
+        REQUIRE(pool->getStats().size == 0);
+        REQUIRE(allocator->deallocations == 5);
+    }
+
+    SECTION("Shared buffers go back to the pool from any thread")
+    {
+        auto pool = std::make_shared<BufferPool>();
+
+        auto shared = pool->share(pool->acquire(10000));
+        shared->assign(10000, 'b');
+        const char* data = shared->data();
+
+        std::thread thread([shared]() mutable { shared.reset(); });
+        shared.reset();
+        thread.join();
+
+        REQUIRE(pool->getStats().buffers == 1);
+        REQUIRE(pool->acquire(10000).data() == data);
+
+        // The buffer is simply freed once the pool is gone
+        shared = pool->share(pool->acquire(10000));
+        pool.reset();
+        shared.reset();
+    }
+}
@@ -0,0 +1,385 @@
+/*
+ *  IXDNSResolverTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include "catch.hpp"
+#include <atomic>
+#include <chrono>
+#include <ixwebsocket/IXDNSLookup.h>
+#include <ixwebsocket/IXDNSResolver.h>
+#include <ixwebsocket/IXNetSystem.h>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketConnect.h>
+#include <map>
+#include <string.h>
+#include <thread>
+
+using namespace ix;
+
+namespace
+{
+    void appendUint16(std::string& message, uint16_t value)
+    {
+        message += (char) (value >> 8);
+        message += (char) (value & 0xff);
+    }
+
+    void appendUint32(std::string& message, uint32_t value)
+    {
+        appendUint16(message, (uint16_t) (value >> 16));
+        appendUint16(message, (uint16_t) (value & 0xffff));
+    }
+
+    std::string encodeName(const std::string& name)
+    {
+        std::string encodedName;
+        std::stringstream ss(name);
+        std::string label;
+        while (std::getline(ss, label, '.'))
+        {
+            encodedName += (char) label.size();
+            encodedName += label;
+        }
+        encodedName += '\0';
+        return encodedName;
+    }
+
+    void appendRecord(std::string& message,
+                      const std::string& name,
+                      uint16_t type,
+                      uint32_t ttl,
+                      const std::string& data)
+    {
+        message += encodeName(name);
+        appendUint16(message, type);
+        appendUint16(message, 1);
+        appendUint32(message, ttl);
+        appendUint16(message, (uint16_t) data.size());
+        message += data;
+    }
+
+    //
+    // Nameserver answering the names of the tests, on the loopback interface
+    //
+    // a.ixwebsocket.test       A 127.0.0.1, TTL of 1s
+    // cname.ixwebsocket.test   CNAME a.ixwebsocket.test
+    // slow.ixwebsocket.test    A 127.0.0.2, answered after 300ms
+    // nodata.ixwebsocket.test  no address, negative TTL of 1s
+    //
+    class TestNameserver
+    {
+    public:
+        TestNameserver()
+            : _port(getFreePort())
+            , _fd(-1)
+            , _stop(false)
+        {
+        }
+
+        ~TestNameserver()
+        {
+            _stop = true;
+            if (_thread.joinable()) _thread.join();
+            if (_fd >= 0) Socket::closeSocket(_fd);
+        }
+
+        bool start()
+        {
+            _fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_fd < 0) return false;
+
+            struct sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_port = htons(_port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(_fd, (struct sockaddr*) &address, sizeof(address)) != 0) return false;
+
+            _thread = std::thread(&TestNameserver::run, this);
+            return true;
+        }
+
+        std::string getAddress() const
+        {
+            return "127.0.0.1:" + std::to_string(_port);
+        }
+
+        // A queries received for a name
+        int getQueryCount(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _queryCounts[name];
+        }
+
+    private:
+        void run()
+        {
+            while (!_stop)
+            {
+                struct pollfd pfd;
+                pfd.fd = _fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                if (ix::poll(&pfd, 1, 10, nullptr) <= 0) continue;
+
+                char buffer[512];
+                struct sockaddr_storage client;
+                socklen_t clientLength = sizeof(client);
+                ssize_t size = recvfrom(
+                    _fd, buffer, sizeof(buffer), 0, (struct sockaddr*) &client, &clientLength);
+                if (size <= 12) continue;
+
+                std::string response = answer(std::string(buffer, size));
+                if (response.empty()) continue;
+
+                sendto(_fd,
+                       response.data(),
+                       response.size(),
+                       0,
+                       (struct sockaddr*) &client,
+                       clientLength);
+            }
+        }
+
+        std::string answer(const std::string& query)
+        {
+            // Question name, right after the header
+            std::string name;
+            size_t pos = 12;
+            while (pos < query.size() && query[pos] != 0)
+            {
+                size_t length = (unsigned char) query[pos];
+                if (!name.empty()) name += '.';
+                name += query.substr(pos + 1, length);
+                pos += 1 + length;
+            }
+            if (pos + 5 > query.size()) return std::string();
+            uint16_t type = (uint16_t) (((unsigned char) query[pos + 1] << 8) |
+                                        (unsigned char) query[pos + 2]);
+
+            std::string records;
+            uint16_t answerCount = 0;
+            uint16_t authorityCount = 0;
+            const std::string localhost("\x7f\x00\x00\x01", 4);
+
+            if (type == 1)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _queryCounts[name]++;
+            }
+
+            if (name == "a.ixwebsocket.test" && type == 1)
+            {
+                appendRecord(records, name, 1, 1, localhost);
+                answerCount = 1;
+            }
+            else if (name == "cname.ixwebsocket.test")
+            {
+                appendRecord(records, name, 5, 30, encodeName("a.ixwebsocket.test"));
+                answerCount = 1;
+                if (type == 1)
+                {
+                    appendRecord(records, "a.ixwebsocket.test", 1, 30, localhost);
+                    answerCount = 2;
+                }
+            }
+            else if (name == "slow.ixwebsocket.test" && type == 1)
+            {
+                ix::msleep(300);
+                appendRecord(records, name, 1, 30, std::string("\x7f\x00\x00\x02", 4));
+                answerCount = 1;
+            }
+            else
+            {
+                // No address, with the SOA record of the zone
+                std::string soa = encodeName("ns.ixwebsocket.test") +
+                                  encodeName("admin.ixwebsocket.test");
+                appendUint32(soa, 1);    // serial
+                appendUint32(soa, 3600); // refresh
+                appendUint32(soa, 600);  // retry
+                appendUint32(soa, 3600); // expire
+                appendUint32(soa, 1);    // minimum
+                appendRecord(records, "ixwebsocket.test", 6, 30, soa);
+                authorityCount = 1;
+            }
+
+            std::string response = query.substr(0, 2);
+            appendUint16(response, 0x8180); // response, recursion available
+            appendUint16(response, 1);
+            appendUint16(response, answerCount);
+            appendUint16(response, authorityCount);
+            appendUint16(response, 0);
+            response += query.substr(12, pos + 5 - 12);
+            response += records;
+            return response;
+        }
+
+        int _port;
+        int _fd;
+        std::atomic<bool> _stop;
+        std::thread _thread;
+        std::mutex _mutex;
+        std::map<std::string, int> _queryCounts;
+    };
+
+    std::string getAddress(const DNSResolver::AddrInfoPtr& res)
+    {
+        char str[INET_ADDRSTRLEN];
+        auto address = reinterpret_cast<struct sockaddr_in*>(res->ai_addr);
+        ix::inet_ntop(AF_INET, &address->sin_addr, str, INET_ADDRSTRLEN);
+        return std::string(str) + ":" + std::to_string(ntohs(address->sin_port));
+    }
+
+    const CancellationRequest kNotCancelled = [] { return false; };
+} // namespace
+
+TEST_CASE("dns_resolver", "[net]")
+{
+    TestNameserver nameserver;
+    REQUIRE(nameserver.start());
+
+    DNSResolver resolver;
+    resolver.setNameservers({nameserver.getAddress()});
+    resolver.setQueryTimeout(1000);
+
+    std::string errMsg;
+
+    SECTION("Addresses are cached for the TTL of the records")
+    {
+        auto res = resolver.resolve("a.ixwebsocket.test", 8008, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(getAddress(res) == "127.0.0.1:8008");
+        REQUIRE(nameserver.getQueryCount("a.ixwebsocket.test") == 1);
+
+        // The port is not part of the cache key, and the case of names does not matter
+        res = resolver.resolve("A.IXWebSocket.test", 443, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(getAddress(res) == "127.0.0.1:443");
+        REQUIRE(nameserver.getQueryCount("a.ixwebsocket.test") == 1);
+        REQUIRE(resolver.getStats().cacheHits == 1);
+        REQUIRE(resolver.getStats().nameserverQueries == 1);
+
+        ix::msleep(1100);
+        res = resolver.resolve("a.ixwebsocket.test", 8008, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(nameserver.getQueryCount("a.ixwebsocket.test") == 2);
+    }
+
+    SECTION("The absence of addresses is cached for the TTL of the SOA record")
+    {
+        auto res = resolver.resolve("nodata.ixwebsocket.test", 80, errMsg, kNotCancelled);
+        REQUIRE(res == nullptr);
+        REQUIRE(errMsg != "no error");
+
+        res = resolver.resolve("nodata.ixwebsocket.test", 80, errMsg, kNotCancelled, false);
+        REQUIRE(res == nullptr);
+        REQUIRE(nameserver.getQueryCount("nodata.ixwebsocket.test") == 1);
+
+        ix::msleep(1100);
+        res = resolver.resolve("nodata.ixwebsocket.test", 80, errMsg, kNotCancelled);
+        REQUIRE(res == nullptr);
+        REQUIRE(nameserver.getQueryCount("nodata.ixwebsocket.test") == 2);
+    }
+
+    SECTION("CNAME records are followed")
+    {
+        auto res = resolver.resolve("cname.ixwebsocket.test", 80, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(getAddress(res) == "127.0.0.1:80");
+        REQUIRE(res->ai_next == nullptr);
+    }
+
+    SECTION("Concurrent lookups of the same host are coalesced")
+    {
+        std::vector<std::thread> threads;
+        std::atomic<int> resolved(0);
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&resolver, &resolved] {
+                std::string threadErrMsg;
+                auto res =
+                    resolver.resolve("slow.ixwebsocket.test", 80, threadErrMsg, kNotCancelled);
+                if (res != nullptr && getAddress(res) == "127.0.0.2:80") resolved++;
+            });
+        }
+        for (auto&& thread : threads)
+        {
+            thread.join();
+        }
+
+        REQUIRE(resolved == 4);
+        REQUIRE(nameserver.getQueryCount("slow.ixwebsocket.test") == 1);
+        REQUIRE(resolver.getStats().coalescedLookups == 3);
+    }
+
+    SECTION("Cancelled lookups return right away, and still fill the cache")
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto cancelled = [start] {
+            return std::chrono::steady_clock::now() - start > std::chrono::milliseconds(50);
+        };
+
+        auto res = resolver.resolve("slow.ixwebsocket.test", 80, errMsg, cancelled);
+        auto duration = std::chrono::steady_clock::now() - start;
+        REQUIRE(res == nullptr);
+        REQUIRE(errMsg == "cancellation requested");
+        REQUIRE(duration < std::chrono::milliseconds(250));
+        REQUIRE(resolver.getStats().cancelledLookups == 1);
+
+        ix::msleep(500);
+        res = resolver.resolve("slow.ixwebsocket.test", 80, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(nameserver.getQueryCount("slow.ixwebsocket.test") == 1);
+        REQUIRE(resolver.getStats().cacheHits == 1);
+    }
+
+    SECTION("Numeric hosts are not looked up")
+    {
+        auto res = resolver.resolve("127.0.0.3", 80, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(getAddress(res) == "127.0.0.3:80");
+        REQUIRE(resolver.getStats().lookups == 0);
+    }
+
+    SECTION("DNSLookup uses the process wide resolver")
+    {
+        DNSResolver::getInstance().setNameservers({nameserver.getAddress()});
+
+        auto dnsLookup = std::make_shared<DNSLookup>("cname.ixwebsocket.test", 9000);
+        auto res = dnsLookup->resolve(errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(getAddress(res) == "127.0.0.1:9000");
+
+        DNSResolver::getInstance().setNameservers({});
+        DNSResolver::getInstance().clearCache();
+    }
+
+    SECTION("Hosts are looked up again after a failed connection")
+    {
+        auto res = resolver.resolve("a.ixwebsocket.test", 80, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        resolver.invalidate("A.ixwebsocket.test");
+        res = resolver.resolve("a.ixwebsocket.test", 80, errMsg, kNotCancelled);
+        REQUIRE(res != nullptr);
+        REQUIRE(nameserver.getQueryCount("a.ixwebsocket.test") == 2);
+        REQUIRE(resolver.getStats().cacheHits == 0);
+
+        // Nothing listens on this port
+        DNSResolver::getInstance().setNameservers({nameserver.getAddress()});
+        int port = getFreePort();
+
+        int fd = SocketConnect::connect("a.ixwebsocket.test", port, errMsg, kNotCancelled);
+        REQUIRE(fd == -1);
+        REQUIRE(nameserver.getQueryCount("a.ixwebsocket.test") == 3);
+
+        fd = SocketConnect::connect("a.ixwebsocket.test", port, errMsg, kNotCancelled);
+        REQUIRE(fd == -1);
+        REQUIRE(nameserver.getQueryCount("a.ixwebsocket.test") == 4);
+
+        DNSResolver::getInstance().setNameservers({});
+        DNSResolver::getInstance().clearCache();
+    }
+}
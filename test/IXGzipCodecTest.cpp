@@ -0,0 +1,138 @@
+/*
+ *  IXGzipCodecTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "catch.hpp"
+#include <algorithm>
+#include <ixwebsocket/IXGzipCodec.h>
+#include <ixwebsocket/IXHttpBodySource.h>
+
+using namespace ix;
+
+namespace
+{
+    std::string makeText(size_t size)
+    {
+        std::string text;
+        for (int i = 0; text.size() < size; ++i)
+        {
+            text += "line " + std::to_string(i) + "\n";
+        }
+        text.resize(size);
+        return text;
+    }
+
+    // Pass the input to the stream in pieces of pieceSize bytes
+    bool runStream(GzipStream& stream,
+                   const std::string& input,
+                   size_t pieceSize,
+                   std::string& output,
+                   size_t& maxChunkSize)
+    {
+        auto append = [&](const char* data, size_t size) -> bool {
+            output.append(data, size);
+            maxChunkSize = std::max(maxChunkSize, size);
+            return true;
+        };
+
+        for (size_t offset = 0; offset < input.size(); offset += pieceSize)
+        {
+            size_t size = std::min(pieceSize, input.size() - offset);
+            if (!stream.write(input.data() + offset, size, append)) return false;
+        }
+        return stream.finish(append);
+    }
+} // namespace
+
+TEST_CASE("gzip-codec", "[gzip]")
+{
+    SECTION("One-shot helpers")
+    {
+        for (size_t size : {0, 1, 100, 1000 * 1000})
+        {
+            std::string text = makeText(size);
+            std::string compressed = gzipCompress(text);
+            REQUIRE(!compressed.empty());
+
+            std::string decompressed;
+            REQUIRE(gzipDecompress(compressed, decompressed));
+            REQUIRE(decompressed == text);
+        }
+
+        // Truncated or invalid input
+        std::string compressed = gzipCompress(makeText(1000));
+        std::string decompressed;
+        REQUIRE(!gzipDecompress(compressed.substr(0, compressed.size() / 2), decompressed));
+        REQUIRE(!gzipDecompress("not gzip", decompressed));
+    }
+
+    SECTION("Streams emit bounded chunks and are reusable")
+    {
+        GzipStream compressor(GzipStream::Mode::Compress);
+        GzipStream decompressor(GzipStream::Mode::Decompress);
+
+        // The same streams are used for several bodies, with various piece sizes
+        for (size_t pieceSize : {1, 1000, 100 * 1000})
+        {
+            std::string text = makeText(1000 * 1000);
+
+            REQUIRE(compressor.reset());
+            std::string compressed;
+            size_t maxChunkSize = 0;
+            REQUIRE(runStream(compressor, text, pieceSize, compressed, maxChunkSize));
+            REQUIRE(maxChunkSize <= GzipStream::kChunkSize);
+            REQUIRE(compressor.isFinished());
+
+            REQUIRE(decompressor.reset());
+            std::string decompressed;
+            maxChunkSize = 0;
+            REQUIRE(runStream(decompressor, compressed, pieceSize, decompressed, maxChunkSize));
+            REQUIRE(maxChunkSize <= GzipStream::kChunkSize);
+            REQUIRE(decompressed == text);
+
+            // Compatible with the one-shot helpers
+            std::string oneShot;
+            REQUIRE(gzipDecompress(compressed, oneShot));
+            REQUIRE(oneShot == text);
+        }
+    }
+
+    SECTION("The output callback can stop the stream")
+    {
+        GzipStream decompressor(GzipStream::Mode::Decompress);
+        REQUIRE(decompressor.reset());
+
+        std::string compressed = gzipCompress(makeText(1000 * 1000));
+        REQUIRE(!decompressor.write(compressed, [](const char*, size_t) { return false; }));
+    }
+
+    SECTION("Bodies are compressed on the fly")
+    {
+        std::string text = makeText(200 * 1000);
+        size_t offset = 0;
+        auto source = std::make_shared<HttpGeneratorBodySource>([&](std::string& chunk) {
+            chunk = text.substr(offset, 4096);
+            offset += chunk.size();
+            return true;
+        });
+
+        HttpGzipBodySource gzipSource(source);
+        REQUIRE(gzipSource.getSize() == -1);
+
+        std::string compressed;
+        char buffer[1000];
+        ssize_t ret;
+        while ((ret = gzipSource.read(buffer, sizeof(buffer))) > 0)
+        {
+            compressed.append(buffer, (size_t) ret);
+        }
+        REQUIRE(ret == 0);
+        REQUIRE(compressed.size() < text.size());
+
+        std::string decompressed;
+        REQUIRE(gzipDecompress(compressed, decompressed));
+        REQUIRE(decompressed == text);
+    }
+}
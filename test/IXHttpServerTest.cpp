@@ -5,13 +5,135 @@
  */
 
 #include "catch.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <set>
 #include <ixwebsocket/IXGetFreePort.h>
+#include <ixwebsocket/IXGzipCodec.h>
 #include <ixwebsocket/IXHttpClient.h>
 #include <ixwebsocket/IXHttpServer.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <thread>
 
 using namespace ix;
 
+namespace
+{
+    // Read a response with a Content-Length header, returns its status code, headers
+    // and body
+    struct RawResponse
+    {
+        int statusCode = -1;
+        WebSocketHttpHeaders headers;
+        std::string body;
+    };
+
+    bool readResponse(std::unique_ptr<Socket>& socket, RawResponse& response)
+    {
+        auto isCancellationRequested = []() -> bool { return false; };
+
+        auto lineResult = socket->readLine(isCancellationRequested);
+        if (!lineResult.first) return false;
+        if (sscanf(lineResult.second.c_str(), "HTTP/1.1 %d", &response.statusCode) != 1)
+        {
+            return false;
+        }
+
+        auto result = parseHttpHeaders(socket, isCancellationRequested);
+        if (!result.first) return false;
+        response.headers = result.second;
+
+        size_t contentLength = (size_t) std::stoi(response.headers["Content-Length"]);
+        auto body = socket->readBytes(contentLength, nullptr, nullptr, isCancellationRequested);
+        response.body = body.second;
+        return body.first;
+    }
+
+    std::unique_ptr<Socket> connectToServer(int port)
+    {
+        std::string errMsg;
+        SocketTLSOptions tlsOptions;
+        auto socket = createSocket(false, -1, errMsg, tlsOptions);
+        auto isCancellationRequested = []() -> bool { return false; };
+        if (!socket->connect("127.0.0.1", port, errMsg, isCancellationRequested))
+        {
+            return nullptr;
+        }
+        return socket;
+    }
+
+    // Answers the first request of a connection, and closes the connection once it
+    // has read the next one, like a server closing an idle connection in the meantime
+    class DroppingServer : public SocketServer
+    {
+    public:
+        DroppingServer(int port)
+            : SocketServer(port, "127.0.0.1")
+            , requests(0)
+            , connections(0)
+        {
+        }
+
+        std::atomic<int> requests;
+        std::atomic<int> connections;
+
+    private:
+        void handleConnection(std::unique_ptr<Socket> socket,
+                              std::shared_ptr<ConnectionState> connectionState) final
+        {
+            connections++;
+            auto isCancellationRequested = []() -> bool { return false; };
+
+            for (int i = 0; std::get<0>(Http::parseRequest(socket, 1)); ++i)
+            {
+                requests++;
+                if (i > 0) break;
+
+                socket->writeBytes("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok",
+                                   isCancellationRequested);
+            }
+
+            connectionState->setTerminated();
+        }
+
+        size_t getConnectedClientsCount() final
+        {
+            return 0;
+        }
+    };
+
+    void startEchoUriServer(ix::HttpServer& server)
+    {
+        server.setOnConnectionCallback(
+            [](HttpRequestPtr request,
+               std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+                return std::make_shared<HttpResponse>(
+                    200, "OK", HttpErrorCode::Ok, WebSocketHttpHeaders(), request->uri);
+            });
+
+        REQUIRE(server.listen().first);
+        server.start();
+    }
+
+    // Resident memory of the process in KB, or -1 when it is not available
+    int64_t getResidentMemory()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+            {
+                return std::stoll(line.substr(6));
+            }
+        }
+        return -1;
+    }
+} // namespace
+
 TEST_CASE("http server", "[httpd]")
 {
     SECTION("Connect to a local HTTP server")
@@ -60,7 +182,10 @@ TEST_CASE("http server", "[httpd]")
         REQUIRE(response->errorCode == HttpErrorCode::Ok);
         REQUIRE(response->statusCode == 200);
         REQUIRE(response->headers["Accept-Encoding"] == "gzip");
-        REQUIRE(response->headers["Content-Encoding"] == "gzip");
+
+        // The file is too small for gzip to make it any smaller, it is sent as is
+        REQUIRE(response->headers["Content-Encoding"].empty());
+        REQUIRE(response->body == "Hello world\n");
 
         server.stop();
     }
@@ -218,3 +343,918 @@ TEST_CASE("http server redirection", "[httpd_redirect]")
         server.stop();
     }
 }
+
+TEST_CASE("http server keep-alive", "[httpd]")
+{
+    auto isCancellationRequested = []() -> bool { return false; };
+
+    SECTION("Pipelined requests on a persistent connection are answered in order")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        REQUIRE(!server.isKeepAliveEnabled());
+        server.enableKeepAlive();
+        startEchoUriServer(server);
+
+        auto socket = connectToServer(port);
+        REQUIRE(socket);
+
+        const int requestCount = 10;
+        std::string requests;
+        for (int i = 0; i < requestCount; ++i)
+        {
+            requests += "GET /" + std::to_string(i) + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        }
+        REQUIRE(socket->writeBytes(requests, isCancellationRequested));
+
+        for (int i = 0; i < requestCount; ++i)
+        {
+            RawResponse response;
+            REQUIRE(readResponse(socket, response));
+            REQUIRE(response.statusCode == 200);
+            REQUIRE(response.body == "/" + std::to_string(i));
+            REQUIRE(response.headers["Connection"] == "keep-alive");
+        }
+
+        // One more request, once the connection has been idle
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        REQUIRE(socket->writeBytes("GET /last HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n",
+                                   isCancellationRequested));
+        RawResponse response;
+        REQUIRE(readResponse(socket, response));
+        REQUIRE(response.body == "/last");
+
+        // Stopping the server does not wait for the idle timeout
+        auto start = std::chrono::steady_clock::now();
+        server.stop();
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    }
+
+    SECTION("Connections are closed after the max number of requests, or when asked")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.enableKeepAlive(5, 2);
+        startEchoUriServer(server);
+
+        auto socket = connectToServer(port);
+        REQUIRE(socket);
+        REQUIRE(socket->writeBytes("GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n",
+                                   isCancellationRequested));
+
+        RawResponse response;
+        REQUIRE(readResponse(socket, response));
+        REQUIRE(response.headers["Connection"] == "keep-alive");
+        REQUIRE(readResponse(socket, response));
+        REQUIRE(response.body == "/b");
+        REQUIRE(response.headers["Connection"] == "close");
+
+        // The server closed the connection
+        char c;
+        REQUIRE(!socket->readByte(&c, isCancellationRequested));
+
+        // HTTP/1.0 clients must ask for keep-alive
+        socket = connectToServer(port);
+        REQUIRE(socket);
+        REQUIRE(socket->writeBytes("GET /c HTTP/1.0\r\n\r\n", isCancellationRequested));
+        REQUIRE(readResponse(socket, response));
+        REQUIRE(response.headers["Connection"] == "close");
+
+        socket = connectToServer(port);
+        REQUIRE(socket);
+        REQUIRE(socket->writeBytes("GET /d HTTP/1.1\r\nConnection: close\r\n\r\n",
+                                   isCancellationRequested));
+        REQUIRE(readResponse(socket, response));
+        REQUIRE(response.headers["Connection"] == "close");
+
+        server.stop();
+    }
+
+    SECTION("Idle connections are closed after the idle timeout")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.enableKeepAlive(1);
+        startEchoUriServer(server);
+
+        auto socket = connectToServer(port);
+        REQUIRE(socket);
+        REQUIRE(socket->writeBytes("GET /a HTTP/1.1\r\n\r\n", isCancellationRequested));
+
+        RawResponse response;
+        REQUIRE(readResponse(socket, response));
+        REQUIRE(response.headers["Connection"] == "keep-alive");
+
+        auto start = std::chrono::steady_clock::now();
+        char c;
+        REQUIRE(!socket->readByte(&c, isCancellationRequested));
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(3));
+
+        server.stop();
+    }
+}
+
+TEST_CASE("http client connection pool", "[httpd]")
+{
+    // Reply with the id of the server side connection, which is unique per TCP connection
+    auto startConnectionIdServer = [](ix::HttpServer& server) {
+        server.setOnConnectionCallback(
+            [](HttpRequestPtr /*request*/,
+               std::shared_ptr<ConnectionState> connectionState) -> HttpResponsePtr {
+                return std::make_shared<HttpResponse>(200,
+                                                      "OK",
+                                                      HttpErrorCode::Ok,
+                                                      WebSocketHttpHeaders(),
+                                                      connectionState->getId());
+            });
+
+        REQUIRE(server.listen().first);
+        server.start();
+    };
+
+    SECTION("Requests to the same server reuse one connection")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.enableKeepAlive();
+        startConnectionIdServer(server);
+
+        HttpClient httpClient;
+        auto args = httpClient.createRequest();
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+
+        std::set<std::string> connectionIds;
+        for (int i = 0; i < 10; ++i)
+        {
+            auto response = (i % 2 == 0) ? httpClient.get(url, args)
+                                          : httpClient.post(url, std::string("a=1"), args);
+            REQUIRE(response->errorCode == HttpErrorCode::Ok);
+            REQUIRE(response->statusCode == 200);
+            connectionIds.insert(response->body);
+        }
+
+        REQUIRE(connectionIds.size() == 1);
+
+        auto stats = httpClient.getConnectionPool().getStats();
+        REQUIRE(stats.hits == 9);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.idleConnections == 1);
+
+        server.stop();
+    }
+
+    SECTION("Connections closed by the server are replaced")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.enableKeepAlive(1);
+        startConnectionIdServer(server);
+
+        HttpClient httpClient;
+        auto args = httpClient.createRequest();
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        std::string firstConnectionId = response->body;
+
+        // Wait for the server to close the idle connection
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+
+        response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->body != firstConnectionId);
+
+        auto stats = httpClient.getConnectionPool().getStats();
+        REQUIRE(stats.evictions + stats.staleRetries == 1);
+
+        server.stop();
+    }
+
+    SECTION("Connections are not pooled when the server closes them")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.disableKeepAlive();
+        startConnectionIdServer(server);
+
+        HttpClient httpClient;
+        auto args = httpClient.createRequest();
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+
+        std::set<std::string> connectionIds;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto response = httpClient.get(url, args);
+            REQUIRE(response->errorCode == HttpErrorCode::Ok);
+            connectionIds.insert(response->body);
+        }
+
+        REQUIRE(connectionIds.size() == 3);
+        REQUIRE(httpClient.getConnectionPool().getStats().misses == 3);
+        REQUIRE(httpClient.getConnectionPool().getStats().idleConnections == 0);
+
+        server.stop();
+    }
+
+    SECTION("Only idempotent requests are sent again when a reused connection was closed")
+    {
+        int port = getFreePort();
+        DroppingServer server(port);
+        REQUIRE(server.listen().first);
+        server.start();
+
+        HttpClient httpClient;
+        auto args = httpClient.createRequest();
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+
+        // The server may have processed the POST request, which must not run twice
+        response = httpClient.post(url, std::string("a=1"), args);
+        REQUIRE(response->errorCode == HttpErrorCode::CannotReadStatusLine);
+        REQUIRE(server.requests == 2);
+        REQUIRE(server.connections == 1);
+        REQUIRE(httpClient.getConnectionPool().getStats().staleRetries == 0);
+
+        response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(server.requests == 5);
+        REQUIRE(server.connections == 3);
+        REQUIRE(httpClient.getConnectionPool().getStats().staleRetries == 1);
+
+        server.stop();
+    }
+
+    SECTION("Idle connections limits")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.enableKeepAlive();
+        startConnectionIdServer(server);
+
+        HttpClient httpClient;
+        httpClient.getConnectionPool().setMaxIdleConnections(0);
+        auto args = httpClient.createRequest();
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+
+        std::set<std::string> connectionIds;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto response = httpClient.get(url, args);
+            REQUIRE(response->errorCode == HttpErrorCode::Ok);
+            connectionIds.insert(response->body);
+        }
+        REQUIRE(connectionIds.size() == 3);
+
+        // Connections idle for longer than the idle timeout are closed
+        httpClient.getConnectionPool().setMaxIdleConnections(
+            HttpConnectionPool::kDefaultMaxIdleConnections);
+        httpClient.getConnectionPool().setIdleTimeout(0);
+
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(httpClient.getConnectionPool().getStats().idleConnections == 1);
+
+        httpClient.getConnectionPool().evictIdleConnections();
+        auto stats = httpClient.getConnectionPool().getStats();
+        REQUIRE(stats.idleConnections == 0);
+        REQUIRE(stats.evictions == 1);
+
+        server.stop();
+    }
+}
+
+TEST_CASE("http client async worker pool", "[httpd]")
+{
+    // Slow server, which records the max number of requests processed at once
+    std::atomic<int> activeRequests(0);
+    std::atomic<int> maxActiveRequests(0);
+
+    // The 8 requests connect at once, more than the default backlog accepts
+    int port = getFreePort();
+    int backlog = 16;
+    ix::HttpServer server(port, "127.0.0.1", backlog);
+    server.setOnConnectionCallback(
+        [&](HttpRequestPtr request,
+            std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+            int active = ++activeRequests;
+            int maxActive = maxActiveRequests;
+            while (active > maxActive && !maxActiveRequests.compare_exchange_weak(maxActive, active))
+            {
+            }
+
+            if (request->uri.find("/fast") != 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            activeRequests--;
+
+            return std::make_shared<HttpResponse>(
+                200, "OK", HttpErrorCode::Ok, WebSocketHttpHeaders(), request->uri);
+        });
+    REQUIRE(server.listen().first);
+    server.start();
+
+    std::string url("http://127.0.0.1:" + std::to_string(port));
+
+    std::mutex mutex;
+    std::vector<std::string> completed;
+    std::atomic<int> completedCount(0);
+    auto onResponse = [&](const HttpResponsePtr& response) {
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.push_back(response->errorCode == HttpErrorCode::Ok ? response->body
+                                                                      : "cancelled");
+        completedCount++;
+    };
+
+    auto waitForCompletions = [&](int count) {
+        for (int i = 0; i < 100 && completedCount < count; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return completedCount == count;
+    };
+
+    SECTION("Requests are executed concurrently")
+    {
+        bool async = true;
+        HttpClient httpClient(async, 8);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 8; ++i)
+        {
+            auto args = httpClient.createRequest(url + "/" + std::to_string(i));
+            REQUIRE(httpClient.performRequest(args, onResponse));
+        }
+
+        REQUIRE(waitForCompletions(8));
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+        REQUIRE(maxActiveRequests > 1);
+    }
+
+    SECTION("Concurrent requests to a host are limited")
+    {
+        bool async = true;
+        HttpClient httpClient(async, 4);
+        httpClient.setMaxConcurrentRequestsPerHost(2);
+
+        for (int i = 0; i < 6; ++i)
+        {
+            auto args = httpClient.createRequest(url + "/" + std::to_string(i));
+            REQUIRE(httpClient.performRequest(args, onResponse));
+        }
+
+        REQUIRE(waitForCompletions(6));
+        REQUIRE(maxActiveRequests == 2);
+    }
+
+    SECTION("Requests are executed by priority, and can be cancelled while queued")
+    {
+        bool async = true;
+        HttpClient httpClient(async, 1);
+
+        // Keep the only worker busy while the other requests are queued
+        REQUIRE(httpClient.performRequest(httpClient.createRequest(url + "/first"), onResponse));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        auto low = httpClient.createRequest(url + "/low");
+        low->priority = -1;
+        auto normal = httpClient.createRequest(url + "/normal");
+        auto cancelled = httpClient.createRequest(url + "/cancelled");
+        auto high = httpClient.createRequest(url + "/high");
+        high->priority = 1;
+
+        REQUIRE(httpClient.performRequest(low, onResponse));
+        REQUIRE(httpClient.performRequest(normal, onResponse));
+        REQUIRE(httpClient.performRequest(cancelled, onResponse));
+        REQUIRE(httpClient.performRequest(high, onResponse));
+        REQUIRE(httpClient.getPendingRequestsCount() == 4);
+
+        cancelled->cancel = true;
+
+        REQUIRE(waitForCompletions(5));
+
+        // The cancelled request completes once it is the next request of the host
+        std::vector<std::string> expected = {"/first", "/high", "/normal", "cancelled", "/low"};
+        REQUIRE(completed == expected);
+    }
+
+    SECTION("Cancelling a request while it is dequeued does not leak its host slot")
+    {
+        bool async = true;
+        HttpClient httpClient(async, 4);
+        httpClient.setMaxConcurrentRequestsPerHost(1);
+
+        const int count = 1000;
+        std::vector<HttpRequestArgsPtr> requests;
+        for (int i = 0; i < count; ++i)
+        {
+            requests.push_back(httpClient.createRequest(url + "/fast/" + std::to_string(i)));
+        }
+
+        // A response is delivered once its host slot is released, while another
+        // worker is dequeuing the next request: cancel that one now
+        for (int i = 0; i < count; ++i)
+        {
+            REQUIRE(httpClient.performRequest(requests[i], [&, i](const HttpResponsePtr& response) {
+                if (i % 2 == 0 && i + 1 < count)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(i % 50));
+                    requests[i + 1]->cancel = true;
+                }
+                onResponse(response);
+            }));
+        }
+
+        REQUIRE(waitForCompletions(count));
+
+        // The host still accepts requests
+        REQUIRE(httpClient.performRequest(httpClient.createRequest(url + "/fast/last"),
+                                          onResponse));
+        REQUIRE(waitForCompletions(count + 1));
+        REQUIRE(completed.back() == "/fast/last");
+    }
+
+    server.stop();
+}
+
+TEST_CASE("http server streaming bodies", "[httpd]")
+{
+    SECTION("Large files are streamed, and Range requests are supported")
+    {
+        // Larger than the max size of compressed files
+        std::string content;
+        for (int i = 0; content.size() < 3 * 1024 * 1024; ++i)
+        {
+            content += std::to_string(i) + "\n";
+        }
+
+        const std::string fileName("ix_http_server_streaming_test.txt");
+        {
+            std::ofstream file(fileName, std::ios::binary);
+            file << content;
+        }
+
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        REQUIRE(server.listen().first);
+        server.start();
+
+        HttpClient httpClient;
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/" + fileName);
+
+        auto args = httpClient.createRequest();
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->headers["Accept-Ranges"] == "bytes");
+        REQUIRE(response->headers["Content-Encoding"] != "gzip");
+        REQUIRE(response->body == content);
+
+        args->extraHeaders["Range"] = "bytes=100-199";
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 206);
+        REQUIRE(response->body == content.substr(100, 100));
+        REQUIRE(response->headers["Content-Range"] ==
+                "bytes 100-199/" + std::to_string(content.size()));
+
+        args->extraHeaders["Range"] = "bytes=-10";
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 206);
+        REQUIRE(response->body == content.substr(content.size() - 10));
+
+        args->extraHeaders["Range"] = "bytes=3000000-";
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 206);
+        REQUIRE(response->body == content.substr(3000000));
+
+        args->extraHeaders["Range"] = "bytes=" + std::to_string(content.size()) + "-";
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 416);
+        REQUIRE(response->headers["Content-Range"] == "bytes */" + std::to_string(content.size()));
+
+        // Multiple ranges are not supported, the whole file is sent
+        args->extraHeaders["Range"] = "bytes=0-10,20-30";
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->body == content);
+
+        server.stop();
+        std::remove(fileName.c_str());
+    }
+
+    SECTION("Bodies produced by a generator are sent with chunked transfer encoding")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.enableKeepAlive();
+        server.setOnConnectionCallback(
+            [](HttpRequestPtr /*request*/,
+               std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+                auto count = std::make_shared<int>(0);
+                auto response = std::make_shared<HttpResponse>(200, "OK");
+                response->bodySource =
+                    std::make_shared<HttpGeneratorBodySource>([count](std::string& chunk) {
+                        if (*count < 100)
+                        {
+                            chunk = "chunk " + std::to_string((*count)++) + "\n";
+                        }
+                        return true;
+                    });
+                return response;
+            });
+        REQUIRE(server.listen().first);
+        server.start();
+
+        std::string expected;
+        for (int i = 0; i < 100; ++i)
+        {
+            expected += "chunk " + std::to_string(i) + "\n";
+        }
+
+        HttpClient httpClient;
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+        auto args = httpClient.createRequest();
+
+        // Twice, to check that the connection is still usable after a chunked body
+        for (int i = 0; i < 2; ++i)
+        {
+            auto response = httpClient.get(url, args);
+            REQUIRE(response->errorCode == HttpErrorCode::Ok);
+            REQUIRE(response->headers["Transfer-Encoding"] == "chunked");
+            REQUIRE(response->body == expected);
+        }
+        REQUIRE(httpClient.getConnectionPool().getStats().hits == 1);
+
+        server.stop();
+    }
+
+    SECTION("Responses to a client which stops reading are abandoned")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.setWriteTimeout(1);
+
+        // An endless body, which the client never reads
+        std::atomic<int> chunks(0);
+        server.setOnConnectionCallback(
+            [&chunks](HttpRequestPtr /*request*/,
+                      std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+                auto response = std::make_shared<HttpResponse>(200, "OK");
+                response->bodySource =
+                    std::make_shared<HttpGeneratorBodySource>([&chunks](std::string& chunk) {
+                        chunks++;
+                        chunk.assign(16 * 1024, 'x');
+                        return true;
+                    });
+                return response;
+            });
+        REQUIRE(server.listen().first);
+        server.start();
+
+        auto isCancellationRequested = []() -> bool { return false; };
+        auto socket = connectToServer(port);
+        REQUIRE(socket);
+        REQUIRE(socket->writeBytes("GET / HTTP/1.1\r\n\r\n", isCancellationRequested));
+
+        // The write timeout fires, and the body is not produced anymore
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        int producedChunks = chunks;
+        REQUIRE(producedChunks > 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        REQUIRE(chunks == producedChunks);
+
+        // Stopping the server does not wait for the write timeout either
+        server.setWriteTimeout(60);
+        socket = connectToServer(port);
+        REQUIRE(socket);
+        REQUIRE(socket->writeBytes("GET / HTTP/1.1\r\n\r\n", isCancellationRequested));
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        auto start = std::chrono::steady_clock::now();
+        server.stop();
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    }
+}
+
+TEST_CASE("http client streaming downloads", "[httpd]")
+{
+    // 64KB blocks of a repeating pattern, produced on the fly by the server
+    const size_t blockSize = 64 * 1024;
+    std::string block;
+    for (size_t i = 0; i < blockSize; ++i)
+    {
+        block += (char) ('a' + i % 26);
+    }
+
+    std::atomic<size_t> blockCount(16);
+    std::atomic<bool> gzip(false);
+
+    int port = getFreePort();
+    ix::HttpServer server(port, "127.0.0.1");
+    server.setOnConnectionCallback(
+        [&](HttpRequestPtr /*request*/,
+            std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+            auto response = std::make_shared<HttpResponse>(200, "OK");
+            auto remaining = std::make_shared<size_t>(blockCount);
+            HttpBodySourcePtr bodySource = std::make_shared<HttpGeneratorBodySource>(
+                [&block, remaining](std::string& chunk) {
+                    if (*remaining > 0)
+                    {
+                        chunk = block;
+                        (*remaining)--;
+                    }
+                    return true;
+                },
+                (int64_t)(blockCount * blockSize));
+
+            // Compressed on the fly, with chunked transfer encoding
+            if (gzip)
+            {
+                response->headers["Content-Encoding"] = "gzip";
+                bodySource = std::make_shared<HttpGzipBodySource>(bodySource);
+            }
+
+            response->bodySource = bodySource;
+            return response;
+        });
+    REQUIRE(server.listen().first);
+    server.start();
+
+    HttpClient httpClient;
+    std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+
+    SECTION("A 1GB body is delivered to a callback with constant memory")
+    {
+        blockCount = 1024 * 1024 * 1024 / blockSize;
+
+        uint64_t received = 0;
+        bool valid = true;
+        auto args = httpClient.createRequest();
+        args->onBodyCallback = [&](const char* data, size_t size) {
+            valid = valid && data[0] == block[received % blockSize];
+            received += size;
+            return true;
+        };
+
+        int64_t residentMemory = getResidentMemory();
+
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(received == (uint64_t) blockCount * blockSize);
+        REQUIRE(response->downloadSize == received);
+        REQUIRE(response->body.empty());
+        REQUIRE(valid);
+
+        // Nothing close to the size of the body was allocated
+        if (residentMemory != -1)
+        {
+            REQUIRE(getResidentMemory() - residentMemory < 64 * 1024);
+        }
+    }
+
+    SECTION("Compressed bodies are decompressed as they are received")
+    {
+        gzip = true;
+        std::string expected;
+        for (size_t i = 0; i < blockCount; ++i)
+        {
+            expected += block;
+        }
+
+        std::string body;
+        size_t chunkCount = 0;
+        auto args = httpClient.createRequest();
+        args->onBodyCallback = [&](const char* data, size_t size) {
+            body.append(data, size);
+            chunkCount++;
+            return true;
+        };
+
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->headers["Content-Encoding"] == "gzip");
+        REQUIRE(response->headers["Transfer-Encoding"] == "chunked");
+        REQUIRE(body == expected);
+        REQUIRE(chunkCount > 1);
+        REQUIRE(response->downloadSize < expected.size());
+    }
+
+    SECTION("Bodies are written to a file")
+    {
+        const std::string fileName("ix_http_client_streaming_test.txt");
+
+        for (bool compressed : {false, true})
+        {
+            gzip = compressed;
+            auto args = httpClient.createRequest();
+            args->outputPath = fileName;
+
+            auto response = httpClient.get(url, args);
+            REQUIRE(response->errorCode == HttpErrorCode::Ok);
+            REQUIRE(response->body.empty());
+
+            std::ifstream file(fileName, std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+            REQUIRE(content.size() == blockCount * blockSize);
+            REQUIRE(content.substr(0, blockSize) == block);
+        }
+
+        std::remove(fileName.c_str());
+
+        auto args = httpClient.createRequest();
+        args->outputPath = "/nonexistent/" + fileName;
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::CannotWriteBody);
+    }
+
+    SECTION("The transfer is aborted when the callback returns false")
+    {
+        blockCount = 1024;
+
+        uint64_t received = 0;
+        auto args = httpClient.createRequest();
+        args->onBodyCallback = [&](const char* /*data*/, size_t size) {
+            received += size;
+            return received < blockSize;
+        };
+
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::CannotWriteBody);
+        REQUIRE(received < blockCount * blockSize);
+    }
+
+    server.stop();
+}
+
+TEST_CASE("http server file cache", "[httpd]")
+{
+    auto writeFile = [](const std::string& path, const std::string& content) {
+        std::ofstream file(path, std::ios::binary);
+        file << content;
+    };
+
+    const std::string fileName("ix_http_server_cache_test.txt");
+    std::string content;
+    for (int i = 0; i < 1000; ++i)
+    {
+        content += "line " + std::to_string(i) + "\n";
+    }
+    writeFile(fileName, content);
+
+    int port = getFreePort();
+    ix::HttpServer server(port, "127.0.0.1");
+    REQUIRE(server.listen().first);
+    server.start();
+
+    HttpClient httpClient;
+    std::string url("http://127.0.0.1:" + std::to_string(port) + "/" + fileName);
+
+    SECTION("Files are compressed once, and validated with ETag and Last-Modified")
+    {
+        auto args = httpClient.createRequest();
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->headers["Content-Encoding"] == "gzip");
+        REQUIRE(response->body == content);
+
+        std::string etag = response->headers["ETag"];
+        std::string lastModified = response->headers["Last-Modified"];
+        REQUIRE(!etag.empty());
+        REQUIRE(!lastModified.empty());
+
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->body == content);
+
+        auto stats = server.getFileCacheStats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.getHitRatio() == 0.5);
+        REQUIRE(stats.entries == 1);
+        REQUIRE(stats.bytesSaved > content.size());
+
+        args->extraHeaders["If-None-Match"] = etag;
+        response = httpClient.get(url, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 304);
+        REQUIRE(response->body.empty());
+
+        args->extraHeaders.erase("If-None-Match");
+        args->extraHeaders["If-Modified-Since"] = lastModified;
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 304);
+
+        args->extraHeaders["If-None-Match"] = "W/\"other\"";
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+
+        REQUIRE(server.getFileCacheStats().notModified == 2);
+
+        // The cached content is replaced when the file changes
+        content += "one more line\n";
+        writeFile(fileName, content);
+
+        args = httpClient.createRequest();
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->body == content);
+        REQUIRE(response->headers["ETag"] != etag);
+        REQUIRE(server.getFileCacheStats().misses == 2);
+
+        server.setFileCacheMaxSize(0);
+        REQUIRE(server.getFileCacheStats().entries == 0);
+        REQUIRE(server.getFileCacheStats().size == 0);
+    }
+
+    SECTION("Precompressed files are used when they are up to date")
+    {
+        writeFile(fileName + ".gz", ix::gzipCompress("precompressed"));
+
+        auto args = httpClient.createRequest();
+        auto response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->headers["Content-Encoding"] == "gzip");
+        REQUIRE(response->body == "precompressed");
+
+        // Without gzip, the file itself is sent
+        args->compress = false;
+        response = httpClient.get(url, args);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->body == content);
+
+        std::remove((fileName + ".gz").c_str());
+    }
+
+    server.stop();
+    std::remove(fileName.c_str());
+}
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL)
+TEST_CASE("https server certificates rotation", "[httpd]")
+{
+    auto copyFile = [](const std::string& from, const std::string& to) {
+        // Written next to the file then renamed, as certificates are usually deployed
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to + ".tmp", std::ios::binary);
+        out << in.rdbuf();
+        out.close();
+        REQUIRE(std::rename((to + ".tmp").c_str(), to.c_str()) == 0);
+    };
+
+    const std::string certFile("ix_https_server_rotation_crt.pem");
+    const std::string keyFile("ix_https_server_rotation_key.pem");
+    copyFile(".certs/trusted-server-crt.pem", certFile);
+    copyFile(".certs/trusted-server-key.pem", keyFile);
+
+    int port = getFreePort();
+    ix::HttpServer server(port, "127.0.0.1");
+
+    SocketTLSOptions tlsOptionsServer;
+    tlsOptionsServer.tls = true;
+    tlsOptionsServer.caFile = "NONE";
+    tlsOptionsServer.certFile = certFile;
+    tlsOptionsServer.keyFile = keyFile;
+    server.setTLSOptions(tlsOptionsServer);
+    REQUIRE(server.listen().first);
+    server.start();
+
+    // The trusted-server certificate has expired, unlike the wrong-name-server one
+    auto get = [port](bool verify) {
+        HttpClient httpClient;
+        SocketTLSOptions tlsOptionsClient;
+        tlsOptionsClient.caFile = verify ? ".certs/trusted-ca-crt.pem" : "NONE";
+        tlsOptionsClient.disable_hostname_validation = true;
+        httpClient.setTLSOptions(tlsOptionsClient);
+
+        std::string url("https://127.0.0.1:" + std::to_string(port) + "/");
+        auto args = httpClient.createRequest(url);
+        args->connectTimeout = 10;
+        args->transferTimeout = 10;
+        return httpClient.get(url, args)->errorCode;
+    };
+
+    REQUIRE(get(false) == HttpErrorCode::Ok);
+    REQUIRE(get(true) == HttpErrorCode::CannotConnect);
+
+    // A certificate without its key is not used
+    copyFile(".certs/wrong-name-server-crt.pem", certFile);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    REQUIRE(get(false) == HttpErrorCode::Ok);
+    REQUIRE(get(true) == HttpErrorCode::CannotConnect);
+
+    copyFile(".certs/wrong-name-server-key.pem", keyFile);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    REQUIRE(get(true) == HttpErrorCode::Ok);
+
+    server.stop();
+    std::remove(certFile.c_str());
+    std::remove(keyFile.c_str());
+}
+#endif
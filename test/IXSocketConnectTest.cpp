@@ -6,11 +6,110 @@
 
 #include "IXTest.h"
 #include "catch.hpp"
+#include <chrono>
 #include <iostream>
+#include <ixwebsocket/IXNetSystem.h>
+#include <ixwebsocket/IXSocket.h>
 #include <ixwebsocket/IXSocketConnect.h>
+#include <string.h>
 
 using namespace ix;
 
+namespace
+{
+    // Listening socket which is never accepted from. With a backlog of 0 and one
+    // connection waiting in its queue, it drops the following SYN packets like an
+    // unreachable host.
+    class Listener
+    {
+    public:
+        Listener(const std::string& host, int backlog)
+            : _port(getFreePort())
+            , _fd(-1)
+            , _filler(-1)
+        {
+            struct addrinfo* res = nullptr;
+            if (getaddrinfo(host.c_str(), std::to_string(_port).c_str(), nullptr, &res) != 0)
+            {
+                return;
+            }
+
+            _fd = socket(res->ai_family, SOCK_STREAM, 0);
+            if (bind(_fd, res->ai_addr, res->ai_addrlen) != 0 || ::listen(_fd, backlog) != 0)
+            {
+                Socket::closeSocket(_fd);
+                _fd = -1;
+            }
+            else if (backlog == 0)
+            {
+                _filler = socket(res->ai_family, SOCK_STREAM, 0);
+                ::connect(_filler, res->ai_addr, res->ai_addrlen);
+            }
+            freeaddrinfo(res);
+        }
+
+        ~Listener()
+        {
+            if (_filler != -1) Socket::closeSocket(_filler);
+            if (_fd != -1) Socket::closeSocket(_fd);
+        }
+
+        bool isListening() const
+        {
+            return _fd != -1;
+        }
+
+        int getPort() const
+        {
+            return _port;
+        }
+
+    private:
+        int _port;
+        int _fd;
+        int _filler;
+    };
+
+    // Address list of numeric hosts, in the given order
+    std::shared_ptr<struct addrinfo> makeAddresses(
+        const std::vector<std::pair<std::string, int>>& hostsAndPorts)
+    {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_flags = AI_NUMERICHOST;
+        hints.ai_socktype = SOCK_STREAM;
+
+        std::vector<struct addrinfo*> results;
+        for (auto&& hostAndPort : hostsAndPorts)
+        {
+            struct addrinfo* res = nullptr;
+            getaddrinfo(hostAndPort.first.c_str(),
+                        std::to_string(hostAndPort.second).c_str(),
+                        &hints,
+                        &res);
+            if (!results.empty()) results.back()->ai_next = res;
+            results.push_back(res);
+        }
+
+        return std::shared_ptr<struct addrinfo>(results.front(), [results](struct addrinfo*) {
+            for (auto&& res : results)
+            {
+                res->ai_next = nullptr;
+                freeaddrinfo(res);
+            }
+        });
+    }
+
+    int connectToAddresses(const std::shared_ptr<struct addrinfo>& addresses,
+                           SocketConnectTimings& timings)
+    {
+        std::string errMsg;
+        int fd = SocketConnect::connectToAddresses(
+            addresses.get(), errMsg, [] { return false; }, &timings);
+        std::cerr << "Error message: " << errMsg << std::endl;
+        return fd;
+    }
+} // namespace
 
 TEST_CASE("socket_connect", "[net]")
 {
@@ -48,3 +147,99 @@ TEST_CASE("socket_connect", "[net]")
         REQUIRE(fd == -1);
     }
 }
+
+TEST_CASE("socket_connect_happy_eyeballs", "[net]")
+{
+    int delayMs = SocketConnect::kConnectionAttemptDelayMs;
+
+    Listener blackhole("127.0.0.1", 0);
+    Listener otherBlackhole("127.0.0.1", 0);
+    Listener listener("127.0.0.1", 16);
+    Listener listenerV6("::1", 16);
+    REQUIRE(blackhole.isListening());
+    REQUIRE(otherBlackhole.isListening());
+    REQUIRE(listener.isListening());
+    REQUIRE(listenerV6.isListening());
+
+    SocketConnectTimings timings;
+
+    SECTION("The first address is used when it answers")
+    {
+        auto addresses =
+            makeAddresses({{"127.0.0.1", listener.getPort()}, {"::1", listenerV6.getPort()}});
+        int fd = connectToAddresses(addresses, timings);
+        REQUIRE(fd != -1);
+        REQUIRE(timings.attempts == 1);
+        REQUIRE(timings.addressFamily == AF_INET);
+        REQUIRE(timings.connectMs < delayMs);
+        Socket::closeSocket(fd);
+    }
+
+    SECTION("An address which does not answer delays the connection by the attempt delay")
+    {
+        auto addresses =
+            makeAddresses({{"127.0.0.1", blackhole.getPort()}, {"::1", listenerV6.getPort()}});
+        int fd = connectToAddresses(addresses, timings);
+        REQUIRE(fd != -1);
+        REQUIRE(timings.attempts == 2);
+        REQUIRE(timings.addressFamily == AF_INET6);
+        REQUIRE(timings.connectMs >= delayMs - 10);
+        REQUIRE(timings.connectMs < delayMs + 500);
+        Socket::closeSocket(fd);
+    }
+
+    SECTION("Address families are interleaved")
+    {
+        auto addresses = makeAddresses({{"127.0.0.1", blackhole.getPort()},
+                                        {"127.0.0.1", otherBlackhole.getPort()},
+                                        {"::1", listenerV6.getPort()}});
+        int fd = connectToAddresses(addresses, timings);
+        REQUIRE(fd != -1);
+        REQUIRE(timings.attempts == 2);
+        REQUIRE(timings.addressFamily == AF_INET6);
+        Socket::closeSocket(fd);
+    }
+
+    SECTION("A refused connection starts the next attempt right away")
+    {
+        int closedPort = getFreePort();
+        auto addresses =
+            makeAddresses({{"127.0.0.1", closedPort}, {"::1", listenerV6.getPort()}});
+        int fd = connectToAddresses(addresses, timings);
+        REQUIRE(fd != -1);
+        REQUIRE(timings.attempts == 2);
+        REQUIRE(timings.connectMs < delayMs);
+        Socket::closeSocket(fd);
+    }
+
+    SECTION("Pending attempts are cancelled")
+    {
+        auto addresses = makeAddresses({{"127.0.0.1", blackhole.getPort()},
+                                        {"127.0.0.1", otherBlackhole.getPort()}});
+
+        auto start = std::chrono::steady_clock::now();
+        auto cancelled = [start] {
+            return std::chrono::steady_clock::now() - start > std::chrono::milliseconds(600);
+        };
+
+        std::string errMsg;
+        int fd =
+            SocketConnect::connectToAddresses(addresses.get(), errMsg, cancelled, &timings);
+        REQUIRE(fd == -1);
+        REQUIRE(errMsg == "Cancelled");
+        REQUIRE(timings.attempts == 2);
+    }
+
+    SECTION("Sockets report the timings of their connection")
+    {
+        Socket socket;
+        std::string errMsg;
+        REQUIRE(socket.init(errMsg));
+        REQUIRE(socket.connect("localhost", listener.getPort(), errMsg, [] { return false; }));
+
+        timings = socket.getConnectTimings();
+        REQUIRE(timings.attempts >= 1);
+        REQUIRE(timings.addressFamily != 0);
+        REQUIRE(timings.resolutionMs >= 0);
+    }
+}
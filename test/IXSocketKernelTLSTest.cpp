@@ -0,0 +1,210 @@
+/*
+ *  IXSocketKernelTLSTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include "catch.hpp"
+#include <fstream>
+#include <ixwebsocket/IXHttpClient.h>
+#include <ixwebsocket/IXHttpServer.h>
+#include <ixwebsocket/IXSocketTLSSessionCache.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL)
+#include <openssl/ssl.h>
+#endif
+
+#if defined(__linux__)
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace ix;
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL)
+namespace
+{
+    // Whether OpenSSL and the kernel can both do kTLS. The tls upper layer protocol can only
+    // be attached to a connected socket, so an unconnected socket fails with ENOTCONN when
+    // the kernel knows it, and with ENOENT when it does not.
+    bool isKernelTLSAvailable()
+    {
+#if defined(__linux__) && defined(TCP_ULP) && defined(SSL_OP_ENABLE_KTLS) && \
+    !defined(OPENSSL_NO_KTLS)
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+
+        bool available = setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 ||
+                         errno == ENOTCONN;
+        close(fd);
+        return available;
+#else
+        return false;
+#endif
+    }
+
+    SocketTLSOptions makeServerOptions(bool enableKernelTLS)
+    {
+        SocketTLSOptions tlsOptions;
+        tlsOptions.tls = true;
+        tlsOptions.caFile = "NONE";
+        tlsOptions.certFile = ".certs/wrong-name-server-crt.pem";
+        tlsOptions.keyFile = ".certs/wrong-name-server-key.pem";
+        tlsOptions.enable_ktls = enableKernelTLS;
+        return tlsOptions;
+    }
+
+    SocketTLSOptions makeClientOptions(bool enableKernelTLS)
+    {
+        SocketTLSOptions tlsOptions;
+        tlsOptions.caFile = ".certs/trusted-ca-crt.pem";
+        tlsOptions.disable_hostname_validation = true;
+        tlsOptions.enable_ktls = enableKernelTLS;
+        return tlsOptions;
+    }
+
+    std::string makePayload(size_t size)
+    {
+        std::string payload(size, 0);
+        for (size_t i = 0; i < size; ++i)
+        {
+            payload[i] = (char) ((i * 31) ^ (i >> 8));
+        }
+        return payload;
+    }
+
+    // Echo messages of different sizes over a secure WebSocket
+    void echoMessages(bool enableKernelTLS)
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port, "127.0.0.1");
+        server.setTLSOptions(makeServerOptions(enableKernelTLS));
+        server.disablePerMessageDeflate();
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.send(msg->str, msg->binary);
+                }
+            });
+        REQUIRE(server.listenAndStart());
+
+        std::vector<std::string> payloads = {
+            "hello", makePayload(100 * 1000), makePayload(3 * 1000 * 1000), "bye"};
+
+        std::mutex receivedMutex;
+        std::vector<std::string> received;
+        std::atomic<bool> open(false);
+
+        ix::WebSocket webSocket;
+        webSocket.setUrl("wss://127.0.0.1:" + std::to_string(port) + "/");
+        webSocket.setTLSOptions(makeClientOptions(enableKernelTLS));
+        webSocket.disableAutomaticReconnection();
+        webSocket.disablePerMessageDeflate();
+        webSocket.setOnMessageCallback([&](const ix::WebSocketMessagePtr& msg) {
+            if (msg->type == ix::WebSocketMessageType::Open)
+            {
+                open = true;
+            }
+            else if (msg->type == ix::WebSocketMessageType::Message)
+            {
+                std::lock_guard<std::mutex> lock(receivedMutex);
+                received.push_back(msg->str);
+            }
+        });
+        webSocket.start();
+
+        for (int i = 0; i < 500 && !open; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(open);
+
+        auto receivedCount = [&]() {
+            std::lock_guard<std::mutex> lock(receivedMutex);
+            return received.size();
+        };
+
+        // One message at a time, as both ends block while sending large messages
+        for (size_t i = 0; i < payloads.size(); ++i)
+        {
+            REQUIRE(webSocket.sendBinary(payloads[i]).success);
+            for (int j = 0; j < 500 && receivedCount() <= i; ++j)
+            {
+                ix::msleep(10);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(receivedMutex);
+            REQUIRE(received == payloads);
+        }
+
+        webSocket.stop();
+        server.stop();
+    }
+} // namespace
+
+TEST_CASE("kernel_tls", "[tls]")
+{
+    SECTION("Messages are the same with and without kTLS")
+    {
+        auto before = getTLSSessionStats();
+        echoMessages(false);
+        REQUIRE(getTLSSessionStats().kernelTLSConnections == before.kernelTLSConnections);
+
+        // Without kTLS support, the connections fall back to user space encryption
+        echoMessages(true);
+        if (isKernelTLSAvailable())
+        {
+            REQUIRE(getTLSSessionStats().kernelTLSConnections > before.kernelTLSConnections);
+        }
+    }
+
+    SECTION("Files are sent with sendfile when the kernel encrypts the records")
+    {
+        auto before = getTLSSessionStats();
+
+        const std::string fileName("ix_kernel_tls_test.bin");
+        std::string content = makePayload(2 * 1000 * 1000);
+        {
+            std::ofstream file(fileName, std::ios::binary);
+            file << content;
+        }
+
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        server.setTLSOptions(makeServerOptions(true));
+        REQUIRE(server.listen().first);
+        server.start();
+
+        HttpClient httpClient;
+        httpClient.setTLSOptions(makeClientOptions(true));
+
+        auto args = httpClient.createRequest();
+        args->compress = false;
+        auto response = httpClient.get(
+            "https://127.0.0.1:" + std::to_string(port) + "/" + fileName, args);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->body == content);
+
+        // Otherwise the file is read and encrypted in user space
+        if (isKernelTLSAvailable())
+        {
+            REQUIRE(getTLSSessionStats().kernelTLSConnections > before.kernelTLSConnections);
+        }
+
+        server.stop();
+        std::remove(fileName.c_str());
+    }
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+ *  IXSocketTLSSessionTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include "catch.hpp"
+#include <ixwebsocket/IXHttpServer.h>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXSocketTLSSessionCache.h>
+
+using namespace ix;
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL)
+namespace
+{
+    // Counts the full and resumed handshakes of a new connection, on both ends
+    std::pair<int, int> connect(int port, const SocketTLSOptions& tlsOptions)
+    {
+        auto before = getTLSSessionStats();
+
+        std::string errMsg;
+        auto socket = createSocket(true, -1, errMsg, tlsOptions);
+        REQUIRE(socket);
+        auto isCancellationRequested = []() -> bool { return false; };
+        REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+
+        // The server completes its handshake after the client
+        SocketTLSSessionStats after;
+        for (int i = 0; i < 500; ++i)
+        {
+            after = getTLSSessionStats();
+            if (after.serverFullHandshakes + after.serverResumedHandshakes >
+                before.serverFullHandshakes + before.serverResumedHandshakes)
+            {
+                break;
+            }
+            ix::msleep(2);
+        }
+        socket->close();
+
+        int clientFull = (int) (after.clientFullHandshakes - before.clientFullHandshakes);
+        int clientResumed = (int) (after.clientResumedHandshakes - before.clientResumedHandshakes);
+        REQUIRE(clientFull + clientResumed == 1);
+        REQUIRE((int) (after.serverFullHandshakes - before.serverFullHandshakes) == clientFull);
+        REQUIRE((int) (after.serverResumedHandshakes - before.serverResumedHandshakes) ==
+                clientResumed);
+
+        return std::make_pair(clientFull, clientResumed);
+    }
+} // namespace
+
+TEST_CASE("tls_session_resumption", "[tls]")
+{
+    int port = getFreePort();
+    ix::HttpServer server(port, "127.0.0.1");
+
+    SocketTLSOptions tlsOptionsServer;
+    tlsOptionsServer.tls = true;
+    tlsOptionsServer.caFile = "NONE";
+    tlsOptionsServer.certFile = ".certs/wrong-name-server-crt.pem";
+    tlsOptionsServer.keyFile = ".certs/wrong-name-server-key.pem";
+    server.setTLSOptions(tlsOptionsServer);
+    REQUIRE(server.listen().first);
+    server.start();
+
+    SocketTLSOptions tlsOptionsClient;
+    tlsOptionsClient.caFile = ".certs/trusted-ca-crt.pem";
+    tlsOptionsClient.disable_hostname_validation = true;
+
+    auto full = std::make_pair(1, 0);
+    auto resumed = std::make_pair(0, 1);
+
+    clearTLSSessionCache();
+
+    SECTION("The session of the previous connection is resumed")
+    {
+        REQUIRE(connect(port, tlsOptionsClient) == full);
+        REQUIRE(connect(port, tlsOptionsClient) == resumed);
+        REQUIRE(connect(port, tlsOptionsClient) == resumed);
+
+        // Sessions are only reused with the same options
+        SocketTLSOptions otherTLSOptions(tlsOptionsClient);
+        otherTLSOptions.caFile = "NONE";
+        REQUIRE(connect(port, otherTLSOptions) == full);
+        REQUIRE(connect(port, otherTLSOptions) == resumed);
+
+        otherTLSOptions.disable_session_resumption = true;
+        REQUIRE(connect(port, otherTLSOptions) == full);
+        REQUIRE(connect(port, otherTLSOptions) == full);
+
+        clearTLSSessionCache();
+        REQUIRE(connect(port, tlsOptionsClient) == full);
+    }
+
+    SECTION("Tickets of the previous key are accepted")
+    {
+        REQUIRE(connect(port, tlsOptionsClient) == full);
+
+        rotateTLSTicketKeys();
+        REQUIRE(connect(port, tlsOptionsClient) == resumed);
+
+        // The ticket was renewed with the current key
+        rotateTLSTicketKeys();
+        REQUIRE(connect(port, tlsOptionsClient) == resumed);
+
+        rotateTLSTicketKeys();
+        rotateTLSTicketKeys();
+        REQUIRE(connect(port, tlsOptionsClient) == full);
+        REQUIRE(connect(port, tlsOptionsClient) == resumed);
+    }
+
+    SECTION("Servers can disable resumption")
+    {
+        ix::HttpServer otherServer(getFreePort(), "127.0.0.1");
+        SocketTLSOptions otherTLSOptions(tlsOptionsServer);
+        otherTLSOptions.disable_session_resumption = true;
+        otherServer.setTLSOptions(otherTLSOptions);
+        REQUIRE(otherServer.listen().first);
+        otherServer.start();
+
+        REQUIRE(connect(otherServer.getPort(), tlsOptionsClient) == full);
+        REQUIRE(connect(otherServer.getPort(), tlsOptionsClient) == full);
+
+        otherServer.stop();
+    }
+
+    server.stop();
+}
+#endif
@@ -0,0 +1,104 @@
+/*
+ *  IXWebSocketMaskTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include "catch.hpp"
+#include <ixwebsocket/IXWebSocketMask.h>
+#include <vector>
+
+using namespace ix;
+
+namespace ix
+{
+    // Reference byte by byte implementation
+    std::vector<uint8_t> maskBytes(const uint8_t* src, size_t size, const uint8_t* maskingKey)
+    {
+        std::vector<uint8_t> dst(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            dst[i] = src[i] ^ maskingKey[i & 0x3];
+        }
+        return dst;
+    }
+
+    TEST_CASE("websocket_mask", "[websocket_mask]")
+    {
+        const uint8_t maskingKey[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+        // Extra room so that buffers can start at unaligned offsets
+        const size_t maxSize = 1100;
+        const size_t maxOffset = 33;
+        std::vector<uint8_t> input(maxSize + maxOffset);
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+            input[i] = (uint8_t) (i * 31 + 7);
+        }
+
+        std::vector<size_t> sizes;
+        for (size_t size = 0; size <= 300; ++size)
+        {
+            sizes.push_back(size);
+        }
+        sizes.push_back(511);
+        sizes.push_back(1024);
+        sizes.push_back(maxSize);
+
+        auto implementations = getWebSocketMaskImplementations();
+        REQUIRE(!implementations.empty());
+        REQUIRE(implementations.back().first == getWebSocketMaskImplementation());
+
+        SECTION("Every implementation matches the byte by byte version")
+        {
+            for (auto&& implementation : implementations)
+            {
+                INFO("implementation: " << implementation.first);
+
+                for (size_t offset = 0; offset < maxOffset; ++offset)
+                {
+                    for (auto size : sizes)
+                    {
+                        INFO("offset: " << offset << " size: " << size);
+
+                        const uint8_t* src = &input[offset];
+                        std::vector<uint8_t> expected = maskBytes(src, size, maskingKey);
+
+                        // Into another buffer, with a different alignment
+                        std::vector<uint8_t> output(size + maxOffset);
+                        uint8_t* dst = &output[(offset * 7) % maxOffset];
+                        implementation.second(src, dst, size, maskingKey);
+                        REQUIRE(std::vector<uint8_t>(dst, dst + size) == expected);
+
+                        // In place
+                        std::vector<uint8_t> buffer(input);
+                        uint8_t* data = &buffer[offset];
+                        implementation.second(data, data, size, maskingKey);
+                        REQUIRE(std::vector<uint8_t>(data, data + size) == expected);
+
+                        // Masking twice gives back the input
+                        implementation.second(data, data, size, maskingKey);
+                        REQUIRE(buffer == input);
+                    }
+                }
+            }
+        }
+
+        SECTION("webSocketMask")
+        {
+            for (size_t offset = 0; offset < 8; ++offset)
+            {
+                for (auto size : sizes)
+                {
+                    std::vector<uint8_t> buffer(input);
+                    uint8_t* data = &buffer[offset];
+                    webSocketMask(data, data, size, maskingKey);
+                    REQUIRE(std::vector<uint8_t>(data, data + size) ==
+                            maskBytes(&input[offset], size, maskingKey));
+                }
+            }
+        }
+    }
+
+} // namespace ix
@@ -9,7 +9,9 @@
 #include "IXTest.h"
 #include "catch.hpp"
 #include <iostream>
+#include <ixwebsocket/IXWebSocketPerMessageDeflate.h>
 #include <ixwebsocket/IXWebSocketPerMessageDeflateCodec.h>
+#include <ixwebsocket/IXWebSocketPerMessageDeflateOptions.h>
 #include <string.h>
 
 using namespace ix;
@@ -48,6 +50,28 @@ namespace ix
         return c;
     }
 
+    // zlib codec counting the codecs it creates
+    class CountingCodec : public WebSocketCompressionCodec
+    {
+    public:
+        std::unique_ptr<WebSocketCompressor> createCompressor() const final
+        {
+            created++;
+            return _zlibCodec.createCompressor();
+        }
+
+        std::unique_ptr<WebSocketDecompressor> createDecompressor() const final
+        {
+            created++;
+            return _zlibCodec.createDecompressor();
+        }
+
+        mutable std::atomic<int> created {0};
+
+    private:
+        WebSocketZlibCodec _zlibCodec;
+    };
+
     TEST_CASE("per-message-deflate-codec", "[zlib]")
     {
         SECTION("string api")
@@ -71,6 +95,201 @@ namespace ix
                 compressAndDecompressVector("/usr/local/include/ixwebsocket/IXSocketAppleSSL.h") ==
                 "/usr/local/include/ixwebsocket/IXSocketAppleSSL.h");
         }
+
+        SECTION("output buffer reused for messages of any size")
+        {
+            std::string random(256 * 1024, 0);
+            for (size_t i = 0; i < random.size(); ++i)
+            {
+                random[i] = (char) ((i * 2654435761u) >> 13);
+            }
+
+            WebSocketPerMessageDeflateCompressor compressor;
+            REQUIRE(compressor.init(11, true));
+            WebSocketPerMessageDeflateDecompressor decompressor;
+            REQUIRE(decompressor.init(11, true));
+
+            // Larger, then smaller than the previous output
+            std::string compressed, decompressed;
+            for (auto message : {std::string(100 * 1024, 'a'), random, std::string("foo")})
+            {
+                REQUIRE(compressor.compress(message, compressed));
+                REQUIRE(decompressor.decompress(compressed, decompressed));
+                REQUIRE(decompressed == message);
+            }
+        }
+
+        SECTION("incompressible messages")
+        {
+            std::string random(4096, 0);
+            uint32_t seed = 42;
+            for (auto&& c : random)
+            {
+                seed = seed * 1103515245u + 12345u;
+                c = (char) (seed >> 16);
+            }
+
+            std::string json;
+            for (int i = 0; json.size() < 4096; ++i)
+            {
+                json += "{\"id\":" + std::to_string(i) + ",\"name\":\"user\"},";
+            }
+
+            REQUIRE(WebSocketPerMessageDeflateCompressor::isIncompressible(random.data(),
+                                                                           random.size()));
+            REQUIRE(!WebSocketPerMessageDeflateCompressor::isIncompressible(json.data(),
+                                                                            json.size()));
+
+            // Too small to be sampled
+            REQUIRE(!WebSocketPerMessageDeflateCompressor::isIncompressible(random.data(), 100));
+        }
+
+        SECTION("memory level, window size and lazy allocation")
+        {
+            WebSocketPerMessageDeflateCompressor defaultCompressor;
+            REQUIRE(defaultCompressor.init(15, false));
+            REQUIRE(defaultCompressor.isAllocated());
+
+            WebSocketPerMessageDeflateCompressor compressor;
+            REQUIRE(compressor.init(10, true, 1, true));
+            REQUIRE(!compressor.isAllocated());
+            REQUIRE(compressor.getMemoryUsage() == 0);
+
+            WebSocketPerMessageDeflateDecompressor decompressor;
+            REQUIRE(decompressor.init(10, true, true));
+            REQUIRE(decompressor.getMemoryUsage() == 0);
+
+            std::string message(10000, 'a');
+            std::string compressed, decompressed;
+            for (int i = 0; i < 2; ++i)
+            {
+                REQUIRE(compressor.compress(message, compressed));
+                REQUIRE(decompressor.decompress(compressed, decompressed));
+                REQUIRE(decompressed == message);
+
+                REQUIRE(compressor.isAllocated());
+                REQUIRE(compressor.getMemoryUsage() > 0);
+                REQUIRE(compressor.getMemoryUsage() < defaultCompressor.getMemoryUsage() / 4);
+                REQUIRE(decompressor.getMemoryUsage() > 0);
+
+                // Allocated again by the next message
+                compressor.release();
+                REQUIRE(decompressor.release());
+                REQUIRE(compressor.getMemoryUsage() == 0);
+                REQUIRE(decompressor.getMemoryUsage() == 0);
+            }
+
+            // The state of a decompressor with context takeover is kept
+            WebSocketPerMessageDeflateDecompressor contextDecompressor;
+            REQUIRE(contextDecompressor.init(15, false));
+            REQUIRE(!contextDecompressor.release());
+            REQUIRE(contextDecompressor.isAllocated());
+        }
+
+        SECTION("server policy")
+        {
+            WebSocketPerMessageDeflateOptions policy(true, true, false, 15, 10);
+
+            WebSocketPerMessageDeflateOptions offer(std::string(
+                "permessage-deflate; server_no_context_takeover; client_max_window_bits"));
+            auto response = policy.negotiate(offer);
+            REQUIRE(response.enabled());
+            REQUIRE(response.getClientNoContextTakeover());
+            REQUIRE(response.getServerNoContextTakeover());
+            REQUIRE(response.getServerMaxWindowBits() == 10);
+            REQUIRE(response.getClientMaxWindowBits() == 15);
+
+            // The client window is only reduced when the client offered it
+            WebSocketPerMessageDeflateOptions smallPolicy(true, false, false, 9, 9);
+            response = smallPolicy.negotiate(offer);
+            REQUIRE(response.getClientMaxWindowBits() == 9);
+
+            response = smallPolicy.negotiate(
+                WebSocketPerMessageDeflateOptions(std::string("permessage-deflate")));
+            REQUIRE(response.getClientMaxWindowBits() == 15);
+            REQUIRE(!response.getClientNoContextTakeover());
+
+            // Nor is it part of the response
+            REQUIRE(response.generateHeader() ==
+                    "Sec-WebSocket-Extensions: permessage-deflate; "
+                    "server_max_window_bits=9\r\n");
+        }
+
+        SECTION("final blocks")
+        {
+            // Messages of encoders which do not keep a stream between messages end with
+            // a final block, here stored blocks with BFINAL set
+            const std::string first("\x01\x05\x00\xfa\xff"
+                                    "hello",
+                                    10);
+            const std::string second("\x01\x03\x00\xfc\xff"
+                                     "abc",
+                                     8);
+
+            for (bool noContextTakeOver : {false, true})
+            {
+                WebSocketPerMessageDeflateDecompressor decompressor;
+                REQUIRE(decompressor.init(15, noContextTakeOver));
+
+                std::string decompressed;
+                REQUIRE(decompressor.decompress(first, decompressed));
+                REQUIRE(decompressed == "hello");
+                REQUIRE(decompressor.decompress(second, decompressed));
+                REQUIRE(decompressed == "abc");
+            }
+        }
+
+        SECTION("custom codec")
+        {
+            auto codec = std::make_shared<CountingCodec>();
+
+            WebSocketPerMessageDeflateOptions options(true);
+            options.setCodec(codec);
+            REQUIRE(options.getCodec() == codec);
+
+            // Local settings are kept by the negotiated options
+            auto response = WebSocketPerMessageDeflateOptions(true).negotiate(options);
+            REQUIRE(response.getCodec() != codec);
+            response.copyLocalSettings(options);
+            REQUIRE(response.getCodec() == codec);
+
+            WebSocketPerMessageDeflate client;
+            WebSocketPerMessageDeflate server;
+            REQUIRE(client.init(response));
+            REQUIRE(server.init(response, true));
+            REQUIRE(codec->created == 4);
+
+            std::string message(1000, 'x');
+            std::string compressed, decompressed;
+            REQUIRE(client.compress(message, compressed));
+            REQUIRE(server.decompress(compressed, decompressed));
+            REQUIRE(decompressed == message);
+            REQUIRE(client.getStats().memory > 0);
+        }
+
+        SECTION("several offers")
+        {
+            WebSocketPerMessageDeflateOptions offer(
+                std::string("x-permessage-zstd; dictionary_id=7, permessage-deflate; "
+                            "client_max_window_bits=10, permessage-deflate"));
+            REQUIRE(offer.enabled());
+            REQUIRE(offer.getClientMaxWindowBits() == 10);
+            REQUIRE(offer.getZstdDictionaryId() == 7);
+
+            // zstd is declined by servers which do not enable it
+            WebSocketPerMessageDeflateOptions policy(true);
+            auto response = policy.negotiate(offer);
+            REQUIRE(response.enabled());
+            REQUIRE(!response.isZstdEnabled());
+            REQUIRE(response.getClientMaxWindowBits() == 10);
+            REQUIRE(response.generateHeader() ==
+                    "Sec-WebSocket-Extensions: permessage-deflate; server_max_window_bits=15; "
+                    "client_max_window_bits=10\r\n");
+
+            // Unknown extensions are ignored
+            WebSocketPerMessageDeflateOptions other(std::string("x-webkit-deflate-frame"));
+            REQUIRE(!other.enabled());
+        }
     }
 
 } // namespace ix
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <ixwebsocket/IXSocket.h>
 #include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXUniquePtr.h>
 #include <ixwebsocket/IXWebSocket.h>
 #include <ixwebsocket/IXWebSocketServer.h>
 
@@ -196,3 +197,1092 @@ TEST_CASE("Websocket_server", "[websocket_server]")
         REQUIRE(server.getClients().size() == 0);
     }
 }
+
+TEST_CASE("Websocket_server_event_loop", "[websocket_server]")
+{
+    SECTION("Echo messages with connections driven by the event loop")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.enableEventLoop(2, 2);
+        REQUIRE(server.isEventLoopEnabled());
+
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.send(msg->str, msg->binary);
+                }
+            });
+
+        REQUIRE(server.listenAndStart());
+
+        const int clientCount = 20;
+        std::atomic<int> openCount(0);
+        std::atomic<int> receivedCount(0);
+        std::vector<std::unique_ptr<ix::WebSocket>> clients;
+
+        for (int i = 0; i < clientCount; ++i)
+        {
+            auto webSocket = ix::make_unique<ix::WebSocket>();
+            webSocket->setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+            webSocket->disableAutomaticReconnection();
+
+            ix::WebSocket* webSocketPtr = webSocket.get();
+            webSocket->setOnMessageCallback(
+                [webSocketPtr, i, &openCount, &receivedCount](const ix::WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Open)
+                    {
+                        openCount++;
+                        webSocketPtr->sendText("hello " + std::to_string(i));
+                    }
+                    else if (msg->type == ix::WebSocketMessageType::Message)
+                    {
+                        if (msg->str == "hello " + std::to_string(i))
+                        {
+                            receivedCount++;
+                        }
+                    }
+                });
+            webSocket->start();
+            clients.push_back(std::move(webSocket));
+        }
+
+        for (int i = 0; i < 500 && receivedCount != clientCount; ++i)
+        {
+            ix::msleep(10);
+        }
+
+        REQUIRE(openCount == clientCount);
+        REQUIRE(receivedCount == clientCount);
+        REQUIRE(server.getClients().size() == clientCount);
+
+        // Half of the clients close their connection, the server should notice
+        for (int i = 0; i < clientCount / 2; ++i)
+        {
+            clients[i]->stop();
+        }
+
+        for (int i = 0; i < 500 && server.getClients().size() != clientCount / 2; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(server.getClients().size() == clientCount / 2);
+
+        // The server closes the remaining ones
+        server.stop();
+        REQUIRE(server.getClients().size() == 0);
+
+        clients.clear();
+    }
+
+    SECTION("A peer which does not read does not stall the other connections")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.disablePerMessageDeflate();
+        server.enableEventLoop(1, 1);
+
+        std::atomic<size_t> slowBufferedAmount(0);
+        server.setOnClientMessageCallback(
+            [&slowBufferedAmount](std::shared_ptr<ConnectionState> /*connectionState*/,
+                                  WebSocket& webSocket,
+                                  const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open && msg->openInfo.uri == "/slow")
+                {
+                    // Much more than what the socket buffers can hold
+                    webSocket.sendBinary(std::string(32 * 1024 * 1024, 'x'));
+                    slowBufferedAmount = webSocket.bufferedAmount();
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.send(msg->str, msg->binary);
+                }
+            });
+
+        REQUIRE(server.listenAndStart());
+
+        std::string errMsg;
+        SocketTLSOptions tlsOptions;
+        std::shared_ptr<Socket> socket = createSocket(false, -1, errMsg, tlsOptions);
+        auto isCancellationRequested = []() -> bool { return false; };
+        REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+
+        socket->writeBytes("GET /slow HTTP/1.1\r\n"
+                           "Upgrade: websocket\r\n"
+                           "Sec-WebSocket-Version: 13\r\n"
+                           "Sec-WebSocket-Key: foobar\r\n"
+                           "\r\n",
+                           isCancellationRequested);
+        auto lineResult = socket->readLine(isCancellationRequested);
+        REQUIRE(lineResult.first);
+
+        for (int i = 0; i < 500 && slowBufferedAmount == 0; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(slowBufferedAmount > 0);
+
+        // The slow connection is never read, the echo still goes through the I/O thread
+        std::atomic<bool> echoed(false);
+        ix::WebSocket webSocket;
+        webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        webSocket.disableAutomaticReconnection();
+        webSocket.setOnMessageCallback([&webSocket, &echoed](const ix::WebSocketMessagePtr& msg) {
+            if (msg->type == ix::WebSocketMessageType::Open)
+            {
+                webSocket.sendText("hello");
+            }
+            else if (msg->type == ix::WebSocketMessageType::Message && msg->str == "hello")
+            {
+                echoed = true;
+            }
+        });
+        webSocket.start();
+
+        for (int i = 0; i < 300 && !echoed; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(echoed);
+
+        webSocket.stop();
+        socket->close();
+        server.stop();
+        REQUIRE(server.getClients().size() == 0);
+    }
+
+    SECTION("Connections waiting for their handshake count against the max connections")
+    {
+        int port = getFreePort();
+        size_t maxConnections = 2;
+        int handshakeTimeoutSecs = 1;
+        ix::WebSocketServer server(port,
+                                   SocketServer::kDefaultHost,
+                                   SocketServer::kDefaultTcpBacklog,
+                                   maxConnections,
+                                   handshakeTimeoutSecs);
+        server.enableEventLoop(1, 1);
+        server.setOnClientMessageCallback([](std::shared_ptr<ConnectionState> /*connectionState*/,
+                                             WebSocket& /*webSocket*/,
+                                             const ix::WebSocketMessagePtr& /*msg*/) {});
+        REQUIRE(server.listenAndStart());
+
+        // Peers which never send their handshake: one is handled, the other one queued
+        std::string errMsg;
+        SocketTLSOptions tlsOptions;
+        auto isCancellationRequested = []() -> bool { return false; };
+        std::vector<std::shared_ptr<Socket>> sockets;
+        for (size_t i = 0; i < maxConnections; ++i)
+        {
+            std::shared_ptr<Socket> socket = createSocket(false, -1, errMsg, tlsOptions);
+            REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+            sockets.push_back(socket);
+        }
+        ix::msleep(200);
+
+        // Closed right away, instead of waiting for an handshake thread
+        std::shared_ptr<Socket> socket = createSocket(false, -1, errMsg, tlsOptions);
+        REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+        auto lineResult = socket->readLine(isCancellationRequested);
+        REQUIRE(!lineResult.first);
+
+        // The handshake of the accepted ones times out
+        for (auto&& accepted : sockets)
+        {
+            lineResult = accepted->readLine(isCancellationRequested);
+            REQUIRE(lineResult.first);
+
+            int status = -1;
+            REQUIRE(sscanf(lineResult.second.c_str(), "HTTP/1.1 %d", &status) == 1);
+            REQUIRE(status == 400);
+        }
+
+        server.stop();
+        REQUIRE(server.getClients().size() == 0);
+    }
+}
+
+TEST_CASE("Websocket_server_shared_send_data", "[websocket_server]")
+{
+    SECTION("Large messages echoed with buffers shared with the send queue")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.disablePerMessageDeflate();
+
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    auto data = std::make_shared<std::string>(msg->str);
+                    webSocket.sendBinary(IXWebSocketSendData(data));
+                }
+            });
+
+        REQUIRE(server.listenAndStart());
+
+        // Messages larger than the socket buffers, so that the send queue fills up
+        const int messageCount = 20;
+        std::vector<std::string> messages;
+        for (int i = 0; i < messageCount; ++i)
+        {
+            messages.push_back(std::string(256 * 1024 + i * 1000, (char) ('a' + i)));
+        }
+
+        std::atomic<bool> connected(false);
+        std::atomic<int> receivedCount(0);
+        std::atomic<int> mismatchCount(0);
+
+        ix::WebSocket webSocket;
+        webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        webSocket.disableAutomaticReconnection();
+        webSocket.disablePerMessageDeflate();
+        webSocket.setOnMessageCallback(
+            [&connected, &receivedCount, &mismatchCount, &messages](
+                const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    connected = true;
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    if (msg->str != messages[receivedCount]) mismatchCount++;
+                    receivedCount++;
+                }
+            });
+        webSocket.start();
+
+        for (int i = 0; i < 500 && !connected; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(connected);
+
+        for (auto&& message : messages)
+        {
+            REQUIRE(webSocket.sendBinary(message).success);
+        }
+
+        for (int i = 0; i < 1000 && receivedCount != messageCount; ++i)
+        {
+            ix::msleep(10);
+        }
+
+        REQUIRE(receivedCount == messageCount);
+        REQUIRE(mismatchCount == 0);
+
+        webSocket.stop();
+        server.stop();
+    }
+}
+
+TEST_CASE("Websocket_server_broadcast", "[websocket_server]")
+{
+    SECTION("Broadcast to clients with different compression settings")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& /*webSocket*/,
+               const ix::WebSocketMessagePtr& /*msg*/) {});
+        REQUIRE(server.listenAndStart());
+
+        // Context takeover (default), no context takeover with two window sizes, and
+        // no compression at all
+        std::vector<ix::WebSocketPerMessageDeflateOptions> options;
+        options.push_back(ix::WebSocketPerMessageDeflateOptions(true));
+        options.push_back(ix::WebSocketPerMessageDeflateOptions(true, true, true));
+        options.push_back(ix::WebSocketPerMessageDeflateOptions(true, true, true, 12, 12));
+        options.push_back(ix::WebSocketPerMessageDeflateOptions(false));
+
+        const int clientCount = (int) options.size();
+        std::atomic<int> openCount(0);
+        std::vector<std::unique_ptr<ix::WebSocket>> clients;
+        std::vector<std::vector<std::string>> received(clientCount);
+        std::mutex receivedMutex;
+
+        for (int i = 0; i < clientCount; ++i)
+        {
+            auto webSocket = ix::make_unique<ix::WebSocket>();
+            webSocket->setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+            webSocket->disableAutomaticReconnection();
+            webSocket->setPerMessageDeflateOptions(options[i]);
+            webSocket->setOnMessageCallback(
+                [i, &openCount, &received, &receivedMutex](const ix::WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Open)
+                    {
+                        openCount++;
+                    }
+                    else if (msg->type == ix::WebSocketMessageType::Message)
+                    {
+                        std::lock_guard<std::mutex> lock(receivedMutex);
+                        received[i].push_back(msg->str);
+                    }
+                });
+            webSocket->start();
+            clients.push_back(std::move(webSocket));
+        }
+
+        for (int i = 0; i < 500 && (openCount != clientCount ||
+                                    (int) server.getClients().size() != clientCount);
+             ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(openCount == clientCount);
+        REQUIRE((int) server.getClients().size() == clientCount);
+
+        // Interleave broadcasts with messages sent to each client, which use the
+        // per connection compressor
+        const int messageCount = 50;
+        std::vector<std::string> expected;
+        for (int i = 0; i < messageCount; ++i)
+        {
+            std::string message;
+            for (int j = 0; j < 100; ++j)
+            {
+                message += "broadcast message " + std::to_string(i) + " ";
+            }
+            expected.push_back(message);
+            REQUIRE(server.broadcast(message, false) == (size_t) clientCount);
+
+            std::string direct = "direct message " + std::to_string(i);
+            expected.push_back(direct);
+            for (auto&& client : server.getClients())
+            {
+                REQUIRE(client->sendText(direct).success);
+            }
+        }
+
+        // Invalid UTF-8 is rejected before anything is sent
+        REQUIRE(server.broadcast(std::string("\xff\xfe"), false) == 0);
+
+        auto isDone = [&]() {
+            std::lock_guard<std::mutex> lock(receivedMutex);
+            for (auto&& messages : received)
+            {
+                if (messages.size() != expected.size()) return false;
+            }
+            return true;
+        };
+
+        for (int i = 0; i < 500 && !isDone(); ++i)
+        {
+            ix::msleep(10);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(receivedMutex);
+            for (auto&& messages : received)
+            {
+                REQUIRE(messages == expected);
+            }
+        }
+
+        for (auto&& client : clients)
+        {
+            client->stop();
+        }
+        server.stop();
+    }
+}
+
+TEST_CASE("Websocket_server_clients_snapshot", "[websocket_server]")
+{
+    SECTION("Broadcast and iterate while clients connect and disconnect")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& /*webSocket*/,
+               const ix::WebSocketMessagePtr& /*msg*/) {});
+        REQUIRE(server.listenAndStart());
+
+        const int threadCount = 4;
+        const int connectionsPerThread = 25;
+        std::atomic<bool> stop(false);
+        std::atomic<int> openCount(0);
+        std::atomic<int> receivedCount(0);
+
+        // Writers: clients repeatedly connecting and disconnecting
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.push_back(std::thread([port, &openCount, &receivedCount]() {
+                for (int i = 0; i < connectionsPerThread; ++i)
+                {
+                    std::atomic<bool> connected(false);
+                    ix::WebSocket webSocket;
+                    webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+                    webSocket.disableAutomaticReconnection();
+                    webSocket.setOnMessageCallback(
+                        [&connected, &receivedCount](const ix::WebSocketMessagePtr& msg) {
+                            if (msg->type == ix::WebSocketMessageType::Open)
+                            {
+                                connected = true;
+                            }
+                            else if (msg->type == ix::WebSocketMessageType::Message)
+                            {
+                                receivedCount++;
+                            }
+                        });
+                    webSocket.start();
+
+                    for (int j = 0; j < 500 && !connected; ++j)
+                    {
+                        ix::msleep(1);
+                    }
+                    if (connected) openCount++;
+
+                    ix::msleep(5);
+                    webSocket.stop();
+                }
+            }));
+        }
+
+        // Readers: broadcast loops and client iterations. Failures are only checked
+        // once the writers are joined, a throwing REQUIRE would leave them joinable.
+        // A client is removed by the server a bit after the stop() of its writer, so
+        // the snapshots are not bounded by the number of writers.
+        std::atomic<bool> failed(false);
+        size_t broadcastCount = 0;
+        size_t visitedCount = 0;
+        while (openCount < threadCount * connectionsPerThread && broadcastCount < 1000000)
+        {
+            server.broadcast(std::string("hello"), false);
+            broadcastCount++;
+
+            server.forEachClient(
+                [&visitedCount, &failed](const std::shared_ptr<WebSocket>& client) {
+                    if (!client) failed = true;
+                    visitedCount++;
+                });
+
+            auto snapshot = server.getClientsSnapshot();
+            if (snapshot->size() > (size_t) (threadCount * connectionsPerThread)) failed = true;
+        }
+
+        for (auto&& thread : threads)
+        {
+            thread.join();
+        }
+
+        REQUIRE(!failed);
+
+        TLogger() << "broadcasts: " << broadcastCount << " visited clients: " << visitedCount
+                  << " received messages: " << receivedCount;
+
+        REQUIRE(openCount == threadCount * connectionsPerThread);
+        REQUIRE(broadcastCount > 0);
+
+        // All the clients are gone
+        for (int i = 0; i < 500 && !server.getClients().empty(); ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(server.getClients().empty());
+        REQUIRE(server.getClientsSnapshot()->empty());
+
+        server.stop();
+    }
+}
+
+TEST_CASE("Websocket_server_handshake_leftover", "[websocket_server]")
+{
+    // A frame sent along with the handshake request is received by the read ahead
+    // buffer used to parse the http headers, it must be handed over to the transport
+    for (int ioThreads = 0; ioThreads <= 1; ++ioThreads)
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        if (ioThreads > 0)
+        {
+            server.enableEventLoop((size_t) ioThreads);
+        }
+
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.send(msg->str, msg->binary);
+                }
+            });
+        REQUIRE(server.listenAndStart());
+
+        std::string errMsg;
+        bool tls = false;
+        SocketTLSOptions tlsOptions;
+        std::shared_ptr<Socket> socket = createSocket(tls, -1, errMsg, tlsOptions);
+        auto isCancellationRequested = []() -> bool { return false; };
+        REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+
+        // Masked text frame with a 'hello' payload
+        const char maskingKey[4] = {0x12, 0x34, 0x56, 0x78};
+        std::string payload("hello");
+        std::string frame;
+        frame.push_back((char) 0x81);
+        frame.push_back((char) (0x80 | payload.size()));
+        frame.append(maskingKey, 4);
+        for (size_t i = 0; i < payload.size(); ++i)
+        {
+            frame.push_back(payload[i] ^ maskingKey[i & 0x3]);
+        }
+
+        REQUIRE(socket->writeBytes("GET / HTTP/1.1\r\n"
+                                   "Upgrade: websocket\r\n"
+                                   "Connection: Upgrade\r\n"
+                                   "Sec-WebSocket-Version: 13\r\n"
+                                   "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                   "\r\n" +
+                                       frame,
+                                   isCancellationRequested));
+
+        auto lineResult = socket->readLine(isCancellationRequested);
+        REQUIRE(lineResult.first);
+        REQUIRE(lineResult.second.compare(0, 12, "HTTP/1.1 101") == 0);
+
+        while (lineResult.first && lineResult.second != "\r\n")
+        {
+            lineResult = socket->readLine(isCancellationRequested);
+        }
+        REQUIRE(lineResult.first);
+
+        // Unmasked echo
+        auto echo = socket->readBytes(2 + payload.size(), nullptr, nullptr, isCancellationRequested);
+        REQUIRE(echo.first);
+        REQUIRE(echo.second == std::string("\x81\x05hello"));
+
+        socket->close();
+        server.stop();
+    }
+}
+
+TEST_CASE("Websocket_server_message_streaming", "[websocket_server]")
+{
+    // Reassemble the parts of the streamed messages, checking their offsets
+    struct StreamedMessages
+    {
+        std::mutex mutex;
+        std::vector<std::string> messages;
+        std::string current;
+        size_t partCount = 0;
+        size_t errorCount = 0;
+
+        void add(const ix::WebSocketMessagePtr& msg)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (msg->offset != current.size() || msg->errorInfo.decompressionError)
+            {
+                errorCount++;
+            }
+            current += msg->str;
+            partCount++;
+
+            if (msg->last)
+            {
+                messages.push_back(std::move(current));
+                current.clear();
+            }
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return messages.size();
+        }
+    };
+
+    auto connect = [](ix::WebSocket& webSocket, int port, bool compress, std::atomic<bool>& open)
+    {
+        webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        webSocket.disableAutomaticReconnection();
+        if (!compress) webSocket.disablePerMessageDeflate();
+        webSocket.start();
+
+        for (int i = 0; i < 500 && !open; ++i)
+        {
+            ix::msleep(10);
+        }
+        return open.load();
+    };
+
+    std::string binary(8 * 1024 * 1024, 0);
+    for (size_t i = 0; i < binary.size(); ++i)
+    {
+        binary[i] = (char) (i * 7 + i / 4096);
+    }
+
+    // Multi bytes characters are split between fragments
+    std::string text;
+    while (text.size() < 1024 * 1024)
+    {
+        text += "streamed \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 message ";
+    }
+
+    SECTION("Large messages are received in parts by the server")
+    {
+        for (bool compress : {false, true})
+        {
+            int port = getFreePort();
+            ix::WebSocketServer server(port);
+            server.enableMessageStreaming();
+
+            StreamedMessages streamed;
+            server.setOnClientMessageCallback(
+                [&streamed](std::shared_ptr<ConnectionState> /*connectionState*/,
+                            WebSocket& /*webSocket*/,
+                            const ix::WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Fragment)
+                    {
+                        streamed.add(msg);
+                    }
+                });
+            REQUIRE(server.listenAndStart());
+
+            std::atomic<bool> open(false);
+            ix::WebSocket webSocket;
+            webSocket.setOnMessageCallback([&open](const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open) open = true;
+            });
+            REQUIRE(connect(webSocket, port, compress, open));
+
+            REQUIRE(webSocket.sendBinary(binary).success);
+            REQUIRE(webSocket.sendText(text).success);
+            REQUIRE(webSocket.sendText("").success);
+
+            for (int i = 0; i < 1000 && streamed.size() != 3; ++i)
+            {
+                ix::msleep(10);
+            }
+
+            REQUIRE(streamed.size() == 3);
+            REQUIRE(streamed.errorCount == 0);
+            REQUIRE(streamed.partCount > 3);
+            REQUIRE(streamed.messages[0] == binary);
+            REQUIRE(streamed.messages[1] == text);
+            REQUIRE(streamed.messages[2].empty());
+
+            webSocket.stop();
+            server.stop();
+        }
+    }
+
+    SECTION("A large single frame is received in parts by the client")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.disablePerMessageDeflate();
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& /*webSocket*/,
+               const ix::WebSocketMessagePtr& /*msg*/) {});
+        REQUIRE(server.listenAndStart());
+
+        std::atomic<bool> open(false);
+        StreamedMessages streamed;
+        ix::WebSocket webSocket;
+        webSocket.enableMessageStreaming();
+        webSocket.setOnMessageCallback([&open, &streamed](const ix::WebSocketMessagePtr& msg) {
+            if (msg->type == ix::WebSocketMessageType::Open)
+            {
+                open = true;
+            }
+            else if (msg->type == ix::WebSocketMessageType::Fragment)
+            {
+                streamed.add(msg);
+            }
+        });
+        REQUIRE(connect(webSocket, port, false, open));
+
+        for (int i = 0; i < 500 && server.getClients().size() != 1; ++i)
+        {
+            ix::msleep(10);
+        }
+
+        // Broadcasts are sent as a single frame
+        REQUIRE(server.broadcast(binary, true) == 1);
+
+        for (int i = 0; i < 1000 && streamed.size() != 1; ++i)
+        {
+            ix::msleep(10);
+        }
+
+        REQUIRE(streamed.size() == 1);
+        REQUIRE(streamed.errorCount == 0);
+        REQUIRE(streamed.partCount > 1);
+        REQUIRE(streamed.messages[0] == binary);
+
+        webSocket.stop();
+        server.stop();
+    }
+
+    SECTION("Messages larger than the maximum size close the connection")
+    {
+        for (bool streaming : {false, true})
+        {
+            int port = getFreePort();
+            ix::WebSocketServer server(port);
+            server.setMaxMessageSize(1024 * 1024);
+            if (streaming) server.enableMessageStreaming();
+
+            std::atomic<int> receivedCount(0);
+            server.setOnClientMessageCallback(
+                [&receivedCount](std::shared_ptr<ConnectionState> /*connectionState*/,
+                                 WebSocket& /*webSocket*/,
+                                 const ix::WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Message ||
+                        (msg->type == ix::WebSocketMessageType::Fragment && msg->last))
+                    {
+                        receivedCount++;
+                    }
+                });
+            REQUIRE(server.listenAndStart());
+
+            std::atomic<bool> open(false);
+            std::atomic<int> closeCode(0);
+            ix::WebSocket webSocket;
+            webSocket.setOnMessageCallback([&open, &closeCode](const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == ix::WebSocketMessageType::Close)
+                {
+                    closeCode = msg->closeInfo.code;
+                }
+            });
+            REQUIRE(connect(webSocket, port, false, open));
+
+            REQUIRE(webSocket.sendBinary(std::string(1024 * 1024, 'a')).success);
+            for (int i = 0; i < 500 && receivedCount != 1; ++i)
+            {
+                ix::msleep(10);
+            }
+            REQUIRE(receivedCount == 1);
+
+            webSocket.sendBinary(binary);
+            for (int i = 0; i < 500 && closeCode == 0; ++i)
+            {
+                ix::msleep(10);
+            }
+
+            REQUIRE(closeCode == 1009);
+            REQUIRE(receivedCount == 1);
+
+            webSocket.stop();
+            server.stop();
+        }
+    }
+}
+
+TEST_CASE("Websocket_server_owned_messages", "[websocket_server]")
+{
+    SECTION("Messages are kept and forwarded without copying their payload")
+    {
+        for (bool compress : {false, true})
+        {
+            int port = getFreePort();
+            ix::WebSocketServer server(port);
+            server.enableOwnedMessages();
+            if (!compress) server.disablePerMessageDeflate();
+
+            std::atomic<int> notOwnedCount(0);
+            server.setOnClientMessageCallback(
+                [&notOwnedCount](std::shared_ptr<ConnectionState> /*connectionState*/,
+                                 WebSocket& webSocket,
+                                 const ix::WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Message)
+                    {
+                        if (!msg->payload || msg->str.data() != msg->payload->data())
+                        {
+                            notOwnedCount++;
+                            return;
+                        }
+                        webSocket.sendBinary(IXWebSocketSendData(msg->payload));
+                    }
+                });
+            REQUIRE(server.listenAndStart());
+
+            // Payloads taken by the client callback, checked once all are received
+            std::mutex payloadsMutex;
+            std::vector<std::shared_ptr<std::string>> payloads;
+            std::atomic<bool> open(false);
+
+            ix::WebSocket webSocket;
+            webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+            webSocket.disableAutomaticReconnection();
+            webSocket.enableOwnedMessages();
+            if (!compress) webSocket.disablePerMessageDeflate();
+            webSocket.setOnMessageCallback(
+                [&open, &payloads, &payloadsMutex](const ix::WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Open)
+                    {
+                        open = true;
+                    }
+                    else if (msg->type == ix::WebSocketMessageType::Message)
+                    {
+                        std::lock_guard<std::mutex> lock(payloadsMutex);
+                        payloads.push_back(std::move(msg->payload));
+                    }
+                });
+            webSocket.start();
+
+            for (int i = 0; i < 500 && !open; ++i)
+            {
+                ix::msleep(10);
+            }
+            REQUIRE(open);
+
+            // Small messages, and large ones which are sent in fragments
+            std::vector<std::string> messages;
+            for (int i = 0; i < 20; ++i)
+            {
+                size_t size = (i % 2 == 0) ? 100 + i : 100 * 1024 + i * 1000;
+                messages.push_back(std::string(size, (char) ('a' + i)));
+                REQUIRE(webSocket.sendBinary(messages.back()).success);
+            }
+
+            auto receivedCount = [&]() {
+                std::lock_guard<std::mutex> lock(payloadsMutex);
+                return payloads.size();
+            };
+
+            for (int i = 0; i < 500 && receivedCount() != messages.size(); ++i)
+            {
+                ix::msleep(10);
+            }
+
+            REQUIRE(notOwnedCount == 0);
+            REQUIRE(receivedCount() == messages.size());
+            for (size_t i = 0; i < messages.size(); ++i)
+            {
+                REQUIRE(payloads[i]);
+                REQUIRE(*payloads[i] == messages[i]);
+            }
+
+            // Buffers of the released payloads are reused
+            payloads.clear();
+            REQUIRE(webSocket.sendBinary(messages[1]).success);
+            for (int i = 0; i < 500 && receivedCount() != 1; ++i)
+            {
+                ix::msleep(10);
+            }
+            REQUIRE(receivedCount() == 1);
+            REQUIRE(webSocket.getBufferPoolStats().hits > 0);
+
+            webSocket.stop();
+            server.stop();
+        }
+    }
+}
+
+TEST_CASE("Websocket_server_compression_policy", "[websocket_server]")
+{
+    SECTION("Small and incompressible messages are sent uncompressed")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        server.setCompressionThreshold(1024);
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.sendBinary(msg->str);
+                }
+            });
+        REQUIRE(server.listenAndStart());
+
+        std::mutex receivedMutex;
+        std::vector<std::string> received;
+        std::atomic<bool> open(false);
+
+        ix::WebSocket webSocket;
+        webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        webSocket.disableAutomaticReconnection();
+        webSocket.setPerMessageDeflateOptions(ix::WebSocketPerMessageDeflateOptions(true));
+        webSocket.setCompressionThreshold(1024);
+        webSocket.setOnMessageCallback(
+            [&open, &received, &receivedMutex](const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    std::lock_guard<std::mutex> lock(receivedMutex);
+                    received.push_back(msg->str);
+                }
+            });
+        webSocket.start();
+
+        for (int i = 0; i < 500 && !open; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(open);
+
+        std::string random(64 * 1024, 0);
+        uint32_t seed = 42;
+        for (auto&& c : random)
+        {
+            seed = seed * 1103515245u + 12345u;
+            c = (char) (seed >> 16);
+        }
+
+        std::string json;
+        for (int i = 0; json.size() < 64 * 1024; ++i)
+        {
+            json += "{\"id\":" + std::to_string(i) + ",\"name\":\"user\"},";
+        }
+
+        std::string small(100, 'a');
+
+        // Only the large compressible message is compressed
+        std::vector<std::string> messages = {small, random, json, random, small};
+        for (auto&& message : messages)
+        {
+            auto sendInfo = webSocket.sendBinary(message);
+            REQUIRE(sendInfo.success);
+            if (&message == &messages[2])
+            {
+                REQUIRE(sendInfo.wireSize < message.size() / 2);
+            }
+            else
+            {
+                REQUIRE(sendInfo.wireSize == message.size());
+            }
+        }
+
+        auto receivedCount = [&]() {
+            std::lock_guard<std::mutex> lock(receivedMutex);
+            return received.size();
+        };
+
+        for (int i = 0; i < 500 && receivedCount() != messages.size(); ++i)
+        {
+            ix::msleep(10);
+        }
+
+        REQUIRE(receivedCount() == messages.size());
+        REQUIRE(received == messages);
+
+        webSocket.stop();
+        server.stop();
+    }
+}
+
+TEST_CASE("Websocket_server_compression_memory", "[websocket_server]")
+{
+    SECTION("zlib states are allocated on first use and freed when idle")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+
+        // Small windows and memory level, allocated lazily and freed after 1s
+        ix::WebSocketPerMessageDeflateOptions policy(true, true, true, 10, 10);
+        policy.setMemLevel(1);
+        policy.enableLazyAllocation(1);
+        server.setPerMessageDeflateOptions(policy);
+
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.sendText(msg->str);
+                }
+            });
+        REQUIRE(server.listenAndStart());
+
+        std::mutex receivedMutex;
+        std::vector<std::string> received;
+        std::atomic<bool> open(false);
+
+        ix::WebSocket webSocket;
+        webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        webSocket.disableAutomaticReconnection();
+        webSocket.setPerMessageDeflateOptions(ix::WebSocketPerMessageDeflateOptions(true));
+        webSocket.setOnMessageCallback(
+            [&open, &received, &receivedMutex](const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    std::lock_guard<std::mutex> lock(receivedMutex);
+                    received.push_back(msg->str);
+                }
+            });
+        webSocket.start();
+
+        for (int i = 0; i < 500 && !open; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(open);
+
+        auto stats = server.getPerMessageDeflateStats();
+        REQUIRE(stats.connections == 1);
+        REQUIRE(stats.compressors == 0);
+        REQUIRE(stats.decompressors == 0);
+        REQUIRE(stats.memory == 0);
+
+        auto receivedCount = [&]() {
+            std::lock_guard<std::mutex> lock(receivedMutex);
+            return received.size();
+        };
+
+        std::string message;
+        for (int i = 0; message.size() < 20000; ++i)
+        {
+            message += "{\"id\":" + std::to_string(i) + "},";
+        }
+
+        for (size_t count = 1; count <= 2; ++count)
+        {
+            auto sendInfo = webSocket.sendText(message);
+            REQUIRE(sendInfo.success);
+            REQUIRE(sendInfo.wireSize < message.size() / 2);
+
+            for (int i = 0; i < 500 && receivedCount() != count; ++i)
+            {
+                ix::msleep(10);
+            }
+            REQUIRE(receivedCount() == count);
+            REQUIRE(received.back() == message);
+
+            stats = server.getPerMessageDeflateStats();
+            REQUIRE(stats.compressors == 1);
+            REQUIRE(stats.decompressors == 1);
+            REQUIRE(stats.memory > 0);
+            REQUIRE(stats.getMemoryPerConnection() == stats.memory);
+
+            // Both states are freed once idle
+            for (int i = 0; i < 300 && server.getPerMessageDeflateStats().memory != 0; ++i)
+            {
+                ix::msleep(10);
+            }
+            stats = server.getPerMessageDeflateStats();
+            REQUIRE(stats.memory == 0);
+            REQUIRE(stats.releases == 2 * count);
+        }
+
+        REQUIRE(webSocket.getPerMessageDeflateStats().connections == 1);
+
+        webSocket.stop();
+        server.stop();
+    }
+}
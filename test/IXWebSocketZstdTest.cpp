@@ -0,0 +1,272 @@
+/*
+ *  IXWebSocketZstdTest.cpp
+ *  Author: agent
+ *  Copyright (c) 2026 agent. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include "catch.hpp"
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketPerMessageDeflate.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <ixwebsocket/IXWebSocketZstdCodec.h>
+
+using namespace ix;
+
+namespace
+{
+    std::string makeMessage(int i)
+    {
+        return "{\"type\":\"position\",\"player\":\"player-" + std::to_string(i % 50) +
+               "\",\"x\":" + std::to_string(i * 7 % 1000) +
+               ",\"y\":" + std::to_string(i * 13 % 1000) + ",\"visible\":true}";
+    }
+
+    std::string trainDictionary()
+    {
+        std::vector<std::string> samples;
+        for (int i = 0; i < 2000; ++i)
+        {
+            samples.push_back(makeMessage(i));
+        }
+        return WebSocketZstdCodec::trainDictionary(samples, 4096);
+    }
+} // namespace
+
+TEST_CASE("zstd_codec", "[zstd]")
+{
+    SECTION("messages compressed with and without dictionary")
+    {
+        std::string dictionary = trainDictionary();
+        REQUIRE(!dictionary.empty());
+
+        auto codec = WebSocketZstdCodec::create(3);
+        auto dictionaryCodec = WebSocketZstdCodec::create(3, dictionary);
+        REQUIRE(codec);
+        REQUIRE(dictionaryCodec);
+        REQUIRE(codec->getDictionaryId() == 0);
+        REQUIRE(dictionaryCodec->getDictionaryId() != 0);
+        REQUIRE(WebSocketZstdCodec::create(3, "not a dictionary")->getDictionaryId() != 0);
+
+        std::string message = makeMessage(12345);
+        std::string compressed, dictionaryCompressed, decompressed;
+
+        auto compressor = codec->createCompressor();
+        auto dictionaryCompressor = dictionaryCodec->createCompressor();
+        REQUIRE(compressor->init(15, false, 8, false));
+        REQUIRE(dictionaryCompressor->init(15, false, 8, true));
+        REQUIRE(!dictionaryCompressor->isAllocated());
+
+        REQUIRE(compressor->compress(message, compressed));
+        REQUIRE(dictionaryCompressor->compress(message, dictionaryCompressed));
+        REQUIRE(dictionaryCompressed.size() < compressed.size());
+        REQUIRE(dictionaryCompressed.size() < message.size() / 2);
+        REQUIRE(dictionaryCompressor->getMemoryUsage() > 0);
+
+        auto append = [&decompressed](const char* data, size_t size) {
+            decompressed.append(data, size);
+            return true;
+        };
+
+        auto decompressor = dictionaryCodec->createDecompressor();
+        REQUIRE(decompressor->init(15, false, true));
+        for (int i = 0; i < 2; ++i)
+        {
+            decompressed.clear();
+            REQUIRE(decompressor->decompress(
+                dictionaryCompressed.data(), dictionaryCompressed.size(), true, append));
+            REQUIRE(decompressed == message);
+
+            // Messages are decoded on their own
+            REQUIRE(decompressor->release());
+            REQUIRE(decompressor->getMemoryUsage() == 0);
+        }
+
+        // The dictionary is needed
+        auto plainDecompressor = codec->createDecompressor();
+        REQUIRE(plainDecompressor->init(15, false, false));
+        REQUIRE(!plainDecompressor->decompress(
+            dictionaryCompressed.data(), dictionaryCompressed.size(), true, append));
+    }
+
+    SECTION("large messages received in parts")
+    {
+        auto codec = WebSocketZstdCodec::create();
+        auto compressor = codec->createCompressor();
+        auto decompressor = codec->createDecompressor();
+        REQUIRE(compressor->init(15, false, 8, false));
+        REQUIRE(decompressor->init(15, false, false));
+
+        std::string message;
+        for (int i = 0; message.size() < 1000000; ++i)
+        {
+            message += makeMessage(i);
+        }
+
+        std::string compressed, decompressed;
+        REQUIRE(compressor->compress(message, compressed));
+
+        auto append = [&decompressed](const char* data, size_t size) {
+            decompressed.append(data, size);
+            return true;
+        };
+
+        size_t half = compressed.size() / 2;
+        REQUIRE(decompressor->decompress(compressed.data(), half, false, append));
+        REQUIRE(decompressor->decompress(
+            compressed.data() + half, compressed.size() - half, true, append));
+        REQUIRE(decompressed == message);
+
+        // A truncated frame is an error, the next message is decoded again
+        REQUIRE(!decompressor->decompress(compressed.data(), half, true, append));
+        decompressed.clear();
+        REQUIRE(decompressor->decompress(compressed.data(), compressed.size(), true, append));
+        REQUIRE(decompressed == message);
+    }
+
+    SECTION("negotiation")
+    {
+        std::string dictionary = trainDictionary();
+
+        WebSocketPerMessageDeflateOptions client(true);
+        REQUIRE(client.enableZstd(3, dictionary));
+        std::string header = client.generateHeader();
+        REQUIRE(header.find("x-permessage-zstd; dictionary_id=") != std::string::npos);
+        REQUIRE(header.find(", permessage-deflate") != std::string::npos);
+
+        WebSocketPerMessageDeflateOptions offer(header.substr(header.find(':') + 1));
+        REQUIRE(offer.isZstdEnabled());
+        REQUIRE(offer.getZstdDictionaryId() == client.getZstdDictionaryId());
+
+        // Accepted by servers with the same dictionary
+        WebSocketPerMessageDeflateOptions policy(true);
+        REQUIRE(policy.enableZstd(1, dictionary));
+        auto response = policy.negotiate(offer);
+        REQUIRE(response.isZstdEnabled());
+        REQUIRE(response.generateHeader() ==
+                "Sec-WebSocket-Extensions: x-permessage-zstd; dictionary_id=" +
+                    std::to_string(client.getZstdDictionaryId()) + "\r\n");
+
+        WebSocketPerMessageDeflate serverCodec;
+        REQUIRE(serverCodec.init(response, true));
+
+        WebSocketPerMessageDeflateOptions clientResponse(
+            response.generateHeader().substr(header.find(':') + 1));
+        clientResponse.copyLocalSettings(client);
+        WebSocketPerMessageDeflate clientCodec;
+        REQUIRE(clientCodec.init(clientResponse));
+
+        std::string message = makeMessage(42);
+        std::string compressed, decompressed;
+        REQUIRE(clientCodec.compress(message, compressed));
+        REQUIRE(serverCodec.decompress(compressed, decompressed));
+        REQUIRE(decompressed == message);
+
+        // permessage-deflate is used with another dictionary, or without zstd
+        WebSocketPerMessageDeflateOptions otherPolicy(true);
+        REQUIRE(otherPolicy.enableZstd());
+        response = otherPolicy.negotiate(offer);
+        REQUIRE(!response.isZstdEnabled());
+        REQUIRE(response.enabled());
+
+        response = WebSocketPerMessageDeflateOptions(true).negotiate(offer);
+        REQUIRE(!response.isZstdEnabled());
+        REQUIRE(response.enabled());
+
+        // A client cannot use a dictionary it does not have
+        WebSocketPerMessageDeflateOptions plainClient(true);
+        clientResponse.copyLocalSettings(plainClient);
+        REQUIRE(!clientCodec.init(clientResponse));
+    }
+}
+
+TEST_CASE("zstd_websocket", "[zstd]")
+{
+    SECTION("clients with the same dictionary as the server use zstd")
+    {
+        std::string dictionary = trainDictionary();
+
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+
+        ix::WebSocketPerMessageDeflateOptions policy(true);
+        REQUIRE(policy.enableZstd(3, dictionary));
+        server.setPerMessageDeflateOptions(policy);
+
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.sendText(msg->str);
+                }
+            });
+        REQUIRE(server.listenAndStart());
+
+        std::string message;
+        for (int i = 0; i < 20; ++i)
+        {
+            message += makeMessage(i);
+        }
+
+        auto exchange = [&](const std::string& clientDictionary, std::string& extensions) {
+            std::mutex receivedMutex;
+            std::string received;
+            std::atomic<bool> open(false);
+
+            ix::WebSocketPerMessageDeflateOptions options(true);
+            REQUIRE(options.enableZstd(3, clientDictionary));
+
+            ix::WebSocket webSocket;
+            webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+            webSocket.disableAutomaticReconnection();
+            webSocket.setPerMessageDeflateOptions(options);
+            webSocket.setOnMessageCallback([&](const ix::WebSocketMessagePtr& msg) {
+                std::lock_guard<std::mutex> lock(receivedMutex);
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    extensions = msg->openInfo.headers["sec-websocket-extensions"];
+                    open = true;
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    received = msg->str;
+                }
+            });
+            webSocket.start();
+
+            for (int i = 0; i < 500 && !open; ++i)
+            {
+                ix::msleep(10);
+            }
+            REQUIRE(open);
+
+            auto sendInfo = webSocket.sendText(message);
+            REQUIRE(sendInfo.success);
+            REQUIRE(sendInfo.wireSize < message.size() / 2);
+
+            auto receivedMessage = [&]() {
+                std::lock_guard<std::mutex> lock(receivedMutex);
+                return received;
+            };
+            for (int i = 0; i < 500 && receivedMessage().empty(); ++i)
+            {
+                ix::msleep(10);
+            }
+            REQUIRE(receivedMessage() == message);
+
+            webSocket.stop();
+        };
+
+        std::string extensions;
+        exchange(dictionary, extensions);
+        REQUIRE(extensions.find("x-permessage-zstd") == 0);
+
+        // Without the dictionary, permessage-deflate is negotiated instead
+        exchange(std::string(), extensions);
+        REQUIRE(extensions.find("permessage-deflate") == 0);
+
+        server.stop();
+    }
+}
@@ -10,6 +10,7 @@
 
 #include "linenoise.hpp"
 #include <CLI11.hpp>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -17,22 +18,30 @@
 #include <iostream>
 #include <ixwebsocket/IXBench.h>
 #include <ixwebsocket/IXDNSLookup.h>
+#include <ixwebsocket/IXGetFreePort.h>
 #include <ixwebsocket/IXGzipCodec.h>
 #include <ixwebsocket/IXHttpClient.h>
 #include <ixwebsocket/IXHttpServer.h>
 #include <ixwebsocket/IXNetSystem.h>
 #include <ixwebsocket/IXSetThreadName.h>
 #include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketConnect.h>
+#include <ixwebsocket/IXSocketFactory.h>
 #include <ixwebsocket/IXSocketTLSOptions.h>
+#include <ixwebsocket/IXSocketTLSSessionCache.h>
 #include <ixwebsocket/IXUserAgent.h>
 #include <ixwebsocket/IXUuid.h>
 #include <ixwebsocket/IXWebSocket.h>
 #include <ixwebsocket/IXWebSocketHttpHeaders.h>
+#include <ixwebsocket/IXWebSocketMask.h>
+#include <ixwebsocket/IXWebSocketPerMessageDeflate.h>
+#include <ixwebsocket/IXWebSocketPerMessageDeflateCodec.h>
 #include <ixwebsocket/IXWebSocketProxyServer.h>
 #include <ixwebsocket/IXWebSocketServer.h>
 #include <msgpack11.hpp>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
 #include <sstream>
@@ -42,6 +51,7 @@
 
 #ifndef _WIN32
 #include <signal.h>
+#include <sys/resource.h>
 #else
 #include <process.h>
 #define getpid _getpid
@@ -144,6 +154,237 @@ namespace
 
         return hashAddress;
     }
+
+    // Read a numerical field such as VmRSS (in KB) or Threads from /proc/self/status.
+    // Returns 0 when not available (non Linux platforms).
+    int64_t readProcStatus(const std::string& field)
+    {
+        std::ifstream file("/proc/self/status");
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.compare(0, field.size() + 1, field + ":") == 0)
+            {
+                return std::atoll(line.c_str() + field.size() + 1);
+            }
+        }
+        return 0;
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty()) return 0;
+
+        std::sort(values.begin(), values.end());
+        return values[(size_t) (p * (values.size() - 1))];
+    }
+
+    // CPU time used by the calling thread, in microseconds. Returns 0 when not
+    // available (non Linux platforms).
+    double getThreadCpuTime()
+    {
+#ifdef __linux__
+        struct rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) == 0)
+        {
+            return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec +
+                   usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+        }
+#endif
+        return 0;
+    }
+
+    //
+    // Raw client sockets helpers, used by the server benchmarks to drive many
+    // connections without paying for a WebSocket client object per connection.
+    //
+    bool waitForSocket(int fd, short events)
+    {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+        void* event = nullptr;
+        return ix::poll(&pfd, 1, 5000, &event) == 1;
+    }
+
+    bool sendAll(int fd, const std::string& data)
+    {
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            ssize_t ret = ::send(fd, data.c_str() + offset, data.size() - offset, 0);
+            if (ret > 0)
+            {
+                offset += (size_t) ret;
+            }
+            else if (ret < 0 && ix::Socket::isWaitNeeded())
+            {
+                if (!waitForSocket(fd, POLLOUT)) return false;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Read exactly size bytes, or up to the end of the http response when
+    // endMarker is not empty. The servers used by the benchmarks do not send anything
+    // after the http response, so it is read in large chunks.
+    std::pair<bool, std::string> recvSome(int fd, size_t size, const std::string& endMarker)
+    {
+        char buffer[1 << 14];
+        std::string data;
+        while (endMarker.empty() ? data.size() < size : data.find(endMarker) == std::string::npos)
+        {
+            size_t wanted = endMarker.empty() ? size - data.size() : sizeof(buffer);
+            ssize_t ret = ::recv(fd, buffer, std::min(wanted, sizeof(buffer)), 0);
+            if (ret > 0)
+            {
+                data.append(buffer, (size_t) ret);
+            }
+            else if (ret < 0 && ix::Socket::isWaitNeeded())
+            {
+                if (!waitForSocket(fd, POLLIN)) return std::make_pair(false, data);
+            }
+            else
+            {
+                return std::make_pair(false, data);
+            }
+        }
+        return std::make_pair(true, data);
+    }
+
+    // Connect to a local port, skipping the DNS lookup done by SocketConnect, which
+    // would dominate the cost of short connections. Returns -1 on failure.
+    int connectLocal(int port, std::string& errMsg)
+    {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t) port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        int fd = (int) ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            errMsg = "Cannot create a socket";
+            return -1;
+        }
+
+        if (::connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+        {
+            errMsg = std::string("Connect error: ") + strerror(ix::Socket::getErrno());
+            ix::Socket::closeSocket(fd);
+            return -1;
+        }
+
+        ix::SocketConnect::configure(fd);
+        return fd;
+    }
+
+    // Read one http response with a Content-Length header. Bytes received past the
+    // end of the response (pipelined responses) are kept in buffer for the next call.
+    bool recvHttpResponse(int fd, std::string& buffer, std::string& response)
+    {
+        char chunk[1 << 14];
+        size_t contentLength = std::string::npos;
+        size_t headersEnd = std::string::npos;
+
+        for (;;)
+        {
+            if (headersEnd == std::string::npos)
+            {
+                headersEnd = buffer.find("\r\n\r\n");
+                if (headersEnd != std::string::npos)
+                {
+                    headersEnd += 4;
+                    auto pos = buffer.find("Content-Length: ");
+                    if (pos == std::string::npos || pos > headersEnd) return false;
+                    contentLength = (size_t) std::atoll(buffer.c_str() + pos + 16);
+                }
+            }
+
+            if (headersEnd != std::string::npos && buffer.size() >= headersEnd + contentLength)
+            {
+                response = buffer.substr(0, headersEnd + contentLength);
+                buffer.erase(0, headersEnd + contentLength);
+                return true;
+            }
+
+            ssize_t ret = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (ret > 0)
+            {
+                buffer.append(chunk, (size_t) ret);
+            }
+            else if (ret < 0 && ix::Socket::isWaitNeeded())
+            {
+                if (!waitForSocket(fd, POLLIN)) return false;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
+    // Connect and perform the opening handshake. Returns -1 on failure.
+    int connectRawClient(int port, std::string& errMsg)
+    {
+        int fd = connectLocal(port, errMsg);
+        if (fd == -1) return -1;
+
+        std::string handshake("GET / HTTP/1.1\r\n"
+                              "Host: 127.0.0.1\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Version: 13\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "\r\n");
+
+        if (!sendAll(fd, handshake))
+        {
+            errMsg = "Cannot send handshake";
+            ix::Socket::closeSocket(fd);
+            return -1;
+        }
+
+        auto response = recvSome(fd, 0, "\r\n\r\n");
+        if (!response.first || response.second.compare(0, 12, "HTTP/1.1 101") != 0)
+        {
+            errMsg = "Handshake failed";
+            ix::Socket::closeSocket(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // Masked client text frame, with a payload made of msgSize 'x'
+    std::string makeClientFrame(int msgSize)
+    {
+        const uint8_t maskingKey[4] = {0x12, 0x34, 0x56, 0x78};
+        std::string frame;
+        frame.push_back((char) 0x81);
+        if (msgSize < 126)
+        {
+            frame.push_back((char) (0x80 | msgSize));
+        }
+        else
+        {
+            frame.push_back((char) (0x80 | 126));
+            frame.push_back((char) ((msgSize >> 8) & 0xff));
+            frame.push_back((char) (msgSize & 0xff));
+        }
+        frame.append((const char*) maskingKey, 4);
+        for (int i = 0; i < msgSize; ++i)
+        {
+            frame.push_back((char) ('x' ^ maskingKey[i & 0x3]));
+        }
+        return frame;
+    }
 } // namespace
 
 namespace ix
@@ -2400,154 +2641,1771 @@ namespace ix
 
         return 0;
     }
-} // namespace ix
-
-int main(int argc, char** argv)
-{
-    ix::setThreadName("ws main thread");
-    ix::initNetSystem();
 
-    spdlog::set_level(spdlog::level::debug);
+    //
+    // Open many raw client connections against a local echo server, then report the
+    // server memory usage and the echo latency, with every connection idle and then
+    // with every connection sending a message at the same time.
+    // Run it once with --io_threads 0 (one thread per connection) and once with the
+    // event loop to compare both server modes.
+    //
+    int ws_server_bench(int connectionCount, int ioThreads, int msgSize, int runCount)
+    {
+        if (msgSize <= 0 || msgSize > 65535)
+        {
+            spdlog::error("Message size should be between 1 and 65535");
+            return 1;
+        }
 
 #ifndef _WIN32
-    signal(SIGPIPE, SIG_IGN);
+        // Each connection needs a client socket, a server socket and a wake up pipe
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
 #endif
 
-    // Display command.
-    if (getenv("DEBUG"))
-    {
-        std::stringstream ss;
-        ss << "Command: ";
-        for (int i = 0; i < argc; ++i)
+        int port = getFreePort();
+        int backlog = 1024;
+        ix::WebSocketServer server(port, "127.0.0.1", backlog, (size_t) connectionCount + 1);
+        server.disablePerMessageDeflate();
+
+        if (ioThreads > 0)
         {
-            ss << argv[i] << " ";
+            server.enableEventLoop((size_t) ioThreads);
         }
-        spdlog::info(ss.str());
-    }
 
-    CLI::App app {"ws is a websocket tool"};
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& webSocket,
+               const WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    webSocket.send(msg->str, msg->binary);
+                }
+            });
 
-    std::string url("ws://127.0.0.1:8008");
-    std::string path;
-    std::string user;
-    std::string data;
-    std::string formData;
-    std::string binaryData;
-    std::string headers;
-    std::string output;
-    std::string hostname("127.0.0.1");
-    std::string pidfile;
-    std::string channel;
-    std::string filter;
-    std::string position;
-    std::string message;
-    std::string timer;
-    std::string configPath;
-    std::string subprotocol;
-    std::string remoteHost;
-    std::string logfile;
-    std::string moduleName;
-    std::string republishChannel;
-    std::string publisherRolename;
-    std::string publisherRolesecret;
-    std::string sendMsg("hello world");
-    std::string filename;
-    std::string httpHeaderAuthorization;
-    ix::SocketTLSOptions tlsOptions;
-    std::string ciphers;
-    std::string redirectUrl;
-    bool headersOnly = false;
-    bool followRedirects = false;
-    bool verbose = false;
-    bool save = false;
-    bool quiet = false;
-    bool compress = false;
-    bool compressRequest = false;
-    bool disableAutomaticReconnection = false;
-    bool disablePerMessageDeflate = false;
-    bool greetings = false;
-    bool ipv6 = false;
-    bool binaryMode = false;
-    bool redirect = false;
-    bool version = false;
-    bool verifyNone = false;
-    bool disablePong = false;
-    bool debug = false;
-    int port = 8008;
-    int connectTimeOut = 60;
-    int transferTimeout = 1800;
-    int maxRedirects = 5;
-    int delayMs = -1;
-    int msgCount = 1000 * 1000;
-    uint32_t maxWaitBetweenReconnectionRetries = 10 * 1000; // 10 seconds
-    int pingIntervalSecs = 30;
-    int runCount = 1;
-    bool decompressGzipMessages = false;
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
 
-    auto addGenericOptions = [&pidfile](CLI::App* app) {
-        app->add_option("--pidfile", pidfile, "Pid file");
-    };
+        spdlog::info("Server mode: {}",
+                     (ioThreads > 0) ? "event loop" : "one thread per connection");
 
-    auto addTLSOptions = [&tlsOptions, &verifyNone](CLI::App* app) {
-        app->add_option(
-               "--cert-file", tlsOptions.certFile, "Path to the (PEM format) TLS cert file")
-            ->check(CLI::ExistingPath);
-        app->add_option("--key-file", tlsOptions.keyFile, "Path to the (PEM format) TLS key file")
-            ->check(CLI::ExistingPath);
-        app->add_option("--ca-file", tlsOptions.caFile, "Path to the (PEM format) ca roots file")
-            ->check(CLI::ExistingPath);
-        app->add_option("--ciphers",
-                        tlsOptions.ciphers,
-                        "A (comma/space/colon) separated list of ciphers to use for TLS");
-        app->add_flag("--tls", tlsOptions.tls, "Enable TLS (server only)");
-        app->add_flag("--verify_none", verifyNone, "Disable peer cert verification");
-        app->add_flag("--disable-hostname-validation", tlsOptions.disable_hostname_validation, "Disable validation of certificates' hostnames");
-    };
+        int64_t rssBefore = readProcStatus("VmRSS");
 
-    app.add_flag("--version", version, "Print ws version");
-    app.add_option("--logfile", logfile, "path where all logs will be redirected");
+        // Masked client text frame, and the size of the unmasked echo
+        std::string frame = makeClientFrame(msgSize);
+        size_t echoSize = (size_t) msgSize + ((msgSize < 126) ? 2 : 4);
 
-    CLI::App* sendApp = app.add_subcommand("send", "Send a file");
-    sendApp->fallthrough();
-    sendApp->add_option("url", url, "Connection url")->required();
-    sendApp->add_option("path", path, "Path to the file to send")
-        ->required()
-        ->check(CLI::ExistingPath);
-    sendApp->add_flag("-x", disablePerMessageDeflate, "Disable per message deflate");
-    addGenericOptions(sendApp);
-    addTLSOptions(sendApp);
+        std::vector<int> fds;
+        fds.reserve((size_t) connectionCount);
 
-    CLI::App* receiveApp = app.add_subcommand("receive", "Receive a file");
-    receiveApp->fallthrough();
-    receiveApp->add_option("url", url, "Connection url")->required();
-    receiveApp->add_option("--delay",
-                           delayMs,
-                           "Delay (ms) to wait after receiving a fragment"
-                           " to artificially slow down the receiver");
-    receiveApp->add_option("--pidfile", pidfile, "Pid file");
-    addTLSOptions(receiveApp);
+        ix::Bench connectBench("Connecting clients");
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            std::string errMsg;
+            int fd = connectRawClient(port, errMsg);
+            if (fd == -1)
+            {
+                spdlog::error("Cannot connect client {}: {}", i, errMsg);
+                break;
+            }
 
-    CLI::App* transferApp = app.add_subcommand("transfer", "Broadcasting server");
-    transferApp->fallthrough();
-    transferApp->add_option("--port", port, "Connection url");
-    transferApp->add_option("--host", hostname, "Hostname");
-    transferApp->add_option("--pidfile", pidfile, "Pid file");
-    addTLSOptions(transferApp);
+            fds.push_back(fd);
+        }
+        connectBench.report();
 
-    CLI::App* connectApp = app.add_subcommand("connect", "Connect to a remote server");
-    connectApp->fallthrough();
-    connectApp->add_option("url", url, "Connection url")->required();
-    connectApp->add_option("-H", headers, "Header")->join();
-    connectApp->add_flag("-d", disableAutomaticReconnection, "Disable Automatic Reconnection");
-    connectApp->add_flag("-x", disablePerMessageDeflate, "Disable per message deflate");
-    connectApp->add_flag("-b", binaryMode, "Send in binary mode");
-    connectApp->add_option("--max_wait",
-                           maxWaitBetweenReconnectionRetries,
-                           "Max Wait Time between reconnection retries");
-    connectApp->add_option("--ping_interval", pingIntervalSecs, "Interval between sending pings");
-    connectApp->add_option("--subprotocol", subprotocol, "Subprotocol");
-    connectApp->add_flag("-g", decompressGzipMessages, "Decompress gziped messages");
-    addGenericOptions(connectApp);
+        // Let the server settle
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        size_t connected = fds.size();
+        int64_t rssIdle = readProcStatus("VmRSS");
+        spdlog::info("{} connections, process threads: {}, rss growth: {} KB ({} bytes per "
+                     "connection)",
+                     connected,
+                     readProcStatus("Threads"),
+                     rssIdle - rssBefore,
+                     (connected == 0) ? 0 : (rssIdle - rssBefore) * 1024 / (int64_t) connected);
+
+        if (connected == 0)
+        {
+            server.stop();
+            return 1;
+        }
+
+        // Idle: one connection at a time sends a message, while all others are idle
+        std::vector<double> latencies;
+        size_t probes = std::min(connected, (size_t) 1000);
+        for (size_t i = 0; i < probes; ++i)
+        {
+            int fd = fds[i * connected / probes];
+            auto start = std::chrono::steady_clock::now();
+
+            if (!sendAll(fd, frame) || !recvSome(fd, echoSize, std::string()).first)
+            {
+                spdlog::error("Echo failed");
+                break;
+            }
+
+            std::chrono::duration<double, std::micro> duration =
+                std::chrono::steady_clock::now() - start;
+            latencies.push_back(duration.count());
+        }
+
+        spdlog::info("Idle connections latency: p50 {:.0f} us, p99 {:.0f} us, max {:.0f} us",
+                     percentile(latencies, 0.5),
+                     percentile(latencies, 0.99),
+                     percentile(latencies, 1.0));
+
+        // Active: every connection sends a message at the same time
+        latencies.clear();
+        std::vector<struct pollfd> pfds(connected);
+        std::vector<size_t> received(connected);
+        std::vector<char> buffer(1 << 16);
+        std::vector<std::chrono::steady_clock::time_point> sendTimes(connected);
+        ix::Bench activeBench("Active rounds");
+        bool success = true;
+
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            for (size_t i = 0; i < connected; ++i)
+            {
+                sendTimes[i] = std::chrono::steady_clock::now();
+                if (!sendAll(fds[i], frame))
+                {
+                    spdlog::error("Cannot send message on connection {}", i);
+                    success = false;
+                    break;
+                }
+
+                pfds[i].fd = fds[i];
+                pfds[i].events = POLLIN;
+                pfds[i].revents = 0;
+                received[i] = 0;
+            }
+
+            size_t remaining = connected;
+            while (success && remaining > 0)
+            {
+                void* event = nullptr;
+                int ret = ix::poll(&pfds[0], (nfds_t) connected, 5000, &event);
+                if (ret <= 0)
+                {
+                    spdlog::error("Timeout waiting for {} echoes", remaining);
+                    success = false;
+                    break;
+                }
+
+                for (size_t i = 0; i < connected; ++i)
+                {
+                    if (pfds[i].fd == -1 || !(pfds[i].revents & POLLIN)) continue;
+
+                    ssize_t n = ::recv(fds[i], &buffer[0], echoSize - received[i], 0);
+                    if (n <= 0)
+                    {
+                        if (n < 0 && Socket::isWaitNeeded()) continue;
+                        spdlog::error("Connection {} closed", i);
+                        success = false;
+                        break;
+                    }
+
+                    received[i] += (size_t) n;
+                    if (received[i] == echoSize)
+                    {
+                        std::chrono::duration<double, std::micro> duration =
+                            std::chrono::steady_clock::now() - sendTimes[i];
+                        latencies.push_back(duration.count());
+                        pfds[i].fd = -1;
+                        remaining--;
+                    }
+                }
+            }
+        }
+        activeBench.record();
+        activeBench.setReported();
+
+        int64_t rssActive = readProcStatus("VmRSS");
+        double seconds = activeBench.getDuration() / 1e6;
+        spdlog::info("Active connections: {} messages echoed in {:.2f} s ({:.0f} msg/s)",
+                     latencies.size(),
+                     seconds,
+                     (seconds > 0) ? latencies.size() / seconds : 0);
+        spdlog::info("Active connections latency: p50 {:.0f} us, p99 {:.0f} us, max {:.0f} us",
+                     percentile(latencies, 0.5),
+                     percentile(latencies, 0.99),
+                     percentile(latencies, 1.0));
+        spdlog::info("Active connections rss growth: {} KB", rssActive - rssBefore);
+
+        for (auto fd : fds)
+        {
+            Socket::closeSocket(fd);
+        }
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+
+    //
+    // Stream many small frames over a single connection, and report how fast the
+    // server parses and dispatches them. This stresses the receive buffer handling,
+    // as a single read contains thousands of frames.
+    //
+    int ws_dispatch_bench(int frameCount, int msgSize, int runCount)
+    {
+        if (frameCount <= 0 || msgSize < 0 || msgSize > 65535)
+        {
+            spdlog::error("Invalid frame count or message size");
+            return 1;
+        }
+
+        int port = getFreePort();
+        ix::WebSocketServer server(port, "127.0.0.1");
+        server.disablePerMessageDeflate();
+
+        std::atomic<int> receivedCount(0);
+        server.setOnClientMessageCallback(
+            [&receivedCount](std::shared_ptr<ConnectionState> /*connectionState*/,
+                             WebSocket& /*webSocket*/,
+                             const WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    receivedCount++;
+                }
+            });
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
+
+        std::string errMsg;
+        int fd = connectRawClient(port, errMsg);
+        if (fd == -1)
+        {
+            spdlog::error("Cannot connect client: {}", errMsg);
+            server.stop();
+            return 1;
+        }
+
+        // Send the frames in batches of about 1MB
+        std::string frame = makeClientFrame(msgSize);
+        int framesPerBatch = std::max(1, (int) ((1 << 20) / frame.size()));
+        std::string batch;
+        batch.reserve((size_t) framesPerBatch * frame.size());
+        for (int i = 0; i < framesPerBatch; ++i)
+        {
+            batch += frame;
+        }
+
+        spdlog::info("Sending {} frames of {} bytes ({} bytes on the wire)",
+                     frameCount,
+                     msgSize,
+                     frame.size());
+
+        bool success = true;
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            receivedCount = 0;
+            ix::Bench bench("Dispatching frames");
+
+            int sent = 0;
+            while (sent < frameCount)
+            {
+                int count = std::min(framesPerBatch, frameCount - sent);
+                bool ok = (count == framesPerBatch)
+                              ? sendAll(fd, batch)
+                              : sendAll(fd, batch.substr(0, (size_t) count * frame.size()));
+                if (!ok)
+                {
+                    spdlog::error("Cannot send frames");
+                    success = false;
+                    break;
+                }
+                sent += count;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            while (success && receivedCount < frameCount)
+            {
+                if (std::chrono::steady_clock::now() - start > std::chrono::seconds(30))
+                {
+                    spdlog::error("Timeout, received {} frames", receivedCount);
+                    success = false;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+
+            bench.record();
+            bench.setReported();
+
+            double seconds = bench.getDuration() / 1e6;
+            spdlog::info("{} frames dispatched in {:.3f} s ({:.0f} frames/s)",
+                         receivedCount,
+                         seconds,
+                         (seconds > 0) ? receivedCount / seconds : 0);
+        }
+
+        for (auto&& client : server.getClients())
+        {
+            auto stats = client->getBufferPoolStats();
+            spdlog::info("Buffer pool: {} hits, {} misses ({:.2f}% hit ratio), {} bytes pooled",
+                         stats.hits,
+                         stats.misses,
+                         100 * stats.getHitRatio(),
+                         stats.size);
+        }
+
+        Socket::closeSocket(fd);
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+
+    //
+    // Throughput of each masking implementation supported by the CPU, compared to
+    // a byte by byte loop
+    //
+    int ws_mask_bench(int size, int runCount)
+    {
+        if (size <= 0)
+        {
+            spdlog::error("Invalid buffer size");
+            return 1;
+        }
+
+        const uint8_t maskingKey[4] = {0x12, 0x34, 0x56, 0x78};
+        std::vector<uint8_t> buffer((size_t) size, 'x');
+
+        // Mask about 4GB for each implementation
+        int iterations = std::max(1, (int) ((4LL << 30) / size));
+
+        auto implementations = getWebSocketMaskImplementations();
+        implementations.insert(
+            implementations.begin(),
+            std::make_pair(std::string("bytes"),
+                           [](const uint8_t* src, uint8_t* dst, size_t n, const uint8_t* key) {
+                               for (size_t i = 0; i != n; ++i)
+                               {
+                                   dst[i] = src[i] ^ key[i & 0x3];
+                               }
+                           }));
+
+        spdlog::info("Masking {} bytes buffers, default implementation: {}",
+                     size,
+                     getWebSocketMaskImplementation());
+
+        for (int run = 0; run < runCount; ++run)
+        {
+            for (auto&& implementation : implementations)
+            {
+                ix::Bench bench(implementation.first);
+                for (int i = 0; i < iterations; ++i)
+                {
+                    implementation.second(&buffer[0], &buffer[0], buffer.size(), maskingKey);
+                }
+                bench.record();
+                bench.setReported();
+
+                double seconds = bench.getDuration() / 1e6;
+                double gigabytes = (double) iterations * size / (1 << 30);
+                spdlog::info("{}: {:.2f} GB/s", implementation.first, gigabytes / seconds);
+            }
+        }
+
+        // Keep the result alive
+        return buffer[0] == 0 ? 1 : 0;
+    }
+
+    //
+    // Per message deflate compression throughput and ratio for JSON and random
+    // payloads, compressing every message or skipping the ones the probe finds
+    // incompressible
+    //
+    int ws_deflate_bench(int runCount)
+    {
+        const std::vector<size_t> sizes = {
+            64, 256, 1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20};
+
+        std::string json;
+        for (int i = 0; json.size() < sizes.back(); ++i)
+        {
+            json += "{\"id\":" + std::to_string(i) + ",\"name\":\"user-" +
+                    std::to_string(i * 7919) +
+                    "\",\"score\":" + std::to_string((i * 31337) % 1000) +
+                    ",\"online\":" + ((i % 3 == 0) ? "true" : "false") + "},";
+        }
+
+        std::mt19937 generator(42);
+        std::string random(sizes.back(), 0);
+        for (auto&& c : random)
+        {
+            c = (char) (generator() & 0xff);
+        }
+
+        const std::vector<std::pair<std::string, const std::string*>> payloads = {
+            {"json", &json}, {"random", &random}};
+
+        for (int run = 0; run < runCount; ++run)
+        {
+            for (auto&& payload : payloads)
+            {
+                for (auto size : sizes)
+                {
+                    std::string message(payload.second->data(), size);
+
+                    WebSocketPerMessageDeflateCompressor compressor;
+                    if (!compressor.init(15, true))
+                    {
+                        spdlog::error("Cannot initialize the compressor");
+                        return 1;
+                    }
+
+                    // Compress about 64MB for each size
+                    int iterations = std::max(1, (int) ((64 << 20) / size));
+                    std::string compressed;
+
+                    for (bool probe : {false, true})
+                    {
+                        size_t wireSize = 0;
+                        ix::Bench bench("deflate");
+                        for (int i = 0; i < iterations; ++i)
+                        {
+                            if (probe && WebSocketPerMessageDeflateCompressor::isIncompressible(
+                                             message.data(), message.size()))
+                            {
+                                wireSize += message.size();
+                                continue;
+                            }
+
+                            compressor.compress(message, compressed);
+                            wireSize += compressed.size();
+                        }
+                        bench.record();
+                        bench.setReported();
+
+                        double seconds = bench.getDuration() / 1e6;
+                        double megabytes = (double) iterations * size / (1 << 20);
+                        spdlog::info("{} {} bytes, {}: {:.0f} MB/s, {:.1f}% of the size",
+                                     payload.first,
+                                     size,
+                                     probe ? "probe" : "always",
+                                     (seconds > 0) ? megabytes / seconds : 0,
+                                     100.0 * wireSize / ((double) iterations * size));
+                    }
+                }
+            }
+        }
+
+        return 0;
+    }
+    //
+    // Compression codecs on a stream of small JSON events, as exchanged by a chat or
+    // game server: permessage-deflate with and without context takeover, and zstd with
+    // and without a dictionary trained on earlier events
+    //
+    int ws_codec_bench(int runCount)
+    {
+        static const std::vector<std::string> words = {
+            "hello", "world", "game", "play", "again", "nice", "shot", "team", "win", "lost",
+            "ready", "wait", "go", "left", "right", "map", "level", "score", "good", "luck"};
+
+        std::mt19937 generator(42);
+        auto makeEvent = [&generator](int i) {
+            std::string room = "\"room\":\"room-" + std::to_string(generator() % 10) + "\"";
+            std::string ts = "\"ts\":" + std::to_string(1600000000000ULL + (uint64_t) i * 37);
+
+            switch (generator() % 3)
+            {
+                case 0:
+                {
+                    std::string text;
+                    for (size_t n = 3 + generator() % 15; n > 0; --n)
+                    {
+                        text += words[generator() % words.size()] + (n > 1 ? " " : "");
+                    }
+                    return "{\"type\":\"chat\"," + room + ",\"from\":\"user-" +
+                           std::to_string(generator() % 1000) + "\",\"text\":\"" + text +
+                           "\"," + ts + "}";
+                }
+                case 1:
+                {
+                    return "{\"type\":\"position\",\"player\":\"player-" +
+                           std::to_string(generator() % 100) +
+                           "\",\"x\":" + std::to_string(generator() % 100000 / 100.0) +
+                           ",\"y\":" + std::to_string(generator() % 100000 / 100.0) +
+                           ",\"heading\":" + std::to_string(generator() % 360) + "," + ts + "}";
+                }
+                default:
+                {
+                    std::string users;
+                    for (size_t n = 5 + generator() % 20; n > 0; --n)
+                    {
+                        users += "\"user-" + std::to_string(generator() % 1000) + "\"" +
+                                 (n > 1 ? "," : "");
+                    }
+                    return "{\"type\":\"presence\"," + room + ",\"users\":[" + users + "]," +
+                           ts + "}";
+                }
+            }
+        };
+
+        std::vector<std::string> samples;
+        for (int i = 0; i < 5000; ++i)
+        {
+            samples.push_back(makeEvent(i));
+        }
+
+        std::vector<std::string> messages;
+        size_t totalSize = 0;
+        for (int i = 0; i < 50000; ++i)
+        {
+            messages.push_back(makeEvent(i));
+            totalSize += messages.back().size();
+        }
+
+        std::vector<std::pair<std::string, WebSocketPerMessageDeflateOptions>> codecs = {
+            {"deflate", WebSocketPerMessageDeflateOptions(true)},
+            {"deflate, no context takeover", WebSocketPerMessageDeflateOptions(true, true, true)}};
+
+#ifdef IXWEBSOCKET_USE_ZSTD
+        std::string dictionary = WebSocketZstdCodec::trainDictionary(samples);
+        for (int level : {1, 3})
+        {
+            WebSocketPerMessageDeflateOptions options;
+            options.enableZstd(level);
+            codecs.emplace_back("zstd " + std::to_string(level), options);
+
+            options.enableZstd(level, dictionary);
+            codecs.emplace_back("zstd " + std::to_string(level) + ", " +
+                                    std::to_string(dictionary.size()) + " bytes dictionary",
+                                options);
+        }
+#else
+        spdlog::info("Built without zstd (USE_ZSTD), only permessage-deflate is measured");
+#endif
+
+        spdlog::info(
+            "{} messages, {} bytes on average", messages.size(), totalSize / messages.size());
+
+        std::vector<std::string> compressed(messages.size());
+        std::string decompressed;
+
+        for (int run = 0; run < runCount; ++run)
+        {
+            for (auto&& codec : codecs)
+            {
+                WebSocketPerMessageDeflate sender;
+                WebSocketPerMessageDeflate receiver;
+                if (!sender.init(codec.second) || !receiver.init(codec.second, true))
+                {
+                    spdlog::error("Cannot initialize {}", codec.first);
+                    return 1;
+                }
+
+                size_t wireSize = 0;
+                ix::Bench compressBench("compress");
+                for (size_t i = 0; i < messages.size(); ++i)
+                {
+                    sender.compress(messages[i], compressed[i]);
+                    wireSize += compressed[i].size();
+                }
+                compressBench.record();
+                compressBench.setReported();
+
+                ix::Bench decompressBench("decompress");
+                for (size_t i = 0; i < messages.size(); ++i)
+                {
+                    if (!receiver.decompress(compressed[i], decompressed) ||
+                        decompressed.size() != messages[i].size())
+                    {
+                        spdlog::error("{}: cannot decompress message {}", codec.first, i);
+                        return 1;
+                    }
+                }
+                decompressBench.record();
+                decompressBench.setReported();
+
+                double megabytes = (double) totalSize / (1 << 20);
+                double compressSeconds = compressBench.getDuration() / 1e6;
+                double decompressSeconds = decompressBench.getDuration() / 1e6;
+                spdlog::info("{}: compress {:.0f} MB/s, decompress {:.0f} MB/s, {:.1f}% of the "
+                             "size, {} bytes of state",
+                             codec.first,
+                             megabytes / compressSeconds,
+                             megabytes / decompressSeconds,
+                             100.0 * wireSize / totalSize,
+                             sender.getStats().memory + receiver.getStats().memory);
+            }
+        }
+
+        return 0;
+    }
+
+    //
+    // Send the same message to many connections, either with one send call per
+    // connection, or with WebSocketServer::broadcast which encodes the frame once.
+    // The CPU time is the one of the sending thread.
+    //
+    int ws_broadcast_bench(
+        int connectionCount, int ioThreads, int msgSize, int messageCount, int runCount)
+    {
+        if (msgSize <= 0 || msgSize > 65535 || messageCount <= 0)
+        {
+            spdlog::error("Invalid message size or message count");
+            return 1;
+        }
+
+#ifndef _WIN32
+        // Each connection needs a client socket, a server socket and a wake up pipe
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+#endif
+
+        int port = getFreePort();
+        int backlog = 1024;
+        ix::WebSocketServer server(port, "127.0.0.1", backlog, (size_t) connectionCount + 1);
+        server.disablePerMessageDeflate();
+
+        if (ioThreads > 0)
+        {
+            server.enableEventLoop((size_t) ioThreads);
+        }
+
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& /*webSocket*/,
+               const WebSocketMessagePtr& /*msg*/) {});
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
+
+        std::vector<int> fds;
+        fds.reserve((size_t) connectionCount);
+        for (int i = 0; i < connectionCount; ++i)
+        {
+            std::string errMsg;
+            int fd = connectRawClient(port, errMsg);
+            if (fd == -1)
+            {
+                spdlog::error("Cannot connect client {}: {}", i, errMsg);
+                break;
+            }
+
+            fds.push_back(fd);
+        }
+
+        // Wait until the server has registered every connection
+        size_t connected = fds.size();
+        for (int i = 0; i < 500 && server.getClients().size() != connected; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        spdlog::info("{} connections, server mode: {}",
+                     connected,
+                     (ioThreads > 0) ? "event loop" : "one thread per connection");
+        if (connected == 0)
+        {
+            server.stop();
+            return 1;
+        }
+
+        // Drain all the client sockets in the background, counting the received bytes
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> receivedBytes(0);
+        std::thread reader([&fds, &stop, &receivedBytes]() {
+            std::vector<struct pollfd> pfds(fds.size());
+            for (size_t i = 0; i < fds.size(); ++i)
+            {
+                pfds[i].fd = fds[i];
+                pfds[i].events = POLLIN;
+            }
+
+            std::vector<char> buffer(1 << 16);
+            while (!stop)
+            {
+                void* event = nullptr;
+                int ret = ix::poll(&pfds[0], (nfds_t) pfds.size(), 10, &event);
+                if (ret <= 0) continue;
+
+                for (auto&& pfd : pfds)
+                {
+                    if (!(pfd.revents & POLLIN)) continue;
+
+                    ssize_t n = ::recv(pfd.fd, &buffer[0], buffer.size(), 0);
+                    if (n > 0) receivedBytes += (uint64_t) n;
+                }
+            }
+        });
+
+        std::string message((size_t) msgSize, 'x');
+        size_t frameSize = (size_t) msgSize + ((msgSize < 126) ? 2 : 4);
+        uint64_t roundBytes = (uint64_t) frameSize * connected * (uint64_t) messageCount;
+        bool success = true;
+
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            for (int mode = 0; mode < 2 && success; ++mode)
+            {
+                bool useBroadcast = (mode == 1);
+                uint64_t expectedBytes = receivedBytes + roundBytes;
+
+                ix::Bench bench(useBroadcast ? "broadcast" : "send loop");
+                double cpuStart = getThreadCpuTime();
+
+                for (int i = 0; i < messageCount; ++i)
+                {
+                    if (useBroadcast)
+                    {
+                        server.broadcast(message, false);
+                    }
+                    else
+                    {
+                        for (auto&& client : server.getClients())
+                        {
+                            client->sendText(message);
+                        }
+                    }
+                }
+
+                double cpu = getThreadCpuTime() - cpuStart;
+
+                auto start = std::chrono::steady_clock::now();
+                while (receivedBytes < expectedBytes)
+                {
+                    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(60))
+                    {
+                        spdlog::error("Timeout, {} bytes missing",
+                                      expectedBytes - receivedBytes);
+                        success = false;
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+
+                bench.record();
+                bench.setReported();
+
+                double seconds = bench.getDuration() / 1e6;
+                double delivered = (double) messageCount * connected;
+                spdlog::info("{}: {} messages of {} bytes to {} clients in {:.3f} s, {:.0f} "
+                             "msg/s delivered, sender cpu {:.1f} us per message, {:.3f} us per "
+                             "client",
+                             useBroadcast ? "broadcast" : "send loop",
+                             messageCount,
+                             msgSize,
+                             connected,
+                             seconds,
+                             (seconds > 0) ? delivered / seconds : 0,
+                             cpu / messageCount,
+                             cpu / delivered);
+            }
+        }
+
+        stop = true;
+        reader.join();
+
+        for (auto fd : fds)
+        {
+            Socket::closeSocket(fd);
+        }
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+    //
+    // Sequential WebSocket handshakes and HTTP requests against local servers, with a
+    // new connection for each one
+    //
+    int ws_handshake_bench(int count, int ioThreads, int runCount)
+    {
+        if (count <= 0)
+        {
+            spdlog::error("Invalid handshake count");
+            return 1;
+        }
+
+        int port = getFreePort();
+        ix::WebSocketServer server(port, "127.0.0.1");
+        server.disablePerMessageDeflate();
+        if (ioThreads > 0)
+        {
+            server.enableEventLoop((size_t) ioThreads);
+        }
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& /*webSocket*/,
+               const WebSocketMessagePtr& /*msg*/) {});
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
+
+        int httpPort = getFreePort();
+        ix::HttpServer httpServer(httpPort, "127.0.0.1");
+        httpServer.setOnConnectionCallback(
+            [](HttpRequestPtr /*request*/,
+               std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+                WebSocketHttpHeaders headers;
+                headers["Content-Type"] = "text/plain";
+                return std::make_shared<HttpResponse>(
+                    200, "OK", HttpErrorCode::Ok, headers, std::string("ok"));
+            });
+
+        res = httpServer.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        httpServer.start();
+
+        std::string request("GET / HTTP/1.1\r\n"
+                            "Host: 127.0.0.1\r\n"
+                            "User-Agent: ws handshake_bench\r\n"
+                            "Accept: */*\r\n"
+                            "\r\n");
+        bool success = true;
+
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            ix::Bench handshakeBench("WebSocket handshakes");
+            for (int i = 0; i < count; ++i)
+            {
+                std::string errMsg;
+                int fd = connectRawClient(port, errMsg);
+                if (fd == -1)
+                {
+                    spdlog::error("Handshake {} failed: {}", i, errMsg);
+                    success = false;
+                    break;
+                }
+                Socket::closeSocket(fd);
+            }
+            handshakeBench.record();
+            handshakeBench.setReported();
+
+            double seconds = handshakeBench.getDuration() / 1e6;
+            spdlog::info("{} handshakes in {:.3f} s ({:.0f} handshakes/s)",
+                         count,
+                         seconds,
+                         (seconds > 0) ? count / seconds : 0);
+
+            ix::Bench httpBench("HTTP requests");
+            for (int i = 0; i < count && success; ++i)
+            {
+                // The server closes the connection after the response
+                std::string errMsg;
+                int fd = connectLocal(httpPort, errMsg);
+                if (fd == -1 || !sendAll(fd, request))
+                {
+                    spdlog::error("Request {} failed: {}", i, errMsg);
+                    success = false;
+                    break;
+                }
+
+                std::string response;
+                char buffer[1 << 12];
+                for (;;)
+                {
+                    ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+                    if (n > 0)
+                    {
+                        response.append(buffer, (size_t) n);
+                    }
+                    else if (n < 0 && Socket::isWaitNeeded())
+                    {
+                        if (!waitForSocket(fd, POLLIN)) break;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                Socket::closeSocket(fd);
+
+                if (response.compare(0, 12, "HTTP/1.1 200") != 0)
+                {
+                    spdlog::error("Request {} failed: {}", i, response);
+                    success = false;
+                }
+            }
+            httpBench.record();
+            httpBench.setReported();
+
+            seconds = httpBench.getDuration() / 1e6;
+            spdlog::info("{} http requests in {:.3f} s ({:.0f} requests/s)",
+                         count,
+                         seconds,
+                         (seconds > 0) ? count / seconds : 0);
+        }
+
+        httpServer.stop();
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+    //
+    // TLS handshakes accepted per second by a local server, from concurrent clients
+    // opening a new connection for each one. The clients present the server certificate,
+    // which the server verifies when a ca file is given.
+    //
+    int ws_tls_accept_bench(const ix::SocketTLSOptions& tlsOptions,
+                            int count,
+                            int clientCount,
+                            int runCount)
+    {
+        if (count <= 0 || clientCount <= 0)
+        {
+            spdlog::error("Invalid connection or client count");
+            return 1;
+        }
+
+        if (!tlsOptions.hasCertAndKey())
+        {
+            spdlog::error("A certificate and a key are required (--cert-file and --key-file)");
+            return 1;
+        }
+
+        ix::SocketTLSOptions serverTLSOptions(tlsOptions);
+        serverTLSOptions.tls = true;
+        if (serverTLSOptions.isUsingSystemDefaults())
+        {
+            serverTLSOptions.caFile = "NONE";
+        }
+
+        ix::SocketTLSOptions clientTLSOptions(tlsOptions);
+        clientTLSOptions.caFile = "NONE";
+
+        int port = getFreePort();
+        ix::WebSocketServer server(
+            port, "127.0.0.1", SocketServer::kDefaultTcpBacklog, (size_t) count + 1);
+        server.setTLSOptions(serverTLSOptions);
+        server.disablePerMessageDeflate();
+        server.setOnClientMessageCallback(
+            [](std::shared_ptr<ConnectionState> /*connectionState*/,
+               WebSocket& /*webSocket*/,
+               const WebSocketMessagePtr& /*msg*/) {});
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
+
+        bool success = true;
+
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            std::atomic<int> next(0);
+            std::atomic<int> failures(0);
+            std::mutex errMsgMutex;
+            std::string firstErrMsg;
+
+            auto sessionStats = getTLSSessionStats();
+            ix::Bench bench("TLS accepts");
+            std::vector<std::thread> clients;
+            for (int i = 0; i < clientCount; ++i)
+            {
+                clients.emplace_back([&] {
+                    while (next++ < count)
+                    {
+                        std::string errMsg;
+                        auto socket = createSocket(true, -1, errMsg, clientTLSOptions);
+                        std::atomic<bool> requestInitCancellation(false);
+                        auto isCancellationRequested =
+                            makeCancellationRequestWithTimeout(10, requestInitCancellation);
+
+                        if (!socket ||
+                            !socket->connect("127.0.0.1", port, errMsg, isCancellationRequested))
+                        {
+                            std::lock_guard<std::mutex> lock(errMsgMutex);
+                            if (failures++ == 0) firstErrMsg = errMsg;
+                        }
+                    }
+                });
+            }
+            for (auto&& client : clients)
+            {
+                client.join();
+            }
+            bench.record();
+            bench.setReported();
+
+            if (failures > 0)
+            {
+                spdlog::error("{} handshakes failed: {}", (int) failures, firstErrMsg);
+                success = false;
+                break;
+            }
+
+            double seconds = bench.getDuration() / 1e6;
+            spdlog::info("{} TLS handshakes from {} clients in {:.3f} s ({:.0f} accepts/s)",
+                         count,
+                         clientCount,
+                         seconds,
+                         (seconds > 0) ? count / seconds : 0);
+            spdlog::info("{} handshakes resumed a session",
+                         getTLSSessionStats().serverResumedHandshakes -
+                             sessionStats.serverResumedHandshakes);
+        }
+
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+    //
+    // Echo large binary messages over a secure WebSocket on the loopback interface,
+    // with the records encrypted in user space by OpenSSL, then by the kernel (kTLS).
+    //
+    int ws_ktls_bench(const ix::SocketTLSOptions& tlsOptions,
+                      int msgSize,
+                      int messageCount,
+                      int runCount)
+    {
+        if (msgSize <= 0 || messageCount <= 0)
+        {
+            spdlog::error("Invalid message size or count");
+            return 1;
+        }
+
+        if (!tlsOptions.hasCertAndKey())
+        {
+            spdlog::error("A certificate and a key are required (--cert-file and --key-file)");
+            return 1;
+        }
+
+        std::string payload((size_t) msgSize, 0);
+        for (size_t i = 0; i < payload.size(); ++i)
+        {
+            payload[i] = (char) (i * 31);
+        }
+
+        const int kMaxInFlight = 4;
+        bool success = true;
+
+        for (bool enableKernelTLS : {false, true})
+        {
+            ix::SocketTLSOptions serverTLSOptions(tlsOptions);
+            serverTLSOptions.tls = true;
+            serverTLSOptions.enable_ktls = enableKernelTLS;
+            if (serverTLSOptions.isUsingSystemDefaults())
+            {
+                serverTLSOptions.caFile = "NONE";
+            }
+
+            ix::SocketTLSOptions clientTLSOptions(tlsOptions);
+            clientTLSOptions.caFile = "NONE";
+            clientTLSOptions.enable_ktls = enableKernelTLS;
+
+            int port = getFreePort();
+            ix::WebSocketServer server(port, "127.0.0.1");
+            server.setTLSOptions(serverTLSOptions);
+            server.disablePerMessageDeflate();
+            server.setOnClientMessageCallback(
+                [](std::shared_ptr<ConnectionState> /*connectionState*/,
+                   WebSocket& webSocket,
+                   const WebSocketMessagePtr& msg) {
+                    if (msg->type == ix::WebSocketMessageType::Message)
+                    {
+                        webSocket.send(msg->str, msg->binary);
+                    }
+                });
+
+            auto res = server.listen();
+            if (!res.first)
+            {
+                spdlog::error(res.second);
+                return 1;
+            }
+            server.start();
+
+            auto statsBefore = getTLSSessionStats();
+
+            std::mutex receivedMutex;
+            std::condition_variable receivedCondition;
+            int received = 0;
+            std::atomic<bool> open(false);
+
+            ix::WebSocket webSocket;
+            webSocket.setUrl("wss://127.0.0.1:" + std::to_string(port) + "/");
+            webSocket.setTLSOptions(clientTLSOptions);
+            webSocket.disableAutomaticReconnection();
+            webSocket.disablePerMessageDeflate();
+            webSocket.setOnMessageCallback([&](const ix::WebSocketMessagePtr& msg) {
+                if (msg->type == ix::WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == ix::WebSocketMessageType::Message)
+                {
+                    std::lock_guard<std::mutex> lock(receivedMutex);
+                    received++;
+                    receivedCondition.notify_one();
+                }
+            });
+            webSocket.start();
+
+            for (int i = 0; i < 500 && !open; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            if (!open)
+            {
+                spdlog::error("Cannot connect to the local server");
+                server.stop();
+                return 1;
+            }
+
+            // Both directions go through the same kind of sockets
+            int kernelTLSConnections =
+                (int) (getTLSSessionStats().kernelTLSConnections -
+                       statsBefore.kernelTLSConnections);
+            spdlog::info("{}: {} of 2 connections use kTLS",
+                         enableKernelTLS ? "kTLS requested" : "User space TLS",
+                         kernelTLSConnections);
+
+            for (int run = 0; run < runCount && success; ++run)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(receivedMutex);
+                    received = 0;
+                }
+
+                ix::Bench bench("Echo");
+                for (int i = 0; i < messageCount; ++i)
+                {
+                    // Sends block while the peer is blocked sending its echoes, so only a
+                    // few messages are in flight
+                    {
+                        std::unique_lock<std::mutex> lock(receivedMutex);
+                        if (!receivedCondition.wait_for(lock, std::chrono::seconds(60), [&] {
+                                return i - received < kMaxInFlight;
+                            }))
+                        {
+                            spdlog::error("Timeout waiting for {} echoes", i - received);
+                            success = false;
+                            break;
+                        }
+                    }
+
+                    if (!webSocket.sendBinary(payload).success)
+                    {
+                        spdlog::error("Cannot send message {}", i);
+                        success = false;
+                        break;
+                    }
+                }
+
+                std::unique_lock<std::mutex> lock(receivedMutex);
+                if (success && !receivedCondition.wait_for(lock, std::chrono::seconds(60), [&] {
+                        return received == messageCount;
+                    }))
+                {
+                    spdlog::error("Timeout waiting for {} echoes", messageCount - received);
+                    success = false;
+                }
+                lock.unlock();
+
+                bench.record();
+                bench.setReported();
+                if (!success) break;
+
+                // Each message goes to the server and back
+                double seconds = bench.getDuration() / 1e6;
+                double megaBytes = 2.0 * msgSize * messageCount / (1024 * 1024);
+                spdlog::info("{} messages of {} bytes echoed in {:.3f} s ({:.0f} MB/s)",
+                             messageCount,
+                             msgSize,
+                             seconds,
+                             (seconds > 0) ? megaBytes / seconds : 0);
+            }
+
+            webSocket.stop();
+            server.stop();
+
+            if (!success) break;
+        }
+
+        return success ? 0 : 1;
+    }
+
+    int ws_http_bench(int clientCount, int requestCount, int pipelineDepth, int runCount)
+    {
+        if (clientCount <= 0 || requestCount <= 0 || pipelineDepth <= 0)
+        {
+            spdlog::error("Invalid client, request count or pipeline depth");
+            return 1;
+        }
+
+        int port = getFreePort();
+        int backlog = 1024;
+        ix::HttpServer server(port, "127.0.0.1", backlog, (size_t) clientCount + 1);
+        server.enableKeepAlive(5, requestCount);
+        server.setOnConnectionCallback(
+            [](HttpRequestPtr /*request*/,
+               std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+                WebSocketHttpHeaders headers;
+                headers["Content-Type"] = "text/plain";
+                return std::make_shared<HttpResponse>(
+                    200, "OK", HttpErrorCode::Ok, headers, std::string("ok"));
+            });
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
+
+        const std::string request("GET / HTTP/1.1\r\n"
+                                  "Host: 127.0.0.1\r\n"
+                                  "User-Agent: ws http_bench\r\n"
+                                  "\r\n");
+        const std::string closeRequest("GET / HTTP/1.1\r\n"
+                                       "Host: 127.0.0.1\r\n"
+                                       "User-Agent: ws http_bench\r\n"
+                                       "Connection: close\r\n"
+                                       "\r\n");
+
+        // Each client sends requestCount requests, on a new connection per request or
+        // on a single persistent connection, pipelineDepth requests at a time
+        auto runClient = [&](bool keepAlive, std::vector<double>& latencies) -> bool {
+            std::string errMsg;
+            std::string buffer;
+            std::string response;
+            int fd = -1;
+
+            for (int i = 0; i < requestCount;)
+            {
+                if (fd == -1)
+                {
+                    fd = connectLocal(port, errMsg);
+                    if (fd == -1) return false;
+                    buffer.clear();
+                }
+
+                int batch = keepAlive ? std::min(pipelineDepth, requestCount - i) : 1;
+                std::string requests;
+                for (int j = 0; j < batch; ++j)
+                {
+                    requests += keepAlive ? request : closeRequest;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                if (!sendAll(fd, requests)) break;
+
+                for (int j = 0; j < batch; ++j)
+                {
+                    if (!recvHttpResponse(fd, buffer, response) ||
+                        response.compare(0, 12, "HTTP/1.1 200") != 0)
+                    {
+                        Socket::closeSocket(fd);
+                        return false;
+                    }
+
+                    auto now = std::chrono::steady_clock::now();
+                    latencies.push_back(
+                        std::chrono::duration_cast<std::chrono::microseconds>(now - start)
+                            .count() /
+                        1e3);
+                }
+                i += batch;
+
+                if (!keepAlive || response.find("Connection: close") != std::string::npos)
+                {
+                    Socket::closeSocket(fd);
+                    fd = -1;
+                }
+            }
+
+            if (fd != -1) Socket::closeSocket(fd);
+            return true;
+        };
+
+        bool success = true;
+
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            for (bool keepAlive : {false, true})
+            {
+                std::vector<std::vector<double>> latencies((size_t) clientCount);
+                std::atomic<int> failures(0);
+                std::vector<std::thread> clients;
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < clientCount; ++i)
+                {
+                    clients.emplace_back([&, i]() {
+                        if (!runClient(keepAlive, latencies[(size_t) i])) failures++;
+                    });
+                }
+                for (auto&& client : clients)
+                {
+                    client.join();
+                }
+                double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count() /
+                                 1e6;
+
+                if (failures > 0)
+                {
+                    spdlog::error("{} clients failed", failures.load());
+                    success = false;
+                    break;
+                }
+
+                std::vector<double> allLatencies;
+                for (auto&& clientLatencies : latencies)
+                {
+                    allLatencies.insert(
+                        allLatencies.end(), clientLatencies.begin(), clientLatencies.end());
+                }
+
+                spdlog::info("{}: {} clients x {} requests in {:.3f} s ({:.0f} requests/s), "
+                             "latency p50 {:.3f} ms p99 {:.3f} ms max {:.3f} ms",
+                             keepAlive ? "keep-alive" : "close",
+                             clientCount,
+                             requestCount,
+                             seconds,
+                             (seconds > 0) ? allLatencies.size() / seconds : 0,
+                             percentile(allLatencies, 0.5),
+                             percentile(allLatencies, 0.99),
+                             percentile(allLatencies, 1.0));
+            }
+        }
+
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+    int ws_http_client_bench(int requestCount, int workerCount, int delayMs, int runCount)
+    {
+        if (requestCount <= 0 || workerCount <= 0 || delayMs < 0)
+        {
+            spdlog::error("Invalid request count, worker count or delay");
+            return 1;
+        }
+
+        // Every response is delayed, like a slow upstream service
+        int port = getFreePort();
+        int backlog = 1024;
+        ix::HttpServer server(port, "127.0.0.1", backlog, (size_t) workerCount + 1);
+        server.setOnConnectionCallback(
+            [delayMs](HttpRequestPtr /*request*/,
+                      std::shared_ptr<ConnectionState> /*connectionState*/) -> HttpResponsePtr {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+
+                WebSocketHttpHeaders headers;
+                headers["Content-Type"] = "text/plain";
+                return std::make_shared<HttpResponse>(
+                    200, "OK", HttpErrorCode::Ok, headers, std::string("ok"));
+            });
+
+        auto res = server.listen();
+        if (!res.first)
+        {
+            spdlog::error(res.second);
+            return 1;
+        }
+        server.start();
+
+        std::string url("http://127.0.0.1:" + std::to_string(port) + "/");
+        bool success = true;
+
+        for (int run = 0; run < runCount && success; ++run)
+        {
+            // A single worker thread is how the async client used to run requests
+            for (int workers : {1, workerCount})
+            {
+                bool async = true;
+                HttpClient httpClient(async, (size_t) workers);
+
+                std::mutex mutex;
+                std::condition_variable condition;
+                std::vector<double> latencies;
+                int completed = 0;
+                int failures = 0;
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < requestCount; ++i)
+                {
+                    auto args = httpClient.createRequest(url);
+                    auto submitTime = std::chrono::steady_clock::now();
+
+                    httpClient.performRequest(
+                        args, [&, submitTime](const HttpResponsePtr& response) {
+                            auto now = std::chrono::steady_clock::now();
+
+                            std::lock_guard<std::mutex> lock(mutex);
+                            latencies.push_back(
+                                std::chrono::duration_cast<std::chrono::microseconds>(
+                                    now - submitTime)
+                                    .count() /
+                                1e3);
+                            if (response->errorCode != HttpErrorCode::Ok) failures++;
+                            if (++completed == requestCount) condition.notify_one();
+                        });
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [&] { return completed == requestCount; });
+                }
+
+                double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count() /
+                                 1e6;
+
+                if (failures > 0)
+                {
+                    spdlog::error("{} requests failed", failures);
+                    success = false;
+                    break;
+                }
+
+                spdlog::info("{} workers: {} requests in {:.3f} s ({:.0f} requests/s), "
+                             "latency p50 {:.1f} ms p99 {:.1f} ms max {:.1f} ms",
+                             workers,
+                             requestCount,
+                             seconds,
+                             (seconds > 0) ? requestCount / seconds : 0,
+                             percentile(latencies, 0.5),
+                             percentile(latencies, 0.99),
+                             percentile(latencies, 1.0));
+            }
+        }
+
+        server.stop();
+
+        return success ? 0 : 1;
+    }
+
+    //
+    // Compress and decompress a file with the one-shot gzip helpers, which hold the
+    // whole input and output in memory, and with GzipStream, which processes the file
+    // in pieces. The streaming codec runs first, since the peak RSS only grows.
+    //
+    int ws_gzip_bench(const std::string& filename, int runCount)
+    {
+        const size_t pieceSize = 64 * 1024;
+        std::string compressedFilename(filename + ".bench.gz");
+
+        auto getSeconds = [](std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count() /
+                   1e6;
+        };
+
+        // Pass a file to a stream in pieces, and return the size of the output
+        auto runStream =
+            [pieceSize](GzipStream& stream, const std::string& input, std::ofstream* output) {
+                int64_t outputSize = 0;
+                auto onOutput = [&](const char* data, size_t size) -> bool {
+                    outputSize += size;
+                    if (output) output->write(data, size);
+                    return true;
+                };
+
+                std::ifstream file(input, std::ios::binary);
+                std::vector<char> piece(pieceSize);
+                while (file)
+                {
+                    file.read(piece.data(), piece.size());
+                    if (file.gcount() > 0 &&
+                        !stream.write(piece.data(), (size_t) file.gcount(), onOutput))
+                    {
+                        return (int64_t) -1;
+                    }
+                }
+                return stream.finish(onOutput) ? outputSize : (int64_t) -1;
+            };
+
+        std::ifstream input(filename, std::ios::binary | std::ios::ate);
+        if (!input.is_open())
+        {
+            spdlog::error("Cannot read content of {}", filename);
+            return 1;
+        }
+        double inputMegaBytes = input.tellg() / (1024. * 1024.);
+        input.close();
+
+        int64_t baselinePeakRss = readProcStatus("VmHWM");
+        spdlog::info("gzip bench: {} ({:.1f} MB), {} runs, baseline peak RSS {} KB",
+                     filename,
+                     inputMegaBytes,
+                     runCount,
+                     baselinePeakRss);
+
+        // The streams are reused by every run
+        GzipStream compressor(GzipStream::Mode::Compress);
+        GzipStream decompressor(GzipStream::Mode::Decompress);
+
+        for (int run = 0; run < runCount; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            int64_t compressedSize = -1;
+            {
+                std::ofstream output(compressedFilename, std::ios::binary);
+                if (compressor.reset())
+                {
+                    compressedSize = runStream(compressor, filename, &output);
+                }
+            }
+            double compressSeconds = getSeconds(start);
+
+            start = std::chrono::steady_clock::now();
+            int64_t decompressedSize = -1;
+            if (decompressor.reset())
+            {
+                decompressedSize = runStream(decompressor, compressedFilename, nullptr);
+            }
+            double decompressSeconds = getSeconds(start);
+
+            if (compressedSize < 0 || decompressedSize < 0)
+            {
+                spdlog::error("Streaming codec failed");
+                std::remove(compressedFilename.c_str());
+                return 1;
+            }
+
+            spdlog::info("streaming: compress {:.1f} MB/s decompress {:.1f} MB/s "
+                         "ratio {:.2f} peak RSS {} KB",
+                         inputMegaBytes / compressSeconds,
+                         inputMegaBytes / decompressSeconds,
+                         (double) decompressedSize / compressedSize,
+                         readProcStatus("VmHWM"));
+        }
+        std::remove(compressedFilename.c_str());
+
+        for (int run = 0; run < runCount; ++run)
+        {
+            // readAsString is not used, it skips whitespace
+            auto start = std::chrono::steady_clock::now();
+            std::ifstream file(filename, std::ios::binary | std::ios::ate);
+            std::string content((size_t) file.tellg(), '\0');
+            file.seekg(0);
+            file.read(&content[0], content.size());
+            std::string compressedBytes = gzipCompress(content);
+            double compressSeconds = getSeconds(start);
+
+            start = std::chrono::steady_clock::now();
+            std::string decompressedBytes;
+            bool ok = gzipDecompress(compressedBytes, decompressedBytes);
+            double decompressSeconds = getSeconds(start);
+
+            if (!ok || decompressedBytes != content)
+            {
+                spdlog::error("One-shot codec failed");
+                return 1;
+            }
+
+            spdlog::info("one-shot:  compress {:.1f} MB/s decompress {:.1f} MB/s "
+                         "ratio {:.2f} peak RSS {} KB",
+                         inputMegaBytes / compressSeconds,
+                         inputMegaBytes / decompressSeconds,
+                         (double) decompressedBytes.size() / compressedBytes.size(),
+                         readProcStatus("VmHWM"));
+        }
+
+        return 0;
+    }
+} // namespace ix
+
+int main(int argc, char** argv)
+{
+    ix::setThreadName("ws main thread");
+    ix::initNetSystem();
+
+    spdlog::set_level(spdlog::level::debug);
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    // Display command.
+    if (getenv("DEBUG"))
+    {
+        std::stringstream ss;
+        ss << "Command: ";
+        for (int i = 0; i < argc; ++i)
+        {
+            ss << argv[i] << " ";
+        }
+        spdlog::info(ss.str());
+    }
+
+    CLI::App app {"ws is a websocket tool"};
+
+    std::string url("ws://127.0.0.1:8008");
+    std::string path;
+    std::string user;
+    std::string data;
+    std::string formData;
+    std::string binaryData;
+    std::string headers;
+    std::string output;
+    std::string hostname("127.0.0.1");
+    std::string pidfile;
+    std::string channel;
+    std::string filter;
+    std::string position;
+    std::string message;
+    std::string timer;
+    std::string configPath;
+    std::string subprotocol;
+    std::string remoteHost;
+    std::string logfile;
+    std::string moduleName;
+    std::string republishChannel;
+    std::string publisherRolename;
+    std::string publisherRolesecret;
+    std::string sendMsg("hello world");
+    std::string filename;
+    std::string httpHeaderAuthorization;
+    ix::SocketTLSOptions tlsOptions;
+    std::string ciphers;
+    std::string redirectUrl;
+    bool headersOnly = false;
+    bool followRedirects = false;
+    bool verbose = false;
+    bool save = false;
+    bool quiet = false;
+    bool compress = false;
+    bool compressRequest = false;
+    bool disableAutomaticReconnection = false;
+    bool disablePerMessageDeflate = false;
+    bool greetings = false;
+    bool ipv6 = false;
+    bool binaryMode = false;
+    bool redirect = false;
+    bool version = false;
+    bool verifyNone = false;
+    bool disablePong = false;
+    bool debug = false;
+    int port = 8008;
+    int connectTimeOut = 60;
+    int transferTimeout = 1800;
+    int maxRedirects = 5;
+    int delayMs = -1;
+    int msgCount = 1000 * 1000;
+    uint32_t maxWaitBetweenReconnectionRetries = 10 * 1000; // 10 seconds
+    int pingIntervalSecs = 30;
+    int runCount = 1;
+    bool decompressGzipMessages = false;
+    int connections = 1000;
+    int ioThreads = 0;
+    int msgSize = 64;
+    int largeMsgSize = 1024 * 1024;
+    int frameCount = 1000000;
+    int messageCount = 100;
+    int clientCount = 16;
+    int requestCount = 1000;
+    int pipelineDepth = 1;
+    int workerCount = 100;
+    int responseDelayMs = 10;
+    bool gzipBench = false;
+
+    auto addGenericOptions = [&pidfile](CLI::App* app) {
+        app->add_option("--pidfile", pidfile, "Pid file");
+    };
+
+    auto addTLSOptions = [&tlsOptions, &verifyNone](CLI::App* app) {
+        app->add_option(
+               "--cert-file", tlsOptions.certFile, "Path to the (PEM format) TLS cert file")
+            ->check(CLI::ExistingPath);
+        app->add_option("--key-file", tlsOptions.keyFile, "Path to the (PEM format) TLS key file")
+            ->check(CLI::ExistingPath);
+        app->add_option("--ca-file", tlsOptions.caFile, "Path to the (PEM format) ca roots file")
+            ->check(CLI::ExistingPath);
+        app->add_option("--ciphers",
+                        tlsOptions.ciphers,
+                        "A (comma/space/colon) separated list of ciphers to use for TLS");
+        app->add_flag("--tls", tlsOptions.tls, "Enable TLS (server only)");
+        app->add_flag("--verify_none", verifyNone, "Disable peer cert verification");
+        app->add_flag("--disable-hostname-validation", tlsOptions.disable_hostname_validation, "Disable validation of certificates' hostnames");
+        app->add_flag("--disable_session_resumption",
+                      tlsOptions.disable_session_resumption,
+                      "Do a full handshake for each connection");
+        app->add_flag("--ktls",
+                      tlsOptions.enable_ktls,
+                      "Let the kernel encrypt the TLS records when supported");
+    };
+
+    app.add_flag("--version", version, "Print ws version");
+    app.add_option("--logfile", logfile, "path where all logs will be redirected");
+
+    CLI::App* sendApp = app.add_subcommand("send", "Send a file");
+    sendApp->fallthrough();
+    sendApp->add_option("url", url, "Connection url")->required();
+    sendApp->add_option("path", path, "Path to the file to send")
+        ->required()
+        ->check(CLI::ExistingPath);
+    sendApp->add_flag("-x", disablePerMessageDeflate, "Disable per message deflate");
+    addGenericOptions(sendApp);
+    addTLSOptions(sendApp);
+
+    CLI::App* receiveApp = app.add_subcommand("receive", "Receive a file");
+    receiveApp->fallthrough();
+    receiveApp->add_option("url", url, "Connection url")->required();
+    receiveApp->add_option("--delay",
+                           delayMs,
+                           "Delay (ms) to wait after receiving a fragment"
+                           " to artificially slow down the receiver");
+    receiveApp->add_option("--pidfile", pidfile, "Pid file");
+    addTLSOptions(receiveApp);
+
+    CLI::App* transferApp = app.add_subcommand("transfer", "Broadcasting server");
+    transferApp->fallthrough();
+    transferApp->add_option("--port", port, "Connection url");
+    transferApp->add_option("--host", hostname, "Hostname");
+    transferApp->add_option("--pidfile", pidfile, "Pid file");
+    addTLSOptions(transferApp);
+
+    CLI::App* connectApp = app.add_subcommand("connect", "Connect to a remote server");
+    connectApp->fallthrough();
+    connectApp->add_option("url", url, "Connection url")->required();
+    connectApp->add_option("-H", headers, "Header")->join();
+    connectApp->add_flag("-d", disableAutomaticReconnection, "Disable Automatic Reconnection");
+    connectApp->add_flag("-x", disablePerMessageDeflate, "Disable per message deflate");
+    connectApp->add_flag("-b", binaryMode, "Send in binary mode");
+    connectApp->add_option("--max_wait",
+                           maxWaitBetweenReconnectionRetries,
+                           "Max Wait Time between reconnection retries");
+    connectApp->add_option("--ping_interval", pingIntervalSecs, "Interval between sending pings");
+    connectApp->add_option("--subprotocol", subprotocol, "Subprotocol");
+    connectApp->add_flag("-g", decompressGzipMessages, "Decompress gziped messages");
+    addGenericOptions(connectApp);
     addTLSOptions(connectApp);
 
     CLI::App* echoClientApp = app.add_subcommand("autoroute", "Test websocket client performance");
@@ -2652,11 +4510,97 @@ int main(int argc, char** argv)
     gzipApp->fallthrough();
     gzipApp->add_option("filename", filename, "Filename")->required();
     gzipApp->add_option("--run_count", runCount, "Number of time to run the compression");
+    gzipApp->add_flag(
+        "--bench", gzipBench, "Compare the throughput and memory of the one-shot and streaming codecs");
 
     CLI::App* gunzipApp = app.add_subcommand("gunzip", "Gzip decompressor");
     gunzipApp->fallthrough();
     gunzipApp->add_option("filename", filename, "Filename")->required();
 
+    CLI::App* serverBenchApp = app.add_subcommand(
+        "server_bench", "Server memory and latency with many idle or active connections");
+    serverBenchApp->fallthrough();
+    serverBenchApp->add_option("--connections", connections, "Number of client connections");
+    serverBenchApp->add_option(
+        "--io_threads", ioThreads, "Event loop I/O threads, 0 for one thread per connection");
+    serverBenchApp->add_option("--msg_size", msgSize, "Size of the echoed messages");
+    serverBenchApp->add_option(
+        "--run_count", runCount, "Number of rounds where every connection sends a message");
+
+    CLI::App* dispatchBenchApp = app.add_subcommand(
+        "dispatch_bench", "Server frame parsing throughput with many small frames");
+    dispatchBenchApp->fallthrough();
+    dispatchBenchApp->add_option("--frames", frameCount, "Number of frames to send");
+    dispatchBenchApp->add_option("--msg_size", msgSize, "Size of the frames payload");
+    dispatchBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* deflateBenchApp = app.add_subcommand(
+        "deflate_bench", "Per message deflate throughput with JSON and random payloads");
+    deflateBenchApp->fallthrough();
+    deflateBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* codecBenchApp = app.add_subcommand(
+        "codec_bench", "Compression codecs speed and ratio on small JSON messages");
+    codecBenchApp->fallthrough();
+    codecBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* maskBenchApp = app.add_subcommand("mask_bench", "Frame masking throughput");
+    maskBenchApp->fallthrough();
+    maskBenchApp->add_option("--size", msgSize, "Size of the masked buffer");
+    maskBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* broadcastBenchApp = app.add_subcommand(
+        "broadcast_bench", "Server broadcast throughput and cpu usage with many connections");
+    broadcastBenchApp->fallthrough();
+    broadcastBenchApp->add_option("--connections", connections, "Number of client connections");
+    broadcastBenchApp->add_option(
+        "--io_threads", ioThreads, "Event loop I/O threads, 0 for one thread per connection");
+    broadcastBenchApp->add_option("--msg_size", msgSize, "Size of the broadcasted messages");
+    broadcastBenchApp->add_option("--messages", messageCount, "Number of messages per round");
+    broadcastBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* handshakeBenchApp = app.add_subcommand(
+        "handshake_bench", "WebSocket handshakes and HTTP requests per second");
+    handshakeBenchApp->fallthrough();
+    handshakeBenchApp->add_option(
+        "--connections", connections, "Number of handshakes and http requests");
+    handshakeBenchApp->add_option(
+        "--io_threads", ioThreads, "Event loop I/O threads, 0 for one thread per connection");
+    handshakeBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* tlsAcceptBenchApp = app.add_subcommand(
+        "tls_accept_bench", "TLS handshakes accepted per second by a local server");
+    tlsAcceptBenchApp->fallthrough();
+    tlsAcceptBenchApp->add_option("--connections", connections, "Number of TLS handshakes");
+    tlsAcceptBenchApp->add_option("--clients", clientCount, "Number of concurrent clients");
+    tlsAcceptBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+    addTLSOptions(tlsAcceptBenchApp);
+
+    CLI::App* kTLSBenchApp = app.add_subcommand(
+        "ktls_bench", "Large secure WebSocket messages throughput, with and without kTLS");
+    kTLSBenchApp->fallthrough();
+    kTLSBenchApp->add_option("--msg_size", largeMsgSize, "Size of the echoed messages");
+    kTLSBenchApp->add_option("--messages", messageCount, "Number of messages per run");
+    kTLSBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+    addTLSOptions(kTLSBenchApp);
+
+    CLI::App* httpBenchApp = app.add_subcommand(
+        "http_bench", "HTTP server requests per second and latency, with and without keep-alive");
+    httpBenchApp->fallthrough();
+    httpBenchApp->add_option("--clients", clientCount, "Number of concurrent clients");
+    httpBenchApp->add_option("--requests", requestCount, "Number of requests per client");
+    httpBenchApp->add_option(
+        "--pipeline", pipelineDepth, "Number of requests sent at once on keep-alive connections");
+    httpBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
+    CLI::App* httpClientBenchApp = app.add_subcommand(
+        "http_client_bench", "Async HTTP client requests against a slow local server");
+    httpClientBenchApp->fallthrough();
+    httpClientBenchApp->add_option("--requests", requestCount, "Number of queued requests");
+    httpClientBenchApp->add_option("--workers", workerCount, "Number of client worker threads");
+    httpClientBenchApp->add_option("--delay_ms", responseDelayMs, "Server response delay");
+    httpClientBenchApp->add_option("--run_count", runCount, "Number of time to run the benchmark");
+
     CLI11_PARSE(app, argc, argv);
 
     // pid file handling
@@ -2861,12 +4805,56 @@ int main(int argc, char** argv)
     }
     else if (app.got_subcommand("gzip"))
     {
-        ret = ix::ws_gzip(filename, runCount);
+        ret = gzipBench ? ix::ws_gzip_bench(filename, runCount) : ix::ws_gzip(filename, runCount);
     }
     else if (app.got_subcommand("gunzip"))
     {
         ret = ix::ws_gunzip(filename);
     }
+    else if (app.got_subcommand("server_bench"))
+    {
+        ret = ix::ws_server_bench(connections, ioThreads, msgSize, runCount);
+    }
+    else if (app.got_subcommand("dispatch_bench"))
+    {
+        ret = ix::ws_dispatch_bench(frameCount, msgSize, runCount);
+    }
+    else if (app.got_subcommand("deflate_bench"))
+    {
+        ret = ix::ws_deflate_bench(runCount);
+    }
+    else if (app.got_subcommand("codec_bench"))
+    {
+        ret = ix::ws_codec_bench(runCount);
+    }
+    else if (app.got_subcommand("mask_bench"))
+    {
+        ret = ix::ws_mask_bench(msgSize, runCount);
+    }
+    else if (app.got_subcommand("broadcast_bench"))
+    {
+        ret = ix::ws_broadcast_bench(connections, ioThreads, msgSize, messageCount, runCount);
+    }
+    else if (app.got_subcommand("handshake_bench"))
+    {
+        ret = ix::ws_handshake_bench(connections, ioThreads, runCount);
+    }
+    else if (app.got_subcommand("tls_accept_bench"))
+    {
+        ret = ix::ws_tls_accept_bench(tlsOptions, connections, clientCount, runCount);
+    }
+    else if (app.got_subcommand("ktls_bench"))
+    {
+        ret = ix::ws_ktls_bench(tlsOptions, largeMsgSize, messageCount, runCount);
+    }
+    else if (app.got_subcommand("http_bench"))
+    {
+        ret = ix::ws_http_bench(clientCount, requestCount, pipelineDepth, runCount);
+    }
+    else if (app.got_subcommand("http_client_bench"))
+    {
+        ret = ix::ws_http_client_bench(requestCount, workerCount, responseDelayMs, runCount);
+    }
     else if (version)
     {
         std::cout << "ws " << ix::userAgent() << std::endl;